@@ -81,7 +81,8 @@ static const GDebugKey gdk_debug_keys[] = {
   {"multihead",	    GDK_DEBUG_MULTIHEAD},
   {"xinerama",	    GDK_DEBUG_XINERAMA},
   {"draw",	    GDK_DEBUG_DRAW},
-  {"eventloop",	    GDK_DEBUG_EVENTLOOP}
+  {"eventloop",	    GDK_DEBUG_EVENTLOOP},
+  {"paint-profile",  GDK_DEBUG_PAINT_PROFILE}
 };
 
 static const int gdk_ndebug_keys = G_N_ELEMENTS (gdk_debug_keys);
@@ -206,6 +207,8 @@ gdk_pre_parse_libgtk_only (void)
   }
 #endif	/* G_ENABLE_DEBUG */
 
+  _gdk_paint_profile_init ();
+
   if (getenv ("GDK_NATIVE_WINDOWS"))
     {
       _gdk_native_windows = TRUE;
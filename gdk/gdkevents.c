@@ -199,6 +199,224 @@ _gdk_event_queue_remove_link (GdkDisplay *display,
     display->queued_tail = node->prev;
 }
 
+/* Returns the GdkEventCompression flag that applies to @event, or 0 if
+ * the window of @event doesn't want it merged with other events.
+ */
+static GdkEventCompression
+event_get_compression (GdkEvent *event)
+{
+  GdkWindowObject *private;
+
+  if (event->any.window == NULL ||
+      (((GdkEventPrivate *)event)->flags & GDK_EVENT_PENDING))
+    return 0;
+
+  private = (GdkWindowObject *) event->any.window;
+
+  switch (event->type)
+    {
+    case GDK_MOTION_NOTIFY:
+      return private->event_compression & GDK_EVENT_COMPRESS_MOTION;
+    case GDK_SCROLL:
+      return private->event_compression & GDK_EVENT_COMPRESS_SCROLL;
+    case GDK_CONFIGURE:
+      return private->event_compression & GDK_EVENT_COMPRESS_CONFIGURE;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * _gdk_event_queue_tail_is_compressible:
+ * @display: a #GdkDisplay
+ *
+ * Checks whether the last event on the queue may still be merged
+ * with a following event. Backends use this to keep reading already
+ * pending events from the windowing system before dispatching.
+ *
+ * Return value: %TRUE if the last event is compressible.
+ **/
+gboolean
+_gdk_event_queue_tail_is_compressible (GdkDisplay *display)
+{
+  if (display->queued_tail == NULL)
+    return FALSE;
+
+  return event_get_compression (display->queued_tail->data) != 0;
+}
+
+static void
+motion_history_append (GdkEventPrivate *private,
+		       GdkEventMotion  *motion)
+{
+  GdkTimeCoord *coord;
+  gint i;
+
+  coord = g_new0 (GdkTimeCoord, 1);
+  coord->time = motion->time;
+
+  if (motion->axes && motion->device)
+    {
+      for (i = 0; i < MIN (motion->device->num_axes, GDK_MAX_TIMECOORD_AXES); i++)
+	coord->axes[i] = motion->axes[i];
+    }
+  else
+    {
+      coord->axes[0] = motion->x;
+      coord->axes[1] = motion->y;
+    }
+
+  if (private->motion_history == NULL)
+    private->motion_history = g_ptr_array_new ();
+  g_ptr_array_add (private->motion_history, coord);
+}
+
+static gboolean
+merge_motion (GdkEvent *old_event,
+	      GdkEvent *event)
+{
+  GdkEventPrivate *old_private = (GdkEventPrivate *) old_event;
+  GdkEventPrivate *private = (GdkEventPrivate *) event;
+  guint i;
+
+  if (old_event->motion.device != event->motion.device ||
+      old_event->motion.state != event->motion.state ||
+      old_event->motion.is_hint || event->motion.is_hint ||
+      old_event->motion.send_event != event->motion.send_event)
+    return FALSE;
+
+  motion_history_append (old_private, &old_event->motion);
+  if (private->motion_history)
+    {
+      for (i = 0; i < private->motion_history->len; i++)
+	g_ptr_array_add (old_private->motion_history,
+			 g_ptr_array_index (private->motion_history, i));
+      g_ptr_array_free (private->motion_history, TRUE);
+      private->motion_history = NULL;
+    }
+
+  old_event->motion.time = event->motion.time;
+  old_event->motion.x = event->motion.x;
+  old_event->motion.y = event->motion.y;
+  old_event->motion.x_root = event->motion.x_root;
+  old_event->motion.y_root = event->motion.y_root;
+
+  g_free (old_event->motion.axes);
+  old_event->motion.axes = event->motion.axes;
+  event->motion.axes = NULL;
+
+  return TRUE;
+}
+
+static gboolean
+merge_scroll (GdkEvent *old_event,
+	      GdkEvent *event)
+{
+  if (old_event->scroll.direction != event->scroll.direction ||
+      old_event->scroll.device != event->scroll.device ||
+      old_event->scroll.state != event->scroll.state ||
+      old_event->scroll.send_event != event->scroll.send_event)
+    return FALSE;
+
+  old_event->scroll.time = event->scroll.time;
+  old_event->scroll.x = event->scroll.x;
+  old_event->scroll.y = event->scroll.y;
+  old_event->scroll.x_root = event->scroll.x_root;
+  old_event->scroll.y_root = event->scroll.y_root;
+
+  return TRUE;
+}
+
+/**
+ * _gdk_event_queue_compress_tail:
+ * @display: a #GdkDisplay
+ *
+ * Merges the last event on the queue into an earlier queued event,
+ * if the event window asked for that with
+ * gdk_window_set_event_compression(). Motion and scroll events are
+ * merged into the directly preceding event, configure events replace
+ * any earlier queued configure event of the same window.
+ **/
+void
+_gdk_event_queue_compress_tail (GdkDisplay *display)
+{
+  GdkEventCompression compression;
+  GdkEvent *event, *old_event;
+  GdkWindowObject *private;
+  GList *tail, *l;
+  gboolean merged;
+
+  tail = display->queued_tail;
+  if (tail == NULL)
+    return;
+
+  event = tail->data;
+  compression = event_get_compression (event);
+  if (compression == 0)
+    return;
+
+  merged = FALSE;
+
+  if (compression == GDK_EVENT_COMPRESS_CONFIGURE)
+    {
+      for (l = tail->prev; l != NULL; l = l->prev)
+	{
+	  old_event = l->data;
+
+	  if (old_event->type == GDK_CONFIGURE &&
+	      old_event->any.window == event->any.window &&
+	      !(((GdkEventPrivate *)old_event)->flags & GDK_EVENT_PENDING))
+	    {
+	      /* Keep the new event, it has the current geometry */
+	      ((GdkEventPrivate *)event)->n_merged +=
+		((GdkEventPrivate *)old_event)->n_merged + 1;
+
+	      _gdk_event_queue_remove_link (display, l);
+	      g_list_free_1 (l);
+	      gdk_event_free (old_event);
+	      merged = TRUE;
+	      break;
+	    }
+	}
+    }
+  else if (tail->prev != NULL)
+    {
+      old_event = tail->prev->data;
+
+      if (old_event->type == event->type &&
+	  old_event->any.window == event->any.window &&
+	  event_get_compression (old_event) == compression)
+	{
+	  if (compression == GDK_EVENT_COMPRESS_MOTION)
+	    merged = merge_motion (old_event, event);
+	  else
+	    merged = merge_scroll (old_event, event);
+	}
+
+      if (merged)
+	{
+	  ((GdkEventPrivate *)old_event)->n_merged +=
+	    ((GdkEventPrivate *)event)->n_merged + 1;
+
+	  _gdk_event_queue_remove_link (display, tail);
+	  g_list_free_1 (tail);
+	  gdk_event_free (event);
+	  event = old_event;
+	}
+    }
+
+  if (merged)
+    {
+      private = (GdkWindowObject *) event->any.window;
+      private->n_compressed_events++;
+
+      GDK_NOTE (EVENTS,
+		g_message ("compressed event of type %d for window %p (%u dropped so far)",
+			   event->type, event->any.window,
+			   private->n_compressed_events));
+    }
+}
+
 /**
  * _gdk_event_unqueue:
  * @display: a #GdkDisplay
@@ -446,6 +664,18 @@ gdk_event_copy (const GdkEvent *event)
       GdkEventPrivate *private = (GdkEventPrivate *)event;
 
       new_private->screen = private->screen;
+      new_private->n_merged = private->n_merged;
+
+      if (private->motion_history)
+	{
+	  guint i;
+
+	  new_private->motion_history = g_ptr_array_sized_new (private->motion_history->len);
+	  for (i = 0; i < private->motion_history->len; i++)
+	    g_ptr_array_add (new_private->motion_history,
+			     g_memdup (g_ptr_array_index (private->motion_history, i),
+				       sizeof (GdkTimeCoord)));
+	}
     }
   
   switch (event->any.type)
@@ -568,6 +798,14 @@ gdk_event_free (GdkEvent *event)
 
   _gdk_windowing_event_data_free (event);
 
+  if (((GdkEventPrivate *) event)->motion_history)
+    {
+      GPtrArray *history = ((GdkEventPrivate *) event)->motion_history;
+
+      g_ptr_array_foreach (history, (GFunc) g_free, NULL);
+      g_ptr_array_free (history, TRUE);
+    }
+
   g_hash_table_remove (event_hash, event);
   g_slice_free (GdkEventPrivate, (GdkEventPrivate*) event);
 }
@@ -958,6 +1196,89 @@ gdk_event_request_motions (const GdkEventMotion *event)
     }
 }
 
+/**
+ * gdk_event_get_motion_history:
+ * @event: a #GdkEvent
+ * @events: (out) (array length=n_events) (transfer full): location to
+ *   store a newly-allocated array of #GdkTimeCoord, or %NULL
+ * @n_events: location to store the length of @events, or %NULL
+ *
+ * If other motion events were merged into @event because its window
+ * has %GDK_EVENT_COMPRESS_MOTION set (see
+ * gdk_window_set_event_compression()), retrieves the times and
+ * positions of those earlier events, oldest first. The position of
+ * @event itself is not included.
+ *
+ * The axes are as for gdk_device_get_history(): for extended input
+ * devices they are the device axes, for the core pointer axes[0] and
+ * axes[1] are the x and y coordinates relative to the event window.
+ * Free the array with gdk_device_free_history().
+ *
+ * Return value: %TRUE if @event has a motion history
+ *
+ * Since: 2.24.11
+ **/
+gboolean
+gdk_event_get_motion_history (const GdkEvent   *event,
+			      GdkTimeCoord   ***events,
+			      gint             *n_events)
+{
+  GPtrArray *history;
+  GdkTimeCoord **coords;
+  guint i;
+
+  g_return_val_if_fail (event != NULL, FALSE);
+
+  if (events)
+    *events = NULL;
+  if (n_events)
+    *n_events = 0;
+
+  if (event->type != GDK_MOTION_NOTIFY ||
+      !gdk_event_is_allocated (event))
+    return FALSE;
+
+  history = ((GdkEventPrivate *) event)->motion_history;
+  if (history == NULL || history->len == 0)
+    return FALSE;
+
+  if (events)
+    {
+      coords = g_new (GdkTimeCoord *, history->len);
+      for (i = 0; i < history->len; i++)
+	coords[i] = g_memdup (g_ptr_array_index (history, i), sizeof (GdkTimeCoord));
+      *events = coords;
+    }
+  if (n_events)
+    *n_events = history->len;
+
+  return TRUE;
+}
+
+/**
+ * gdk_event_get_merge_count:
+ * @event: a #GdkEvent
+ *
+ * Returns how many events reported by the windowing system @event
+ * stands for. This is 1, unless events were merged into @event
+ * because of gdk_window_set_event_compression(). For scroll events
+ * this is the number of scroll steps.
+ *
+ * Return value: the number of events @event was merged from
+ *
+ * Since: 2.24.11
+ **/
+guint
+gdk_event_get_merge_count (const GdkEvent *event)
+{
+  g_return_val_if_fail (event != NULL, 1);
+
+  if (!gdk_event_is_allocated (event))
+    return 1;
+
+  return ((GdkEventPrivate *) event)->n_merged + 1;
+}
+
 /**
  * gdk_event_set_screen:
  * @event: a #GdkEvent
@@ -541,6 +541,10 @@ gboolean  gdk_event_get_axis            (const GdkEvent  *event,
                                          GdkAxisUse       axis_use,
                                          gdouble         *value);
 void      gdk_event_request_motions     (const GdkEventMotion *event);
+gboolean  gdk_event_get_motion_history  (const GdkEvent  *event,
+                                         GdkTimeCoord  ***events,
+                                         gint            *n_events);
+guint     gdk_event_get_merge_count     (const GdkEvent  *event);
 void	  gdk_event_handler_set 	(GdkEventFunc    func,
 					 gpointer        data,
 					 GDestroyNotify  notify);
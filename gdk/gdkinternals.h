@@ -86,7 +86,8 @@ typedef enum {
   GDK_DEBUG_MULTIHEAD	  = 1 <<12,
   GDK_DEBUG_XINERAMA	  = 1 <<13,
   GDK_DEBUG_DRAW	  = 1 <<14,
-  GDK_DEBUG_EVENTLOOP     = 1 <<15
+  GDK_DEBUG_EVENTLOOP     = 1 <<15,
+  GDK_DEBUG_PAINT_PROFILE = 1 <<16
 } GdkDebugFlag;
 
 #ifndef GDK_DISABLE_DEPRECATED
@@ -169,6 +170,8 @@ struct _GdkEventPrivate
   guint      flags;
   GdkScreen *screen;
   gpointer   windowing_data;
+  guint      n_merged;        /* Events merged into this one by compression */
+  GPtrArray *motion_history;  /* GdkTimeCoord of merged motion events */
 };
 
 /* Tracks information about the pointer grab on this display */
@@ -276,6 +279,9 @@ struct _GdkWindowObject
   guint outstanding_surfaces; /* only set on impl window */
 
   cairo_pattern_t *background;
+
+  guint event_compression : 3; /* GdkEventCompression */
+  guint n_compressed_events;
 };
 
 #define GDK_WINDOW_TYPE(d) (((GdkWindowObject*)(GDK_WINDOW (d)))->window_type)
@@ -306,6 +312,8 @@ GList* _gdk_event_queue_insert_after (GdkDisplay *display,
 GList* _gdk_event_queue_insert_before(GdkDisplay *display,
                                       GdkEvent   *after_event,
                                       GdkEvent   *event);
+gboolean _gdk_event_queue_tail_is_compressible (GdkDisplay *display);
+void     _gdk_event_queue_compress_tail        (GdkDisplay *display);
 void   _gdk_event_button_generate    (GdkDisplay *display,
 				      GdkEvent   *event);
 
@@ -682,6 +690,50 @@ GdkWindow *_gdk_window_get_input_window_for_event (GdkWindow *native_window,
 						   gulong serial);
 GdkRegion  *_gdk_region_new_from_yxbanded_rects (GdkRectangle *rects, int n_rects);
 
+/******************
+ * Paint profiling *
+ ******************/
+
+typedef enum
+{
+  GDK_PAINT_PHASE_INVALIDATE,
+  GDK_PAINT_PHASE_EXPOSE,
+  GDK_PAINT_PHASE_BEGIN_PAINT,
+  GDK_PAINT_PHASE_BLIT,
+  GDK_PAINT_PHASE_MOVES,
+  GDK_PAINT_PHASE_FLUSH,
+  GDK_PAINT_N_PHASES
+} GdkPaintPhase;
+
+typedef struct _GdkPaintProfileRecord GdkPaintProfileRecord;
+
+struct _GdkPaintProfileRecord
+{
+  guint    frame;
+  gpointer window;     /* impl window, only used as an identifier */
+  gint64   timestamp;  /* monotonic time the record was opened */
+  gint64   duration[GDK_PAINT_N_PHASES];  /* in microseconds */
+  guint    count[GDK_PAINT_N_PHASES];
+};
+
+extern gboolean _gdk_paint_profile_enabled;
+
+#define GDK_PAINT_PROFILE_START() \
+  (G_UNLIKELY (_gdk_paint_profile_enabled) ? g_get_monotonic_time () : 0)
+
+#define GDK_PAINT_PROFILE_END(window, phase, start) G_STMT_START { \
+    if (G_UNLIKELY ((start) != 0))                                  \
+      _gdk_paint_profile_record ((window), (phase), (start));       \
+  } G_STMT_END
+
+void                   _gdk_paint_profile_init         (void);
+void                   _gdk_paint_profile_record       (GdkWindow     *window,
+							GdkPaintPhase  phase,
+							gint64         start);
+void                   _gdk_paint_profile_end_frame    (void);
+GdkPaintProfileRecord *_gdk_paint_profile_copy_records (guint         *n_records);
+gboolean               _gdk_paint_profile_dump         (const gchar   *filename);
+
 /*****************************
  * offscreen window routines *
  *****************************/
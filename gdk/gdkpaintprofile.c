@@ -0,0 +1,241 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Paint profiling
+ *
+ * When enabled (GDK_DEBUG=paint-profile, or GDK_PAINT_PROFILE=<file>
+ * which also works in non-debug builds) the window update machinery in
+ * gdkwindow.c reports how long each phase of a frame took. A frame is
+ * one run of gdk_window_process_all_updates(). Timings are accumulated
+ * into one record per (frame, impl window) and kept in a fixed size
+ * ring buffer, so a long running process only keeps the most recent
+ * frames. Timings not tied to a window (the display flush at the end
+ * of the frame) go to a record with a %NULL window.
+ *
+ * Note that the expose phase is inclusive: double buffer setup and
+ * blits done from within expose handlers are also counted in their own
+ * phases.
+ *
+ * When disabled, the only cost is a test of _gdk_paint_profile_enabled
+ * at each instrumentation point, see GDK_PAINT_PROFILE_START().
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gdkinternals.h"
+#include "gdkalias.h"
+
+#define DEFAULT_N_RECORDS 4096
+
+gboolean _gdk_paint_profile_enabled = FALSE;
+
+static GdkPaintProfileRecord *records = NULL;
+static guint n_allocated = 0;
+static guint n_filled = 0;
+static guint head = 0; /* Next slot to write */
+static guint current_frame = 1;
+static gchar *dump_filename = NULL;
+
+static const gchar *phase_names[GDK_PAINT_N_PHASES] = {
+  "invalidate",
+  "expose",
+  "begin-paint",
+  "blit",
+  "moves",
+  "flush"
+};
+
+static void
+paint_profile_atexit (void)
+{
+  if (n_filled > 0)
+    _gdk_paint_profile_dump (dump_filename);
+}
+
+void
+_gdk_paint_profile_init (void)
+{
+  const gchar *filename;
+  const gchar *size;
+
+  if (records != NULL)
+    return;
+
+  filename = g_getenv ("GDK_PAINT_PROFILE");
+
+  if (filename == NULL && !(_gdk_debug_flags & GDK_DEBUG_PAINT_PROFILE))
+    return;
+
+  n_allocated = DEFAULT_N_RECORDS;
+  size = g_getenv ("GDK_PAINT_PROFILE_SIZE");
+  if (size != NULL)
+    {
+      guint64 n = g_ascii_strtoull (size, NULL, 10);
+      if (n > 0 && n < G_MAXUINT / sizeof (GdkPaintProfileRecord))
+	n_allocated = n;
+    }
+
+  records = g_new0 (GdkPaintProfileRecord, n_allocated);
+  if (filename != NULL && filename[0] != '\0')
+    dump_filename = g_strdup (filename);
+
+  _gdk_paint_profile_enabled = TRUE;
+
+  atexit (paint_profile_atexit);
+}
+
+static GdkPaintProfileRecord *
+lookup_record (gpointer window)
+{
+  GdkPaintProfileRecord *record;
+  guint i, idx;
+
+  /* The records of the current frame are the most recently opened
+   * ones, so walk backwards from head until we leave the frame.
+   */
+  for (i = 0; i < n_filled; i++)
+    {
+      idx = (head + n_allocated - 1 - i) % n_allocated;
+      record = &records[idx];
+
+      if (record->frame != current_frame)
+	break;
+
+      if (record->window == window)
+	return record;
+    }
+
+  record = &records[head];
+  memset (record, 0, sizeof (GdkPaintProfileRecord));
+  record->frame = current_frame;
+  record->window = window;
+  record->timestamp = g_get_monotonic_time ();
+
+  head = (head + 1) % n_allocated;
+  if (n_filled < n_allocated)
+    n_filled++;
+
+  return record;
+}
+
+void
+_gdk_paint_profile_record (GdkWindow     *window,
+			   GdkPaintPhase  phase,
+			   gint64         start)
+{
+  GdkPaintProfileRecord *record;
+  gint64 end;
+
+  g_return_if_fail (phase < GDK_PAINT_N_PHASES);
+
+  if (!_gdk_paint_profile_enabled)
+    return;
+
+  end = g_get_monotonic_time ();
+
+  record = lookup_record (window);
+  record->duration[phase] += end - start;
+  record->count[phase]++;
+}
+
+void
+_gdk_paint_profile_end_frame (void)
+{
+  if (!_gdk_paint_profile_enabled)
+    return;
+
+  current_frame++;
+  /* Frame 0 marks an unused record */
+  if (current_frame == 0)
+    current_frame = 1;
+}
+
+/* Returns a newly allocated copy of the ring buffer contents, oldest
+ * record first.
+ */
+GdkPaintProfileRecord *
+_gdk_paint_profile_copy_records (guint *n_records)
+{
+  GdkPaintProfileRecord *copy;
+  guint first, i;
+
+  *n_records = n_filled;
+  if (n_filled == 0)
+    return NULL;
+
+  copy = g_new (GdkPaintProfileRecord, n_filled);
+  first = (head + n_allocated - n_filled) % n_allocated;
+  for (i = 0; i < n_filled; i++)
+    copy[i] = records[(first + i) % n_allocated];
+
+  return copy;
+}
+
+/* Writes the ring buffer as tab separated text to @filename, or to
+ * stderr if @filename is %NULL. All durations are in microseconds.
+ */
+gboolean
+_gdk_paint_profile_dump (const gchar *filename)
+{
+  GdkPaintProfileRecord *copy;
+  guint n_records, i;
+  gint phase;
+  FILE *file;
+
+  if (filename != NULL)
+    {
+      file = g_fopen (filename, "w");
+      if (file == NULL)
+	{
+	  g_warning ("Could not write paint profile to '%s'", filename);
+	  return FALSE;
+	}
+    }
+  else
+    file = stderr;
+
+  fprintf (file, "# frame\twindow\ttimestamp");
+  for (phase = 0; phase < GDK_PAINT_N_PHASES; phase++)
+    fprintf (file, "\t%s\tn-%s", phase_names[phase], phase_names[phase]);
+  fprintf (file, "\n");
+
+  copy = _gdk_paint_profile_copy_records (&n_records);
+  for (i = 0; i < n_records; i++)
+    {
+      fprintf (file, "%u\t%p\t%" G_GINT64_FORMAT,
+	       copy[i].frame, copy[i].window, copy[i].timestamp);
+      for (phase = 0; phase < GDK_PAINT_N_PHASES; phase++)
+	fprintf (file, "\t%" G_GINT64_FORMAT "\t%u",
+		 copy[i].duration[phase], copy[i].count[phase]);
+      fprintf (file, "\n");
+    }
+  g_free (copy);
+
+  if (file != stderr)
+    fclose (file);
+  else
+    fflush (file);
+
+  return TRUE;
+}
@@ -329,6 +329,8 @@ static void recompute_visible_regions   (GdkWindowObject *private,
 					 gboolean recalculate_siblings,
 					 gboolean recalculate_children);
 static void gdk_window_flush_outstanding_moves (GdkWindow *window);
+static void gdk_window_flush_outstanding_moves_in_region (GdkWindow       *window,
+							  const GdkRegion *region);
 static void gdk_window_flush_recursive  (GdkWindowObject *window);
 static void do_move_region_bits_on_impl (GdkWindowObject *private,
 					 GdkRegion *region, /* In impl window coords */
@@ -434,6 +436,7 @@ accumulate_get_window (GSignalInvocationHint *ihint,
 }
 
 static GQuark quark_pointer_window = 0;
+static GQuark quark_backing_pool = 0;
 
 static void
 gdk_window_class_init (GdkWindowObjectClass *klass)
@@ -478,6 +481,7 @@ gdk_window_class_init (GdkWindowObjectClass *klass)
   drawable_class->get_source_drawable = gdk_window_get_source_drawable;
 
   quark_pointer_window = g_quark_from_static_string ("gtk-pointer-window");
+  quark_backing_pool = g_quark_from_static_string ("gdk-backing-pool");
 
 
   /* Properties */
@@ -2728,6 +2732,214 @@ gdk_window_get_state (GdkWindow *window)
 }
 
 
+/* Pool of backing store pixmaps for double buffered paints.
+ *
+ * Every gdk_window_begin_paint_region() that is not covered by an
+ * implicit paint, and every implicit paint, needs an offscreen pixmap.
+ * Creating and freeing one per paint costs a server round trip each
+ * time, so instead released pixmaps are kept in a per-screen pool and
+ * handed out again to later paints with the same colormap and depth
+ * that fit inside them. Requested sizes are rounded up so that paints
+ * of slightly different sizes can share pixmaps. Pixmaps that stay
+ * unused for BACKING_POOL_MAX_AGE seconds are freed again.
+ *
+ * The contents of a pooled pixmap are undefined, which is fine as
+ * paints always clear the area they paint before drawing, and only
+ * the painted region is ever copied to the window.
+ */
+#define BACKING_POOL_GRANULARITY 64
+#define BACKING_POOL_MAX_PIXMAPS 8
+#define BACKING_POOL_MAX_AGE     10 /* seconds */
+
+typedef struct {
+  GdkPixmap *pixmap;
+  GdkColormap *colormap; /* Only used for comparison */
+  gint depth;
+  gint width, height;
+  gint64 release_time;
+} GdkBackingPixmap;
+
+typedef struct {
+  GList *free_pixmaps; /* Most recently released first */
+  guint trim_id;
+  guint hits;
+  guint allocations;
+} GdkBackingPool;
+
+static void
+backing_pixmap_free (GdkBackingPixmap *backing)
+{
+  g_object_unref (backing->pixmap);
+  g_slice_free (GdkBackingPixmap, backing);
+}
+
+static void
+backing_pool_free (GdkBackingPool *pool)
+{
+  if (pool->trim_id)
+    g_source_remove (pool->trim_id);
+
+  g_list_foreach (pool->free_pixmaps, (GFunc)backing_pixmap_free, NULL);
+  g_list_free (pool->free_pixmaps);
+  g_slice_free (GdkBackingPool, pool);
+}
+
+static GdkBackingPool *
+backing_pool_get (GdkScreen *screen)
+{
+  GdkBackingPool *pool;
+
+  pool = g_object_get_qdata (G_OBJECT (screen), quark_backing_pool);
+  if (pool == NULL)
+    {
+      pool = g_slice_new0 (GdkBackingPool);
+      g_object_set_qdata_full (G_OBJECT (screen), quark_backing_pool,
+			       pool, (GDestroyNotify)backing_pool_free);
+    }
+
+  return pool;
+}
+
+static gboolean
+backing_pool_trim (gpointer data)
+{
+  GdkBackingPool *pool = data;
+  GdkBackingPixmap *backing;
+  GList *l, *next;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  for (l = pool->free_pixmaps; l != NULL; l = next)
+    {
+      next = l->next;
+      backing = l->data;
+
+      if (now - backing->release_time >= BACKING_POOL_MAX_AGE * G_USEC_PER_SEC)
+	{
+	  backing_pixmap_free (backing);
+	  pool->free_pixmaps = g_list_delete_link (pool->free_pixmaps, l);
+	}
+    }
+
+  GDK_NOTE (PIXMAP,
+	    g_message ("backing pool: %u pooled pixmaps after trimming (%u hits, %u allocations)",
+		       g_list_length (pool->free_pixmaps), pool->hits, pool->allocations));
+
+  if (pool->free_pixmaps == NULL)
+    {
+      pool->trim_id = 0;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Returns a pixmap compatible with @window that is at least
+ * @width x @height, reusing a pooled one if possible.
+ */
+static GdkPixmap *
+backing_pool_acquire (GdkWindow *window,
+		      gint       width,
+		      gint       height)
+{
+  GdkBackingPool *pool;
+  GdkBackingPixmap *backing;
+  GdkColormap *colormap;
+  GdkPixmap *pixmap;
+  GList *l, *best;
+  gint depth;
+
+  pool = backing_pool_get (gdk_drawable_get_screen (window));
+  colormap = gdk_drawable_get_colormap (window);
+  depth = gdk_drawable_get_depth (window);
+
+  width = MAX (width, 1);
+  height = MAX (height, 1);
+
+  best = NULL;
+  for (l = pool->free_pixmaps; l != NULL; l = l->next)
+    {
+      backing = l->data;
+
+      if (backing->colormap != colormap ||
+	  backing->depth != depth ||
+	  backing->width < width ||
+	  backing->height < height)
+	continue;
+
+      if (best == NULL ||
+	  backing->width * backing->height <
+	  ((GdkBackingPixmap *)best->data)->width * ((GdkBackingPixmap *)best->data)->height)
+	best = l;
+    }
+
+  if (best != NULL)
+    {
+      backing = best->data;
+      pool->free_pixmaps = g_list_delete_link (pool->free_pixmaps, best);
+
+      pixmap = backing->pixmap;
+      g_slice_free (GdkBackingPixmap, backing);
+      pool->hits++;
+
+      return pixmap;
+    }
+
+  width = (width + BACKING_POOL_GRANULARITY - 1) & ~(BACKING_POOL_GRANULARITY - 1);
+  height = (height + BACKING_POOL_GRANULARITY - 1) & ~(BACKING_POOL_GRANULARITY - 1);
+
+  pool->allocations++;
+  GDK_NOTE (PIXMAP,
+	    g_message ("backing pool: allocating %dx%d pixmap (%u hits, %u allocations)",
+		       width, height, pool->hits, pool->allocations));
+
+  return gdk_pixmap_new (window, width, height, -1);
+}
+
+/* Gives a pixmap returned by backing_pool_acquire() back to the pool */
+static void
+backing_pool_release (GdkPixmap *pixmap)
+{
+  GdkScreen *screen;
+  GdkBackingPool *pool;
+  GdkBackingPixmap *backing;
+  GList *last;
+
+  screen = gdk_drawable_get_screen (pixmap);
+
+  /* Someone else still uses the pixmap, or we're shutting down */
+  if (G_OBJECT (pixmap)->ref_count > 1 ||
+      gdk_display_is_closed (gdk_screen_get_display (screen)))
+    {
+      g_object_unref (pixmap);
+      return;
+    }
+
+  pool = backing_pool_get (screen);
+
+  backing = g_slice_new (GdkBackingPixmap);
+  backing->pixmap = pixmap;
+  backing->colormap = gdk_drawable_get_colormap (pixmap);
+  backing->depth = gdk_drawable_get_depth (pixmap);
+  gdk_drawable_get_size (pixmap, &backing->width, &backing->height);
+  backing->release_time = g_get_monotonic_time ();
+
+  pool->free_pixmaps = g_list_prepend (pool->free_pixmaps, backing);
+
+  if (g_list_length (pool->free_pixmaps) > BACKING_POOL_MAX_PIXMAPS)
+    {
+      last = g_list_last (pool->free_pixmaps);
+      backing_pixmap_free (last->data);
+      pool->free_pixmaps = g_list_delete_link (pool->free_pixmaps, last);
+    }
+
+  if (pool->trim_id == 0)
+    pool->trim_id = gdk_threads_add_timeout_seconds (BACKING_POOL_MAX_AGE,
+						     backing_pool_trim,
+						     pool);
+}
+
 /* This creates an empty "implicit" paint region for the impl window.
  * By itself this does nothing, but real paints to this window
  * or children of it can use this pixmap as backing to avoid allocating
@@ -2744,6 +2956,7 @@ gdk_window_begin_implicit_paint (GdkWindow *window, GdkRectangle *rect)
 {
   GdkWindowObject *private = (GdkWindowObject *)window;
   GdkWindowPaint *paint;
+  gint64 profile_start;
 
   g_assert (gdk_window_has_impl (private));
 
@@ -2768,6 +2981,8 @@ gdk_window_begin_implicit_paint (GdkWindow *window, GdkRectangle *rect)
   if (private->window_type == GDK_WINDOW_FOREIGN)
     return FALSE;
 
+  profile_start = GDK_PAINT_PROFILE_START ();
+
   paint = g_new (GdkWindowPaint, 1);
   paint->region = gdk_region_new (); /* Empty */
   paint->x_offset = rect->x;
@@ -2775,12 +2990,12 @@ gdk_window_begin_implicit_paint (GdkWindow *window, GdkRectangle *rect)
   paint->uses_implicit = FALSE;
   paint->flushed = FALSE;
   paint->surface = NULL;
-  paint->pixmap =
-    gdk_pixmap_new (window,
-		    MAX (rect->width, 1), MAX (rect->height, 1), -1);
+  paint->pixmap = backing_pool_acquire (window, rect->width, rect->height);
 
   private->implicit_paint = paint;
 
+  GDK_PAINT_PROFILE_END (window, GDK_PAINT_PHASE_BEGIN_PAINT, profile_start);
+
   return TRUE;
 }
 
@@ -2796,11 +3011,14 @@ gdk_window_flush_implicit_paint (GdkWindow *window)
   GdkRegion *region;
   GdkGC *tmp_gc;
   GSList *list;
+  gint64 profile_start;
 
   impl_window = gdk_window_get_impl_window (private);
   if (impl_window->implicit_paint == NULL)
     return;
 
+  profile_start = GDK_PAINT_PROFILE_START ();
+
   paint = impl_window->implicit_paint;
   paint->flushed = TRUE;
   region = gdk_region_copy (private->clip_region_with_children);
@@ -2832,6 +3050,9 @@ gdk_window_flush_implicit_paint (GdkWindow *window)
     }
   else
     gdk_region_destroy (region);
+
+  GDK_PAINT_PROFILE_END ((GdkWindow *)impl_window,
+			 GDK_PAINT_PHASE_BLIT, profile_start);
 }
 
 /* Ends an implicit paint, paired with gdk_window_begin_implicit_paint returning TRUE */
@@ -2841,11 +3062,14 @@ gdk_window_end_implicit_paint (GdkWindow *window)
   GdkWindowObject *private = (GdkWindowObject *)window;
   GdkWindowPaint *paint;
   GdkGC *tmp_gc;
+  gint64 profile_start;
 
   g_assert (gdk_window_has_impl (private));
 
   g_assert (private->implicit_paint != NULL);
 
+  profile_start = GDK_PAINT_PROFILE_START ();
+
   paint = private->implicit_paint;
 
   private->implicit_paint = NULL;
@@ -2863,8 +3087,10 @@ gdk_window_end_implicit_paint (GdkWindow *window)
   else
     gdk_region_destroy (paint->region);
 
-  g_object_unref (paint->pixmap);
+  backing_pool_release (paint->pixmap);
   g_free (paint);
+
+  GDK_PAINT_PROFILE_END (window, GDK_PAINT_PHASE_BLIT, profile_start);
 }
 
 /**
@@ -2945,6 +3171,7 @@ gdk_window_begin_paint_region (GdkWindow       *window,
   GdkWindowPaint *paint, *implicit_paint;
   GdkWindowObject *impl_window;
   GSList *list;
+  gint64 profile_start;
 
   g_return_if_fail (GDK_IS_WINDOW (window));
 
@@ -2961,6 +3188,8 @@ gdk_window_begin_paint_region (GdkWindow       *window,
       return;
     }
 
+  profile_start = GDK_PAINT_PROFILE_START ();
+
   impl_window = gdk_window_get_impl_window (private);
   implicit_paint = impl_window->implicit_paint;
 
@@ -2999,9 +3228,8 @@ gdk_window_begin_paint_region (GdkWindow       *window,
       paint->uses_implicit = FALSE;
       paint->x_offset = clip_box.x;
       paint->y_offset = clip_box.y;
-      paint->pixmap =
-	gdk_pixmap_new (window,
-			MAX (clip_box.width, 1), MAX (clip_box.height, 1), -1);
+      paint->pixmap = backing_pool_acquire (window,
+					    clip_box.width, clip_box.height);
       paint->surface = _gdk_drawable_ref_cairo_surface (paint->pixmap);
     }
 
@@ -3024,6 +3252,8 @@ gdk_window_begin_paint_region (GdkWindow       *window,
 				       paint->region);
     }
 
+  GDK_PAINT_PROFILE_END ((GdkWindow *)impl_window,
+			 GDK_PAINT_PHASE_BEGIN_PAINT, profile_start);
 #endif /* USE_BACKING_STORE */
 }
 
@@ -3100,6 +3330,7 @@ gdk_window_end_paint (GdkWindow *window)
   GdkRectangle clip_box;
   gint x_offset, y_offset;
   GdkRegion *full_clip;
+  gint64 profile_start;
 
   g_return_if_fail (GDK_IS_WINDOW (window));
 
@@ -3135,10 +3366,17 @@ gdk_window_end_paint (GdkWindow *window)
 
   if (!paint->uses_implicit)
     {
-      gdk_window_flush_outstanding_moves (window);
-
       full_clip = gdk_region_copy (private->clip_region_with_children);
       gdk_region_intersect (full_clip, paint->region);
+
+      /* Only the moves that touch the area we're about to update need
+       * to happen before it */
+      gdk_region_offset (full_clip, private->abs_x, private->abs_y);
+      gdk_window_flush_outstanding_moves_in_region (window, full_clip);
+      gdk_region_offset (full_clip, -private->abs_x, -private->abs_y);
+
+      profile_start = GDK_PAINT_PROFILE_START ();
+
       _gdk_gc_set_clip_region_internal (tmp_gc, full_clip, TRUE); /* Takes ownership of full_clip */
       gdk_gc_set_clip_origin (tmp_gc, - x_offset, - y_offset);
       gdk_draw_drawable (private->impl, tmp_gc, paint->pixmap,
@@ -3146,6 +3384,9 @@ gdk_window_end_paint (GdkWindow *window)
 			 clip_box.y - paint->y_offset,
 			 clip_box.x - x_offset, clip_box.y - y_offset,
 			 clip_box.width, clip_box.height);
+
+      GDK_PAINT_PROFILE_END ((GdkWindow *)private->impl_window,
+			     GDK_PAINT_PHASE_BLIT, profile_start);
     }
 
   if (private->redirect)
@@ -3166,7 +3407,10 @@ gdk_window_end_paint (GdkWindow *window)
   gdk_gc_set_clip_region (tmp_gc, NULL);
 
   cairo_surface_destroy (paint->surface);
-  g_object_unref (paint->pixmap);
+  if (paint->uses_implicit)
+    g_object_unref (paint->pixmap);
+  else
+    backing_pool_release (paint->pixmap);
   gdk_region_destroy (paint->region);
   g_free (paint);
 
@@ -3305,6 +3549,7 @@ append_move_region (GdkWindowObject *impl_window,
   GdkRegion *new_total_region, *old_total_region;
   GdkRegion *source_overlaps_destination;
   GdkRegion *non_overwritten;
+  GdkRegion *remaining, *remaining_source;
   gboolean added_move;
   GList *l, *prev;
 
@@ -3329,6 +3574,7 @@ append_move_region (GdkWindowObject *impl_window,
   gdk_region_union (new_total_region, new_dest_region);
 
   added_move = FALSE;
+  remaining = NULL;
   for (l = g_list_last (impl_window->outstanding_moves); l != NULL; l = prev)
     {
       prev = l->prev;
@@ -3352,36 +3598,70 @@ append_move_region (GdkWindowObject *impl_window,
 
 	  /* We can do all sort of optimizations here, but to do things safely it becomes
 	     quite complicated. However, a very common case is that you copy something first,
-	     then copy all that or a subset of it to a new location (i.e. if you scroll twice
-	     in the same direction). We'd like to detect this case and optimize it to one
-	     copy. */
-	  if (gdk_region_equal (source_overlaps_destination, new_dest_region))
+	     then copy all that or a subset of it to a new location (i.e. if you scroll several
+	     times in the same direction, possibly in nested scrolled windows). We'd like to
+	     detect this case and read the part of the new move that comes from the old moves
+	     destination directly from the old moves source, in a single copy done before
+	     the old move. Whatever remains of the new move is read from outside the old
+	     moves destination and is still done after the old move. */
+	  if (!gdk_region_empty (source_overlaps_destination))
 	    {
-	      /* This means we might be able to replace the old move and the new one
-		 with the new one read from the old ones source, and a second copy of
-		 the non-overwritten parts of the old move. However, such a split
-		 is only valid if the source in the old move isn't overwritten
-		 by the destination of the new one */
+	      /* Such a split is only valid if the source in the old move isn't
+		 overwritten by the destination of the combined move, which
+		 now happens before it... */
 
 	      /* the new destination of old move if split is ok: */
 	      non_overwritten = gdk_region_copy (old_move->dest_region);
-	      gdk_region_subtract (non_overwritten, new_dest_region);
+	      gdk_region_subtract (non_overwritten, source_overlaps_destination);
 	      /* move to source region */
 	      gdk_region_offset (non_overwritten, -old_move->dx, -old_move->dy);
+	      gdk_region_intersect (non_overwritten, source_overlaps_destination);
+
+	      /* ...and if the rest of the new move doesn't read from that
+		 destination either, as it would then see the result of the
+		 combined move rather than what was there before. */
+	      remaining = gdk_region_copy (new_dest_region);
+	      gdk_region_subtract (remaining, source_overlaps_destination);
+	      remaining_source = gdk_region_copy (remaining);
+	      gdk_region_offset (remaining_source, -dx, -dy);
+	      gdk_region_intersect (remaining_source, source_overlaps_destination);
+
+	      if (gdk_region_empty (non_overwritten) &&
+		  gdk_region_empty (remaining_source))
+		{
+		  /* A combined move with no offset (i.e. scrolling back and
+		     forth) just leaves the pixels where they already are */
+		  if (dx + old_move->dx != 0 || dy + old_move->dy != 0)
+		    {
+		      move = gdk_window_region_move_new (source_overlaps_destination,
+							 dx + old_move->dx,
+							 dy + old_move->dy);
 
-	      gdk_region_intersect (non_overwritten, new_dest_region);
-	      if (gdk_region_empty (non_overwritten))
+		      impl_window->outstanding_moves =
+			g_list_insert_before (impl_window->outstanding_moves,
+					      l, move);
+		    }
+
+		  gdk_region_subtract (old_move->dest_region, source_overlaps_destination);
+		  if (gdk_region_empty (old_move->dest_region))
+		    {
+		      /* Keep the position for inserting the rest of the new move */
+		      prev = l->prev;
+		      gdk_window_region_move_free (old_move);
+		      impl_window->outstanding_moves =
+			g_list_delete_link (impl_window->outstanding_moves, l);
+		      l = prev;
+		    }
+
+		  if (gdk_region_empty (remaining))
+		    added_move = TRUE;
+		}
+	      else
 		{
-		  added_move = TRUE;
-		  move = gdk_window_region_move_new (new_dest_region,
-						     dx + old_move->dx,
-						     dy + old_move->dy);
-
-		  impl_window->outstanding_moves =
-		    g_list_insert_before (impl_window->outstanding_moves,
-					  l, move);
-		  gdk_region_subtract (old_move->dest_region, new_dest_region);
+		  gdk_region_destroy (remaining);
+		  remaining = NULL;
 		}
+	      gdk_region_destroy (remaining_source);
 	      gdk_region_destroy (non_overwritten);
 	    }
 
@@ -3396,7 +3676,8 @@ append_move_region (GdkWindowObject *impl_window,
 
   if (!added_move)
     {
-      move = gdk_window_region_move_new (new_dest_region, dx, dy);
+      move = gdk_window_region_move_new (remaining ? remaining : new_dest_region,
+					 dx, dy);
 
       if (l == NULL)
 	impl_window->outstanding_moves =
@@ -3407,6 +3688,9 @@ append_move_region (GdkWindowObject *impl_window,
 	  g_list_insert_before (impl_window->outstanding_moves,
 				l->next, move);
     }
+
+  if (remaining)
+    gdk_region_destroy (remaining);
 }
 
 /* Moves bits and update area by dx/dy in impl window.
@@ -3476,6 +3760,39 @@ move_region_on_impl (GdkWindowObject *impl_window,
   gdk_region_destroy (region);
 }
 
+/* Executes the outstanding moves of impl_window from the first one up
+ * to and including @last, or all of them if @last is %NULL.
+ */
+static void
+flush_outstanding_moves_up_to (GdkWindowObject *impl_window,
+			       GList           *last)
+{
+  GList *l, *next;
+  GdkWindowRegionMove *move;
+  gint64 profile_start;
+
+  profile_start = GDK_PAINT_PROFILE_START ();
+
+  for (l = impl_window->outstanding_moves; l != NULL; l = next)
+    {
+      next = l->next;
+      move = l->data;
+
+      do_move_region_bits_on_impl (impl_window,
+				   move->dest_region, move->dx, move->dy);
+
+      gdk_window_region_move_free (move);
+      impl_window->outstanding_moves =
+	g_list_delete_link (impl_window->outstanding_moves, l);
+
+      if (l == last)
+	break;
+    }
+
+  GDK_PAINT_PROFILE_END ((GdkWindow *)impl_window,
+			 GDK_PAINT_PHASE_MOVES, profile_start);
+}
+
 /* Flushes all outstanding changes to the window, call this
  * before drawing directly to the window (i.e. outside a begin/end_paint pair).
  */
@@ -3484,25 +3801,70 @@ gdk_window_flush_outstanding_moves (GdkWindow *window)
 {
   GdkWindowObject *private;
   GdkWindowObject *impl_window;
-  GList *l;
-  GdkWindowRegionMove *move;
 
   private = (GdkWindowObject *) window;
 
   impl_window = gdk_window_get_impl_window (private);
 
-  for (l = impl_window->outstanding_moves; l != NULL; l = l->next)
-    {
-      move = l->data;
+  if (impl_window->outstanding_moves == NULL)
+    return;
 
-      do_move_region_bits_on_impl (impl_window,
-				   move->dest_region, move->dx, move->dy);
+  flush_outstanding_moves_up_to (impl_window, NULL);
+}
 
-      gdk_window_region_move_free (move);
-    }
+static gboolean
+move_touches_region (GdkWindowRegionMove *move,
+		     const GdkRegion     *region)
+{
+  GdkRegion *tmp;
+  gboolean touches;
 
-  g_list_free (impl_window->outstanding_moves);
-  impl_window->outstanding_moves = NULL;
+  /* Destination */
+  tmp = gdk_region_copy (move->dest_region);
+  gdk_region_intersect (tmp, region);
+  touches = !gdk_region_empty (tmp);
+  gdk_region_destroy (tmp);
+
+  if (touches)
+    return TRUE;
+
+  /* Source */
+  tmp = gdk_region_copy (region);
+  gdk_region_offset (tmp, move->dx, move->dy);
+  gdk_region_intersect (tmp, move->dest_region);
+  touches = !gdk_region_empty (tmp);
+  gdk_region_destroy (tmp);
+
+  return touches;
+}
+
+/* Like gdk_window_flush_outstanding_moves(), but only flushes what is
+ * needed before drawing to @region (in impl window coordinates): the
+ * last move that reads from or writes to @region and all moves queued
+ * before it. Moves queued after that don't depend on what is drawn, so
+ * they can stay queued and be combined with later moves (i.e. during
+ * kinetic scrolling) until the next update is processed.
+ */
+static void
+gdk_window_flush_outstanding_moves_in_region (GdkWindow       *window,
+					      const GdkRegion *region)
+{
+  GdkWindowObject *private;
+  GdkWindowObject *impl_window;
+  GList *l;
+
+  private = (GdkWindowObject *) window;
+
+  impl_window = gdk_window_get_impl_window (private);
+
+  for (l = g_list_last (impl_window->outstanding_moves); l != NULL; l = l->prev)
+    {
+      if (move_touches_region (l->data, region))
+	{
+	  flush_outstanding_moves_up_to (impl_window, l);
+	  break;
+	}
+    }
 }
 
 /**
@@ -3534,6 +3896,33 @@ gdk_window_flush (GdkWindow *window)
   gdk_window_flush_implicit_paint (window);
 }
 
+/* Like gdk_window_flush(), but only flushes the moves that drawing
+ * to the window can be affected by, for when gdk is about to draw to
+ * the window directly.
+ */
+static void
+gdk_window_flush_for_drawing (GdkWindow *window)
+{
+  GdkWindowObject *private = (GdkWindowObject *)window;
+  GdkRegion *region;
+
+  if (private->impl_window->outstanding_moves != NULL)
+    {
+      if (private->clip_region != NULL)
+	{
+	  /* Only moves touching this window can be affected by drawing to it */
+	  region = gdk_region_copy (private->clip_region);
+	  gdk_region_offset (region, private->abs_x, private->abs_y);
+	  gdk_window_flush_outstanding_moves_in_region (window, region);
+	  gdk_region_destroy (region);
+	}
+      else
+	gdk_window_flush_outstanding_moves (window);
+    }
+
+  gdk_window_flush_implicit_paint (window);
+}
+
 /* If we're about to move/resize or otherwise change the
  * hierarchy of a client side window in an impl and we're
  * called from an expose event handler then we need to
@@ -3730,7 +4119,7 @@ start_draw_helper (GdkDrawable *drawable,
     {
       /* Drawing directly to the window, flush anything outstanding to
 	 guarantee ordering. */
-      gdk_window_flush ((GdkWindow *)drawable);
+      gdk_window_flush_for_drawing ((GdkWindow *)drawable);
 
       /* Don't clip when drawing to root or all native */
       if (!_gdk_native_windows && private->window_type != GDK_WINDOW_ROOT)
@@ -4787,7 +5176,7 @@ gdk_window_clear_region_internal (GdkWindow *window,
 
 	  /* Drawing directly to the window, flush anything outstanding to
 	     guarantee ordering. */
-	  gdk_window_flush (window);
+	  gdk_window_flush_for_drawing (window);
 	  impl_iface->clear_region (window, copy, send_expose);
 
 	  gdk_region_destroy (copy);
@@ -5139,7 +5528,7 @@ gdk_window_ref_cairo_surface (GdkDrawable *drawable)
     {
 
       /* This will be drawing directly to the window, so flush implicit paint */
-      gdk_window_flush ((GdkWindow *)drawable);
+      gdk_window_flush_for_drawing ((GdkWindow *)drawable);
 
       if (!private->cairo_surface)
 	{
@@ -5482,6 +5871,7 @@ gdk_window_process_updates_internal (GdkWindow *window)
 	{
 	  GdkRegion *expose_region;
 	  gboolean end_implicit;
+	  gint64 profile_start;
 
 	  /* Clip to part visible in toplevel */
 	  gdk_region_intersect (update_area, private->clip_region);
@@ -5585,7 +5975,9 @@ gdk_window_process_updates_internal (GdkWindow *window)
 
 	  /* Render the invalid areas to the implicit paint, by sending exposes.
 	   * May flush if non-double buffered widget draw. */
+	  profile_start = GDK_PAINT_PROFILE_START ();
 	  _gdk_windowing_window_process_updates_recurse (window, expose_region);
+	  GDK_PAINT_PROFILE_END (window, GDK_PAINT_PHASE_EXPOSE, profile_start);
 
 	  if (end_implicit)
 	    {
@@ -5629,11 +6021,16 @@ flush_all_displays (void)
 {
   GSList *displays = gdk_display_manager_list_displays (gdk_display_manager_get ());
   GSList *tmp_list;
+  gint64 profile_start;
+
+  profile_start = GDK_PAINT_PROFILE_START ();
 
   for (tmp_list = displays; tmp_list; tmp_list = tmp_list->next)
     gdk_display_flush (tmp_list->data);
 
   g_slist_free (displays);
+
+  GDK_PAINT_PROFILE_END (NULL, GDK_PAINT_PHASE_FLUSH, profile_start);
 }
 
 /* Currently it is not possible to override
@@ -5706,6 +6103,8 @@ gdk_window_process_all_updates (void)
 
   _gdk_windowing_after_process_all_updates ();
 
+  _gdk_paint_profile_end_frame ();
+
   in_process_all_updates = FALSE;
 
   /* If we ignored a recursive call, schedule a
@@ -6015,8 +6414,13 @@ gdk_window_invalidate_maybe_recurse (GdkWindow       *window,
 								   gpointer),
 				     gpointer   user_data)
 {
+  gint64 profile_start;
+
+  profile_start = GDK_PAINT_PROFILE_START ();
   gdk_window_invalidate_maybe_recurse_full (window, region, CLEAR_BG_NONE,
 					    child_func, user_data);
+  GDK_PAINT_PROFILE_END ((GdkWindow *)GDK_WINDOW_OBJECT (window)->impl_window,
+			 GDK_PAINT_PHASE_INVALIDATE, profile_start);
 }
 
 static gboolean
@@ -6032,10 +6436,15 @@ gdk_window_invalidate_region_full (GdkWindow       *window,
 				    gboolean         invalidate_children,
 				    ClearBg          clear_bg)
 {
+  gint64 profile_start;
+
+  profile_start = GDK_PAINT_PROFILE_START ();
   gdk_window_invalidate_maybe_recurse_full (window, region, clear_bg,
 					    invalidate_children ?
 					    true_predicate : (gboolean (*) (GdkWindow *, gpointer))NULL,
 				       NULL);
+  GDK_PAINT_PROFILE_END ((GdkWindow *)GDK_WINDOW_OBJECT (window)->impl_window,
+			 GDK_PAINT_PHASE_INVALIDATE, profile_start);
 }
 
 /**
@@ -6103,6 +6512,9 @@ _gdk_window_invalidate_for_expose (GdkWindow       *window,
   GdkWindowRegionMove *move;
   GdkRegion *move_region;
   GList *l;
+  gint64 profile_start;
+
+  profile_start = GDK_PAINT_PROFILE_START ();
 
   /* Any invalidations comming from the windowing system will
      be in areas that may be moved by outstanding moves,
@@ -6131,6 +6543,9 @@ _gdk_window_invalidate_for_expose (GdkWindow       *window,
   gdk_window_invalidate_maybe_recurse_full (window, region, CLEAR_BG_WINCLEARED,
 					    (gboolean (*) (GdkWindow *, gpointer))gdk_window_has_no_impl,
 					    NULL);
+
+  GDK_PAINT_PROFILE_END ((GdkWindow *)private->impl_window,
+			 GDK_PAINT_PHASE_INVALIDATE, profile_start);
 }
 
 
@@ -7358,6 +7773,82 @@ gdk_window_get_events (GdkWindow *window)
   return private->event_mask;
 }
 
+/**
+ * gdk_window_set_event_compression:
+ * @window: a #GdkWindow
+ * @compression: the kinds of events that may be merged
+ *
+ * Sets which kinds of events GDK may merge before delivering them to
+ * @window. By default nothing is merged, and every event reported by
+ * the windowing system is delivered.
+ *
+ * With %GDK_EVENT_COMPRESS_MOTION, consecutive queued motion events
+ * with the same device and modifier state are merged into the most
+ * recent one; the positions of the merged events can be retrieved with
+ * gdk_event_get_motion_history(). With %GDK_EVENT_COMPRESS_SCROLL,
+ * consecutive scroll events in the same direction are merged and
+ * gdk_event_get_merge_count() returns the number of scroll steps. With
+ * %GDK_EVENT_COMPRESS_CONFIGURE, only the most recent queued configure
+ * event is delivered.
+ *
+ * This is meant for windows that receive events at a higher rate than
+ * they can handle, such as drawing canvases used with high resolution
+ * pointing devices, as an alternative to %GDK_POINTER_MOTION_HINT_MASK.
+ *
+ * Since: 2.24.11
+ **/
+void
+gdk_window_set_event_compression (GdkWindow           *window,
+				  GdkEventCompression  compression)
+{
+  GdkWindowObject *private;
+
+  g_return_if_fail (GDK_IS_WINDOW (window));
+
+  private = (GdkWindowObject *) window;
+
+  private->event_compression = compression;
+}
+
+/**
+ * gdk_window_get_event_compression:
+ * @window: a #GdkWindow
+ *
+ * Gets the kinds of events that may be merged before they are
+ * delivered to @window. See gdk_window_set_event_compression().
+ *
+ * Return value: the event compression of @window
+ *
+ * Since: 2.24.11
+ **/
+GdkEventCompression
+gdk_window_get_event_compression (GdkWindow *window)
+{
+  g_return_val_if_fail (GDK_IS_WINDOW (window), GDK_EVENT_COMPRESS_NONE);
+
+  return ((GdkWindowObject *) window)->event_compression;
+}
+
+/**
+ * gdk_window_get_n_compressed_events:
+ * @window: a #GdkWindow
+ *
+ * Gets the number of events for @window that were dropped because
+ * they were merged into other events. See
+ * gdk_window_set_event_compression().
+ *
+ * Return value: the number of merged events
+ *
+ * Since: 2.24.11
+ **/
+guint
+gdk_window_get_n_compressed_events (GdkWindow *window)
+{
+  g_return_val_if_fail (GDK_IS_WINDOW (window), 0);
+
+  return ((GdkWindowObject *) window)->n_compressed_events;
+}
+
 static void
 gdk_window_move_resize_toplevel (GdkWindow *window,
 				 gboolean   with_move,
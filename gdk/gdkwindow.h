@@ -117,6 +117,17 @@ typedef enum
   GDK_HINT_USER_SIZE   = 1 << 8
 } GdkWindowHints;
 
+/* Kinds of events GDK may merge before delivering them,
+ * see gdk_window_set_event_compression().
+ */
+typedef enum
+{
+  GDK_EVENT_COMPRESS_NONE      = 0,
+  GDK_EVENT_COMPRESS_MOTION    = 1 << 0,
+  GDK_EVENT_COMPRESS_SCROLL    = 1 << 1,
+  GDK_EVENT_COMPRESS_CONFIGURE = 1 << 2
+} GdkEventCompression;
+
 
 /* Window type hints.
  * These are hints for the window manager that indicate
@@ -604,6 +615,10 @@ GList *       gdk_window_peek_children   (GdkWindow       *window);
 GdkEventMask  gdk_window_get_events	 (GdkWindow	  *window);
 void	      gdk_window_set_events	 (GdkWindow	  *window,
 					  GdkEventMask	   event_mask);
+void          gdk_window_set_event_compression (GdkWindow           *window,
+                                                GdkEventCompression  compression);
+GdkEventCompression gdk_window_get_event_compression (GdkWindow   *window);
+guint         gdk_window_get_n_compressed_events (GdkWindow       *window);
 
 void          gdk_window_set_icon_list   (GdkWindow       *window,
 					  GList           *pixbufs);
@@ -58,6 +58,7 @@ typedef struct _ListChildrenState ListChildrenState;
 typedef struct _SendEventState SendEventState;
 typedef struct _SetInputFocusState SetInputFocusState;
 typedef struct _RoundtripState RoundtripState;
+typedef struct _InternAtomsState InternAtomsState;
 
 typedef enum {
   CHILD_INFO_GET_PROPERTY,
@@ -123,6 +124,19 @@ struct _RoundtripState
   gpointer data;
 };
 
+struct _InternAtomsState
+{
+  Display *dpy;
+  _XAsyncHandler async;
+  gulong first_req;
+  gulong last_req;
+  GdkDisplay *display;
+  Atom *atoms;
+  gint n_atoms;
+  GdkInternAtomsCallback callback;
+  gpointer data;
+};
+
 static gboolean
 callback_idle (gpointer data)
 {
@@ -841,5 +855,119 @@ _gdk_x11_roundtrip_async (GdkDisplay           *display,
   SyncHandle();
 }
 
+static gboolean
+intern_atoms_callback_idle (gpointer data)
+{
+  InternAtomsState *state = (InternAtomsState *)data;
+
+  state->callback (state->display, state->atoms, state->n_atoms, state->data);
+
+  g_object_unref (state->display);
+  g_free (state->atoms);
+  g_free (state);
+
+  return FALSE;
+}
+
+static Bool
+intern_atoms_handler (Display *dpy,
+		      xReply  *rep,
+		      char    *buf,
+		      int      len,
+		      XPointer data)
+{
+  InternAtomsState *state = (InternAtomsState *)data;
+  gulong idx;
+
+  if (dpy->last_request_read < state->first_req ||
+      dpy->last_request_read > state->last_req)
+    return False;
+
+  idx = dpy->last_request_read - state->first_req;
+
+  if (rep->generic.type != X_Error)
+    {
+      xInternAtomReply replbuf;
+      xInternAtomReply *repl;
+
+      repl = (xInternAtomReply *)
+	_XGetAsyncReply(dpy, (char *)&replbuf, rep, buf, len,
+			(sizeof(xInternAtomReply) - sizeof(xReply)) >> 2,
+			True);
+      state->atoms[idx] = repl->atom;
+    }
+  else
+    state->atoms[idx] = None;
+
+  if (dpy->last_request_read == state->last_req)
+    {
+      DeqAsyncHandler(state->dpy, &state->async);
+
+      gdk_threads_add_idle (intern_atoms_callback_idle, state);
+    }
+
+  return True;
+}
+
+/* Like XInternAtoms(), but doesn't wait for the replies. @callback is
+ * called from an idle once all replies have arrived, with the atoms in
+ * the order of @atom_names; atoms that could not be interned are None.
+ */
+void
+_gdk_x11_intern_atoms_async (GdkDisplay            *display,
+			     const gchar * const   *atom_names,
+			     gint                   n_atoms,
+			     GdkInternAtomsCallback callback,
+			     gpointer               data)
+{
+  Display *dpy;
+  InternAtomsState *state;
+  gint i;
+
+  g_return_if_fail (callback != NULL);
+
+  if (n_atoms <= 0)
+    return;
+
+  dpy = GDK_DISPLAY_XDISPLAY (display);
+
+  state = g_new (InternAtomsState, 1);
+
+  state->display = g_object_ref (display);
+  state->dpy = dpy;
+  state->atoms = g_new0 (Atom, n_atoms);
+  state->n_atoms = n_atoms;
+  state->callback = callback;
+  state->data = data;
+
+  LockDisplay(dpy);
+
+  state->async.next = dpy->async_handlers;
+  state->async.handler = intern_atoms_handler;
+  state->async.data = (XPointer) state;
+  dpy->async_handlers = &state->async;
+
+  for (i = 0; i < n_atoms; i++)
+    {
+      xInternAtomReq *req;
+      long nbytes;
+
+      nbytes = strlen (atom_names[i]);
+
+      GetReq(InternAtom, req);
+      req->nbytes = nbytes;
+      req->onlyIfExists = False;
+      req->length += (nbytes + 3) >> 2;
+      Data(dpy, atom_names[i], nbytes);
+
+      if (i == 0)
+	state->first_req = dpy->request;
+    }
+  state->last_req = dpy->request;
+
+  UnlockDisplay(dpy);
+  SyncHandle();
+}
+
 #define __GDK_ASYNC_C__
 #include "gdkaliasdef.c"
@@ -34,6 +34,10 @@ typedef void (*GdkSendXEventCallback) (Window   window,
 typedef void (*GdkRoundTripCallback)  (GdkDisplay *display,
 				       gpointer data,
 				       gulong serial);
+typedef void (*GdkInternAtomsCallback) (GdkDisplay *display,
+					const Atom *atoms,
+					gint        n_atoms,
+					gpointer    data);
 
 struct _GdkChildInfoX11
 {
@@ -70,6 +74,12 @@ void _gdk_x11_roundtrip_async           (GdkDisplay           *display,
 					 GdkRoundTripCallback callback,
 					 gpointer              data);
 
+void _gdk_x11_intern_atoms_async        (GdkDisplay            *display,
+					 const gchar * const   *atom_names,
+					 gint                   n_atoms,
+					 GdkInternAtomsCallback callback,
+					 gpointer               data);
+
 G_END_DECLS
 
 #endif /* __GDK_ASYNC_H__ */
@@ -2307,6 +2307,11 @@ gdk_wm_protocols_filter (GdkXEvent *xev,
   return GDK_FILTER_CONTINUE;
 }
 
+/* How many events to read ahead at most while merging compressible
+ * events, see gdk_window_set_event_compression().
+ */
+#define MAX_COMPRESS_READ_AHEAD 128
+
 void
 _gdk_events_queue (GdkDisplay *display)
 {
@@ -2314,9 +2319,15 @@ _gdk_events_queue (GdkDisplay *display)
   GdkEvent *event;
   XEvent xevent;
   Display *xdisplay = GDK_DISPLAY_XDISPLAY (display);
+  guint n_read = 0;
 
-  while (!_gdk_event_queue_find_first(display) && XPending (xdisplay))
+  while ((!_gdk_event_queue_find_first(display) ||
+	  (n_read < MAX_COMPRESS_READ_AHEAD &&
+	   _gdk_event_queue_tail_is_compressible (display))) &&
+	 XPending (xdisplay))
     {
+      n_read++;
+
       XNextEvent (xdisplay, &xevent);
 
       switch (xevent.type)
@@ -2342,6 +2353,7 @@ _gdk_events_queue (GdkDisplay *display)
 	{
 	  ((GdkEventPrivate *)event)->flags &= ~GDK_EVENT_PENDING;
           _gdk_windowing_got_event (display, node, event, xevent.xany.serial);
+	  _gdk_event_queue_compress_tail (display);
 	}
       else
 	{
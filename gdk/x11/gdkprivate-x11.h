@@ -173,6 +173,12 @@ gboolean _gdk_x11_display_is_root_window (GdkDisplay *display,
 void _gdk_x11_precache_atoms (GdkDisplay          *display,
 			      const gchar * const *atom_names,
 			      gint                 n_atoms);
+void _gdk_x11_precache_atoms_async   (GdkDisplay          *display,
+				      const gchar * const *atom_names,
+				      gint                 n_atoms);
+void _gdk_x11_precache_display_atoms (GdkDisplay          *display,
+				      const gchar * const *atom_names,
+				      gint                 n_atoms);
 
 void _gdk_x11_events_init_screen   (GdkScreen *screen);
 void _gdk_x11_events_uninit_screen (GdkScreen *screen);
@@ -36,12 +36,16 @@
 #include "gdkinternals.h"
 #include "gdkdisplay-x11.h"
 #include "gdkscreen-x11.h"
+#include "gdkasync.h"
 #include "gdkselection.h"	/* only from predefined atom */
 #include "gdkalias.h"
 
 static GPtrArray *virtual_atom_array;
 static GHashTable *virtual_atom_hash;
 
+/* GdkAtoms registered with gdk_x11_register_preload_atoms() */
+static GArray *preload_atoms;
+
 static const gchar xatoms_string[] = 
   /* These are all the standard predefined X atoms */
   "\0"  /* leave a space for None, even though it is not a predefined atom */
@@ -261,6 +265,144 @@ _gdk_x11_precache_atoms (GdkDisplay          *display,
   g_free (atoms);
 }
 
+static void
+precache_atoms_async_done (GdkDisplay *display,
+			   const Atom *xatoms,
+			   gint        n_xatoms,
+			   gpointer    data)
+{
+  GdkAtom *atoms = data;
+  gint i;
+
+  if (!display->closed)
+    {
+      for (i = 0; i < n_xatoms; i++)
+	{
+	  /* The atom may have been interned synchronously meanwhile */
+	  if (xatoms[i] != None && lookup_cached_xatom (display, atoms[i]) == None)
+	    insert_atom_pair (display, atoms[i], xatoms[i]);
+	}
+    }
+
+  g_free (atoms);
+}
+
+/* Like _gdk_x11_precache_atoms(), but doesn't wait for the X server.
+ * Atoms that are looked up before the replies have arrived are still
+ * interned synchronously.
+ */
+void
+_gdk_x11_precache_atoms_async (GdkDisplay          *display,
+			       const gchar * const *atom_names,
+			       gint                 n_atoms)
+{
+  GdkAtom *atoms;
+  const gchar **xatom_names;
+  gint n_xatoms;
+  gint i;
+
+  if (display->closed)
+    return;
+
+  xatom_names = g_new (const gchar *, n_atoms);
+  atoms = g_new (GdkAtom, n_atoms);
+
+  n_xatoms = 0;
+  for (i = 0; i < n_atoms; i++)
+    {
+      GdkAtom atom = gdk_atom_intern_static_string (atom_names[i]);
+      if (lookup_cached_xatom (display, atom) == None)
+	{
+	  atoms[n_xatoms] = atom;
+	  xatom_names[n_xatoms] = atom_names[i];
+	  n_xatoms++;
+	}
+    }
+
+  if (n_xatoms)
+    _gdk_x11_intern_atoms_async (display, xatom_names, n_xatoms,
+				 precache_atoms_async_done, atoms);
+  else
+    g_free (atoms);
+
+  g_free (xatom_names);
+}
+
+/* Interns @atom_names together with the atoms registered with
+ * gdk_x11_register_preload_atoms(), with a single round trip. This is
+ * done when a display is opened.
+ */
+void
+_gdk_x11_precache_display_atoms (GdkDisplay          *display,
+				 const gchar * const *atom_names,
+				 gint                 n_atoms)
+{
+  const gchar **names;
+  gint n_preload;
+  gint i;
+
+  n_preload = preload_atoms ? preload_atoms->len : 0;
+
+  names = g_new (const gchar *, n_atoms + n_preload);
+  for (i = 0; i < n_atoms; i++)
+    names[i] = atom_names[i];
+  for (i = 0; i < n_preload; i++)
+    names[n_atoms + i] = g_ptr_array_index (virtual_atom_array,
+					    ATOM_TO_INDEX (g_array_index (preload_atoms, GdkAtom, i)));
+
+  _gdk_x11_precache_atoms (display, names, n_atoms + n_preload);
+
+  g_free (names);
+}
+
+/**
+ * gdk_x11_register_preload_atoms:
+ * @atom_names: (array length=n_atoms): the names of the atoms
+ * @n_atoms: the number of atoms in @atom_names
+ *
+ * Registers atoms that the application will need on every display.
+ * Converting an atom to an X atom the first time normally takes a
+ * round trip to the X server; registered atoms are instead interned
+ * together with the atoms GDK needs itself, with a single request,
+ * when a display is opened. On displays that are already open, the
+ * atoms are interned asynchronously.
+ *
+ * Call this before gtk_init() to get the full benefit. This is mostly
+ * useful when running over a high latency connection to the X server.
+ *
+ * Since: 2.24.11
+ **/
+void
+gdk_x11_register_preload_atoms (const gchar * const *atom_names,
+				gint                 n_atoms)
+{
+  GSList *displays, *l;
+  GdkAtom atom;
+  gint i, j;
+
+  g_return_if_fail (atom_names != NULL || n_atoms == 0);
+
+  if (!preload_atoms)
+    preload_atoms = g_array_new (FALSE, FALSE, sizeof (GdkAtom));
+
+  for (i = 0; i < n_atoms; i++)
+    {
+      atom = gdk_atom_intern (atom_names[i], FALSE);
+
+      for (j = 0; j < preload_atoms->len; j++)
+	if (g_array_index (preload_atoms, GdkAtom, j) == atom)
+	  break;
+
+      if (j == preload_atoms->len)
+	g_array_append_val (preload_atoms, atom);
+    }
+
+  displays = gdk_display_manager_list_displays (gdk_display_manager_get ());
+  for (l = displays; l; l = l->next)
+    _gdk_x11_precache_atoms_async (l->data, atom_names, n_atoms);
+  g_slist_free (displays);
+}
+
 /**
  * gdk_x11_atom_to_xatom:
  * @atom: A #GdkAtom 
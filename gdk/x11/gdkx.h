@@ -186,6 +186,8 @@ Atom		      gdk_x11_get_xatom_by_name_for_display (GdkDisplay  *display,
 							     const gchar *atom_name);
 const gchar *         gdk_x11_get_xatom_name_for_display (GdkDisplay  *display,
 							  Atom         xatom);
+void                  gdk_x11_register_preload_atoms     (const gchar * const *atom_names,
+							  gint                 n_atoms);
 #ifndef GDK_MULTIHEAD_SAFE
 Atom                  gdk_x11_atom_to_xatom     (GdkAtom      atom);
 GdkAtom               gdk_x11_xatom_to_atom     (Atom         xatom);
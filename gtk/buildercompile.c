@@ -0,0 +1,651 @@
+/* buildercompile.c
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gmodule.h>
+#include <gtk/gtk.h>
+
+#include "gtkbuildercompiled.h"
+
+static gboolean quiet = FALSE;
+
+static GOptionEntry args[] = {
+  { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, "Turn off verbose output", NULL },
+  { NULL }
+};
+
+typedef GType (*GTypeGetFunc) (void);
+
+typedef struct
+{
+  GtkBuilder  *builder;
+  GModule     *module;
+
+  GHashTable  *string_ids;      /* string -> index + 1 */
+  GPtrArray   *strings;
+  GArray      *records;
+  GHashTable  *hinted_classes;
+  GSList      *types;           /* Types of the enclosing objects,
+                                 * innermost first, G_TYPE_INVALID if
+                                 * not known
+                                 */
+  guint        n_objects;
+  guint        n_precompiled;
+
+  /* The <property> element being compiled */
+  gboolean     in_property;
+  gint         property_line;
+  gchar      **property_names;
+  gchar      **property_values;
+  GString     *property_text;
+
+  /* The custom element being compiled, as XML */
+  guint        custom_depth;
+  gint         custom_line;
+  GString     *custom;
+} Compiler;
+
+static guint32
+add_string (Compiler    *compiler,
+	    const gchar *string)
+{
+  gpointer id;
+
+  id = g_hash_table_lookup (compiler->string_ids, string);
+  if (id == NULL)
+    {
+      gchar *copy = g_strdup (string);
+
+      g_ptr_array_add (compiler->strings, copy);
+      id = GUINT_TO_POINTER (compiler->strings->len);
+      g_hash_table_insert (compiler->string_ids, copy, id);
+    }
+
+  return GPOINTER_TO_UINT (id) - 1;
+}
+
+static void
+add_word (Compiler *compiler,
+	  guint32   value)
+{
+  g_array_append_val (compiler->records, value);
+}
+
+static gboolean
+add_attributes (Compiler     *compiler,
+		const gchar **names,
+		const gchar **values,
+		GError      **error)
+{
+  guint i, n_attributes;
+
+  n_attributes = g_strv_length ((gchar **) names);
+  if (n_attributes > GTK_BUILDER_COMPILED_MAX_ATTRIBUTES)
+    {
+      g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+		   "too many attributes");
+      return FALSE;
+    }
+
+  add_word (compiler, n_attributes);
+  for (i = 0; i < n_attributes; i++)
+    {
+      add_word (compiler, add_string (compiler, names[i]));
+      add_word (compiler, add_string (compiler, values[i]));
+    }
+
+  return TRUE;
+}
+
+/* The name of the _get_type function that GtkBuilder guesses for a
+ * class that is not registered yet, e.g. GtkHBox -> gtk_hbox_get_type
+ */
+static gchar *
+get_type_function (const gchar *name)
+{
+  GString *symbol_name = g_string_new ("");
+  char c;
+  int i;
+
+  for (i = 0; name[i] != '\0'; i++)
+    {
+      c = name[i];
+      /* skip if uppercase, first or previous is uppercase */
+      if ((c == g_ascii_toupper (c) &&
+           i > 0 && name[i-1] != g_ascii_toupper (name[i-1])) ||
+          (i > 2 && name[i]   == g_ascii_toupper (name[i]) &&
+           name[i-1] == g_ascii_toupper (name[i-1]) &&
+           name[i-2] == g_ascii_toupper (name[i-2])))
+        g_string_append_c (symbol_name, '_');
+      g_string_append_c (symbol_name, g_ascii_tolower (c));
+    }
+  g_string_append (symbol_name, "_get_type");
+
+  return g_string_free (symbol_name, FALSE);
+}
+
+static GType
+resolve_class (Compiler    *compiler,
+	       const gchar *class_name)
+{
+  GTypeGetFunc func;
+  gchar *symbol;
+  GType type;
+
+  type = gtk_builder_get_type_from_name (compiler->builder, class_name);
+  if (type == G_TYPE_INVALID ||
+      g_hash_table_lookup (compiler->hinted_classes, class_name))
+    return type;
+
+  g_hash_table_insert (compiler->hinted_classes, g_strdup (class_name),
+		       GINT_TO_POINTER (TRUE));
+
+  symbol = get_type_function (class_name);
+  if (compiler->module &&
+      g_module_symbol (compiler->module, symbol, (gpointer) &func) &&
+      func () == type)
+    {
+      add_word (compiler, GTK_BUILDER_RECORD_TYPE_HINT);
+      add_word (compiler, add_string (compiler, class_name));
+      add_word (compiler, add_string (compiler, symbol));
+    }
+  g_free (symbol);
+
+  return type;
+}
+
+static void
+append_escaped (GString     *string,
+		const gchar *text,
+		gssize       length)
+{
+  const gchar *p, *end;
+
+  end = text + (length < 0 ? strlen (text) : length);
+  for (p = text; p < end; p++)
+    {
+      switch (*p)
+	{
+	case '&':  g_string_append (string, "&amp;");  break;
+	case '<':  g_string_append (string, "&lt;");   break;
+	case '>':  g_string_append (string, "&gt;");   break;
+	case '"':  g_string_append (string, "&quot;"); break;
+	case '\'': g_string_append (string, "&apos;"); break;
+	/* Keeps them from being normalized in attribute values */
+	case '\t': g_string_append (string, "&#9;");   break;
+	case '\n': g_string_append (string, "&#10;");  break;
+	case '\r': g_string_append (string, "&#13;");  break;
+	default:   g_string_append_c (string, *p);      break;
+	}
+    }
+}
+
+static void
+append_start_tag (GString      *string,
+		  const gchar  *element_name,
+		  const gchar **names,
+		  const gchar **values)
+{
+  gint i;
+
+  g_string_append_printf (string, "<%s", element_name);
+  for (i = 0; names[i]; i++)
+    {
+      g_string_append_printf (string, " %s=\"", names[i]);
+      append_escaped (string, values[i], -1);
+      g_string_append_c (string, '"');
+    }
+  g_string_append_c (string, '>');
+}
+
+static gboolean
+is_builder_element (const gchar *element_name)
+{
+  return strcmp (element_name, "interface") == 0 ||
+	 strcmp (element_name, "requires") == 0 ||
+	 strcmp (element_name, "object") == 0 ||
+	 strcmp (element_name, "child") == 0 ||
+	 strcmp (element_name, "signal") == 0;
+}
+
+static gboolean
+is_false (const gchar *string)
+{
+  return g_ascii_strcasecmp (string, "no") == 0 ||
+	 g_ascii_strcasecmp (string, "false") == 0 ||
+	 g_ascii_strcasecmp (string, "n") == 0 ||
+	 g_ascii_strcasecmp (string, "f") == 0 ||
+	 strcmp (string, "0") == 0;
+}
+
+/* Converts the value of a property the way GtkBuilder would when
+ * constructing the object, for the types where the result can be
+ * stored as a number.
+ */
+static guint32
+precompile_value (Compiler    *compiler,
+		  GType        type,
+		  const gchar *property_name,
+		  const gchar *text,
+		  guint64     *result)
+{
+  GObjectClass *oclass;
+  GParamSpec *pspec;
+  GValue value = { 0, };
+  guint32 value_type;
+  union { gdouble d; guint64 u; } bits;
+
+  if (!G_TYPE_IS_OBJECT (type))
+    return GTK_BUILDER_VALUE_NONE;
+
+  oclass = g_type_class_ref (type);
+  pspec = g_object_class_find_property (oclass, property_name);
+  g_type_class_unref (oclass);
+
+  if (!pspec || G_IS_PARAM_SPEC_UNICHAR (pspec))
+    return GTK_BUILDER_VALUE_NONE;
+
+  switch (G_TYPE_FUNDAMENTAL (G_PARAM_SPEC_VALUE_TYPE (pspec)))
+    {
+    case G_TYPE_BOOLEAN: value_type = GTK_BUILDER_VALUE_BOOLEAN; break;
+    case G_TYPE_INT:     value_type = GTK_BUILDER_VALUE_INT;     break;
+    case G_TYPE_UINT:    value_type = GTK_BUILDER_VALUE_UINT;    break;
+    case G_TYPE_LONG:    value_type = GTK_BUILDER_VALUE_LONG;    break;
+    case G_TYPE_ULONG:   value_type = GTK_BUILDER_VALUE_ULONG;   break;
+    case G_TYPE_ENUM:    value_type = GTK_BUILDER_VALUE_ENUM;    break;
+    case G_TYPE_FLAGS:   value_type = GTK_BUILDER_VALUE_FLAGS;   break;
+    case G_TYPE_FLOAT:   value_type = GTK_BUILDER_VALUE_FLOAT;   break;
+    case G_TYPE_DOUBLE:  value_type = GTK_BUILDER_VALUE_DOUBLE;  break;
+    default:
+      return GTK_BUILDER_VALUE_NONE;
+    }
+
+  /* Invalid values are left to GtkBuilder to warn about */
+  if (!gtk_builder_value_from_string (compiler->builder, pspec, text, &value, NULL))
+    return GTK_BUILDER_VALUE_NONE;
+
+  switch (value_type)
+    {
+    case GTK_BUILDER_VALUE_BOOLEAN: *result = g_value_get_boolean (&value); break;
+    case GTK_BUILDER_VALUE_INT:     *result = (gint64) g_value_get_int (&value); break;
+    case GTK_BUILDER_VALUE_UINT:    *result = g_value_get_uint (&value); break;
+    case GTK_BUILDER_VALUE_LONG:    *result = (gint64) g_value_get_long (&value); break;
+    case GTK_BUILDER_VALUE_ULONG:   *result = g_value_get_ulong (&value); break;
+    case GTK_BUILDER_VALUE_ENUM:    *result = (gint64) g_value_get_enum (&value); break;
+    case GTK_BUILDER_VALUE_FLAGS:   *result = g_value_get_flags (&value); break;
+    case GTK_BUILDER_VALUE_FLOAT:
+      bits.d = g_value_get_float (&value);
+      *result = bits.u;
+      break;
+    case GTK_BUILDER_VALUE_DOUBLE:
+      bits.d = g_value_get_double (&value);
+      *result = bits.u;
+      break;
+    }
+  g_value_unset (&value);
+
+  compiler->n_precompiled++;
+
+  return value_type;
+}
+
+static gboolean
+add_property (Compiler  *compiler,
+	      GError   **error)
+{
+  const gchar *name = NULL;
+  gboolean translatable = FALSE;
+  guint32 value_type = GTK_BUILDER_VALUE_NONE;
+  guint64 value = 0;
+  gint i;
+
+  for (i = 0; compiler->property_names[i]; i++)
+    {
+      if (strcmp (compiler->property_names[i], "name") == 0)
+	name = compiler->property_values[i];
+      else if (strcmp (compiler->property_names[i], "translatable") == 0)
+	{
+	  /* Invalid values are left to GtkBuilder to report */
+	  translatable = !is_false (compiler->property_values[i]);
+	}
+    }
+
+  if (name && !translatable && compiler->types)
+    {
+      gchar *canonical_name = g_strdelimit (g_strdup (name), "_", '-');
+
+      value_type = precompile_value (compiler,
+				     GPOINTER_TO_SIZE (compiler->types->data),
+				     canonical_name,
+				     compiler->property_text->str,
+				     &value);
+      g_free (canonical_name);
+    }
+
+  add_word (compiler, GTK_BUILDER_RECORD_PROPERTY);
+  add_word (compiler, compiler->property_line);
+  if (!add_attributes (compiler,
+		       (const gchar **) compiler->property_names,
+		       (const gchar **) compiler->property_values,
+		       error))
+    return FALSE;
+  add_word (compiler, add_string (compiler, compiler->property_text->str));
+  add_word (compiler, value_type);
+  add_word (compiler, value >> 32);
+  add_word (compiler, value & 0xffffffff);
+
+  return TRUE;
+}
+
+static void
+start_element (GMarkupParseContext  *context,
+	       const gchar          *element_name,
+	       const gchar         **names,
+	       const gchar         **values,
+	       gpointer              user_data,
+	       GError              **error)
+{
+  Compiler *compiler = user_data;
+  gint line;
+  gint i;
+
+  g_markup_parse_context_get_position (context, &line, NULL);
+
+  if (compiler->custom_depth > 0)
+    {
+      append_start_tag (compiler->custom, element_name, names, values);
+      compiler->custom_depth++;
+    }
+  else if (compiler->in_property)
+    {
+      g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+		   "'%s' is not a valid tag in a property", element_name);
+    }
+  else if (strcmp (element_name, "property") == 0)
+    {
+      compiler->in_property = TRUE;
+      compiler->property_line = line;
+      compiler->property_names = g_strdupv ((gchar **) names);
+      compiler->property_values = g_strdupv ((gchar **) values);
+      g_string_truncate (compiler->property_text, 0);
+    }
+  else if (strcmp (element_name, "placeholder") == 0)
+    {
+      /* GtkBuilder ignores these */
+    }
+  else if (is_builder_element (element_name))
+    {
+      if (strcmp (element_name, "object") == 0)
+	{
+	  GType type = G_TYPE_INVALID;
+
+	  for (i = 0; names[i]; i++)
+	    {
+	      if (strcmp (names[i], "class") == 0)
+		type = resolve_class (compiler, values[i]);
+	    }
+
+	  compiler->types = g_slist_prepend (compiler->types, GSIZE_TO_POINTER (type));
+	  compiler->n_objects++;
+	}
+
+      add_word (compiler, GTK_BUILDER_RECORD_START_ELEMENT);
+      add_word (compiler, line);
+      add_word (compiler, add_string (compiler, element_name));
+      add_attributes (compiler, names, values, error);
+    }
+  else
+    {
+      /* Left to the buildable to parse when the interface is loaded */
+      compiler->custom_depth = 1;
+      compiler->custom_line = line;
+      g_string_truncate (compiler->custom, 0);
+      append_start_tag (compiler->custom, element_name, names, values);
+    }
+}
+
+static void
+end_element (GMarkupParseContext  *context,
+	     const gchar          *element_name,
+	     gpointer              user_data,
+	     GError              **error)
+{
+  Compiler *compiler = user_data;
+
+  if (compiler->custom_depth > 0)
+    {
+      g_string_append_printf (compiler->custom, "</%s>", element_name);
+
+      if (--compiler->custom_depth == 0)
+	{
+	  add_word (compiler, GTK_BUILDER_RECORD_CUSTOM);
+	  add_word (compiler, compiler->custom_line);
+	  add_word (compiler, add_string (compiler, compiler->custom->str));
+	}
+    }
+  else if (compiler->in_property)
+    {
+      add_property (compiler, error);
+
+      g_strfreev (compiler->property_names);
+      g_strfreev (compiler->property_values);
+      compiler->in_property = FALSE;
+    }
+  else if (strcmp (element_name, "placeholder") == 0)
+    {
+    }
+  else
+    {
+      if (strcmp (element_name, "object") == 0)
+	compiler->types = g_slist_delete_link (compiler->types, compiler->types);
+
+      add_word (compiler, GTK_BUILDER_RECORD_END_ELEMENT);
+      add_word (compiler, add_string (compiler, element_name));
+    }
+}
+
+static void
+text (GMarkupParseContext  *context,
+      const gchar          *text,
+      gsize                 text_len,
+      gpointer              user_data,
+      GError              **error)
+{
+  Compiler *compiler = user_data;
+
+  if (compiler->custom_depth > 0)
+    append_escaped (compiler->custom, text, text_len);
+  else if (compiler->in_property)
+    g_string_append_len (compiler->property_text, text, text_len);
+}
+
+static const GMarkupParser parser = {
+  start_element,
+  end_element,
+  text,
+  NULL,
+  NULL
+};
+
+static void
+write_uint16 (GString *data,
+	      guint16  value)
+{
+  value = GUINT16_TO_BE (value);
+  g_string_append_len (data, (gchar *) &value, 2);
+}
+
+static void
+write_uint32 (GString *data,
+	      guint32  value)
+{
+  value = GUINT32_TO_BE (value);
+  g_string_append_len (data, (gchar *) &value, 4);
+}
+
+static GString *
+write_compiled (Compiler *compiler)
+{
+  GString *data, *strings;
+  guint32 strings_offset, records_offset, data_offset;
+  guint i;
+
+  strings_offset = GTK_BUILDER_COMPILED_HEADER_SIZE;
+  records_offset = strings_offset + 4 + 4 * compiler->strings->len;
+  data_offset = records_offset + 4 * compiler->records->len;
+
+  data = g_string_new (NULL);
+  strings = g_string_new (NULL);
+
+  g_string_append_len (data, GTK_BUILDER_COMPILED_MAGIC, GTK_BUILDER_COMPILED_MAGIC_LEN);
+  write_uint16 (data, GTK_BUILDER_COMPILED_MAJOR_VERSION);
+  write_uint16 (data, GTK_BUILDER_COMPILED_MINOR_VERSION);
+  write_uint32 (data, strings_offset);
+  write_uint32 (data, records_offset);
+  write_uint32 (data, 4 * compiler->records->len);
+
+  write_uint32 (data, compiler->strings->len);
+  for (i = 0; i < compiler->strings->len; i++)
+    {
+      const gchar *string = g_ptr_array_index (compiler->strings, i);
+
+      write_uint32 (data, data_offset + strings->len);
+      g_string_append_len (strings, string, strlen (string) + 1);
+    }
+
+  for (i = 0; i < compiler->records->len; i++)
+    write_uint32 (data, g_array_index (compiler->records, guint32, i));
+
+  g_assert (data->len == data_offset);
+  g_string_append_len (data, strings->str, strings->len);
+  g_string_free (strings, TRUE);
+
+  return data;
+}
+
+static gboolean
+compile (const gchar  *input,
+	 const gchar  *output,
+	 GError      **error)
+{
+  GMarkupParseContext *context;
+  Compiler compiler = { NULL, };
+  GString *data;
+  gchar *contents;
+  gsize length;
+  gboolean result;
+
+  if (!g_file_get_contents (input, &contents, &length, error))
+    return FALSE;
+
+  compiler.builder = gtk_builder_new ();
+  compiler.module = g_module_open (NULL, 0);
+  compiler.string_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  compiler.strings = g_ptr_array_new ();
+  compiler.records = g_array_new (FALSE, FALSE, sizeof (guint32));
+  compiler.hinted_classes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  compiler.property_text = g_string_new (NULL);
+  compiler.custom = g_string_new (NULL);
+
+  context = g_markup_parse_context_new (&parser, G_MARKUP_TREAT_CDATA_AS_TEXT,
+					&compiler, NULL);
+  result = g_markup_parse_context_parse (context, contents, length, error) &&
+	   g_markup_parse_context_end_parse (context, error);
+  g_markup_parse_context_free (context);
+
+  if (result)
+    {
+      data = write_compiled (&compiler);
+      result = g_file_set_contents (output, data->str, data->len, error);
+
+      if (result && !quiet)
+	g_printerr ("Compiled %s: %u objects, %u precompiled values, %u bytes\n",
+		    input, compiler.n_objects, compiler.n_precompiled,
+		    (guint) data->len);
+
+      g_string_free (data, TRUE);
+    }
+
+  if (compiler.in_property)
+    {
+      g_strfreev (compiler.property_names);
+      g_strfreev (compiler.property_values);
+    }
+  g_string_free (compiler.property_text, TRUE);
+  g_string_free (compiler.custom, TRUE);
+  g_slist_free (compiler.types);
+  g_hash_table_destroy (compiler.hinted_classes);
+  g_array_free (compiler.records, TRUE);
+  g_hash_table_destroy (compiler.string_ids);
+  g_ptr_array_foreach (compiler.strings, (GFunc) g_free, NULL);
+  g_ptr_array_free (compiler.strings, TRUE);
+  if (compiler.module)
+    g_module_close (compiler.module);
+  g_object_unref (compiler.builder);
+  g_free (contents);
+
+  return result;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+
+  setlocale (LC_ALL, "");
+
+  context = g_option_context_new ("INPUT OUTPUT");
+  g_option_context_set_summary (context,
+				"Compile a GtkBuilder UI definition into a "
+				"binary form that loads faster.");
+  g_option_context_add_main_entries (context, args, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (argc != 3)
+    {
+      g_printerr ("Expected an input and an output file\n");
+      return 1;
+    }
+
+  /* Classes are only looked at, not instantiated, so this does not
+   * need a display
+   */
+  g_type_init ();
+
+  if (!compile (argv[1], argv[2], &error))
+    {
+      g_printerr ("Failed to compile %s: %s\n", argv[1], error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  return 0;
+}
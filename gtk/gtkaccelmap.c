@@ -31,6 +31,8 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -57,10 +59,38 @@ typedef struct {
   guint	       std_accel_key;
   guint	       std_accel_mods;
   guint        changed    :  1;
-  guint        lock_count : 15;
+  guint        notify_queued : 1;
+  guint        lock_count : 14;
   GSList      *groups;
 } AccelEntry;
 
+/* The cache written next to an accel map file by gtk_accel_map_save().
+ * It holds the entries that the file sets, sorted by accel path, so
+ * that gtk_accel_map_load() can map it instead of parsing the file and
+ * look the entries up when they are first used. The cache is in host
+ * byte order and only used if the file still has the size, the
+ * modification time and the MD5 digest it had when the cache was
+ * written; the digest catches edits within the same second.
+ */
+#define ACCEL_MAP_CACHE_MAGIC   0x47414d43	/* "GAMC" */
+#define ACCEL_MAP_CACHE_VERSION 2
+
+typedef struct {
+  guint32 magic;
+  guint32 version;
+  guint32 n_entries;
+  guint32 padding;
+  guint64 source_size;
+  guint64 source_mtime;
+  guint8  source_digest[16];
+} AccelMapCacheHeader;
+
+typedef struct {
+  guint32 path_offset;	/* Of a nul-terminated string in the cache */
+  guint32 accel_key;
+  guint32 accel_mods;
+} AccelMapCacheEntry;
+
 /* --- signals --- */
 enum {
   CHANGED,
@@ -74,8 +104,21 @@ static GSList      *accel_filters = NULL;
 static gulong	    accel_map_signals[LAST_SIGNAL] = { 0, };
 static GtkAccelMap *accel_map;
 
+/* Entries set by the last loaded accel map that have not been looked
+ * up yet, either parsed from a file or in a mapped cache
+ */
+static GHashTable  *pending_entries = NULL;	/* accel_path -> GtkAccelKey */
+static GMappedFile *pending_cache = NULL;
+static const AccelMapCacheEntry *pending_cache_entries = NULL;
+static guint        pending_cache_n_entries = 0;
+
+/* Changed notifications held back while an accel map is loaded */
+static guint        notify_freeze_count = 0;
+static GSList      *notify_queue = NULL;
+
 /* --- prototypes --- */
-static void do_accel_map_changed (AccelEntry *entry);
+static void        do_accel_map_changed        (AccelEntry  *entry);
+static AccelEntry *accel_path_register_pending (const gchar *accel_path);
 
 /* --- functions --- */
 static guint
@@ -99,12 +142,20 @@ accel_entry_equal (gconstpointer key1,
 static inline AccelEntry*
 accel_path_lookup (const gchar *accel_path)
 {
-  AccelEntry ekey;
+  AccelEntry ekey, *entry;
+
+  /* safety NULL check for return_if_fail()s */
+  if (!accel_path)
+    return NULL;
 
   ekey.accel_path = accel_path;
+  entry = g_hash_table_lookup (accel_entry_ht, &ekey);
 
-  /* safety NULL check for return_if_fail()s */
-  return accel_path ? g_hash_table_lookup (accel_entry_ht, &ekey) : NULL;
+  /* paths set by a loaded accel map are registered when first used */
+  if (!entry && (pending_entries || pending_cache))
+    entry = accel_path_register_pending (accel_path);
+
+  return entry;
 }
 
 void
@@ -129,6 +180,225 @@ _gtk_accel_path_is_valid (const gchar *accel_path)
   return TRUE;
 }
 
+static AccelEntry*
+accel_path_lookup_registered (const gchar *accel_path)
+{
+  AccelEntry ekey;
+
+  ekey.accel_path = accel_path;
+
+  return g_hash_table_lookup (accel_entry_ht, &ekey);
+}
+
+/* Adds an entry for a path set by a loaded accel map, in the state
+ * that gtk_accel_map_change_entry() leaves a new path in.
+ */
+static AccelEntry*
+accel_entry_register (const gchar    *accel_path,
+		      guint           accel_key,
+		      GdkModifierType accel_mods)
+{
+  AccelEntry *entry;
+
+  entry = g_slice_new0 (AccelEntry);
+  entry->accel_path = g_intern_string (accel_path);
+  entry->accel_key = accel_key;
+  entry->accel_mods = accel_mods;
+  entry->changed = TRUE;
+  g_hash_table_insert (accel_entry_ht, entry, entry);
+
+  return entry;
+}
+
+static gint
+accel_map_cache_find (const gchar *accel_path)
+{
+  const gchar *data = g_mapped_file_get_contents (pending_cache);
+  guint lower = 0, upper = pending_cache_n_entries;
+
+  while (lower < upper)
+    {
+      guint mid = (lower + upper) / 2;
+      gint cmp = strcmp (accel_path, data + pending_cache_entries[mid].path_offset);
+
+      if (cmp == 0)
+	return mid;
+      else if (cmp < 0)
+	upper = mid;
+      else
+	lower = mid + 1;
+    }
+
+  return -1;
+}
+
+static AccelEntry*
+accel_path_register_pending (const gchar *accel_path)
+{
+  AccelEntry *entry = NULL;
+
+  if (pending_entries)
+    {
+      GtkAccelKey *key = g_hash_table_lookup (pending_entries, accel_path);
+
+      if (key)
+	{
+	  entry = accel_entry_register (accel_path, key->accel_key, key->accel_mods);
+	  g_hash_table_remove (pending_entries, accel_path);
+	}
+    }
+  else if (pending_cache)
+    {
+      gint i = accel_map_cache_find (accel_path);
+
+      if (i >= 0)
+	entry = accel_entry_register (accel_path,
+				      pending_cache_entries[i].accel_key,
+				      pending_cache_entries[i].accel_mods);
+    }
+
+  return entry;
+}
+
+/* Registers all the entries that are still pending, and notifies
+ * about them if @notify is set.
+ */
+static void
+accel_map_register_pending (gboolean notify)
+{
+  AccelEntry *entry;
+
+  if (pending_entries)
+    {
+      GHashTableIter iter;
+      gpointer accel_path, value;
+
+      g_hash_table_iter_init (&iter, pending_entries);
+      while (g_hash_table_iter_next (&iter, &accel_path, &value))
+	{
+	  GtkAccelKey *key = value;
+
+	  if (accel_path_lookup_registered (accel_path))
+	    continue;
+
+	  entry = accel_entry_register (accel_path, key->accel_key, key->accel_mods);
+	  if (notify)
+	    do_accel_map_changed (entry);
+	}
+
+      g_hash_table_destroy (pending_entries);
+      pending_entries = NULL;
+    }
+
+  if (pending_cache)
+    {
+      const gchar *data = g_mapped_file_get_contents (pending_cache);
+      guint i;
+
+      for (i = 0; i < pending_cache_n_entries; i++)
+	{
+	  const AccelMapCacheEntry *cache_entry = &pending_cache_entries[i];
+	  const gchar *accel_path = data + cache_entry->path_offset;
+
+	  /* looked up earlier, and maybe changed since */
+	  if (accel_path_lookup_registered (accel_path))
+	    continue;
+
+	  entry = accel_entry_register (accel_path,
+					cache_entry->accel_key,
+					cache_entry->accel_mods);
+	  if (notify)
+	    do_accel_map_changed (entry);
+	}
+
+      g_mapped_file_unref (pending_cache);
+      pending_cache = NULL;
+      pending_cache_entries = NULL;
+      pending_cache_n_entries = 0;
+    }
+}
+
+static void
+accel_map_thaw_notify (void)
+{
+  GSList *queue, *slist;
+
+  if (--notify_freeze_count > 0)
+    return;
+
+  queue = g_slist_reverse (notify_queue);
+  notify_queue = NULL;
+
+  for (slist = queue; slist; slist = slist->next)
+    {
+      AccelEntry *entry = slist->data;
+
+      entry->notify_queued = FALSE;
+      do_accel_map_changed (entry);
+    }
+  g_slist_free (queue);
+}
+
+static void
+accel_map_begin_load (void)
+{
+  /* the entries of an earlier load apply before the new ones */
+  accel_map_register_pending (FALSE);
+
+  notify_freeze_count++;
+}
+
+static void
+accel_map_end_load (void)
+{
+  /* Entries are registered when they are first looked up, without
+   * a notification. If somebody listens for changes, register them
+   * right away instead, so that they get notified as before.
+   */
+  if (accel_map &&
+      g_signal_has_handler_pending (accel_map, accel_map_signals[CHANGED], 0, FALSE))
+    accel_map_register_pending (TRUE);
+
+  accel_map_thaw_notify ();
+}
+
+static void
+free_accel_key (gpointer data)
+{
+  g_slice_free (GtkAccelKey, data);
+}
+
+/* Applies an accelerator read from an accel map. Paths that have
+ * not been registered yet are only remembered until they are used.
+ */
+static void
+accel_map_load_entry (const gchar    *accel_path,
+		      guint           accel_key,
+		      GdkModifierType accel_mods)
+{
+  GtkAccelKey *key;
+
+  g_return_if_fail (_gtk_accel_path_is_valid (accel_path));
+
+  if (!accel_key)
+    accel_mods = 0;
+
+  if (accel_path_lookup_registered (accel_path))
+    {
+      gtk_accel_map_change_entry (accel_path, accel_key, accel_mods, TRUE);
+      return;
+    }
+
+  if (!pending_entries)
+    pending_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     g_free, free_accel_key);
+
+  key = g_slice_new0 (GtkAccelKey);
+  key->accel_key = accel_key;
+  key->accel_mods = accel_mods;
+  g_hash_table_replace (pending_entries, g_strdup (accel_path), key);
+}
+
 /**
  * gtk_accel_map_add_entry:
  * @accel_path: valid accelerator path
@@ -475,12 +745,9 @@ accel_map_parse_accel_path (GScanner *scanner)
   g_scanner_get_next_token (scanner);
   accel = g_strdup (scanner->value.v_string);
 
-  /* ensure the entry is present */
-  gtk_accel_map_add_entry (path, 0, 0);
-
   /* and propagate it */
   gtk_accelerator_parse (accel, &accel_key, &accel_mods);
-  gtk_accel_map_change_entry (path, accel_key, accel_mods, TRUE);
+  accel_map_load_entry (path, accel_key, accel_mods);
 
   g_free (accel);
   g_free (path);
@@ -562,6 +829,8 @@ gtk_accel_map_load_scanner (GScanner *scanner)
   g_scanner_scope_add_symbol (scanner, 0, "gtk_accel_path", 
 			      accel_map_parse_accel_path);
 
+  accel_map_begin_load ();
+
   /* outer parsing loop
    */
   g_scanner_peek_next_token (scanner);
@@ -574,6 +843,8 @@ gtk_accel_map_load_scanner (GScanner *scanner)
       g_scanner_peek_next_token (scanner);
     }
 
+  accel_map_end_load ();
+
   /* restore config */
   scanner->config->skip_comment_single = skip_comment_single;
   scanner->config->cpair_comment_single = cpair_comment_single;
@@ -607,6 +878,108 @@ gtk_accel_map_load_fd (gint fd)
   g_scanner_destroy (scanner);
 }
 
+/* Computes the MD5 digest of the contents of @file_name */
+static gboolean
+accel_map_file_digest (const gchar *file_name,
+		       guint8       digest[16])
+{
+  GChecksum *checksum;
+  gchar *contents;
+  gsize length, digest_len = 16;
+
+  if (!g_file_get_contents (file_name, &contents, &length, NULL))
+    return FALSE;
+
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  g_checksum_update (checksum, (const guchar *) contents, length);
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  g_checksum_free (checksum);
+  g_free (contents);
+
+  return TRUE;
+}
+
+static gboolean
+accel_map_load_cache (const gchar *file_name)
+{
+  const AccelMapCacheHeader *header;
+  const AccelMapCacheEntry *entries;
+  GMappedFile *map;
+  struct stat st;
+  const gchar *data;
+  gchar *cache_name;
+  GSList *registered, *slist;
+  gsize length, strings_start;
+  guint8 digest[16];
+  guint i;
+
+  if (g_stat (file_name, &st) < 0)
+    return FALSE;
+
+  cache_name = g_strconcat (file_name, ".cache", NULL);
+  map = g_mapped_file_new (cache_name, FALSE, NULL);
+  g_free (cache_name);
+
+  if (!map)
+    return FALSE;
+
+  data = g_mapped_file_get_contents (map);
+  length = g_mapped_file_get_length (map);
+  header = (const AccelMapCacheHeader *) data;
+  entries = (const AccelMapCacheEntry *) (data + sizeof (AccelMapCacheHeader));
+
+  if (length <= sizeof (AccelMapCacheHeader) ||
+      header->magic != ACCEL_MAP_CACHE_MAGIC ||
+      header->version != ACCEL_MAP_CACHE_VERSION ||
+      header->source_size != (guint64) st.st_size ||
+      header->source_mtime != (guint64) st.st_mtime ||
+      header->n_entries > (length - sizeof (AccelMapCacheHeader)) / sizeof (AccelMapCacheEntry) ||
+      data[length - 1] != '\0')
+    goto invalid;
+
+  if (!accel_map_file_digest (file_name, digest) ||
+      memcmp (digest, header->source_digest, sizeof (digest)) != 0)
+    goto invalid;
+
+  /* every path is inside the cache and, given the check for the
+   * last byte, nul-terminated
+   */
+  strings_start = sizeof (AccelMapCacheHeader) + header->n_entries * sizeof (AccelMapCacheEntry);
+  for (i = 0; i < header->n_entries; i++)
+    if (entries[i].path_offset < strings_start || entries[i].path_offset >= length)
+      goto invalid;
+
+  accel_map_begin_load ();
+
+  pending_cache = map;
+  pending_cache_entries = entries;
+  pending_cache_n_entries = header->n_entries;
+
+  /* paths that are already in use change right away */
+  registered = g_hash_table_slist_values (accel_entry_ht);
+  for (slist = registered; slist; slist = slist->next)
+    {
+      AccelEntry *entry = slist->data;
+      gint j = accel_map_cache_find (entry->accel_path);
+
+      if (j >= 0)
+	gtk_accel_map_change_entry (entry->accel_path,
+				    entries[j].accel_key,
+				    entries[j].accel_mods,
+				    TRUE);
+    }
+  g_slist_free (registered);
+
+  accel_map_end_load ();
+
+  return TRUE;
+
+ invalid:
+  g_mapped_file_unref (map);
+
+  return FALSE;
+}
+
 /**
  * gtk_accel_map_load:
  * @file_name: a file containing accelerator specifications,
@@ -614,6 +987,9 @@ gtk_accel_map_load_fd (gint fd)
  *
  * Parses a file previously saved with gtk_accel_map_save() for
  * accelerator specifications, and propagates them accordingly.
+ *
+ * If the cache that gtk_accel_map_save() writes next to the file
+ * is still up to date, it is used instead of parsing the file.
  */
 void
 gtk_accel_map_load (const gchar *file_name)
@@ -625,6 +1001,9 @@ gtk_accel_map_load (const gchar *file_name)
   if (!g_file_test (file_name, G_FILE_TEST_IS_REGULAR))
     return;
 
+  if (accel_map_load_cache (file_name))
+    return;
+
   fd = g_open (file_name, O_RDONLY, 0);
   if (fd < 0)
     return;
@@ -718,6 +1097,83 @@ gtk_accel_map_save_fd (gint fd)
   gtk_accel_map_foreach (GINT_TO_POINTER (fd), accel_map_print);
 }
 
+static void
+accel_map_collect_changed (gpointer        data,
+			   const gchar    *accel_path,
+			   guint           accel_key,
+			   GdkModifierType accel_mods,
+			   gboolean        changed)
+{
+  GPtrArray *paths = data;
+
+  /* the others are commented out in the file */
+  if (changed)
+    g_ptr_array_add (paths, (gpointer) accel_path);
+}
+
+static gint
+accel_path_compare (gconstpointer a,
+		    gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static void
+accel_map_save_cache (const gchar *file_name)
+{
+  AccelMapCacheHeader header = { 0, };
+  GPtrArray *paths;
+  GString *data;
+  struct stat st;
+  gchar *cache_name;
+  guint32 offset;
+  guint i;
+
+  if (g_stat (file_name, &st) < 0 ||
+      !accel_map_file_digest (file_name, header.source_digest))
+    return;
+
+  paths = g_ptr_array_new ();
+  gtk_accel_map_foreach (paths, accel_map_collect_changed);
+  g_ptr_array_sort (paths, accel_path_compare);
+
+  header.magic = ACCEL_MAP_CACHE_MAGIC;
+  header.version = ACCEL_MAP_CACHE_VERSION;
+  header.n_entries = paths->len;
+  header.source_size = st.st_size;
+  header.source_mtime = st.st_mtime;
+
+  data = g_string_new (NULL);
+  g_string_append_len (data, (const gchar *) &header, sizeof (header));
+
+  offset = sizeof (header) + paths->len * sizeof (AccelMapCacheEntry);
+  for (i = 0; i < paths->len; i++)
+    {
+      AccelEntry *entry = accel_path_lookup_registered (paths->pdata[i]);
+      AccelMapCacheEntry cache_entry;
+
+      cache_entry.path_offset = offset;
+      cache_entry.accel_key = entry->accel_key;
+      cache_entry.accel_mods = entry->accel_mods;
+      g_string_append_len (data, (const gchar *) &cache_entry, sizeof (cache_entry));
+
+      offset += strlen (entry->accel_path) + 1;
+    }
+
+  for (i = 0; i < paths->len; i++)
+    g_string_append_len (data, paths->pdata[i], strlen (paths->pdata[i]) + 1);
+
+  /* so that the cache always ends in a nul byte */
+  g_string_append_c (data, '\0');
+
+  cache_name = g_strconcat (file_name, ".cache", NULL);
+  g_file_set_contents (cache_name, data->str, data->len, NULL);
+  g_free (cache_name);
+
+  g_string_free (data, TRUE);
+  g_ptr_array_free (paths, TRUE);
+}
+
 /**
  * gtk_accel_map_save:
  * @file_name: the name of the file to contain accelerator specifications,
@@ -727,6 +1183,10 @@ gtk_accel_map_save_fd (gint fd)
  * and modifiers) to @file_name.
  * The file is written in a format suitable to be read back in by
  * gtk_accel_map_load().
+ *
+ * A binary cache of the file is written next to it, with ".cache"
+ * appended to @file_name, which gtk_accel_map_load() can use instead
+ * of parsing the file.
  */
 void
 gtk_accel_map_save (const gchar *file_name)
@@ -742,6 +1202,8 @@ gtk_accel_map_save (const gchar *file_name)
   gtk_accel_map_save_fd (fd);
 
   close (fd);
+
+  accel_map_save_cache (file_name);
 }
 
 /**
@@ -765,6 +1227,8 @@ gtk_accel_map_foreach (gpointer           data,
 
   g_return_if_fail (foreach_func != NULL);
 
+  accel_map_register_pending (FALSE);
+
   entries = g_hash_table_slist_values (accel_entry_ht);
   for (slist = entries; slist; slist = slist->next)
     {
@@ -800,6 +1264,8 @@ gtk_accel_map_foreach_unfiltered (gpointer           data,
 
   g_return_if_fail (foreach_func != NULL);
 
+  accel_map_register_pending (FALSE);
+
   entries = g_hash_table_slist_values (accel_entry_ht);
   for (slist = entries; slist; slist = slist->next)
     {
@@ -996,7 +1462,16 @@ gtk_accel_map_get (void)
 static void
 do_accel_map_changed (AccelEntry *entry)
 {
-  if (accel_map)
+  if (accel_map && notify_freeze_count > 0)
+    {
+      /* one notification with the final accelerator per entry */
+      if (!entry->notify_queued)
+	{
+	  entry->notify_queued = TRUE;
+	  notify_queue = g_slist_prepend (notify_queue, entry);
+	}
+    }
+  else if (accel_map)
     g_signal_emit (accel_map,
 		   accel_map_signals[CHANGED],
 		   g_quark_from_string (entry->accel_path),
@@ -57,6 +57,7 @@ typedef struct {
 static GHashTable	*binding_entry_hash_table = NULL;
 static GSList           *binding_key_hashes = NULL;
 static GSList		*binding_set_list = NULL;
+static GHashTable	*class_branch_sets = NULL;
 static const gchar	 key_class_binding_set[] = "gtk-class-binding-set";
 static GQuark		 key_id_class_binding_set = 0;
 
@@ -71,6 +72,16 @@ pattern_spec_free (PatternSpec *pspec)
   g_free (pspec);
 }
 
+/* Forget the binding sets that apply to each class, after the
+ * class branch patterns changed
+ */
+static void
+class_branch_sets_invalidate (void)
+{
+  if (class_branch_sets)
+    g_hash_table_remove_all (class_branch_sets);
+}
+
 static GtkBindingSignal*
 binding_signal_new (const gchar *signal_name,
 		    guint	 n_args)
@@ -278,6 +289,8 @@ binding_entry_destroy (GtkBindingEntry *entry)
       tmp = last->set_next;
     }
   entry->set_next = NULL;
+  if (entry->binding_set->current == entry)
+    entry->binding_set->current = NULL;
   
   o_entry = g_hash_table_lookup (binding_entry_hash_table, entry);
   begin = o_entry;
@@ -1080,6 +1093,9 @@ gtk_binding_set_add_path (GtkBindingSet	     *binding_set,
       pspec->seq_id |= seq_id++ & 0x0fffffff;
       *slist_p = g_slist_prepend (*slist_p, pspec);
     }
+
+  if (path_type == GTK_PATH_CLASS)
+    class_branch_sets_invalidate ();
 }
 
 static gboolean
@@ -1143,38 +1159,51 @@ gtk_binding_pattern_compare (gconstpointer new_pattern,
   return np->seq_id < ep->seq_id;
 }
 
-static GSList*
-gtk_binding_entries_sort_patterns (GSList      *entries,
-				   GtkPathType  path_id,
-				   gboolean     is_release)
+/* Make the first entry of each binding set that matches the key
+ * event the current entry of that set
+ */
+static void
+gtk_binding_entries_set_current (GSList   *entries,
+				 gboolean  is_release)
 {
-  GSList *patterns;
   GSList *tmp_list;
 
-  patterns = NULL;
   for (tmp_list = entries; tmp_list; tmp_list = tmp_list->next)
     {
       GtkBindingEntry *entry = tmp_list->data;
-      GtkBindingSet *binding_set;
 
-      binding_set = entry->binding_set;
-      binding_set->current = NULL;
+      entry->binding_set->current = NULL;
     }
-  
+
+  for (tmp_list = entries; tmp_list; tmp_list = tmp_list->next)
+    {
+      GtkBindingEntry *entry = tmp_list->data;
+
+      if (is_release != ((entry->modifiers & GDK_RELEASE_MASK) != 0))
+	continue;
+
+      if (!entry->binding_set->current)
+	entry->binding_set->current = entry;
+    }
+}
+
+static GSList*
+gtk_binding_entries_sort_patterns (GSList      *entries,
+				   GtkPathType  path_id)
+{
+  GSList *patterns;
+
+  patterns = NULL;
   for (; entries; entries = entries->next)
     {
       GtkBindingEntry *entry = entries->data;
       GtkBindingSet *binding_set;
       GSList *slist = NULL;
 
-      if (is_release != ((entry->modifiers & GDK_RELEASE_MASK) != 0))
-	continue;
-
       binding_set = entry->binding_set;
 
-      if (binding_set->current)
+      if (binding_set->current != entry)
 	continue;
-      binding_set->current = entry;
 
       switch (path_id)
 	{
@@ -1201,6 +1230,80 @@ gtk_binding_entries_sort_patterns (GSList      *entries,
   return patterns;
 }
 
+/* Returns the binding sets whose class branch patterns match @type or
+ * one of its ancestors, in the order they are tried: from @type up to
+ * the fundamental type, and by pattern priority within each class.
+ * The result only depends on the patterns, not on the keys bound in
+ * the sets, so it is computed once per type and kept until a class
+ * branch pattern is added or removed.
+ */
+static GtkBindingSet **
+binding_class_branch_sets (GType type)
+{
+  GtkBindingSet **sets;
+  GPtrArray *array;
+  GType class_type;
+
+  if (!class_branch_sets)
+    class_branch_sets = g_hash_table_new_full (g_direct_hash, NULL, NULL, g_free);
+
+  sets = g_hash_table_lookup (class_branch_sets, GSIZE_TO_POINTER (type));
+  if (sets)
+    return sets;
+
+  array = g_ptr_array_new ();
+
+  for (class_type = type; class_type; class_type = g_type_parent (class_type))
+    {
+      const gchar *type_name = g_type_name (class_type);
+      GSList *patterns = NULL;
+      GSList *slist, *pspecs;
+
+      for (slist = binding_set_list; slist; slist = slist->next)
+	{
+	  GtkBindingSet *binding_set = slist->data;
+
+	  for (pspecs = binding_set->class_branch_pspecs; pspecs; pspecs = pspecs->next)
+	    {
+	      PatternSpec *pspec = pspecs->data;
+
+	      if (g_pattern_match_string (pspec->pspec, type_name))
+		patterns = g_slist_insert_sorted (patterns, pspec, gtk_binding_pattern_compare);
+	    }
+	}
+
+      for (slist = patterns; slist; slist = slist->next)
+	{
+	  PatternSpec *pspec = slist->data;
+	  guint i;
+
+	  /* A set that was tried already fails the same way again
+	   */
+	  for (i = 0; i < array->len; i++)
+	    if (g_ptr_array_index (array, i) == pspec->user_data)
+	      break;
+
+	  if (i == array->len)
+	    g_ptr_array_add (array, pspec->user_data);
+	}
+
+      g_slist_free (patterns);
+    }
+
+  g_ptr_array_add (array, NULL);
+  sets = (GtkBindingSet **) g_ptr_array_free (array, FALSE);
+  g_hash_table_insert (class_branch_sets, GSIZE_TO_POINTER (type), sets);
+
+  return sets;
+}
+
+/* Note that activating a binding runs arbitrary code, which may
+ * change the bindings, and with them the cached class branch sets,
+ * or run a main loop. @entries must therefore not be owned by the key
+ * hash, and the class branch sets are walked on a copy. Binding sets
+ * are never freed, and entries that are removed are no longer the
+ * current entry of their set.
+ */
 static gboolean
 gtk_bindings_activate_list (GtkObject *object,
 			    GSList    *entries,
@@ -1212,6 +1315,8 @@ gtk_bindings_activate_list (GtkObject *object,
   if (!entries)
     return FALSE;
 
+  gtk_binding_entries_set_current (entries, is_release);
+
   if (!handled)
     {
       guint path_length;
@@ -1219,15 +1324,20 @@ gtk_bindings_activate_list (GtkObject *object,
       GSList *patterns;
       gboolean unbound;
 
-      gtk_widget_path (widget, &path_length, &path, &path_reversed);
-      patterns = gtk_binding_entries_sort_patterns (entries, GTK_PATH_WIDGET, is_release);
-      handled = binding_match_activate (patterns, object, path_length, path, path_reversed, &unbound);
-      g_slist_free (patterns);
-      g_free (path);
-      g_free (path_reversed);
+      /* Only compute the path if some binding set can match it
+       */
+      patterns = gtk_binding_entries_sort_patterns (entries, GTK_PATH_WIDGET);
+      if (patterns)
+	{
+	  gtk_widget_path (widget, &path_length, &path, &path_reversed);
+	  handled = binding_match_activate (patterns, object, path_length, path, path_reversed, &unbound);
+	  g_slist_free (patterns);
+	  g_free (path);
+	  g_free (path_reversed);
 
-      if (unbound)
-        return FALSE;
+	  if (unbound)
+	    return FALSE;
+	}
     }
 
   if (!handled)
@@ -1237,48 +1347,47 @@ gtk_bindings_activate_list (GtkObject *object,
       GSList *patterns;
       gboolean unbound;
 
-      gtk_widget_class_path (widget, &path_length, &path, &path_reversed);
-      patterns = gtk_binding_entries_sort_patterns (entries, GTK_PATH_WIDGET_CLASS, is_release);
-      handled = binding_match_activate (patterns, object, path_length, path, path_reversed, &unbound);
-      g_slist_free (patterns);
-      g_free (path);
-      g_free (path_reversed);
+      patterns = gtk_binding_entries_sort_patterns (entries, GTK_PATH_WIDGET_CLASS);
+      if (patterns)
+	{
+	  gtk_widget_class_path (widget, &path_length, &path, &path_reversed);
+	  handled = binding_match_activate (patterns, object, path_length, path, path_reversed, &unbound);
+	  g_slist_free (patterns);
+	  g_free (path);
+	  g_free (path_reversed);
 
-      if (unbound)
-        return FALSE;
+	  if (unbound)
+	    return FALSE;
+	}
     }
 
   if (!handled)
     {
-      GSList *patterns;
-      GType class_type;
-      gboolean unbound = FALSE;
+      GtkBindingSet **sets;
+      guint n_sets, i;
+
+      sets = binding_class_branch_sets (G_TYPE_FROM_INSTANCE (object));
+      for (n_sets = 0; sets[n_sets]; n_sets++)
+	;
+      sets = g_memdup (sets, n_sets * sizeof (GtkBindingSet *));
 
-      patterns = gtk_binding_entries_sort_patterns (entries, GTK_PATH_CLASS, is_release);
-      class_type = G_TYPE_FROM_INSTANCE (object);
-      while (class_type && !handled)
+      for (i = 0; i < n_sets && !handled; i++)
 	{
-	  guint path_length;
-	  gchar *path;
-	  gchar *path_reversed;
-
-	  path = g_strdup (g_type_name (class_type));
-	  path_reversed = g_strdup (path);
-	  g_strreverse (path_reversed);
-	  path_length = strlen (path);
-	  handled = binding_match_activate (patterns, object, path_length, path, path_reversed, &unbound);
-	  g_free (path);
-	  g_free (path_reversed);
+	  GtkBindingEntry *entry = sets[i]->current;
+
+	  /* The current entry is left over from an earlier key event
+	   * unless the set has an entry for this one
+	   */
+	  if (!entry || !g_slist_find (entries, entry))
+	    continue;
 
-          if (unbound)
-            break;
+	  if (entry->marks_unbound)
+	    break;
 
-	  class_type = g_type_parent (class_type);
+	  handled = gtk_binding_entry_activate (entry, object);
 	}
-      g_slist_free (patterns);
 
-      if (unbound)
-        return FALSE;
+      g_free (sets);
     }
 
   return handled;
@@ -1355,11 +1464,15 @@ gtk_bindings_activate_event (GtkObject   *object,
   display = gtk_widget_get_display (GTK_WIDGET (object));
   key_hash = binding_key_hash_for_keymap (gdk_keymap_get_for_display (display));
 
-  entries = _gtk_key_hash_lookup (key_hash,
-				  event->hardware_keycode,
-				  event->state,
-				  BINDING_MOD_MASK () & ~GDK_RELEASE_MASK,
-				  event->group);
+  /* The list belongs to the key hash, which drops it when the bindings
+   * change, so it is copied for activating them. Most widgets have no
+   * bindings for a key, and then nothing is allocated.
+   */
+  entries = g_slist_copy (_gtk_key_hash_lookup_cached (key_hash,
+						       event->hardware_keycode,
+						       event->state,
+						       BINDING_MOD_MASK () & ~GDK_RELEASE_MASK,
+						       event->group));
   
   handled = gtk_bindings_activate_list (object, entries,
 					event->type == GDK_KEY_RELEASE);
@@ -1692,6 +1805,8 @@ binding_set_delete (GtkBindingSet *binding_set)
   
   free_pattern_specs (binding_set->widget_path_pspecs);
   free_pattern_specs (binding_set->widget_class_pspecs);
+  if (binding_set->class_branch_pspecs)
+    class_branch_sets_invalidate ();
   free_pattern_specs (binding_set->class_branch_pspecs);
 
   g_free (binding_set);
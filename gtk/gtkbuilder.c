@@ -28,6 +28,8 @@
 #include "gtkbuilder.h"
 #include "gtkbuildable.h"
 #include "gtkbuilderprivate.h"
+#include "gtkalignment.h"
+#include "gtkdebug.h"
 #include "gtkmain.h"
 #include "gtkintl.h"
 #include "gtkprivate.h"
@@ -63,8 +65,30 @@ struct _GtkBuilderPrivate
   GSList *delayed_properties;
   GSList *signals;
   gchar *filename;
+
+  GHashTable *lazy_objects;  /* id -> LazyObject of the lazy object it is in */
+  GHashTable *lazy_roots;    /* id -> LazyObject, owns them */
+
+  /* Connects the signals of lazy objects once they are built */
+  GtkBuilderConnectFunc connect_func;
+  gpointer connect_data;
+  GDestroyNotify connect_data_destroy;
 };
 
+typedef struct {
+  GtkBuilder *builder;
+  gchar *id;
+  LazyBuffer *buffer;
+  GtkWidget *placeholder;
+  gulong map_handler;
+} LazyObject;
+
+static void gtk_builder_construct_lazy (GtkBuilder *builder,
+                                        LazyObject *lazy);
+static void gtk_builder_connect_signals_real (GtkBuilder            *builder,
+                                              GtkBuilderConnectFunc  func,
+                                              gpointer               user_data);
+
 G_DEFINE_TYPE (GtkBuilder, gtk_builder, G_TYPE_OBJECT)
 
 static void
@@ -109,9 +133,27 @@ gtk_builder_init (GtkBuilder *builder)
   builder->priv->domain = NULL;
   builder->priv->objects = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                   g_free, g_object_unref);
+  builder->priv->lazy_objects = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                       g_free, NULL);
+  builder->priv->lazy_roots = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 
+static void
+free_lazy_object (const gchar *id,
+                  LazyObject  *lazy)
+{
+  if (lazy->placeholder)
+    {
+      g_signal_handler_disconnect (lazy->placeholder, lazy->map_handler);
+      g_object_remove_weak_pointer (G_OBJECT (lazy->placeholder),
+                                    (gpointer *) &lazy->placeholder);
+    }
+  _gtk_builder_lazy_buffer_unref (lazy->buffer);
+  g_free (lazy->id);
+  g_slice_free (LazyObject, lazy);
+}
+
 /*
  * GObject virtual methods
  */
@@ -126,6 +168,14 @@ gtk_builder_finalize (GObject *object)
   
   g_hash_table_destroy (priv->objects);
 
+  /* Placeholders keep the builder alive, so they are gone already */
+  g_hash_table_foreach (priv->lazy_roots, (GHFunc) free_lazy_object, NULL);
+  g_hash_table_destroy (priv->lazy_roots);
+  g_hash_table_destroy (priv->lazy_objects);
+
+  if (priv->connect_data_destroy)
+    priv->connect_data_destroy (priv->connect_data);
+
   g_slist_foreach (priv->signals, (GFunc) _free_signal_info, NULL);
   g_slist_free (priv->signals);
   
@@ -241,6 +291,59 @@ typedef struct
   gchar *value;
 } DelayedProperty;
 
+/* Uses the value that gtk-builder-compile converted from the string,
+ * if the property still has the type it had then.
+ */
+static gboolean
+gtk_builder_value_from_precompiled (GParamSpec   *pspec,
+                                    PropertyInfo *prop,
+                                    GValue       *value)
+{
+  GType type = G_PARAM_SPEC_VALUE_TYPE (pspec);
+
+  if (prop->precompiled_type == G_TYPE_INVALID ||
+      prop->precompiled_type != G_TYPE_FUNDAMENTAL (type) ||
+      G_IS_PARAM_SPEC_UNICHAR (pspec))
+    return FALSE;
+
+  g_value_init (value, type);
+
+  switch (prop->precompiled_type)
+    {
+    case G_TYPE_BOOLEAN:
+      g_value_set_boolean (value, prop->precompiled_value.v_int != 0);
+      break;
+    case G_TYPE_INT:
+      g_value_set_int (value, prop->precompiled_value.v_int);
+      break;
+    case G_TYPE_UINT:
+      g_value_set_uint (value, prop->precompiled_value.v_uint);
+      break;
+    case G_TYPE_LONG:
+      g_value_set_long (value, prop->precompiled_value.v_int);
+      break;
+    case G_TYPE_ULONG:
+      g_value_set_ulong (value, prop->precompiled_value.v_uint);
+      break;
+    case G_TYPE_ENUM:
+      g_value_set_enum (value, prop->precompiled_value.v_int);
+      break;
+    case G_TYPE_FLAGS:
+      g_value_set_flags (value, prop->precompiled_value.v_uint);
+      break;
+    case G_TYPE_FLOAT:
+      g_value_set_float (value, prop->precompiled_value.v_double);
+      break;
+    case G_TYPE_DOUBLE:
+      g_value_set_double (value, prop->precompiled_value.v_double);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  return TRUE;
+}
+
 static void
 gtk_builder_get_parameters (GtkBuilder  *builder,
                             GType        object_type,
@@ -306,7 +409,8 @@ gtk_builder_get_parameters (GtkBuilder  *builder,
               continue;
             }
         }
-      else if (!gtk_builder_value_from_string (builder, pspec,
+      else if (!gtk_builder_value_from_precompiled (pspec, prop, &parameter.value) &&
+               !gtk_builder_value_from_string (builder, pspec,
 					       prop->data, &parameter.value, &error))
         {
           g_warning ("Failed to set property %s.%s to %s: %s",
@@ -598,7 +702,7 @@ gtk_builder_apply_delayed_properties (GtkBuilder *builder)
         {
           GObject *obj;
 
-          obj = g_hash_table_lookup (builder->priv->objects, property->value);
+          obj = gtk_builder_get_object (builder, property->value);
           if (!obj)
             g_warning ("No object called: %s", property->value);
           else
@@ -619,6 +723,183 @@ _gtk_builder_finish (GtkBuilder *builder)
   gtk_builder_apply_delayed_properties (builder);
 }
 
+LazyBuffer *
+_gtk_builder_lazy_buffer_new (GtkBuilder  *builder,
+                              const gchar *filename,
+                              const gchar *buffer,
+                              gsize        length)
+{
+  LazyBuffer *lazy_buffer;
+
+  if (length == (gsize) -1)
+    length = strlen (buffer);
+
+  lazy_buffer = g_slice_new (LazyBuffer);
+  lazy_buffer->ref_count = 1;
+  lazy_buffer->filename = g_strdup (filename);
+  lazy_buffer->path = g_strdup (builder->priv->filename);
+  lazy_buffer->buffer = g_memdup (buffer, length);
+  lazy_buffer->length = length;
+
+  return lazy_buffer;
+}
+
+void
+_gtk_builder_lazy_buffer_unref (LazyBuffer *buffer)
+{
+  if (--buffer->ref_count > 0)
+    return;
+
+  g_free (buffer->filename);
+  g_free (buffer->path);
+  g_free (buffer->buffer);
+  g_slice_free (LazyBuffer, buffer);
+}
+
+void
+_gtk_builder_add_lazy (GtkBuilder  *builder,
+                       LazyBuffer  *buffer,
+                       const gchar *lazy_id,
+                       const gchar *object_id)
+{
+  GtkBuilderPrivate *priv = builder->priv;
+  LazyObject *lazy;
+
+  lazy = g_hash_table_lookup (priv->lazy_roots, lazy_id);
+  if (!lazy)
+    {
+      lazy = g_slice_new0 (LazyObject);
+      lazy->builder = builder;
+      lazy->id = g_strdup (lazy_id);
+      lazy->buffer = buffer;
+      buffer->ref_count++;
+      g_hash_table_insert (priv->lazy_roots, lazy->id, lazy);
+    }
+
+  g_hash_table_insert (priv->lazy_objects, g_strdup (object_id), lazy);
+}
+
+static void
+lazy_placeholder_map (GtkWidget  *placeholder,
+                      LazyObject *lazy)
+{
+  GtkBuilder *builder = lazy->builder;
+
+  /* The placeholder may hold the last reference on the builder */
+  g_object_ref (builder);
+  gtk_builder_construct_lazy (builder, lazy);
+  g_object_unref (builder);
+}
+
+GObject *
+_gtk_builder_add_lazy_placeholder (GtkBuilder  *builder,
+                                   const gchar *lazy_id)
+{
+  LazyObject *lazy;
+  GtkWidget *placeholder;
+
+  lazy = g_hash_table_lookup (builder->priv->lazy_roots, lazy_id);
+  g_assert (lazy != NULL);
+
+  placeholder = gtk_alignment_new (0.5, 0.5, 1.0, 1.0);
+  gtk_widget_show (placeholder);
+
+  lazy->placeholder = placeholder;
+  g_object_add_weak_pointer (G_OBJECT (placeholder),
+                             (gpointer *) &lazy->placeholder);
+  lazy->map_handler = g_signal_connect_after (placeholder, "map",
+                                              G_CALLBACK (lazy_placeholder_map),
+                                              lazy);
+
+  /* The builder is needed to fill the placeholder */
+  g_object_set_data_full (G_OBJECT (placeholder), I_("gtk-builder-lazy"),
+                          g_object_ref (builder), g_object_unref);
+
+  return G_OBJECT (placeholder);
+}
+
+static gboolean
+is_in_lazy_object (const gchar *id,
+                   LazyObject  *lazy,
+                   LazyObject  *root)
+{
+  return lazy == root;
+}
+
+static void
+gtk_builder_construct_lazy (GtkBuilder *builder,
+                            LazyObject *lazy)
+{
+  GtkBuilderPrivate *priv = builder->priv;
+  GtkWidget *placeholder;
+  gchar *requested[2];
+  gchar *filename;
+  GSList *delayed_properties, *signals;
+  GObject *object;
+  GError *error = NULL;
+
+  GTK_NOTE (BUILDER, g_print ("building lazy object %s\n", lazy->id));
+
+  /* Everything inside of the lazy object is built now; lazy objects
+   * inside of it are found again by the parser
+   */
+  g_hash_table_foreach_remove (priv->lazy_objects,
+                               (GHRFunc) is_in_lazy_object, lazy);
+  g_hash_table_steal (priv->lazy_roots, lazy->id);
+
+  placeholder = lazy->placeholder;
+  if (placeholder)
+    {
+      g_signal_handler_disconnect (placeholder, lazy->map_handler);
+      g_object_remove_weak_pointer (G_OBJECT (placeholder),
+                                    (gpointer *) &lazy->placeholder);
+      lazy->placeholder = NULL;
+    }
+
+  /* This can happen in the middle of another parse, when an object
+   * property refers to the lazy object. The properties and signals
+   * that parse has collected so far must be left for it to finish.
+   */
+  filename = priv->filename;
+  priv->filename = g_strdup (lazy->buffer->path);
+  delayed_properties = priv->delayed_properties;
+  priv->delayed_properties = NULL;
+  signals = priv->signals;
+  priv->signals = NULL;
+
+  requested[0] = lazy->id;
+  requested[1] = NULL;
+  _gtk_builder_parser_parse_buffer (builder, lazy->buffer->filename,
+                                    lazy->buffer->buffer, lazy->buffer->length,
+                                    requested, &error);
+
+  g_free (priv->filename);
+  priv->filename = filename;
+
+  if (error)
+    {
+      g_warning ("Failed to build lazy object %s: %s", lazy->id, error->message);
+      g_error_free (error);
+    }
+
+  object = g_hash_table_lookup (priv->objects, lazy->id);
+  if (placeholder)
+    {
+      if (object)
+        gtk_container_add (GTK_CONTAINER (placeholder), GTK_WIDGET (object));
+      g_object_set_data (G_OBJECT (placeholder), I_("gtk-builder-lazy"), NULL);
+    }
+
+  if (priv->connect_func)
+    gtk_builder_connect_signals_real (builder, priv->connect_func, priv->connect_data);
+
+  priv->delayed_properties = g_slist_concat (priv->delayed_properties,
+                                             delayed_properties);
+  priv->signals = g_slist_concat (signals, priv->signals);
+
+  free_lazy_object (NULL, lazy);
+}
+
 /**
  * gtk_builder_new:
  *
@@ -871,6 +1152,9 @@ gtk_builder_add_objects_from_string (GtkBuilder   *builder,
  * Gets the object named @name. Note that this function does not
  * increment the reference count of the returned object. 
  *
+ * If @name is a lazy object, or inside of one, the lazy object
+ * is built first.
+ *
  * Return value: (transfer none): the object named @name or %NULL if
  *    it could not be found in the object tree.
  *
@@ -880,10 +1164,24 @@ GObject *
 gtk_builder_get_object (GtkBuilder  *builder,
                         const gchar *name)
 {
+  GObject *object;
+  LazyObject *lazy;
+
   g_return_val_if_fail (GTK_IS_BUILDER (builder), NULL);
   g_return_val_if_fail (name != NULL, NULL);
 
-  return g_hash_table_lookup (builder->priv->objects, name);
+  object = g_hash_table_lookup (builder->priv->objects, name);
+  if (!object)
+    {
+      lazy = g_hash_table_lookup (builder->priv->lazy_objects, name);
+      if (lazy)
+        {
+          gtk_builder_construct_lazy (builder, lazy);
+          object = g_hash_table_lookup (builder->priv->objects, name);
+        }
+    }
+
+  return object;
 }
 
 static void
@@ -900,7 +1198,7 @@ object_add_to_list (gchar    *object_id,
  *
  * Gets all objects that have been constructed by @builder. Note that 
  * this function does not increment the reference counts of the returned
- * objects.
+ * objects. Lazy objects that have not been built yet are not included.
  *
  * Return value: (element-type GObject) (transfer container): a newly-allocated #GSList containing all the objects
  *   constructed by the #GtkBuilder instance. It should be freed by
@@ -969,6 +1267,29 @@ typedef struct {
   gpointer data;
 } connect_args;
 
+static void
+free_connect_args (connect_args *args)
+{
+  g_module_close (args->module);
+  g_slice_free (connect_args, args);
+}
+
+static void
+gtk_builder_set_connect_func (GtkBuilder            *builder,
+                              GtkBuilderConnectFunc  func,
+                              gpointer               user_data,
+                              GDestroyNotify         destroy)
+{
+  GtkBuilderPrivate *priv = builder->priv;
+
+  if (priv->connect_data_destroy)
+    priv->connect_data_destroy (priv->connect_data);
+
+  priv->connect_func = func;
+  priv->connect_data = user_data;
+  priv->connect_data_destroy = destroy;
+}
+
 static void
 gtk_builder_connect_signals_default (GtkBuilder    *builder,
 				     GObject       *object,
@@ -1031,12 +1352,17 @@ gtk_builder_connect_signals (GtkBuilder *builder,
   args->module = g_module_open (NULL, G_MODULE_BIND_LAZY);
   args->data = user_data;
   
-  gtk_builder_connect_signals_full (builder,
+  gtk_builder_connect_signals_real (builder,
                                     gtk_builder_connect_signals_default,
                                     args);
-  g_module_close (args->module);
 
-  g_slice_free (connect_args, args);
+  /* Lazy objects which are built later need the module */
+  if (g_hash_table_size (builder->priv->lazy_roots) > 0)
+    gtk_builder_set_connect_func (builder,
+                                  gtk_builder_connect_signals_default,
+                                  args, (GDestroyNotify) free_connect_args);
+  else
+    free_connect_args (args);
 }
 
 /**
@@ -1068,6 +1394,10 @@ gtk_builder_connect_signals (GtkBuilder *builder,
  * version of gtk_builder_connect_signals(), except that it does not
  * require GModule to function correctly.
  *
+ * If @builder has lazy objects that have not been built yet, @func
+ * and @user_data are used again to connect their signals when they
+ * are built.
+ *
  * Since: 2.12
  */
 void
@@ -1075,18 +1405,34 @@ gtk_builder_connect_signals_full (GtkBuilder            *builder,
                                   GtkBuilderConnectFunc  func,
                                   gpointer               user_data)
 {
-  GSList *l;
-  GObject *object;
-  GObject *connect_object;
-  
   g_return_if_fail (GTK_IS_BUILDER (builder));
   g_return_if_fail (func != NULL);
+
+  gtk_builder_connect_signals_real (builder, func, user_data);
+
+  if (g_hash_table_size (builder->priv->lazy_roots) > 0)
+    gtk_builder_set_connect_func (builder, func, user_data, NULL);
+}
+
+static void
+gtk_builder_connect_signals_real (GtkBuilder            *builder,
+                                  GtkBuilderConnectFunc  func,
+                                  gpointer               user_data)
+{
+  GSList *l, *signals;
+  GObject *object;
+  GObject *connect_object;
   
   if (!builder->priv->signals)
     return;
 
-  builder->priv->signals = g_slist_reverse (builder->priv->signals);
-  for (l = builder->priv->signals; l; l = l->next)
+  /* Looking up the connect objects can build lazy objects, which
+   * connect their own signals
+   */
+  signals = g_slist_reverse (builder->priv->signals);
+  builder->priv->signals = NULL;
+
+  for (l = signals; l; l = l->next)
     {
       SignalInfo *signal = (SignalInfo*)l->data;
 
@@ -1101,8 +1447,8 @@ gtk_builder_connect_signals_full (GtkBuilder            *builder,
       
       if (signal->connect_object_name)
 	{
-	  connect_object = g_hash_table_lookup (builder->priv->objects,
-						signal->connect_object_name);
+	  connect_object = gtk_builder_get_object (builder,
+						   signal->connect_object_name);
 	  if (!connect_object)
 	      g_warning ("Could not lookup object %s on signal %s of object %s",
 			 signal->connect_object_name, signal->name,
@@ -1113,9 +1459,8 @@ gtk_builder_connect_signals_full (GtkBuilder            *builder,
 	    connect_object, signal->flags, user_data);
     }
 
-  g_slist_foreach (builder->priv->signals, (GFunc)_free_signal_info, NULL);
-  g_slist_free (builder->priv->signals);
-  builder->priv->signals = NULL;
+  g_slist_foreach (signals, (GFunc)_free_signal_info, NULL);
+  g_slist_free (signals);
 }
 
 /**
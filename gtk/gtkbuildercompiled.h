@@ -0,0 +1,118 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_BUILDER_COMPILED_H__
+#define __GTK_BUILDER_COMPILED_H__
+
+/* Layout of the compiled interface descriptions written by
+ * gtk-builder-compile and read by _gtk_builder_parser_parse_buffer().
+ *
+ * A compiled interface is the sequence of elements of the XML
+ * description, with the markup already parsed, all strings stored
+ * once in a string table, and the values of properties of known
+ * classes already converted from their string form. Elements that
+ * GtkBuilder does not handle itself (the custom tags of buildable
+ * objects) are kept as XML fragments, which are given to the
+ * buildable's parser as usual.
+ *
+ * All numbers are stored big-endian, all offsets are from the start
+ * of the file and all strings are nul-terminated.
+ *
+ * Header:
+ * 8			MAGIC		"GTKBUILD"
+ * 2			CARD16		MAJOR_VERSION	1
+ * 2			CARD16		MINOR_VERSION	0
+ * 4			CARD32		STRING_LIST_OFFSET
+ * 4			CARD32		RECORDS_OFFSET
+ * 4			CARD32		RECORDS_LENGTH	in bytes
+ *
+ * StringList:
+ * 4			CARD32		N_STRINGS
+ * 4 * N_STRINGS	CARD32		STRING_OFFSETS
+ *
+ * Records are sequences of CARD32s, starting with the record type.
+ * Strings are referred to by their index in the string list.
+ *
+ * StartElement:
+ * 4			CARD32		RECORD_START_ELEMENT
+ * 4			CARD32		LINE
+ * 4			CARD32		NAME
+ * 4			CARD32		N_ATTRIBUTES
+ * 8 * N_ATTRIBUTES	CARD32 pairs	ATTRIBUTE_NAME, ATTRIBUTE_VALUE
+ *
+ * EndElement:
+ * 4			CARD32		RECORD_END_ELEMENT
+ * 4			CARD32		NAME
+ *
+ * Property:		a complete <property> element
+ * 4			CARD32		RECORD_PROPERTY
+ * 4			CARD32		LINE
+ * 4			CARD32		N_ATTRIBUTES
+ * 8 * N_ATTRIBUTES	CARD32 pairs	ATTRIBUTE_NAME, ATTRIBUTE_VALUE
+ * 4			CARD32		TEXT
+ * 4			CARD32		VALUE_TYPE	GTK_BUILDER_VALUE_NONE if
+ *							not precompiled
+ * 8			CARD32 pair	VALUE		high and low word; the
+ *							IEEE 754 double for floats
+ *
+ * Custom:		a complete element not handled by GtkBuilder
+ * 4			CARD32		RECORD_CUSTOM
+ * 4			CARD32		LINE
+ * 4			CARD32		XML
+ *
+ * TypeHint:		comes before the first object of a class
+ * 4			CARD32		RECORD_TYPE_HINT
+ * 4			CARD32		CLASS_NAME
+ * 4			CARD32		TYPE_FUNCTION	the _get_type function
+ *							of the class
+ */
+
+#define GTK_BUILDER_COMPILED_MAGIC         "GTKBUILD"
+#define GTK_BUILDER_COMPILED_MAGIC_LEN     8
+#define GTK_BUILDER_COMPILED_MAJOR_VERSION 1
+#define GTK_BUILDER_COMPILED_MINOR_VERSION 0
+
+#define GTK_BUILDER_COMPILED_HEADER_SIZE   24
+
+/* Elements have few attributes; anything with more is an error */
+#define GTK_BUILDER_COMPILED_MAX_ATTRIBUTES 16
+
+enum {
+  GTK_BUILDER_RECORD_START_ELEMENT = 1,
+  GTK_BUILDER_RECORD_END_ELEMENT,
+  GTK_BUILDER_RECORD_PROPERTY,
+  GTK_BUILDER_RECORD_CUSTOM,
+  GTK_BUILDER_RECORD_TYPE_HINT
+};
+
+/* The fundamental type of precompiled property values */
+enum {
+  GTK_BUILDER_VALUE_NONE,
+  GTK_BUILDER_VALUE_BOOLEAN,
+  GTK_BUILDER_VALUE_INT,
+  GTK_BUILDER_VALUE_UINT,
+  GTK_BUILDER_VALUE_LONG,
+  GTK_BUILDER_VALUE_ULONG,
+  GTK_BUILDER_VALUE_ENUM,
+  GTK_BUILDER_VALUE_FLAGS,
+  GTK_BUILDER_VALUE_FLOAT,
+  GTK_BUILDER_VALUE_DOUBLE
+};
+
+#endif /* __GTK_BUILDER_COMPILED_H__ */
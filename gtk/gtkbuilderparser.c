@@ -27,9 +27,11 @@
 #include "gtkbuilderprivate.h"
 #include "gtkbuilder.h"
 #include "gtkbuildable.h"
+#include "gtkbuildercompiled.h"
 #include "gtkdebug.h"
 #include "gtkversion.h"
 #include "gtktypeutils.h"
+#include "gtkwidget.h"
 #include "gtkintl.h"
 #include "gtkalias.h"
 
@@ -66,6 +68,25 @@ state_pop (ParserData *data)
 #define state_peek_info(data, st) ((st*)state_peek(data))
 #define state_pop_info(data, st) ((st*)state_pop(data))
 
+static void
+get_position (ParserData *data,
+              gint       *line_number,
+              gint       *char_number)
+{
+  /* Compiled interfaces only have a markup context while a custom tag
+   * is parsed
+   */
+  if (data->ctx)
+    g_markup_parse_context_get_position (data->ctx, line_number, char_number);
+  else
+    {
+      if (line_number)
+        *line_number = data->line;
+      if (char_number)
+        *char_number = 0;
+    }
+}
+
 static void
 error_missing_attribute (ParserData *data,
                          const gchar *tag,
@@ -74,9 +95,7 @@ error_missing_attribute (ParserData *data,
 {
   gint line_number, char_number;
 
-  g_markup_parse_context_get_position (data->ctx,
-                                       &line_number,
-                                       &char_number);
+  get_position (data, &line_number, &char_number);
 
   g_set_error (error,
                GTK_BUILDER_ERROR,
@@ -94,9 +113,7 @@ error_invalid_attribute (ParserData *data,
 {
   gint line_number, char_number;
 
-  g_markup_parse_context_get_position (data->ctx,
-                                       &line_number,
-                                       &char_number);
+  get_position (data, &line_number, &char_number);
 
   g_set_error (error,
                GTK_BUILDER_ERROR,
@@ -114,9 +131,7 @@ error_invalid_tag (ParserData *data,
 {
   gint line_number, char_number;
 
-  g_markup_parse_context_get_position (data->ctx,
-                                       &line_number,
-                                       &char_number);
+  get_position (data, &line_number, &char_number);
 
   if (expected)
     g_set_error (error,
@@ -239,9 +254,7 @@ parse_requires (ParserData   *data,
   gint          i, version_major = 0, version_minor = 0;
   gint          line_number, char_number;
 
-  g_markup_parse_context_get_position (data->ctx,
-                                       &line_number,
-                                       &char_number);
+  get_position (data, &line_number, &char_number);
 
   for (i = 0; names[i] != NULL; i++)
     {
@@ -311,6 +324,7 @@ parse_object (GMarkupParseContext  *context,
   gchar *object_class = NULL;
   gchar *object_id = NULL;
   gchar *constructor = NULL;
+  gboolean lazy = FALSE;
   gint line, line2;
 
   child_info = state_peek_info (data, ChildInfo);
@@ -328,6 +342,11 @@ parse_object (GMarkupParseContext  *context,
         object_id = g_strdup (values[i]);
       else if (strcmp (names[i], "constructor") == 0)
         constructor = g_strdup (values[i]);
+      else if (strcmp (names[i], "lazy") == 0)
+        {
+          if (!_gtk_builder_boolean_from_string (values[i], &lazy, error))
+            return;
+        }
       else if (strcmp (names[i], "type-func") == 0)
         {
 	  /* Call the GType function, and return the name of the GType,
@@ -337,7 +356,7 @@ parse_object (GMarkupParseContext  *context,
           object_class = _get_type_by_symbol (values[i]);
           if (!object_class)
             {
-              g_markup_parse_context_get_position (context, &line, NULL);
+              get_position (data, &line, NULL);
               g_set_error (error, GTK_BUILDER_ERROR,
                            GTK_BUILDER_ERROR_INVALID_TYPE_FUNCTION,
                            _("Invalid type function on line %d: '%s'"),
@@ -388,17 +407,37 @@ parse_object (GMarkupParseContext  *context,
         }
     }
 
-  object_info = g_slice_new0 (ObjectInfo);
-  object_info->class_name = object_class;
-  object_info->id = object_id;
-  object_info->constructor = constructor;
-  state_push (data, object_info);
-  object_info->tag.name = element_name;
+  /* A requested object is built even if it is lazy, that is how
+   * lazy objects are built in the end
+   */
+  if (lazy && data->requested_objects &&
+      data->cur_object_level == data->requested_object_level)
+    lazy = FALSE;
 
-  if (child_info)
-    object_info->parent = (CommonInfo*)child_info;
+  if (lazy && !data->lazy_object_level)
+    {
+      if (child_info &&
+          (child_info->internal_child ||
+           !g_type_is_a (gtk_builder_get_type_from_name (data->builder, object_class),
+                         GTK_TYPE_WIDGET)))
+        {
+          error_invalid_attribute (data, element_name, "lazy", error);
+          return;
+        }
+
+      if (!data->lazy_buffer)
+        data->lazy_buffer = _gtk_builder_lazy_buffer_new (data->builder,
+                                                          data->filename,
+                                                          data->buffer,
+                                                          data->length);
+      data->lazy_object_level = data->cur_object_level;
+      data->lazy_id = g_strdup (object_id);
+
+      GTK_NOTE (BUILDER, g_print ("lazy object \"%s\" found at level %d\n",
+                                  object_id, data->lazy_object_level));
+    }
 
-  g_markup_parse_context_get_position (context, &line, NULL);
+  get_position (data, &line, NULL);
   line2 = GPOINTER_TO_INT (g_hash_table_lookup (data->object_ids, object_id));
   if (line2 != 0)
     {
@@ -406,11 +445,36 @@ parse_object (GMarkupParseContext  *context,
                    GTK_BUILDER_ERROR_DUPLICATE_ID,
                    _("Duplicate object ID '%s' on line %d (previously on line %d)"),
                    object_id, line, line2);
+      g_free (object_class);
+      g_free (object_id);
+      g_free (constructor);
       return;
     }
 
-
   g_hash_table_insert (data->object_ids, g_strdup (object_id), GINT_TO_POINTER (line));
+
+  /* Objects inside of a lazy object are only remembered, so that
+   * looking any of them up builds the lazy object
+   */
+  if (data->lazy_object_level)
+    {
+      _gtk_builder_add_lazy (data->builder, data->lazy_buffer,
+                             data->lazy_id, object_id);
+      g_free (object_class);
+      g_free (object_id);
+      g_free (constructor);
+      return;
+    }
+
+  object_info = g_slice_new0 (ObjectInfo);
+  object_info->class_name = object_class;
+  object_info->id = object_id;
+  object_info->constructor = constructor;
+  state_push (data, object_info);
+  object_info->tag.name = element_name;
+
+  if (child_info)
+    object_info->parent = (CommonInfo*)child_info;
 }
 
 static void
@@ -876,6 +940,11 @@ start_element (GMarkupParseContext *context,
       /* If outside a requested object, simply ignore this tag */
       return;
     }
+  else if (data->lazy_object_level)
+    {
+      /* Lazy objects are parsed again when they are built */
+      return;
+    }
   else if (strcmp (element_name, "child") == 0)
     parse_child (data, element_name, names, values, error);
   else if (strcmp (element_name, "property") == 0)
@@ -960,6 +1029,29 @@ end_element (GMarkupParseContext *context,
       /* If outside a requested object, simply ignore this tag */
       return;
     }
+  else if (data->lazy_object_level)
+    {
+      if (strcmp (element_name, "object") != 0)
+        return;
+
+      if (data->cur_object_level == data->lazy_object_level)
+        {
+          ChildInfo *child_info = state_peek_info (data, ChildInfo);
+
+          /* A lazy child widget is added to its parent in a
+           * placeholder, which builds it when it is mapped
+           */
+          if (child_info)
+            child_info->object = _gtk_builder_add_lazy_placeholder (data->builder,
+                                                                    data->lazy_id);
+
+          data->lazy_object_level = 0;
+          g_free (data->lazy_id);
+          data->lazy_id = NULL;
+        }
+
+      --data->cur_object_level;
+    }
   else if (strcmp (element_name, "object") == 0)
     {
       ObjectInfo *object_info = state_pop_info (data, ObjectInfo);
@@ -1078,7 +1170,7 @@ text (GMarkupParseContext *context,
   info = state_peek_info (data, CommonInfo);
   g_assert (info != NULL);
 
-  if (strcmp (g_markup_parse_context_get_element (context), "property") == 0)
+  if (strcmp (info->tag.name, "property") == 0)
     {
       PropertyInfo *prop_info = (PropertyInfo*)info;
 
@@ -1111,6 +1203,360 @@ static const GMarkupParser parser = {
   NULL
 };
 
+/*
+ * Compiled interfaces, see gtkbuildercompiled.h
+ */
+
+typedef struct {
+  const gchar *buffer;
+  gsize length;
+  guint32 n_strings;
+  gsize strings;   /* Offset of the string offsets */
+  gsize pos;       /* Offset of the next word to read */
+  gsize end;       /* End of the records */
+} CompiledData;
+
+static inline guint32
+get_uint32 (const gchar *p)
+{
+  const guchar *u = (const guchar *) p;
+
+  /* The buffer is not necessarily aligned */
+  return ((guint32) u[0] << 24) | ((guint32) u[1] << 16) | ((guint32) u[2] << 8) | u[3];
+}
+
+static gboolean
+compiled_read (CompiledData *compiled,
+               guint32      *value)
+{
+  if (compiled->end - compiled->pos < 4)
+    return FALSE;
+
+  *value = get_uint32 (compiled->buffer + compiled->pos);
+  compiled->pos += 4;
+
+  return TRUE;
+}
+
+static gboolean
+compiled_read_string (CompiledData  *compiled,
+                      const gchar  **string)
+{
+  guint32 index;
+
+  if (!compiled_read (compiled, &index) || index >= compiled->n_strings)
+    return FALSE;
+
+  /* Validated in compiled_init() */
+  *string = compiled->buffer + get_uint32 (compiled->buffer + compiled->strings + 4 * index);
+
+  return TRUE;
+}
+
+static gboolean
+compiled_read_attributes (CompiledData  *compiled,
+                          const gchar  **names,
+                          const gchar  **values)
+{
+  guint32 n_attributes, i;
+
+  if (!compiled_read (compiled, &n_attributes) ||
+      n_attributes > GTK_BUILDER_COMPILED_MAX_ATTRIBUTES)
+    return FALSE;
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      if (!compiled_read_string (compiled, &names[i]) ||
+          !compiled_read_string (compiled, &values[i]))
+        return FALSE;
+    }
+  names[i] = NULL;
+  values[i] = NULL;
+
+  return TRUE;
+}
+
+static gboolean
+is_compiled (const gchar *buffer,
+             gsize        length)
+{
+  /* Compiled data contains nul bytes, so it always comes with a length */
+  return length != (gsize) -1 &&
+         length >= GTK_BUILDER_COMPILED_MAGIC_LEN &&
+         memcmp (buffer, GTK_BUILDER_COMPILED_MAGIC, GTK_BUILDER_COMPILED_MAGIC_LEN) == 0;
+}
+
+static gboolean
+compiled_init (CompiledData *compiled,
+               const gchar  *buffer,
+               gsize         length)
+{
+  gsize records, records_length;
+  guint32 i;
+
+  compiled->buffer = buffer;
+  compiled->length = length;
+
+  if (length < GTK_BUILDER_COMPILED_HEADER_SIZE ||
+      get_uint32 (buffer + 8) >> 16 != GTK_BUILDER_COMPILED_MAJOR_VERSION)
+    return FALSE;
+
+  compiled->strings = get_uint32 (buffer + 12);
+  records = get_uint32 (buffer + 16);
+  records_length = get_uint32 (buffer + 20);
+
+  if (compiled->strings > length - 4 ||
+      records > length || records_length > length - records ||
+      records_length % 4 != 0)
+    return FALSE;
+
+  compiled->n_strings = get_uint32 (buffer + compiled->strings);
+  compiled->strings += 4;
+  if (compiled->n_strings > (length - compiled->strings) / 4)
+    return FALSE;
+
+  for (i = 0; i < compiled->n_strings; i++)
+    {
+      gsize offset = get_uint32 (buffer + compiled->strings + 4 * i);
+
+      if (offset >= length || !memchr (buffer + offset, '\0', length - offset))
+        return FALSE;
+    }
+
+  compiled->pos = records;
+  compiled->end = records + records_length;
+
+  return TRUE;
+}
+
+static GType
+precompiled_fundamental_type (guint32 value_type)
+{
+  switch (value_type)
+    {
+    case GTK_BUILDER_VALUE_BOOLEAN: return G_TYPE_BOOLEAN;
+    case GTK_BUILDER_VALUE_INT:     return G_TYPE_INT;
+    case GTK_BUILDER_VALUE_UINT:    return G_TYPE_UINT;
+    case GTK_BUILDER_VALUE_LONG:    return G_TYPE_LONG;
+    case GTK_BUILDER_VALUE_ULONG:   return G_TYPE_ULONG;
+    case GTK_BUILDER_VALUE_ENUM:    return G_TYPE_ENUM;
+    case GTK_BUILDER_VALUE_FLAGS:   return G_TYPE_FLAGS;
+    case GTK_BUILDER_VALUE_FLOAT:   return G_TYPE_FLOAT;
+    case GTK_BUILDER_VALUE_DOUBLE:  return G_TYPE_DOUBLE;
+    default:                        return G_TYPE_INVALID;
+    }
+}
+
+static gboolean
+parse_compiled_property (ParserData    *data,
+                         CompiledData  *compiled,
+                         GError       **error)
+{
+  const gchar *names[GTK_BUILDER_COMPILED_MAX_ATTRIBUTES + 1];
+  const gchar *values[GTK_BUILDER_COMPILED_MAX_ATTRIBUTES + 1];
+  const gchar *text;
+  guint32 line, value_type, high, low;
+  GSList *stack;
+
+  if (!compiled_read (compiled, &line) ||
+      !compiled_read_attributes (compiled, names, values) ||
+      !compiled_read_string (compiled, &text) ||
+      !compiled_read (compiled, &value_type) ||
+      !compiled_read (compiled, &high) ||
+      !compiled_read (compiled, &low))
+    return FALSE;
+
+  data->line = line;
+
+  stack = data->stack;
+  start_element (NULL, "property", names, values, data, error);
+  if (*error)
+    return TRUE;
+
+  /* Nothing is pushed for properties of objects that were not requested */
+  if (data->stack != stack)
+    {
+      PropertyInfo *info = state_peek_info (data, PropertyInfo);
+      guint64 value = ((guint64) high << 32) | low;
+
+      g_string_append (info->text, text);
+
+      if (!info->translatable)
+        {
+          info->precompiled_type = precompiled_fundamental_type (value_type);
+          if (info->precompiled_type == G_TYPE_FLOAT ||
+              info->precompiled_type == G_TYPE_DOUBLE)
+            memcpy (&info->precompiled_value.v_double, &value, sizeof (gdouble));
+          else
+            info->precompiled_value.v_uint = value;
+        }
+    }
+
+  end_element (NULL, "property", data, error);
+
+  return TRUE;
+}
+
+static gboolean
+parse_compiled_custom (ParserData    *data,
+                       CompiledData  *compiled,
+                       GError       **error)
+{
+  const gchar *xml;
+  guint32 line;
+
+  if (!compiled_read (compiled, &line) ||
+      !compiled_read_string (compiled, &xml))
+    return FALSE;
+
+  data->line = line;
+
+  /* Buildables parse their custom tags with a GMarkupParser, so they
+   * get a real markup context
+   */
+  data->ctx = g_markup_parse_context_new (&parser,
+                                          G_MARKUP_TREAT_CDATA_AS_TEXT,
+                                          data, NULL);
+  if (g_markup_parse_context_parse (data->ctx, xml, -1, error))
+    g_markup_parse_context_end_parse (data->ctx, error);
+  g_markup_parse_context_free (data->ctx);
+  data->ctx = NULL;
+
+  return TRUE;
+}
+
+static gboolean
+parse_compiled_type_hint (CompiledData *compiled)
+{
+  const gchar *class_name, *type_func;
+
+  if (!compiled_read_string (compiled, &class_name) ||
+      !compiled_read_string (compiled, &type_func))
+    return FALSE;
+
+  /* Registers the type, so that looking it up by name when the object
+   * is constructed does not need to guess the function
+   */
+  if (g_type_from_name (class_name) == G_TYPE_INVALID)
+    g_free (_get_type_by_symbol (type_func));
+
+  return TRUE;
+}
+
+static gboolean
+is_compiled_element (const gchar *element_name)
+{
+  return strcmp (element_name, "interface") == 0 ||
+         strcmp (element_name, "requires") == 0 ||
+         strcmp (element_name, "object") == 0 ||
+         strcmp (element_name, "child") == 0 ||
+         strcmp (element_name, "signal") == 0;
+}
+
+/* Feeds the records of a compiled interface to the same element
+ * handlers as the markup parser. Like the markup parser, it makes
+ * sure that the elements are properly nested, so that the handlers
+ * can rely on that.
+ */
+static gboolean
+parse_compiled (ParserData   *data,
+                const gchar  *buffer,
+                gsize         length,
+                GError      **error)
+{
+  const gchar *names[GTK_BUILDER_COMPILED_MAX_ATTRIBUTES + 1];
+  const gchar *values[GTK_BUILDER_COMPILED_MAX_ATTRIBUTES + 1];
+  const gchar *element_name;
+  CompiledData compiled;
+  GPtrArray *open_elements;
+  GError *tmp_error = NULL;
+  guint32 record, line;
+  gboolean valid, has_root = FALSE;
+
+  if (!compiled_init (&compiled, buffer, length))
+    goto invalid;
+
+  open_elements = g_ptr_array_new ();
+
+  while (compiled.pos < compiled.end)
+    {
+      if (!compiled_read (&compiled, &record))
+        break;
+
+      /* Everything is inside of the one root element */
+      if ((record == GTK_BUILDER_RECORD_PROPERTY ||
+           record == GTK_BUILDER_RECORD_CUSTOM) &&
+          open_elements->len == 0)
+        break;
+
+      switch (record)
+        {
+        case GTK_BUILDER_RECORD_START_ELEMENT:
+          valid = compiled_read (&compiled, &line) &&
+                  compiled_read_string (&compiled, &element_name) &&
+                  is_compiled_element (element_name) &&
+                  compiled_read_attributes (&compiled, names, values) &&
+                  (open_elements->len > 0 || !has_root);
+          if (valid)
+            {
+              has_root = TRUE;
+              g_ptr_array_add (open_elements, (gpointer) element_name);
+
+              data->line = line;
+              start_element (NULL, element_name, names, values, data, &tmp_error);
+            }
+          break;
+        case GTK_BUILDER_RECORD_END_ELEMENT:
+          valid = compiled_read_string (&compiled, &element_name) &&
+                  open_elements->len > 0 &&
+                  strcmp (g_ptr_array_index (open_elements, open_elements->len - 1),
+                          element_name) == 0;
+          if (valid)
+            {
+              g_ptr_array_remove_index (open_elements, open_elements->len - 1);
+              end_element (NULL, element_name, data, &tmp_error);
+            }
+          break;
+        case GTK_BUILDER_RECORD_PROPERTY:
+          valid = parse_compiled_property (data, &compiled, &tmp_error);
+          break;
+        case GTK_BUILDER_RECORD_CUSTOM:
+          valid = parse_compiled_custom (data, &compiled, &tmp_error);
+          break;
+        case GTK_BUILDER_RECORD_TYPE_HINT:
+          valid = parse_compiled_type_hint (&compiled);
+          break;
+        default:
+          valid = FALSE;
+          break;
+        }
+
+      if (!valid)
+        break;
+
+      if (tmp_error)
+        {
+          g_ptr_array_free (open_elements, TRUE);
+          g_propagate_error (error, tmp_error);
+          return FALSE;
+        }
+    }
+
+  valid = compiled.pos == compiled.end && has_root && open_elements->len == 0;
+  g_ptr_array_free (open_elements, TRUE);
+
+  if (valid)
+    return TRUE;
+
+ invalid:
+  g_set_error (error,
+               GTK_BUILDER_ERROR,
+               GTK_BUILDER_ERROR_INVALID_VALUE,
+               "%s: invalid compiled interface description",
+               data->filename);
+  return FALSE;
+}
+
 void
 _gtk_builder_parser_parse_buffer (GtkBuilder   *builder,
                                   const gchar  *filename,
@@ -1119,7 +1565,7 @@ _gtk_builder_parser_parse_buffer (GtkBuilder   *builder,
                                   gchar       **requested_objs,
                                   GError      **error)
 {
-  const gchar* domain;
+  gchar *domain;
   ParserData *data;
   GSList *l;
   
@@ -1128,11 +1574,13 @@ _gtk_builder_parser_parse_buffer (GtkBuilder   *builder,
    * parsing has finished. This allows subparsers to translate elements with
    * gtk_builder_get_translation_domain() without breaking the ABI or API
    */
-  domain = gtk_builder_get_translation_domain (builder);
+  domain = g_strdup (gtk_builder_get_translation_domain (builder));
 
   data = g_new0 (ParserData, 1);
   data->builder = builder;
   data->filename = filename;
+  data->buffer = buffer;
+  data->length = length;
   data->domain = g_strdup (domain);
   data->object_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
 					    (GDestroyNotify)g_free, NULL);
@@ -1155,12 +1603,20 @@ _gtk_builder_parser_parse_buffer (GtkBuilder   *builder,
       data->inside_requested_object = TRUE;
     }
 
-  data->ctx = g_markup_parse_context_new (&parser, 
-                                          G_MARKUP_TREAT_CDATA_AS_TEXT, 
-                                          data, NULL);
+  if (is_compiled (buffer, length))
+    {
+      if (!parse_compiled (data, buffer, length, error))
+        goto out;
+    }
+  else
+    {
+      data->ctx = g_markup_parse_context_new (&parser, 
+                                              G_MARKUP_TREAT_CDATA_AS_TEXT, 
+                                              data, NULL);
 
-  if (!g_markup_parse_context_parse (data->ctx, buffer, length, error))
-    goto out;
+      if (!g_markup_parse_context_parse (data->ctx, buffer, length, error))
+        goto out;
+    }
 
   _gtk_builder_finish (builder);
 
@@ -1196,9 +1652,16 @@ _gtk_builder_parser_parse_buffer (GtkBuilder   *builder,
   g_slist_free (data->requested_objects);
   g_free (data->domain);
   g_hash_table_destroy (data->object_ids);
-  g_markup_parse_context_free (data->ctx);
+  if (data->ctx)
+    g_markup_parse_context_free (data->ctx);
+  if (data->lazy_buffer)
+    _gtk_builder_lazy_buffer_unref (data->lazy_buffer);
+  g_free (data->lazy_id);
   g_free (data);
 
-  /* restore the original domain */
+  /* restore the original domain; building lazy objects parses again
+   * while parsing, which changes the domain
+   */
   gtk_builder_set_translation_domain (builder, domain);
+  g_free (domain);
 }
@@ -59,6 +59,16 @@ typedef struct {
   gchar *data;
   gboolean translatable;
   gchar *context;
+
+  /* Set for values converted by gtk-builder-compile; the fundamental
+   * type of the value, or G_TYPE_INVALID
+   */
+  GType precompiled_type;
+  union {
+    gint64 v_int;
+    guint64 v_uint;
+    gdouble v_double;
+  } precompiled_value;
 } PropertyInfo;
 
 typedef struct {
@@ -86,6 +96,15 @@ typedef struct {
   GObject *child;
 } SubParser;
 
+/* A copy of a UI definition which has lazy objects in it */
+typedef struct {
+  gint ref_count;
+  gchar *filename;  /* As given to the parser */
+  gchar *path;      /* Resolves relative filenames in property values */
+  gchar *buffer;
+  gsize length;
+} LazyBuffer;
+
 typedef struct {
   const gchar *last_element;
   GtkBuilder *builder;
@@ -103,6 +122,15 @@ typedef struct {
   gint cur_object_level;
 
   GHashTable *object_ids;
+
+  /* Line of the current record when loading a compiled interface */
+  gint line;
+
+  const gchar *buffer;
+  gsize length;
+  LazyBuffer *lazy_buffer;   /* NULL until the first lazy object */
+  gint lazy_object_level;    /* 0 if not inside of a lazy object */
+  gchar *lazy_id;
 } ParserData;
 
 typedef GType (*GTypeGetFunc) (void);
@@ -122,6 +150,17 @@ void      _gtk_builder_add (GtkBuilder *builder,
 void      _gtk_builder_add_signals (GtkBuilder *builder,
 				    GSList     *signals);
 void      _gtk_builder_finish (GtkBuilder *builder);
+LazyBuffer * _gtk_builder_lazy_buffer_new   (GtkBuilder  *builder,
+                                             const gchar *filename,
+                                             const gchar *buffer,
+                                             gsize        length);
+void         _gtk_builder_lazy_buffer_unref (LazyBuffer  *buffer);
+void      _gtk_builder_add_lazy (GtkBuilder  *builder,
+                                 LazyBuffer  *buffer,
+                                 const gchar *lazy_id,
+                                 const gchar *object_id);
+GObject * _gtk_builder_add_lazy_placeholder (GtkBuilder  *builder,
+                                             const gchar *lazy_id);
 void _free_signal_info (SignalInfo *info,
                         gpointer user_data);
 
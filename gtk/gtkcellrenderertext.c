@@ -22,6 +22,7 @@
 #include "gtkcellrenderertext.h"
 #include "gtkeditable.h"
 #include "gtkentry.h"
+#include "gtkentryprivate.h"
 #include "gtkmarshalers.h"
 #include "gtkintl.h"
 #include "gtkprivate.h"
@@ -143,6 +144,7 @@ struct _GtkCellRendererTextPrivate
   gulong populate_popup_id;
   gulong entry_menu_popdown_timeout;
   gboolean in_entry_menu;
+  gboolean recycle_entry;
   
   gint width_chars;
   gint wrap_width;
@@ -1702,6 +1704,17 @@ gtk_cell_renderer_text_render (GtkCellRenderer      *cell,
   g_object_unref (layout);
 }
 
+static gboolean
+release_entry (gpointer data)
+{
+  GtkEntry *entry = data;
+
+  g_object_set_data (G_OBJECT (entry), I_(GTK_CELL_RENDERER_TEXT_PATH), NULL);
+  _gtk_entry_release (entry);
+
+  return FALSE;
+}
+
 static void
 gtk_cell_renderer_text_editing_done (GtkCellEditable *entry,
 				     gpointer         data)
@@ -1715,6 +1728,16 @@ gtk_cell_renderer_text_editing_done (GtkCellEditable *entry,
 
   priv->entry = NULL;
 
+  /* The entry is removed from the view right after this, try to
+   * reuse it once that happened
+   */
+  if (priv->recycle_entry)
+    {
+      priv->recycle_entry = FALSE;
+      g_signal_handlers_disconnect_by_func (entry, gtk_cell_renderer_text_editing_done, data);
+      gdk_threads_add_idle (release_entry, g_object_ref (entry));
+    }
+
   if (priv->focus_out_id > 0)
     {
       g_signal_handler_disconnect (entry, priv->focus_out_id);
@@ -1842,10 +1865,24 @@ gtk_cell_renderer_text_start_editing (GtkCellRenderer      *cell,
   if (celltext->editable == FALSE)
     return NULL;
 
-  priv->entry = g_object_new (GTK_TYPE_ENTRY,
-			      "has-frame", FALSE,
-			      "xalign", cell->xalign,
-			      NULL);
+  /* Only reuse entries that nobody else could have seen, which
+   * excludes subclasses, renderers with editing-started handlers and
+   * callers other than the tree view
+   */
+  priv->recycle_entry =
+    G_OBJECT_TYPE (cell) == GTK_TYPE_CELL_RENDERER_TEXT &&
+    G_OBJECT_TYPE (widget) == GTK_TYPE_TREE_VIEW &&
+    !g_signal_has_handler_pending (cell,
+				   g_signal_lookup ("editing-started", GTK_TYPE_CELL_RENDERER),
+				   0, TRUE);
+
+  if (priv->recycle_entry)
+    priv->entry = _gtk_entry_new_recycled ();
+  else
+    priv->entry = gtk_entry_new ();
+
+  gtk_entry_set_has_frame (GTK_ENTRY (priv->entry), FALSE);
+  gtk_entry_set_alignment (GTK_ENTRY (priv->entry), cell->xalign);
 
   if (celltext->text)
     gtk_entry_set_text (GTK_ENTRY (priv->entry), celltext->text);
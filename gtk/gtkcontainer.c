@@ -45,6 +45,32 @@
 #include "gtkmenu.h"
 #endif /* MAEMO_CHANGES */
 
+/* Containers with at least this many children keep an index of the
+ * areas their children draw in, to find the children an expose
+ * touches without visiting them all
+ */
+#define EXPOSE_INDEX_MIN_CHILDREN 32
+
+typedef struct _GtkExposeIndex      GtkExposeIndex;
+typedef struct _GtkExposeIndexChild GtkExposeIndexChild;
+
+struct _GtkExposeIndexChild
+{
+  GtkWidget *widget;
+  GdkRectangle area;
+  guint position;               /* in the order of gtk_container_forall() */
+};
+
+/* The %NO_WINDOW children of a container, sorted by the top of their
+ * area
+ */
+struct _GtkExposeIndex
+{
+  guint n_children;
+  gint max_height;
+  GtkExposeIndexChild children[1];
+};
+
 enum {
   ADD,
   REMOVE,
@@ -107,6 +133,10 @@ static void     gtk_container_show_all             (GtkWidget         *widget);
 static void     gtk_container_hide_all             (GtkWidget         *widget);
 static gint     gtk_container_expose               (GtkWidget         *widget,
 						    GdkEventExpose    *event);
+static void     gtk_container_propagate_expose_area (GtkContainer       *container,
+						     GtkWidget          *child,
+						     const GdkRectangle *child_area,
+						     GdkEventExpose     *event);
 static void     gtk_container_map                  (GtkWidget         *widget);
 static void     gtk_container_unmap                (GtkWidget         *widget);
 
@@ -146,6 +176,8 @@ static const gchar           vadjustment_key[] = "gtk-vadjustment";
 static guint                 vadjustment_key_id = 0;
 static const gchar           hadjustment_key[] = "gtk-hadjustment";
 static guint                 hadjustment_key_id = 0;
+static const gchar           expose_index_key[] = "gtk-expose-index";
+static guint                 expose_index_key_id = 0;
 static GSList	            *container_resize_queue = NULL;
 static guint                 container_signals[LAST_SIGNAL] = { 0 };
 static GtkWidgetClass       *parent_class = NULL;
@@ -232,6 +264,7 @@ gtk_container_class_init (GtkContainerClass *class)
 
   vadjustment_key_id = g_quark_from_static_string (vadjustment_key);
   hadjustment_key_id = g_quark_from_static_string (hadjustment_key);
+  expose_index_key_id = g_quark_from_static_string (expose_index_key);
   
   gobject_class->set_property = gtk_container_set_property;
   gobject_class->get_property = gtk_container_get_property;
@@ -1459,8 +1492,21 @@ _gtk_container_queue_resize (GtkContainer *container)
   widget = GTK_WIDGET (container);
   resize_container = gtk_container_get_resize_container (container);
   
+  /* The layout of @container itself depends on what changed about the
+   * child, but the ancestors further up only need to be revisited if
+   * the requisition of @container turns out different. Mark them with
+   * GTK_DESCENDANT_RESIZE unless they are already waiting for a size
+   * request or allocation of their own.
+   */
+  GTK_PRIVATE_UNSET_FLAG (widget, GTK_DESCENDANT_RESIZE);
+
   while (TRUE)
     {
+      if (widget != GTK_WIDGET (container) &&
+	  !GTK_WIDGET_REQUEST_NEEDED (widget) &&
+	  !GTK_WIDGET_ALLOC_NEEDED (widget))
+	GTK_PRIVATE_SET_FLAG (widget, GTK_DESCENDANT_RESIZE);
+
       GTK_PRIVATE_SET_FLAG (widget, GTK_ALLOC_NEEDED);
       GTK_PRIVATE_SET_FLAG (widget, GTK_REQUEST_NEEDED);
       if ((resize_container && widget == GTK_WIDGET (resize_container)) ||
@@ -2741,28 +2787,180 @@ gtk_container_hide_all (GtkWidget *widget)
 }
 
 
+typedef struct
+{
+  GtkWidget *container;
+  GdkEventExpose *event;
+  guint n_children;
+} ExposeData;
+
 static void
 gtk_container_expose_child (GtkWidget *child,
 			    gpointer   client_data)
 {
-  struct {
-    GtkWidget *container;
-    GdkEventExpose *event;
-  } *data = client_data;
+  ExposeData *data = client_data;
   
   gtk_container_propagate_expose (GTK_CONTAINER (data->container),
 				  child,
 				  data->event);
+  data->n_children++;
+}
+
+static void
+expose_index_add_child (GtkWidget *child,
+			gpointer   data)
+{
+  GArray *children = data;
+  GtkExposeIndexChild index_child;
+
+  index_child.widget = child;
+  index_child.position = children->len;
+
+  if (!gtk_widget_get_has_window (child))
+    {
+      _gtk_widget_get_draw_rectangle (child, &index_child.area);
+      g_array_append_val (children, index_child);
+    }
+}
+
+static gint
+expose_index_compare_top (gconstpointer a,
+			  gconstpointer b)
+{
+  const GtkExposeIndexChild *child_a = a;
+  const GtkExposeIndexChild *child_b = b;
+
+  return child_a->area.y < child_b->area.y ? -1 : child_a->area.y > child_b->area.y;
+}
+
+static gint
+expose_index_compare_position (gconstpointer a,
+			       gconstpointer b)
+{
+  const GtkExposeIndexChild *child_a = a;
+  const GtkExposeIndexChild *child_b = b;
+
+  return child_a->position < child_b->position ? -1 : child_a->position > child_b->position;
+}
+
+/* Remembers the areas of the children, until one of them changes;
+ * see _gtk_container_child_area_changed()
+ */
+static void
+gtk_container_build_expose_index (GtkContainer *container)
+{
+  GtkExposeIndex *index;
+  GArray *children;
+  guint i;
+
+  children = g_array_new (FALSE, FALSE, sizeof (GtkExposeIndexChild));
+  gtk_container_forall (container, expose_index_add_child, children);
+
+  index = g_malloc (sizeof (GtkExposeIndex) + children->len * sizeof (GtkExposeIndexChild));
+  index->n_children = children->len;
+  index->max_height = 0;
+  memcpy (index->children, children->data, children->len * sizeof (GtkExposeIndexChild));
+  g_array_free (children, TRUE);
+
+  qsort (index->children, index->n_children, sizeof (GtkExposeIndexChild),
+	 expose_index_compare_top);
+  for (i = 0; i < index->n_children; i++)
+    index->max_height = MAX (index->max_height, index->children[i].area.height);
+
+  g_object_set_qdata_full (G_OBJECT (container), expose_index_key_id, index, g_free);
+  GTK_PRIVATE_SET_FLAG (container, GTK_EXPOSE_INDEX);
+}
+
+/**
+ * _gtk_container_child_area_changed:
+ * @child: a #GtkWidget
+ *
+ * Tells the containers above @child that the area it draws in may
+ * have changed: its allocation changed, it was mapped or unmapped,
+ * or it was added to or removed from its parent. Since the area of a
+ * %NO_WINDOW widget includes the areas of its %NO_WINDOW children,
+ * this drops the expose index of every container up to the first
+ * widget with a window.
+ **/
+void
+_gtk_container_child_area_changed (GtkWidget *child)
+{
+  GtkWidget *widget;
+
+  for (widget = child;
+       widget->parent && !gtk_widget_get_has_window (widget);
+       widget = widget->parent)
+    {
+      if (GTK_CONTAINER_EXPOSE_INDEX (widget->parent))
+	{
+	  GTK_PRIVATE_UNSET_FLAG (widget->parent, GTK_EXPOSE_INDEX);
+	  g_object_set_qdata (G_OBJECT (widget->parent), expose_index_key_id, NULL);
+	}
+    }
+}
+
+/* Only visits the children whose area intersects the area of the
+ * event; they are exposed in the same order as gtk_container_forall()
+ * would, so that overlapping children are painted the same way.
+ */
+static void
+gtk_container_expose_with_index (GtkContainer   *container,
+				 GtkExposeIndex *index,
+				 GdkEventExpose *event)
+{
+  GtkExposeIndexChild stack_hits[64];
+  GtkExposeIndexChild *hits;
+  GdkRectangle *area = &event->area;
+  guint lower, upper, first, i, n_hits;
+
+  /* The first child that can reach down into the area
+   */
+  lower = 0;
+  upper = index->n_children;
+  while (lower < upper)
+    {
+      guint middle = (lower + upper) / 2;
+
+      if (index->children[middle].area.y + index->max_height <= area->y)
+	lower = middle + 1;
+      else
+	upper = middle;
+    }
+  first = lower;
+
+  n_hits = 0;
+  for (i = first; i < index->n_children && index->children[i].area.y < area->y + area->height; i++)
+    n_hits++;
+
+  hits = n_hits > G_N_ELEMENTS (stack_hits) ? g_new (GtkExposeIndexChild, n_hits) : stack_hits;
+
+  n_hits = 0;
+  for (i = first; i < index->n_children && index->children[i].area.y < area->y + area->height; i++)
+    {
+      GtkExposeIndexChild *child = &index->children[i];
+
+      if (child->area.y + child->area.height > area->y &&
+	  child->area.x < area->x + area->width &&
+	  child->area.x + child->area.width > area->x)
+	hits[n_hits++] = *child;
+    }
+
+  qsort (hits, n_hits, sizeof (GtkExposeIndexChild), expose_index_compare_position);
+
+  /* The hits are copies; exposing a child may drop the index
+   */
+  for (i = 0; i < n_hits; i++)
+    gtk_container_propagate_expose_area (container, hits[i].widget, &hits[i].area, event);
+
+  if (hits != stack_hits)
+    g_free (hits);
 }
 
 static gint 
 gtk_container_expose (GtkWidget      *widget,
 		      GdkEventExpose *event)
 {
-  struct {
-    GtkWidget *container;
-    GdkEventExpose *event;
-  } data;
+  ExposeData data;
 
   g_return_val_if_fail (GTK_IS_CONTAINER (widget), FALSE);
   g_return_val_if_fail (event != NULL, FALSE);
@@ -2770,12 +2968,24 @@ gtk_container_expose (GtkWidget      *widget,
   
   if (gtk_widget_is_drawable (widget))
     {
+      if (GTK_CONTAINER_EXPOSE_INDEX (widget))
+	{
+	  gtk_container_expose_with_index (GTK_CONTAINER (widget),
+					   g_object_get_qdata (G_OBJECT (widget), expose_index_key_id),
+					   event);
+	  return FALSE;
+	}
+
       data.container = widget;
       data.event = event;
+      data.n_children = 0;
       
       gtk_container_forall (GTK_CONTAINER (widget),
 			    gtk_container_expose_child,
 			    &data);
+
+      if (data.n_children >= EXPOSE_INDEX_MIN_CHILDREN)
+	gtk_container_build_expose_index (GTK_CONTAINER (widget));
     }   
   
   return FALSE;
@@ -2849,7 +3059,7 @@ gtk_container_propagate_expose (GtkContainer   *container,
 				GtkWidget      *child,
 				GdkEventExpose *event)
 {
-  GdkEvent *child_event;
+  GdkRectangle child_area;
 
   g_return_if_fail (GTK_IS_CONTAINER (container));
   g_return_if_fail (GTK_IS_WIDGET (child));
@@ -2860,19 +3070,57 @@ gtk_container_propagate_expose (GtkContainer   *container,
   if (gtk_widget_is_drawable (child) &&
       !gtk_widget_get_has_window (child) &&
       (child->window == event->window))
+    {
+      _gtk_widget_get_draw_rectangle (child, &child_area);
+      gtk_container_propagate_expose_area (container, child, &child_area, event);
+    }
+}
+
+/* Sends the part of @event that falls into @child_area to @child,
+ * checking the area against the region of the event before building
+ * a region for the child
+ */
+static void
+gtk_container_propagate_expose_area (GtkContainer       *container,
+				     GtkWidget          *child,
+				     const GdkRectangle *child_area,
+				     GdkEventExpose     *event)
+{
+  GdkEvent *child_event;
+  GdkRegion *region;
+
+  if (!gtk_widget_is_drawable (child) ||
+      gtk_widget_get_has_window (child) ||
+      child->window != event->window)
+    return;
+
+  switch (gdk_region_rect_in (event->region, child_area))
+    {
+    case GDK_OVERLAP_RECTANGLE_OUT:
+      return;
+    case GDK_OVERLAP_RECTANGLE_IN:
+      region = gdk_region_rectangle (child_area);
+      break;
+    case GDK_OVERLAP_RECTANGLE_PART:
+    default:
+      region = gdk_region_rectangle (child_area);
+      gdk_region_intersect (region, event->region);
+      break;
+    }
+
+  if (!gdk_region_empty (region))
     {
       child_event = gdk_event_new (GDK_EXPOSE);
       child_event->expose = *event;
       g_object_ref (child_event->expose.window);
 
-      child_event->expose.region = gtk_widget_region_intersect (child, event->region);
-      if (!gdk_region_empty (child_event->expose.region))
-	{
-	  gdk_region_get_clipbox (child_event->expose.region, &child_event->expose.area);
-	  gtk_widget_send_expose (child, child_event);
-	}
+      child_event->expose.region = region;
+      gdk_region_get_clipbox (region, &child_event->expose.area);
+      gtk_widget_send_expose (child, child_event);
       gdk_event_free (child_event);
     }
+  else
+    gdk_region_destroy (region);
 }
 
 #ifdef MAEMO_CHANGES
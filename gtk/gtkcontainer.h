@@ -219,6 +219,7 @@ void    _gtk_container_clear_resize_widgets   (GtkContainer *container);
 gchar*	_gtk_container_child_composite_name   (GtkContainer *container,
 					      GtkWidget	   *child);
 void   _gtk_container_dequeue_resize_handler (GtkContainer *container);
+void   _gtk_container_child_area_changed     (GtkWidget    *child);
 GList *_gtk_container_focus_sort             (GtkContainer     *container,
 					      GList            *children,
 					      GtkDirectionType  direction,
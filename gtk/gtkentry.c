@@ -65,6 +65,7 @@
 #include "gtktooltip.h"
 #include "gtkiconfactory.h"
 #include "gtkicontheme.h"
+#include "gtkwidgetpool.h"
 #include "gtkalias.h"
 
 #define GTK_ENTRY_COMPLETION_KEY "gtk-entry-completion-key"
@@ -3053,7 +3054,7 @@ gtk_entry_unrealize (GtkWidget *widget)
 
   if (entry->popup_menu)
     {
-      gtk_widget_destroy (entry->popup_menu);
+      _gtk_menu_release (GTK_MENU (entry->popup_menu));
       entry->popup_menu = NULL;
     }
 
@@ -7151,6 +7152,91 @@ gtk_entry_new (void)
   return g_object_new (GTK_TYPE_ENTRY, NULL);
 }
 
+static gboolean
+gtk_entry_reset (GtkWidget *widget)
+{
+  GtkEntry *entry = GTK_ENTRY (widget);
+  GtkEntryPrivate *priv = GTK_ENTRY_GET_PRIVATE (entry);
+  gint i;
+
+  /* Icons come with too much state to be worth resetting */
+  for (i = 0; i < MAX_ICONS; i++)
+    if (priv->icons[i])
+      return FALSE;
+
+  g_signal_handlers_disconnect_by_func (entry, gtk_cell_editable_entry_activated, NULL);
+  g_signal_handlers_disconnect_by_func (entry, gtk_cell_editable_key_press_event, NULL);
+  entry->is_cell_renderer = FALSE;
+  entry->editing_canceled = FALSE;
+
+  gtk_entry_set_completion (entry, NULL);
+  gtk_entry_set_buffer (entry, NULL);
+  entry->current_pos = 0;
+  entry->selection_bound = 0;
+  entry->scroll_offset = 0;
+
+  gtk_editable_set_editable (GTK_EDITABLE (entry), TRUE);
+  gtk_entry_set_visibility (entry, TRUE);
+  gtk_entry_unset_invisible_char (entry);
+  gtk_entry_set_activates_default (entry, FALSE);
+  gtk_entry_set_width_chars (entry, -1);
+  gtk_entry_set_has_frame (entry, TRUE);
+  gtk_entry_set_inner_border (entry, NULL);
+  gtk_entry_set_alignment (entry, 0.0);
+  gtk_entry_set_overwrite_mode (entry, FALSE);
+  gtk_entry_set_cursor_hadjustment (entry, NULL);
+  gtk_entry_set_progress_fraction (entry, 0.0);
+  gtk_entry_set_progress_pulse_step (entry, 0.1);
+#ifdef MAEMO_CHANGES
+  hildon_gtk_entry_set_placeholder_text (entry, NULL);
+  entry->truncate_multiline = TRUE;
+#else /* MAEMO_CHANGES */
+  entry->truncate_multiline = FALSE;
+#endif /* MAEMO_CHANGES */
+  priv->shadow_type = GTK_SHADOW_IN;
+  priv->caps_lock_warning = TRUE;
+
+  return TRUE;
+}
+
+static GtkWidgetPool *
+gtk_entry_get_pool (void)
+{
+  static GtkWidgetPool *pool = NULL;
+
+  if (!pool)
+    pool = _gtk_widget_pool_new (GTK_TYPE_ENTRY, 2, gtk_entry_reset);
+
+  return pool;
+}
+
+/* Like gtk_entry_new(), but reuses an entry given to
+ * _gtk_entry_release() if there is one.
+ */
+GtkWidget*
+_gtk_entry_new_recycled (void)
+{
+  GtkWidget *entry;
+
+  entry = _gtk_widget_pool_take (gtk_entry_get_pool ());
+  if (!entry)
+    entry = gtk_entry_new ();
+
+  return entry;
+}
+
+/* Drops a reference to @entry, which is kept for
+ * _gtk_entry_new_recycled() if it was the last one.
+ */
+void
+_gtk_entry_release (GtkEntry *entry)
+{
+  g_return_if_fail (GTK_IS_ENTRY (entry));
+
+  if (!_gtk_widget_pool_recycle (gtk_entry_get_pool (), GTK_WIDGET (entry)))
+    g_object_unref (entry);
+}
+
 /**
  * gtk_entry_new_with_buffer:
  * @buffer: The buffer to use for the new #GtkEntry.
@@ -9246,9 +9332,13 @@ popup_targets_received (GtkClipboard     *clipboard,
       
       clipboard_contains_text = gtk_selection_data_targets_include_text (data);
       if (entry->popup_menu)
-	gtk_widget_destroy (entry->popup_menu);
+	_gtk_menu_release (GTK_MENU (entry->popup_menu));
       
-      entry->popup_menu = gtk_menu_new ();
+      /* Menus that ::populate-popup handlers saw are not reused */
+      entry->popup_menu =
+	_gtk_menu_new_recycled (!g_signal_has_handler_pending (entry,
+							       signals[POPULATE_POPUP],
+							       0, TRUE));
       
       gtk_menu_attach_to_widget (GTK_MENU (entry->popup_menu),
 				 GTK_WIDGET (entry),
@@ -81,6 +81,9 @@ void      _gtk_entry_get_borders            (GtkEntry  *entry,
 void     _gtk_entry_effective_inner_border (GtkEntry  *entry,
 					    GtkBorder *border);
 void     _gtk_entry_reset_im_context       (GtkEntry  *entry);
+
+GtkWidget *_gtk_entry_new_recycled         (void);
+void       _gtk_entry_release              (GtkEntry  *entry);
 G_END_DECLS
 
 #endif /* __GTK_ENTRY_PRIVATE_H__ */
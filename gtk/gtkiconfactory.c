@@ -1082,19 +1082,8 @@ static void       add_to_cache      (GtkIconSet       *icon_set,
                                      GtkStateType      state,
                                      GtkIconSize       size,
                                      GdkPixbuf        *pixbuf);
-/* Clear icon set contents, drop references to all contained
- * GdkPixbuf objects and forget all GtkIconSources. Used to
- * recycle an icon set.
- */
-static void       clear_cache       (GtkIconSet       *icon_set,
-                                     gboolean          style_detach);
-static GSList*    copy_cache        (GtkIconSet       *icon_set,
-                                     GtkIconSet       *copy_recipient);
-static void       attach_to_style   (GtkIconSet       *icon_set,
-                                     GtkStyle         *style);
-static void       detach_from_style (GtkIconSet       *icon_set,
-                                     GtkStyle         *style);
-static void       style_dnotify     (gpointer          data);
+/* Drop all rendered versions of the icon set from the cache */
+static void       clear_cache       (GtkIconSet       *icon_set);
 
 struct _GtkIconSet
 {
@@ -1102,16 +1091,10 @@ struct _GtkIconSet
 
   GSList *sources;
 
-  /* Cache of the last few rendered versions of the icon. */
-  GSList *cache;
-
-  guint cache_size;
-
-  guint cache_serial;
+  /* The CachedIcons rendered from this set, see find_in_cache() */
+  GList *cache;
 };
 
-static guint cache_serial = 0;
-
 /**
  * gtk_icon_set_new:
  *
@@ -1137,8 +1120,6 @@ gtk_icon_set_new (void)
   icon_set->ref_count = 1;
   icon_set->sources = NULL;
   icon_set->cache = NULL;
-  icon_set->cache_size = 0;
-  icon_set->cache_serial = cache_serial;
 
   return icon_set;
 }
@@ -1219,7 +1200,7 @@ gtk_icon_set_unref (GtkIconSet *icon_set)
         }
       g_slist_free (icon_set->sources);
 
-      clear_cache (icon_set, TRUE);
+      clear_cache (icon_set);
 
       g_free (icon_set);
     }
@@ -1265,10 +1246,6 @@ gtk_icon_set_copy (GtkIconSet *icon_set)
 
   copy->sources = g_slist_reverse (copy->sources);
 
-  copy->cache = copy_cache (icon_set, copy);
-  copy->cache_size = icon_set->cache_size;
-  copy->cache_serial = icon_set->cache_serial;
-
   return copy;
 }
 
@@ -1738,6 +1715,9 @@ gtk_icon_set_add_source (GtkIconSet          *icon_set,
   icon_set->sources = g_slist_insert_sorted (icon_set->sources,
                                              gtk_icon_source_copy (source),
                                              icon_source_compare);
+
+  /* The new source may be a better match for icons already rendered */
+  clear_cache (icon_set);
 }
 
 /**
@@ -2385,7 +2365,19 @@ gtk_icon_source_get_size (const GtkIconSource *source)
   return source->size;
 }
 
-#define NUM_CACHED_ICONS 8
+/* Rendered icons are kept in one cache shared by all icon sets, bounded
+ * by the memory used by the pixbufs, and evicted least recently used
+ * first. Entries are keyed on the icon set, the style and the render
+ * parameters. Instead of the style pointer, which could be reused for
+ * a new style, each style gets a unique generation number the first
+ * time it renders an icon, and its entries are removed when it is
+ * finalized.
+ *
+ * Entries are dropped precisely: those of an icon set when it changes
+ * or is freed, those of a style when it goes away, and all of them
+ * when the rc files or the icon theme change.
+ */
+#define ICON_CACHE_MAX_BYTES (2 * 1024 * 1024)
 
 typedef struct _CachedIcon CachedIcon;
 
@@ -2394,33 +2386,123 @@ struct _CachedIcon
   /* These must all match to use the cached pixbuf.
    * If any don't match, we must re-render the pixbuf.
    */
-  GtkStyle *style;
+  GtkIconSet *icon_set;
+  guint style_generation;
   GtkTextDirection direction;
   GtkStateType state;
   GtkIconSize size;
 
   GdkPixbuf *pixbuf;
+  gsize bytes;
+
+  /* The StyleIcons of the style, or %NULL */
+  gpointer style_icons;
+
+  GList lru_link;
+  GList set_link;
+  GList style_link;
 };
 
+typedef struct
+{
+  guint generation;
+  GList *icons;
+} StyleIcons;
+
+typedef struct
+{
+  guint hits;
+  guint misses;
+  guint evictions;
+  guint invalidations;
+} IconCacheStats;
+
+static GHashTable *icon_cache = NULL;
+/* Most recently used first */
+static GQueue icon_cache_lru = G_QUEUE_INIT;
+static gsize icon_cache_bytes = 0;
+static IconCacheStats icon_cache_stats;
+static guint style_generation = 0;
+
+static guint
+cached_icon_hash (gconstpointer key)
+{
+  const CachedIcon *icon = key;
+
+  return (GPOINTER_TO_UINT (icon->icon_set) ^
+          (icon->style_generation << 12) ^
+          (icon->size << 4) ^
+          (icon->state << 2) ^
+          icon->direction);
+}
+
+static gboolean
+cached_icon_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const CachedIcon *icon_a = a;
+  const CachedIcon *icon_b = b;
+
+  return (icon_a->icon_set == icon_b->icon_set &&
+          icon_a->style_generation == icon_b->style_generation &&
+          icon_a->direction == icon_b->direction &&
+          icon_a->state == icon_b->state &&
+          icon_a->size == icon_b->size);
+}
+
 static void
-ensure_cache_up_to_date (GtkIconSet *icon_set)
+remove_from_cache (CachedIcon *icon)
 {
-  if (icon_set->cache_serial != cache_serial)
+  g_hash_table_remove (icon_cache, icon);
+
+  g_queue_unlink (&icon_cache_lru, &icon->lru_link);
+  icon->icon_set->cache = g_list_remove_link (icon->icon_set->cache,
+                                              &icon->set_link);
+  if (icon->style_icons)
     {
-      clear_cache (icon_set, TRUE);
-      icon_set->cache_serial = cache_serial;
+      StyleIcons *style_icons = icon->style_icons;
+
+      style_icons->icons = g_list_remove_link (style_icons->icons,
+                                               &icon->style_link);
     }
+
+  icon_cache_bytes -= icon->bytes;
+
+  g_object_unref (icon->pixbuf);
+  g_slice_free (CachedIcon, icon);
 }
 
 static void
-cached_icon_free (CachedIcon *icon)
+style_icons_free (gpointer data)
 {
-  g_object_unref (icon->pixbuf);
+  StyleIcons *style_icons = data;
 
-  if (icon->style)
-    g_object_unref (icon->style);
+  while (style_icons->icons)
+    remove_from_cache (style_icons->icons->data);
 
-  g_free (icon);
+  g_slice_free (StyleIcons, style_icons);
+}
+
+static StyleIcons *
+get_style_icons (GtkStyle *style,
+                 gboolean  create)
+{
+  static GQuark quark_style_icons = 0;
+  StyleIcons *style_icons;
+
+  if (G_UNLIKELY (!quark_style_icons))
+    quark_style_icons = g_quark_from_static_string ("gtk-style-icons");
+
+  style_icons = g_object_get_qdata (G_OBJECT (style), quark_style_icons);
+  if (!style_icons && create)
+    {
+      style_icons = g_slice_new0 (StyleIcons);
+      style_icons->generation = ++style_generation;
+      g_object_set_qdata_full (G_OBJECT (style), quark_style_icons,
+                               style_icons, style_icons_free);
+    }
+
+  return style_icons;
 }
 
 static GdkPixbuf *
@@ -2430,38 +2512,45 @@ find_in_cache (GtkIconSet      *icon_set,
                GtkStateType     state,
                GtkIconSize      size)
 {
-  GSList *tmp_list;
-  GSList *prev;
+  CachedIcon key;
+  CachedIcon *icon;
 
-  ensure_cache_up_to_date (icon_set);
+  if (!icon_cache)
+    return NULL;
 
-  prev = NULL;
-  tmp_list = icon_set->cache;
-  while (tmp_list != NULL)
+  key.icon_set = icon_set;
+  key.style_generation = 0;
+  key.direction = direction;
+  key.state = state;
+  key.size = size;
+
+  if (style)
     {
-      CachedIcon *icon = tmp_list->data;
+      StyleIcons *style_icons = get_style_icons (style, FALSE);
 
-      if (icon->style == style &&
-          icon->direction == direction &&
-          icon->state == state &&
-          (size == (GtkIconSize)-1 || icon->size == size))
+      /* The style has never rendered an icon */
+      if (!style_icons)
         {
-          if (prev)
-            {
-              /* Move this icon to the front of the list. */
-              prev->next = tmp_list->next;
-              tmp_list->next = icon_set->cache;
-              icon_set->cache = tmp_list;
-            }
-
-          return icon->pixbuf;
+          icon_cache_stats.misses++;
+          return NULL;
         }
 
-      prev = tmp_list;
-      tmp_list = g_slist_next (tmp_list);
+      key.style_generation = style_icons->generation;
+    }
+
+  icon = g_hash_table_lookup (icon_cache, &key);
+  if (!icon)
+    {
+      icon_cache_stats.misses++;
+      return NULL;
     }
 
-  return NULL;
+  icon_cache_stats.hits++;
+
+  g_queue_unlink (&icon_cache_lru, &icon->lru_link);
+  g_queue_push_head_link (&icon_cache_lru, &icon->lru_link);
+
+  return icon->pixbuf;
 }
 
 static void
@@ -2472,197 +2561,87 @@ add_to_cache (GtkIconSet      *icon_set,
               GtkIconSize      size,
               GdkPixbuf       *pixbuf)
 {
-  CachedIcon *icon;
-
-  ensure_cache_up_to_date (icon_set);
+  CachedIcon *icon, *old_icon;
+  StyleIcons *style_icons = NULL;
 
-  g_object_ref (pixbuf);
+  if (!icon_cache)
+    icon_cache = g_hash_table_new (cached_icon_hash, cached_icon_equal);
 
-  /* We have to ref the style, since if the style was finalized
-   * its address could be reused by another style, creating a
-   * really weird bug
-   */
+  icon = g_slice_new0 (CachedIcon);
 
-  if (style)
-    g_object_ref (style);
-
-  icon = g_new (CachedIcon, 1);
-  icon_set->cache = g_slist_prepend (icon_set->cache, icon);
-  icon_set->cache_size++;
-
-  icon->style = style;
+  icon->icon_set = icon_set;
   icon->direction = direction;
   icon->state = state;
   icon->size = size;
-  icon->pixbuf = pixbuf;
-
-  if (icon->style)
-    attach_to_style (icon_set, icon->style);
+  icon->pixbuf = g_object_ref (pixbuf);
+  icon->bytes = gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
 
-  if (icon_set->cache_size >= NUM_CACHED_ICONS)
+  if (style)
     {
-      /* Remove oldest item in the cache */
-      GSList *tmp_list;
-
-      tmp_list = icon_set->cache;
-
-      /* Find next-to-last link */
-      g_assert (NUM_CACHED_ICONS > 2);
-      while (tmp_list->next->next)
-        tmp_list = tmp_list->next;
-
-      g_assert (tmp_list != NULL);
-      g_assert (tmp_list->next != NULL);
-      g_assert (tmp_list->next->next == NULL);
-
-      /* Free the last icon */
-      icon = tmp_list->next->data;
-
-      g_slist_free (tmp_list->next);
-      tmp_list->next = NULL;
-
-      cached_icon_free (icon);
+      style_icons = get_style_icons (style, TRUE);
+      icon->style_generation = style_icons->generation;
     }
-}
 
-static void
-clear_cache (GtkIconSet *icon_set,
-             gboolean    style_detach)
-{
-  GSList *cache, *tmp_list;
-  GtkStyle *last_style = NULL;
-
-  cache = icon_set->cache;
-  icon_set->cache = NULL;
-  icon_set->cache_size = 0;
-  tmp_list = cache;
-  while (tmp_list != NULL)
-    {
-      CachedIcon *icon = tmp_list->data;
-
-      if (style_detach)
-        {
-          /* simple optimization for the case where the cache
-           * contains contiguous icons from the same style.
-           * it's safe to call detach_from_style more than
-           * once on the same style though.
-           */
-          if (last_style != icon->style)
-            {
-              detach_from_style (icon_set, icon->style);
-              last_style = icon->style;
-            }
-        }
+  /* A theme engine's render_icon may have rendered and cached the
+   * same icon already
+   */
+  old_icon = g_hash_table_lookup (icon_cache, icon);
+  if (old_icon)
+    remove_from_cache (old_icon);
 
-      cached_icon_free (icon);
+  g_hash_table_insert (icon_cache, icon, icon);
 
-      tmp_list = g_slist_next (tmp_list);
-    }
+  icon->lru_link.data = icon;
+  g_queue_push_head_link (&icon_cache_lru, &icon->lru_link);
 
-  g_slist_free (cache);
-}
+  icon->set_link.data = icon;
+  icon_set->cache = g_list_concat (&icon->set_link, icon_set->cache);
 
-static GSList*
-copy_cache (GtkIconSet *icon_set,
-            GtkIconSet *copy_recipient)
-{
-  GSList *tmp_list;
-  GSList *copy = NULL;
-
-  ensure_cache_up_to_date (icon_set);
-
-  tmp_list = icon_set->cache;
-  while (tmp_list != NULL)
+  if (style_icons)
     {
-      CachedIcon *icon = tmp_list->data;
-      CachedIcon *icon_copy = g_new (CachedIcon, 1);
-
-      *icon_copy = *icon;
-
-      if (icon_copy->style)
-	{
-	  attach_to_style (copy_recipient, icon_copy->style);
-	  g_object_ref (icon_copy->style);
-	}
-
-      g_object_ref (icon_copy->pixbuf);
-
-      icon_copy->size = icon->size;
-
-      copy = g_slist_prepend (copy, icon_copy);
-
-      tmp_list = g_slist_next (tmp_list);
+      icon->style_icons = style_icons;
+      icon->style_link.data = icon;
+      style_icons->icons = g_list_concat (&icon->style_link, style_icons->icons);
     }
 
-  return g_slist_reverse (copy);
-}
-
-static void
-attach_to_style (GtkIconSet *icon_set,
-                 GtkStyle   *style)
-{
-  GHashTable *table;
+  icon_cache_bytes += icon->bytes;
 
-  table = g_object_get_qdata (G_OBJECT (style),
-                              g_quark_try_string ("gtk-style-icon-sets"));
-
-  if (table == NULL)
+  /* Always keep the icon just added, even if it is larger than the
+   * whole cache
+   */
+  while (icon_cache_bytes > ICON_CACHE_MAX_BYTES &&
+         icon_cache_lru.tail != &icon->lru_link)
     {
-      table = g_hash_table_new (NULL, NULL);
-      g_object_set_qdata_full (G_OBJECT (style),
-                               g_quark_from_static_string ("gtk-style-icon-sets"),
-                               table,
-                               style_dnotify);
+      remove_from_cache (icon_cache_lru.tail->data);
+      icon_cache_stats.evictions++;
     }
-
-  g_hash_table_insert (table, icon_set, icon_set);
 }
 
 static void
-detach_from_style (GtkIconSet *icon_set,
-                   GtkStyle   *style)
+clear_cache (GtkIconSet *icon_set)
 {
-  GHashTable *table;
-
-  table = g_object_get_qdata (G_OBJECT (style),
-                              g_quark_try_string ("gtk-style-icon-sets"));
-
-  if (table != NULL)
-    g_hash_table_remove (table, icon_set);
+  while (icon_set->cache)
+    remove_from_cache (icon_set->cache->data);
 }
 
-static void
-iconsets_foreach (gpointer key,
-                  gpointer value,
-                  gpointer user_data)
-{
-  GtkIconSet *icon_set = key;
-
-  /* We only need to remove cache entries for the given style;
-   * but that complicates things because in destroy notify
-   * we don't know which style got destroyed, and 95% of the
-   * time all cache entries will have the same style,
-   * so this is faster anyway.
-   */
-
-  clear_cache (icon_set, FALSE);
-}
-
-static void
-style_dnotify (gpointer data)
-{
-  GHashTable *table = data;
-
-  g_hash_table_foreach (table, iconsets_foreach, NULL);
-
-  g_hash_table_destroy (table);
-}
-
-/* This allows the icon set to detect that its cache is out of date. */
+/* Drops all rendered icons, since the rc files or the icon theme
+ * changed and they may look different now.
+ */
 void
 _gtk_icon_set_invalidate_caches (void)
 {
-  ++cache_serial;
+  icon_cache_stats.invalidations++;
+
+  GTK_NOTE (ICONTHEME,
+            g_print ("icon set cache: %u hits, %u misses, %u evictions, "
+                     "%u icons (%" G_GSIZE_FORMAT " bytes) dropped in "
+                     "invalidation %u\n",
+                     icon_cache_stats.hits, icon_cache_stats.misses,
+                     icon_cache_stats.evictions, icon_cache_lru.length,
+                     icon_cache_bytes, icon_cache_stats.invalidations));
+
+  while (icon_cache_lru.tail)
+    remove_from_cache (icon_cache_lru.tail->data);
 }
 
 /**
@@ -0,0 +1,715 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include <gdk/gdk.h>
+#include "gtkdebug.h"
+#include "gtkiconindex.h"
+#include "gtkalias.h"
+
+#define MAJOR_VERSION 1
+#define MINOR_VERSION 0
+
+#define HEADER_SIZE     20
+#define DIR_ENTRY_SIZE  12
+#define ICON_ENTRY_SIZE 8
+
+/* Number of directories scanned in parallel */
+#define MAX_SCAN_THREADS 4
+
+#define GET_UINT16(buf, offset) (GUINT16_FROM_BE (*(guint16 *)((buf) + (offset))))
+#define GET_UINT32(buf, offset) (GUINT32_FROM_BE (*(guint32 *)((buf) + (offset))))
+
+struct _GtkIconIndex
+{
+  gint ref_count;
+
+  GMappedFile *map;
+  gchar *buffer;	/* Owned if map is NULL */
+  gsize size;
+
+  guint32 n_dirs;
+  guint32 dir_list_offset;
+  guint32 n_icons;
+  guint32 icon_list_offset;
+
+  /* Directory path => index + 1, created on first lookup */
+  GHashTable *dir_indices;
+};
+
+GtkIconIndex *
+_gtk_icon_index_ref (GtkIconIndex *index)
+{
+  index->ref_count++;
+  return index;
+}
+
+void
+_gtk_icon_index_unref (GtkIconIndex *index)
+{
+  index->ref_count--;
+
+  if (index->ref_count == 0)
+    {
+      if (index->dir_indices)
+	g_hash_table_destroy (index->dir_indices);
+      if (index->map)
+	g_mapped_file_unref (index->map);
+      else
+	g_free (index->buffer);
+      g_free (index);
+    }
+}
+
+gchar *
+_gtk_icon_index_get_filename (const gchar * const *directories,
+			      gint                 n_directories)
+{
+  GChecksum *checksum;
+  gchar *filename;
+  gint i;
+
+  /* The index depends on the theme, the inheritance chain and the
+   * search path, all of which show up in the directory list.
+   */
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  for (i = 0; i < n_directories; i++)
+    g_checksum_update (checksum, (const guchar *)directories[i],
+		       strlen (directories[i]) + 1);
+
+  filename = g_build_filename (g_get_user_cache_dir (),
+			       "gtk-2.0", "icon-index",
+			       g_checksum_get_string (checksum), NULL);
+  g_checksum_free (checksum);
+
+  return filename;
+}
+
+static GtkIconIndex *
+icon_index_new (gchar *buffer,
+		gsize  size)
+{
+  GtkIconIndex *index;
+  guint32 n_dirs, dir_list_offset, n_icons, icon_list_offset;
+
+  if (size < HEADER_SIZE || buffer[size - 1] != '\0')
+    return NULL;
+
+  if (GET_UINT16 (buffer, 0) != MAJOR_VERSION)
+    return NULL;
+
+  n_dirs = GET_UINT32 (buffer, 4);
+  dir_list_offset = GET_UINT32 (buffer, 8);
+  n_icons = GET_UINT32 (buffer, 12);
+  icon_list_offset = GET_UINT32 (buffer, 16);
+
+  if (dir_list_offset > size ||
+      n_dirs > (size - dir_list_offset) / DIR_ENTRY_SIZE ||
+      icon_list_offset > size ||
+      n_icons > (size - icon_list_offset) / ICON_ENTRY_SIZE)
+    return NULL;
+
+  index = g_new0 (GtkIconIndex, 1);
+  index->ref_count = 1;
+  index->buffer = buffer;
+  index->size = size;
+  index->n_dirs = n_dirs;
+  index->dir_list_offset = dir_list_offset;
+  index->n_icons = n_icons;
+  index->icon_list_offset = icon_list_offset;
+
+  return index;
+}
+
+/* Offsets are checked on access rather than at load time, so that
+ * loading stays independent of the size of the index. Since the
+ * buffer ends with a nul byte, any offset inside it is a valid string.
+ */
+static const gchar *
+icon_index_get_string (GtkIconIndex *index,
+		       guint32       offset)
+{
+  if (offset >= index->size)
+    return "";
+
+  return index->buffer + offset;
+}
+
+GtkIconIndex *
+_gtk_icon_index_new_for_file (const gchar *filename)
+{
+  GtkIconIndex *index;
+  GMappedFile *map;
+
+  map = g_mapped_file_new (filename, FALSE, NULL);
+  if (!map)
+    return NULL;
+
+  index = icon_index_new (g_mapped_file_get_contents (map),
+			  g_mapped_file_get_length (map));
+  if (!index)
+    {
+      GTK_NOTE (ICONTHEME, g_print ("icon index %s is invalid\n", filename));
+      g_mapped_file_unref (map);
+      return NULL;
+    }
+
+  GTK_NOTE (ICONTHEME, g_print ("mapped icon index %s\n", filename));
+  index->map = map;
+
+  return index;
+}
+
+gint
+_gtk_icon_index_get_directory_index (GtkIconIndex *index,
+				     const gchar  *directory,
+				     gint64       *mtime)
+{
+  guint32 offset;
+  gint i;
+
+  if (!index->dir_indices)
+    {
+      index->dir_indices = g_hash_table_new (g_str_hash, g_str_equal);
+
+      for (i = 0; i < index->n_dirs; i++)
+	{
+	  offset = index->dir_list_offset + DIR_ENTRY_SIZE * i;
+	  g_hash_table_insert (index->dir_indices,
+			       (gpointer) icon_index_get_string (index, GET_UINT32 (index->buffer, offset)),
+			       GINT_TO_POINTER (i + 1));
+	}
+    }
+
+  i = GPOINTER_TO_INT (g_hash_table_lookup (index->dir_indices, directory)) - 1;
+
+  if (i >= 0 && mtime)
+    {
+      offset = index->dir_list_offset + DIR_ENTRY_SIZE * i;
+      *mtime = ((gint64) GET_UINT32 (index->buffer, offset + 4) << 32) |
+	GET_UINT32 (index->buffer, offset + 8);
+    }
+
+  return i;
+}
+
+static gint
+icon_index_compare (GtkIconIndex *index,
+		    guint32       entry,
+		    const gchar  *icon_name,
+		    gint          directory_index)
+{
+  guint32 offset = index->icon_list_offset + ICON_ENTRY_SIZE * entry;
+  gint result;
+
+  result = strcmp (icon_index_get_string (index, GET_UINT32 (index->buffer, offset)),
+		   icon_name);
+  if (result == 0)
+    result = (gint) GET_UINT16 (index->buffer, offset + 4) - directory_index;
+
+  return result;
+}
+
+guint
+_gtk_icon_index_get_icon_flags (GtkIconIndex *index,
+				const gchar  *icon_name,
+				gint          directory_index)
+{
+  guint32 lo, hi, mid;
+  gint result;
+
+  lo = 0;
+  hi = index->n_icons;
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      result = icon_index_compare (index, mid, icon_name, directory_index);
+
+      if (result == 0)
+	return GET_UINT16 (index->buffer,
+			   index->icon_list_offset + ICON_ENTRY_SIZE * mid + 6);
+      else if (result < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return 0;
+}
+
+/* Adds the names of the icons in the given directory, or in all
+ * directories if directory_index is -1, to hash_table. The names are
+ * owned by the index.
+ */
+void
+_gtk_icon_index_add_icons (GtkIconIndex *index,
+			   gint          directory_index,
+			   GHashTable   *hash_table)
+{
+  guint32 i, offset;
+
+  for (i = 0; i < index->n_icons; i++)
+    {
+      offset = index->icon_list_offset + ICON_ENTRY_SIZE * i;
+
+      if (directory_index == -1 ||
+	  GET_UINT16 (index->buffer, offset + 4) == directory_index)
+	g_hash_table_insert (hash_table,
+			     (gpointer) icon_index_get_string (index, GET_UINT32 (index->buffer, offset)),
+			     NULL);
+    }
+}
+
+/* Building */
+
+typedef struct
+{
+  const gchar *name;
+  guint16 dir;
+  guint16 flags;
+} IndexEntry;
+
+/* Returns a hash table of icon name => flags for one directory */
+static GHashTable *
+scan_directory (const gchar           *directory,
+		GtkIconIndexFlagsFunc  flags_func)
+{
+  GHashTable *icons;
+  GDir *gdir;
+  const gchar *name;
+  const gchar *dot;
+  gchar *base_name;
+  guint flags;
+
+  icons = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  gdir = g_dir_open (directory, 0, NULL);
+  if (gdir == NULL)
+    return icons;
+
+  while ((name = g_dir_read_name (gdir)))
+    {
+      flags = flags_func (name);
+      if (flags == 0)
+	continue;
+
+      dot = strrchr (name, '.');
+      base_name = dot ? g_strndup (name, dot - name) : g_strdup (name);
+
+      flags |= GPOINTER_TO_UINT (g_hash_table_lookup (icons, base_name));
+      g_hash_table_replace (icons, base_name, GUINT_TO_POINTER (flags));
+    }
+
+  g_dir_close (gdir);
+
+  return icons;
+}
+
+static gint
+index_entry_compare (gconstpointer a,
+		     gconstpointer b)
+{
+  const IndexEntry *ea = a;
+  const IndexEntry *eb = b;
+  gint result;
+
+  result = strcmp (ea->name, eb->name);
+  if (result == 0)
+    result = (gint) ea->dir - (gint) eb->dir;
+
+  return result;
+}
+
+static void
+append_uint16 (GString *buffer,
+	       guint16  value)
+{
+  value = GUINT16_TO_BE (value);
+  g_string_append_len (buffer, (const gchar *)&value, 2);
+}
+
+static void
+append_uint32 (GString *buffer,
+	       guint32  value)
+{
+  value = GUINT32_TO_BE (value);
+  g_string_append_len (buffer, (const gchar *)&value, 4);
+}
+
+/* Appends name to the string table unless it is there already, and
+ * returns its offset.
+ */
+static guint32
+append_string (GString     *strings,
+	       GHashTable  *offsets,
+	       gsize        base,
+	       const gchar *name)
+{
+  gpointer value;
+
+  if (g_hash_table_lookup_extended (offsets, name, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  value = GUINT_TO_POINTER (base + strings->len);
+  g_string_append_len (strings, name, strlen (name) + 1);
+  g_hash_table_insert (offsets, (gpointer) name, value);
+
+  return GPOINTER_TO_UINT (value);
+}
+
+static GtkIconIndex *
+index_new_from_scans (const gchar * const *directories,
+		      const gint64        *mtimes,
+		      gint                 n_directories,
+		      GHashTable         **scans,
+		      guint                image_flags)
+{
+  GArray *entries;
+  GHashTableIter iter;
+  gpointer key, value;
+  GString *buffer, *strings;
+  GHashTable *offsets;
+  IndexEntry *entry;
+  gsize strings_offset;
+  gsize size;
+  guint i;
+
+  /* Directory indices are 16 bits */
+  if (n_directories > G_MAXUINT16)
+    return NULL;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  for (i = 0; i < n_directories; i++)
+    {
+      g_hash_table_iter_init (&iter, scans[i]);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+	  IndexEntry e;
+
+	  /* Skip names that only have e.g. an .icon file */
+	  if ((GPOINTER_TO_UINT (value) & image_flags) == 0)
+	    continue;
+
+	  e.name = key;
+	  e.dir = i;
+	  e.flags = GPOINTER_TO_UINT (value);
+	  g_array_append_val (entries, e);
+	}
+    }
+  g_array_sort (entries, index_entry_compare);
+
+  strings_offset = HEADER_SIZE + DIR_ENTRY_SIZE * n_directories +
+    ICON_ENTRY_SIZE * entries->len;
+
+  buffer = g_string_sized_new (strings_offset);
+  strings = g_string_new (NULL);
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+
+  append_uint16 (buffer, MAJOR_VERSION);
+  append_uint16 (buffer, MINOR_VERSION);
+  append_uint32 (buffer, n_directories);
+  append_uint32 (buffer, HEADER_SIZE);
+  append_uint32 (buffer, entries->len);
+  append_uint32 (buffer, HEADER_SIZE + DIR_ENTRY_SIZE * n_directories);
+
+  for (i = 0; i < n_directories; i++)
+    {
+      append_uint32 (buffer, append_string (strings, offsets, strings_offset,
+					    directories[i]));
+      append_uint32 (buffer, (guint64) mtimes[i] >> 32);
+      append_uint32 (buffer, (guint64) mtimes[i] & 0xffffffff);
+    }
+
+  for (i = 0; i < entries->len; i++)
+    {
+      entry = &g_array_index (entries, IndexEntry, i);
+      append_uint32 (buffer, append_string (strings, offsets, strings_offset,
+					    entry->name));
+      append_uint16 (buffer, entry->dir);
+      append_uint16 (buffer, entry->flags);
+    }
+
+  g_assert (buffer->len == strings_offset);
+  g_string_append_len (buffer, strings->str, strings->len);
+  /* Makes every offset into the buffer a valid string */
+  g_string_append_c (buffer, '\0');
+
+  g_hash_table_destroy (offsets);
+  g_string_free (strings, TRUE);
+  g_array_free (entries, TRUE);
+
+  /* The offsets are only 32 bits */
+  if (buffer->len > G_MAXUINT32)
+    {
+      g_string_free (buffer, TRUE);
+      return NULL;
+    }
+
+  size = buffer->len;
+  return icon_index_new (g_string_free (buffer, FALSE), size);
+}
+
+/* Returns %TRUE if the index in @filename is invalid, or if any of
+ * its directories changed since it was written, so that whoever uses
+ * it would rebuild it anyway.
+ */
+static gboolean
+icon_index_file_is_stale (const gchar *filename)
+{
+  GtkIconIndex *index;
+  struct stat stat_buf;
+  gboolean stale = FALSE;
+  guint32 offset, i;
+  gint64 mtime;
+
+  index = _gtk_icon_index_new_for_file (filename);
+  if (!index)
+    return TRUE;
+
+  for (i = 0; i < index->n_dirs && !stale; i++)
+    {
+      offset = index->dir_list_offset + DIR_ENTRY_SIZE * i;
+      mtime = ((gint64) GET_UINT32 (index->buffer, offset + 4) << 32) |
+	GET_UINT32 (index->buffer, offset + 8);
+
+      /* Same as the mtimes GtkIconTheme passes in */
+      if (g_stat (icon_index_get_string (index, GET_UINT32 (index->buffer, offset)),
+		  &stat_buf) != 0 || !S_ISDIR (stat_buf.st_mode))
+	stale = mtime != 0;
+      else
+	stale = mtime != (gint64) stat_buf.st_mtime;
+    }
+
+  _gtk_icon_index_unref (index);
+
+  return stale;
+}
+
+/* Removes the indexes in @dir other than @filename that are out of
+ * date. Indexes are named after their directory list, so every change
+ * of theme or search path leaves one behind.
+ */
+static void
+icon_index_prune (const gchar *dir,
+		  const gchar *filename)
+{
+  GDir *gdir;
+  const gchar *name;
+  gchar *path;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (!gdir)
+    return;
+
+  while ((name = g_dir_read_name (gdir)))
+    {
+      /* Skips the temporary files of indexes that are being written */
+      if (strchr (name, '.'))
+	continue;
+
+      path = g_build_filename (dir, name, NULL);
+      if (strcmp (path, filename) != 0 && icon_index_file_is_stale (path))
+	{
+	  GTK_NOTE (ICONTHEME, g_print ("removing stale icon index %s\n", path));
+	  g_unlink (path);
+	}
+      g_free (path);
+    }
+
+  g_dir_close (gdir);
+}
+
+static gboolean
+icon_index_write (GtkIconIndex *index,
+		  const gchar  *filename)
+{
+  GError *error = NULL;
+  gchar *dir;
+
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0700);
+
+  /* Written atomically, as other processes may be mapping it */
+  if (!g_file_set_contents (filename, index->buffer, index->size, &error))
+    {
+      GTK_NOTE (ICONTHEME,
+		g_print ("could not write icon index: %s\n", error->message));
+      g_error_free (error);
+      g_free (dir);
+      return FALSE;
+    }
+
+  icon_index_prune (dir, filename);
+  g_free (dir);
+
+  return TRUE;
+}
+
+GtkIconIndex *
+_gtk_icon_index_build (const gchar * const   *directories,
+		       const gint64          *mtimes,
+		       gint                   n_directories,
+		       GtkIconIndexFlagsFunc  flags_func,
+		       guint                  image_flags,
+		       const gchar           *filename,
+		       gboolean              *written)
+{
+  GHashTable **scans;
+  GtkIconIndex *index;
+  gint i;
+
+  scans = g_new (GHashTable *, n_directories);
+  for (i = 0; i < n_directories; i++)
+    {
+      GTK_NOTE (ICONTHEME, g_print ("scanning directory %s\n", directories[i]));
+      scans[i] = scan_directory (directories[i], flags_func);
+    }
+
+  index = index_new_from_scans (directories, mtimes, n_directories,
+				scans, image_flags);
+
+  for (i = 0; i < n_directories; i++)
+    g_hash_table_destroy (scans[i]);
+  g_free (scans);
+
+  *written = index && filename && icon_index_write (index, filename);
+
+  return index;
+}
+
+typedef struct
+{
+  gchar **directories;
+  gint64 *mtimes;
+  gint n_directories;
+  GtkIconIndexFlagsFunc flags_func;
+  guint image_flags;
+  gchar *filename;
+
+  GHashTable **scans;
+  volatile gint n_pending;
+  GThreadPool *pool;
+  GtkIconIndex *index;
+  gboolean written;
+
+  GtkIconIndexReadyFunc callback;
+  gpointer user_data;
+} BuildJob;
+
+static gboolean
+build_job_finish (gpointer data)
+{
+  BuildJob *job = data;
+  gint i;
+
+  g_thread_pool_free (job->pool, FALSE, TRUE);
+
+  job->callback (job->index, job->written, job->user_data);
+
+  if (job->index)
+    _gtk_icon_index_unref (job->index);
+
+  for (i = 0; i < job->n_directories; i++)
+    g_hash_table_destroy (job->scans[i]);
+  g_free (job->scans);
+  g_strfreev (job->directories);
+  g_free (job->mtimes);
+  g_free (job->filename);
+  g_slice_free (BuildJob, job);
+
+  return FALSE;
+}
+
+/* Runs in a worker thread. The last directory to finish builds and
+ * writes the index.
+ */
+static void
+build_job_scan (gpointer data,
+		gpointer user_data)
+{
+  BuildJob *job = user_data;
+  gint i = GPOINTER_TO_INT (data) - 1;
+
+  job->scans[i] = scan_directory (job->directories[i], job->flags_func);
+
+  if (g_atomic_int_dec_and_test (&job->n_pending))
+    {
+      job->index = index_new_from_scans ((const gchar * const *)job->directories,
+					 job->mtimes, job->n_directories,
+					 job->scans, job->image_flags);
+      if (job->index)
+	job->written = icon_index_write (job->index, job->filename);
+
+      gdk_threads_add_idle (build_job_finish, job);
+    }
+}
+
+/* Scans the directories in worker threads and calls callback from the
+ * main loop once the index has been written, with the new index or
+ * %NULL on failure, and whether it could be written to filename.
+ * Requires threads to be initialized.
+ */
+void
+_gtk_icon_index_build_async (const gchar * const   *directories,
+			     const gint64          *mtimes,
+			     gint                   n_directories,
+			     GtkIconIndexFlagsFunc  flags_func,
+			     guint                  image_flags,
+			     const gchar           *filename,
+			     GtkIconIndexReadyFunc  callback,
+			     gpointer               user_data)
+{
+  BuildJob *job;
+  gint i;
+
+  g_return_if_fail (n_directories > 0);
+
+  job = g_slice_new0 (BuildJob);
+  job->directories = g_new (gchar *, n_directories + 1);
+  for (i = 0; i < n_directories; i++)
+    job->directories[i] = g_strdup (directories[i]);
+  job->directories[n_directories] = NULL;
+  job->mtimes = g_memdup (mtimes, sizeof (gint64) * n_directories);
+  job->n_directories = n_directories;
+  job->flags_func = flags_func;
+  job->image_flags = image_flags;
+  job->filename = g_strdup (filename);
+  job->scans = g_new0 (GHashTable *, n_directories);
+  job->n_pending = n_directories;
+  job->callback = callback;
+  job->user_data = user_data;
+
+  GTK_NOTE (ICONTHEME,
+	    g_print ("scanning %d directories for %s in the background\n",
+		     n_directories, filename));
+
+  job->pool = g_thread_pool_new (build_job_scan, job,
+				 MIN (n_directories, MAX_SCAN_THREADS),
+				 FALSE, NULL);
+
+  for (i = 0; i < n_directories; i++)
+    g_thread_pool_push (job->pool, GINT_TO_POINTER (i + 1), NULL);
+}
@@ -0,0 +1,101 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_ICON_INDEX_H__
+#define __GTK_ICON_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A per-user index of the icons in the icon theme directories that
+ * have no icon-theme.cache. Unlike an icon-theme.cache, which covers
+ * one theme directory, an index covers all directories a GtkIconTheme
+ * has to scan, across the whole inheritance chain and search path. It
+ * is stored under the user cache directory and mapped when loaded.
+ *
+ * All numbers are big-endian:
+ *
+ * Header:
+ *   2  major version (1)
+ *   2  minor version (0)
+ *   4  number of directories
+ *   4  offset of the directory list
+ *   4  number of icons
+ *   4  offset of the icon list
+ *
+ * Directory list entry, 12 bytes:
+ *   4  offset of the directory path
+ *   8  mtime of the directory when it was scanned
+ *
+ * Icon list entry, 8 bytes, sorted by name (strcmp()) and then by
+ * directory, so that lookups are a binary search:
+ *   4  offset of the icon name
+ *   2  directory index
+ *   2  flags, as returned by the GtkIconIndexFlagsFunc
+ *
+ * Strings are nul-terminated and the file ends with a nul byte.
+ */
+
+typedef struct _GtkIconIndex GtkIconIndex;
+
+/* Returns the flags for a file in an icon directory, or 0 to ignore
+ * the file. Called from worker threads.
+ */
+typedef guint (* GtkIconIndexFlagsFunc) (const gchar *filename);
+
+typedef void  (* GtkIconIndexReadyFunc) (GtkIconIndex *index,
+					 gboolean      written,
+					 gpointer      user_data);
+
+gchar        *_gtk_icon_index_get_filename        (const gchar * const   *directories,
+						   gint                   n_directories);
+GtkIconIndex *_gtk_icon_index_new_for_file        (const gchar           *filename);
+GtkIconIndex *_gtk_icon_index_build               (const gchar * const   *directories,
+						   const gint64          *mtimes,
+						   gint                   n_directories,
+						   GtkIconIndexFlagsFunc  flags_func,
+						   guint                  image_flags,
+						   const gchar           *filename,
+						   gboolean              *written);
+void          _gtk_icon_index_build_async         (const gchar * const   *directories,
+						   const gint64          *mtimes,
+						   gint                   n_directories,
+						   GtkIconIndexFlagsFunc  flags_func,
+						   guint                  image_flags,
+						   const gchar           *filename,
+						   GtkIconIndexReadyFunc  callback,
+						   gpointer               user_data);
+
+gint          _gtk_icon_index_get_directory_index (GtkIconIndex          *index,
+						   const gchar           *directory,
+						   gint64                *mtime);
+guint         _gtk_icon_index_get_icon_flags      (GtkIconIndex          *index,
+						   const gchar           *icon_name,
+						   gint                   directory_index);
+void          _gtk_icon_index_add_icons           (GtkIconIndex          *index,
+						   gint                   directory_index,
+						   GHashTable            *hash_table);
+
+GtkIconIndex *_gtk_icon_index_ref                 (GtkIconIndex          *index);
+void          _gtk_icon_index_unref               (GtkIconIndex          *index);
+
+G_END_DECLS
+
+#endif /* __GTK_ICON_INDEX_H__ */
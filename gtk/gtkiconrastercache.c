@@ -0,0 +1,390 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include "gtkdebug.h"
+#include "gtkiconrastercache.h"
+#include "gtkalias.h"
+
+#define MAJOR_VERSION 1
+#define MINOR_VERSION 0
+
+#define HEADER_SIZE 32
+
+#define FLAG_HAS_ALPHA 1
+
+/* Larger icons are rarely shown often enough to be worth the disk space */
+#define MAX_CACHED_PIXELS (256 * 256)
+
+/* When the entries add up to more than this, the least recently used
+ * ones are removed until they take up less than PRUNED_CACHE_SIZE.
+ */
+#define MAX_CACHE_SIZE (16 * 1024 * 1024)
+#define PRUNED_CACHE_SIZE (MAX_CACHE_SIZE / 4 * 3)
+
+#define GET_UINT16(buf, offset) (GUINT16_FROM_BE (*(guint16 *)((buf) + (offset))))
+#define GET_UINT32(buf, offset) (GUINT32_FROM_BE (*(guint32 *)((buf) + (offset))))
+
+#define ALIGN4(n) (((n) + 3) & ~3)
+
+typedef struct
+{
+  gchar  *filename;
+  time_t  atime;
+  goffset size;
+} CacheEntry;
+
+/* Size of the cache as of the last prune_cache(), plus the entries
+ * stored since; -1 until this process first stores an entry.
+ */
+static gint64 cache_size = -1;
+
+static gchar *
+get_entry_filename (const gchar *key)
+{
+  gchar *checksum;
+  gchar *filename;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+  filename = g_build_filename (g_get_user_cache_dir (),
+			       "gtk-2.0", "icon-pixels", checksum, NULL);
+  g_free (checksum);
+
+  return filename;
+}
+
+static gsize
+pixel_data_size (gint width,
+		 gint height,
+		 gint rowstride,
+		 gint n_channels)
+{
+  /* The last row of a GdkPixbuf does not need to be padded */
+  return (gsize) rowstride * (height - 1) + (gsize) width * n_channels;
+}
+
+static void
+unmap_pixels (guchar   *pixels,
+	      gpointer  data)
+{
+  g_mapped_file_unref (data);
+}
+
+/* Returns the cached pixbuf for key, or %NULL. The pixbuf wraps the
+ * mapped file.
+ */
+GdkPixbuf *
+_gtk_icon_raster_cache_lookup (const gchar *key,
+			       gdouble     *scale)
+{
+  GMappedFile *map;
+  gchar *filename;
+  const gchar *buffer;
+  gsize size, key_len, pixels_offset;
+  gint width, height, rowstride, n_channels;
+  gboolean has_alpha;
+  union { guint64 i; gdouble d; } scale_bits;
+
+  filename = get_entry_filename (key);
+
+  /* Mapped privately writable, so that a caller that modifies the
+   * pixbuf despite being told not to gets a copy of the page instead
+   * of a crash.
+   */
+  map = g_mapped_file_new (filename, TRUE, NULL);
+  g_free (filename);
+
+  if (!map)
+    return NULL;
+
+  buffer = g_mapped_file_get_contents (map);
+  size = g_mapped_file_get_length (map);
+
+  if (size < HEADER_SIZE || GET_UINT16 (buffer, 0) != MAJOR_VERSION)
+    goto invalid;
+
+  width = GET_UINT32 (buffer, 4);
+  height = GET_UINT32 (buffer, 8);
+  rowstride = GET_UINT32 (buffer, 12);
+  has_alpha = (GET_UINT32 (buffer, 16) & FLAG_HAS_ALPHA) != 0;
+  n_channels = has_alpha ? 4 : 3;
+  key_len = GET_UINT32 (buffer, 28);
+
+  if (width <= 0 || height <= 0 ||
+      width > G_MAXINT / n_channels || rowstride < width * n_channels ||
+      (gsize) width * height > MAX_CACHED_PIXELS ||
+      key_len > size - HEADER_SIZE)
+    goto invalid;
+
+  pixels_offset = HEADER_SIZE + ALIGN4 (key_len);
+  if (pixels_offset > size ||
+      size - pixels_offset < pixel_data_size (width, height, rowstride, n_channels))
+    goto invalid;
+
+  /* Guards against checksum collisions */
+  if (strlen (key) != key_len ||
+      memcmp (buffer + HEADER_SIZE, key, key_len) != 0)
+    goto invalid;
+
+  scale_bits.i = ((guint64) GET_UINT32 (buffer, 20) << 32) | GET_UINT32 (buffer, 24);
+  *scale = scale_bits.d;
+
+  GTK_NOTE (ICONTHEME, g_print ("found cached pixels for %s\n", key));
+
+  return gdk_pixbuf_new_from_data ((const guchar *) buffer + pixels_offset,
+				   GDK_COLORSPACE_RGB, has_alpha, 8,
+				   width, height, rowstride,
+				   unmap_pixels, map);
+
+ invalid:
+  g_mapped_file_unref (map);
+  return NULL;
+}
+
+/* Returns %TRUE if the entry in @filename can't be used anymore,
+ * because it is invalid, or because the source file at the start of
+ * its key has been removed or changed.
+ */
+static gboolean
+entry_is_stale (const gchar *filename)
+{
+  GMappedFile *map;
+  const gchar *buffer;
+  gsize size, key_len;
+  gchar *key, *p, *end;
+  gint64 mtime, source_size;
+  struct stat stat_buf;
+  gboolean stale = TRUE;
+
+  map = g_mapped_file_new (filename, FALSE, NULL);
+  if (!map)
+    return TRUE;
+
+  buffer = g_mapped_file_get_contents (map);
+  size = g_mapped_file_get_length (map);
+
+  if (size < HEADER_SIZE || GET_UINT16 (buffer, 0) != MAJOR_VERSION)
+    goto out;
+
+  key_len = GET_UINT32 (buffer, 28);
+  if (key_len > size - HEADER_SIZE)
+    goto out;
+
+  key = g_strndup (buffer + HEADER_SIZE, key_len);
+  p = strchr (key, '\n');
+  if (p)
+    {
+      *p++ = '\0';
+      mtime = g_ascii_strtoll (p, &end, 10);
+      if (*end == '\n')
+	{
+	  source_size = g_ascii_strtoll (end + 1, &end, 10);
+	  if (*end == '\n' &&
+	      g_stat (key, &stat_buf) == 0 &&
+	      (gint64) stat_buf.st_mtime == mtime &&
+	      (gint64) stat_buf.st_size == source_size)
+	    stale = FALSE;
+	}
+    }
+  g_free (key);
+
+ out:
+  g_mapped_file_unref (map);
+
+  return stale;
+}
+
+static gint
+compare_entry_age (gconstpointer a,
+		   gconstpointer b)
+{
+  const CacheEntry *entry_a = a;
+  const CacheEntry *entry_b = b;
+
+  if (entry_a->atime < entry_b->atime)
+    return -1;
+  if (entry_a->atime > entry_b->atime)
+    return 1;
+  return 0;
+}
+
+/* Removes the stale entries in @dir, and if the rest is still too
+ * large, the ones that were used least recently, going by their
+ * access time, or their modification time where the file system
+ * does not update the former.
+ */
+static void
+prune_cache (const gchar *dir)
+{
+  GDir *gdir;
+  GArray *entries;
+  const gchar *name;
+  struct stat stat_buf;
+  guint i;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (!gdir)
+    return;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+  cache_size = 0;
+
+  while ((name = g_dir_read_name (gdir)))
+    {
+      CacheEntry entry;
+
+      /* Skips the temporary files of entries that are being written */
+      if (strchr (name, '.'))
+	continue;
+
+      entry.filename = g_build_filename (dir, name, NULL);
+
+      if (g_stat (entry.filename, &stat_buf) != 0 || !S_ISREG (stat_buf.st_mode))
+	{
+	  g_free (entry.filename);
+	  continue;
+	}
+
+      if (entry_is_stale (entry.filename))
+	{
+	  GTK_NOTE (ICONTHEME, g_print ("removing stale cached pixels %s\n", name));
+	  g_unlink (entry.filename);
+	  g_free (entry.filename);
+	  continue;
+	}
+
+      entry.atime = MAX (stat_buf.st_atime, stat_buf.st_mtime);
+      entry.size = stat_buf.st_size;
+      cache_size += entry.size;
+      g_array_append_val (entries, entry);
+    }
+
+  g_dir_close (gdir);
+
+  if (cache_size > MAX_CACHE_SIZE)
+    {
+      g_array_sort (entries, compare_entry_age);
+
+      for (i = 0; i < entries->len && cache_size > PRUNED_CACHE_SIZE; i++)
+	{
+	  CacheEntry *entry = &g_array_index (entries, CacheEntry, i);
+
+	  if (g_unlink (entry->filename) == 0)
+	    cache_size -= entry->size;
+	}
+    }
+
+  for (i = 0; i < entries->len; i++)
+    g_free (g_array_index (entries, CacheEntry, i).filename);
+  g_array_free (entries, TRUE);
+}
+
+static void
+append_uint16 (GString *buffer,
+	       guint16  value)
+{
+  value = GUINT16_TO_BE (value);
+  g_string_append_len (buffer, (const gchar *)&value, 2);
+}
+
+static void
+append_uint32 (GString *buffer,
+	       guint32  value)
+{
+  value = GUINT32_TO_BE (value);
+  g_string_append_len (buffer, (const gchar *)&value, 4);
+}
+
+void
+_gtk_icon_raster_cache_store (const gchar *key,
+			      GdkPixbuf   *pixbuf,
+			      gdouble      scale)
+{
+  gint width, height, rowstride, n_channels;
+  union { guint64 i; gdouble d; } scale_bits;
+  gchar *filename, *dir;
+  GString *buffer;
+  gsize key_len;
+  GError *error = NULL;
+
+  if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB ||
+      gdk_pixbuf_get_bits_per_sample (pixbuf) != 8)
+    return;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+  if ((gsize) width * height > MAX_CACHED_PIXELS)
+    return;
+
+  key_len = strlen (key);
+  scale_bits.d = scale;
+
+  buffer = g_string_sized_new (HEADER_SIZE + ALIGN4 (key_len) +
+			       pixel_data_size (width, height, rowstride, n_channels));
+  append_uint16 (buffer, MAJOR_VERSION);
+  append_uint16 (buffer, MINOR_VERSION);
+  append_uint32 (buffer, width);
+  append_uint32 (buffer, height);
+  append_uint32 (buffer, rowstride);
+  append_uint32 (buffer, gdk_pixbuf_get_has_alpha (pixbuf) ? FLAG_HAS_ALPHA : 0);
+  append_uint32 (buffer, scale_bits.i >> 32);
+  append_uint32 (buffer, scale_bits.i & 0xffffffff);
+  append_uint32 (buffer, key_len);
+  g_string_append_len (buffer, key, key_len);
+  while (buffer->len % 4 != 0)
+    g_string_append_c (buffer, '\0');
+  g_string_append_len (buffer, (const gchar *) gdk_pixbuf_get_pixels (pixbuf),
+		       pixel_data_size (width, height, rowstride, n_channels));
+
+  filename = get_entry_filename (key);
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0700);
+
+  /* Entries for icons that changed are never used again, so the
+   * cache is checked for them the first time each process stores an
+   * entry, as well as whenever it gets too large.
+   */
+  if (cache_size < 0 || cache_size > MAX_CACHE_SIZE)
+    prune_cache (dir);
+
+  /* Written to a temporary file and renamed, so that other processes
+   * never map a partial entry, and existing mappings stay valid.
+   */
+  if (!g_file_set_contents (filename, buffer->str, buffer->len, &error))
+    {
+      GTK_NOTE (ICONTHEME,
+		g_print ("could not cache pixels for %s: %s\n", key, error->message));
+      g_error_free (error);
+    }
+  else
+    cache_size += buffer->len;
+
+  g_free (dir);
+  g_free (filename);
+  g_string_free (buffer, TRUE);
+}
@@ -0,0 +1,66 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_ICON_RASTER_CACHE_H__
+#define __GTK_ICON_RASTER_CACHE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/* A per-user on-disk cache of decoded and scaled icons, shared between
+ * processes. Each entry is a file under
+ * $XDG_CACHE_HOME/gtk-2.0/icon-pixels/ named after a checksum of its
+ * key, and is mapped when loaded, so that processes showing the same
+ * icons share the pages. Entries are written atomically by the first
+ * process that renders the icon.
+ *
+ * The key is a string that must change whenever the rendered pixels
+ * would. It starts with the path of the source file, its mtime and its
+ * size, each followed by a newline; entries whose source file changed
+ * are removed when the cache is pruned. GtkIconTheme adds the
+ * parameters that determine the scale.
+ *
+ * The cache is pruned the first time a process stores an entry, and
+ * whenever the entries add up to more than 16 MB, in which case the
+ * least recently used ones are removed as well.
+ *
+ * All numbers are big-endian:
+ *
+ *   2  major version (1)
+ *   2  minor version (0)
+ *   4  width
+ *   4  height
+ *   4  rowstride
+ *   4  flags (1: has alpha)
+ *   8  scale that was applied to the source, as IEEE 754 double
+ *   4  length of the key
+ *   key, padded with nul bytes to a multiple of 4
+ *   pixels, in the layout of a GdkPixbuf with the above parameters
+ */
+
+GdkPixbuf *_gtk_icon_raster_cache_lookup (const gchar *key,
+					  gdouble     *scale);
+void       _gtk_icon_raster_cache_store  (const gchar *key,
+					  GdkPixbuf   *pixbuf,
+					  gdouble      scale);
+
+G_END_DECLS
+
+#endif /* __GTK_ICON_RASTER_CACHE_H__ */
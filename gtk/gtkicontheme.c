@@ -41,6 +41,8 @@
 #include "gtkicontheme.h"
 #include "gtkiconfactory.h"
 #include "gtkiconcache.h"
+#include "gtkiconindex.h"
+#include "gtkiconrastercache.h"
 #include "gtkbuiltincache.h"
 #include "gtkintl.h"
 #include "gtkmain.h"
@@ -105,6 +107,17 @@ struct _GtkIconThemePrivate
   long last_stat_time;
   GList *dir_mtimes;
 
+  /* Incremented whenever the themes are reloaded, so that a
+   * background index build can tell whether it is still current
+   */
+  guint index_serial;
+
+  /* The last icon index that was built but could not be written,
+   * used instead of rebuilding it until the directories change
+   */
+  GtkIconIndex *unwritten_index;
+  gchar *unwritten_index_filename;
+
   gulong reset_styles_idle;
 };
 
@@ -178,8 +191,14 @@ typedef struct
   
   GtkIconCache *cache;
   
-  GHashTable *icons;
   GHashTable *icon_data;
+
+  /* For directories without a cache: the per-user icon index, or
+   * NULL until the index is built
+   */
+  GtkIconIndex *index;
+  gint index_dir;
+  gint64 mtime;
 } IconThemeDir;
 
 typedef struct
@@ -226,6 +245,7 @@ static void     blow_themes               (GtkIconTheme    *icon_themes);
 static gboolean rescan_themes             (GtkIconTheme    *icon_themes);
 
 static void  icon_data_free            (GtkIconData     *icon_data);
+static void load_icon_index            (GtkIconTheme    *icon_theme);
 static void load_icon_data             (IconThemeDir    *dir,
 			                const char      *path,
 			                const char      *name);
@@ -662,6 +682,7 @@ blow_themes (GtkIconTheme *icon_theme)
   priv->dir_mtimes = NULL;
   priv->all_icons = NULL;
   priv->themes_valid = FALSE;
+  priv->index_serial++;
 }
 
 static void
@@ -693,6 +714,10 @@ gtk_icon_theme_finalize (GObject *object)
 
   blow_themes (icon_theme);
 
+  if (priv->unwritten_index)
+    _gtk_icon_index_unref (priv->unwritten_index);
+  g_free (priv->unwritten_index_filename);
+
   G_OBJECT_CLASS (gtk_icon_theme_parent_class)->finalize (object);  
 }
 
@@ -1066,6 +1091,8 @@ load_themes (GtkIconTheme *icon_theme)
   insert_theme (icon_theme, DEFAULT_THEME_NAME);
   priv->themes = g_list_reverse (priv->themes);
 
+  load_icon_index (icon_theme);
+
 
   priv->unthemed_icons = g_hash_table_new_full (g_str_hash, g_str_equal,
 						g_free, (GDestroyNotify)free_unthemed_icon);
@@ -1186,11 +1213,11 @@ _gtk_icon_theme_ensure_builtin_cache (void)
   IconThemeDir *dir;
   static IconThemeDir dirs[5] = 
     {
-      { ICON_THEME_DIR_THRESHOLD, 0, 16, 16, 16, 2, NULL, "16", -1, NULL, NULL, NULL },
-      { ICON_THEME_DIR_THRESHOLD, 0, 20, 20, 20, 2, NULL, "20", -1,  NULL, NULL, NULL },
-      { ICON_THEME_DIR_THRESHOLD, 0, 24, 24, 24, 2, NULL, "24", -1, NULL, NULL, NULL },
-      { ICON_THEME_DIR_THRESHOLD, 0, 32, 32, 32, 2, NULL, "32", -1, NULL, NULL, NULL },
-      { ICON_THEME_DIR_THRESHOLD, 0, 48, 48, 48, 2, NULL, "48", -1, NULL, NULL, NULL }
+      { ICON_THEME_DIR_THRESHOLD, 0, 16, 16, 16, 2, NULL, "16", -1, NULL, NULL },
+      { ICON_THEME_DIR_THRESHOLD, 0, 20, 20, 20, 2, NULL, "20", -1, NULL, NULL },
+      { ICON_THEME_DIR_THRESHOLD, 0, 24, 24, 24, 2, NULL, "24", -1, NULL, NULL },
+      { ICON_THEME_DIR_THRESHOLD, 0, 32, 32, 32, 2, NULL, "32", -1, NULL, NULL },
+      { ICON_THEME_DIR_THRESHOLD, 0, 48, 48, 48, 2, NULL, "48", -1, NULL, NULL }
     };
   gint i;
 
@@ -1989,9 +2016,9 @@ static void
 theme_dir_destroy (IconThemeDir *dir)
 {
   if (dir->cache)
-      _gtk_icon_cache_unref (dir->cache);
-  else
-    g_hash_table_destroy (dir->icons);
+    _gtk_icon_cache_unref (dir->cache);
+  if (dir->index)
+    _gtk_icon_index_unref (dir->index);
   
   if (dir->icon_data)
     g_hash_table_destroy (dir->icon_data);
@@ -2113,13 +2140,26 @@ theme_dir_get_icon_suffix (IconThemeDir *dir,
       if (has_icon_file)
 	*has_icon_file = suffix & HAS_ICON_FILE;
 
+      suffix = suffix & ~HAS_ICON_FILE;
+    }
+  else if (dir->index)
+    {
+      suffix = (IconSuffix)_gtk_icon_index_get_icon_flags (dir->index,
+							   icon_name,
+							   dir->index_dir);
+
+      if (has_icon_file)
+	*has_icon_file = suffix & HAS_ICON_FILE;
+
       suffix = suffix & ~HAS_ICON_FILE;
     }
   else
-    suffix = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+    suffix = ICON_SUFFIX_NONE;
 
   GTK_NOTE (ICONTHEME, 
-	    g_print ("get_icon_suffix%s %u\n", dir->cache ? " (cached)" : "", suffix));
+	    g_print ("get_icon_suffix%s %u\n",
+		     dir->cache ? " (cached)" : dir->index ? " (indexed)" : "",
+		     suffix));
 
   return suffix;
 }
@@ -2339,12 +2379,13 @@ theme_list_icons (IconTheme  *theme,
 					 icons);
 					 
 	    }
-	  else
+	  else if (dir->index)
 	    {
-	      g_hash_table_foreach (dir->icons,
-				    add_key_to_hash,
-				    icons);
+	      _gtk_icon_index_add_icons (dir->index,
+					 dir->index_dir,
+					 icons);
 	    }
+
 	}
       l = l->next;
     }
@@ -2450,56 +2491,211 @@ load_icon_data (IconThemeDir *dir, const char *path, const char *name)
     }
 }
 
+/* Classifies the files of icon directories for the icon index.
+ * Called from worker threads.
+ */
+static guint
+icon_index_flags_for_file (const gchar *filename)
+{
+  if (g_str_has_suffix (filename, ".icon"))
+    return HAS_ICON_FILE;
+
+  return suffix_from_name (filename);
+}
+
 static void
-scan_directory (GtkIconThemePrivate *icon_theme,
-		IconThemeDir *dir, char *full_dir)
+set_unwritten_index (GtkIconTheme *icon_theme,
+		     GtkIconIndex *index,
+		     const gchar  *filename)
 {
-  GDir *gdir;
-  const char *name;
+  GtkIconThemePrivate *priv = icon_theme->priv;
 
-  GTK_NOTE (ICONTHEME, 
-	    g_print ("scanning directory %s\n", full_dir));
-  dir->icons = g_hash_table_new_full (g_str_hash, g_str_equal,
-				      g_free, NULL);
-  
-  gdir = g_dir_open (full_dir, 0, NULL);
+  if (index)
+    _gtk_icon_index_ref (index);
+  if (priv->unwritten_index)
+    _gtk_icon_index_unref (priv->unwritten_index);
+  priv->unwritten_index = index;
 
-  if (gdir == NULL)
-    return;
+  g_free (priv->unwritten_index_filename);
+  priv->unwritten_index_filename = g_strdup (filename);
+}
 
-  while ((name = g_dir_read_name (gdir)))
+static gboolean
+icon_index_is_up_to_date (GtkIconIndex *index,
+			  GPtrArray    *dirs)
+{
+  IconThemeDir *dir;
+  gint64 mtime;
+  guint i;
+
+  for (i = 0; i < dirs->len; i++)
+    {
+      dir = g_ptr_array_index (dirs, i);
+      if (_gtk_icon_index_get_directory_index (index, dir->dir, &mtime) < 0 ||
+	  mtime != dir->mtime)
+	return FALSE;
+    }
+
+  return TRUE;
+}
+
+typedef struct
+{
+  GtkIconTheme *icon_theme;
+  guint serial;
+  gchar *filename;
+} IconIndexBuild;
+
+static void
+icon_index_ready (GtkIconIndex *index,
+		  gboolean      written,
+		  gpointer      user_data)
+{
+  IconIndexBuild *build = user_data;
+
+  /* If the index could not be written, keep it around, or reloading
+   * would find the old index and start building it all over again.
+   */
+  if (index && !written)
+    set_unwritten_index (build->icon_theme, index, build->filename);
+
+  /* Reload from the new index, unless the themes have been reloaded
+   * in the meantime anyway
+   */
+  if (index && build->serial == build->icon_theme->priv->index_serial)
     {
-      char *path;
-      char *base_name;
-      IconSuffix suffix, hash_suffix;
+      GTK_NOTE (ICONTHEME, g_print ("icon index ready\n"));
+      do_theme_change (build->icon_theme);
+    }
+
+  g_object_unref (build->icon_theme);
+  g_free (build->filename);
+  g_slice_free (IconIndexBuild, build);
+}
+
+/* Looks up the theme directories that have no icon-theme.cache in the
+ * per-user icon index. If the index is missing or out of date, it is
+ * rebuilt in the background when threads are available; until then
+ * lookups use the outdated index, or see no icons in the directories
+ * that it lacks, and the theme emits ::changed once the new index is
+ * ready. Without threads the index is rebuilt right away. An index
+ * that could not be written is kept in memory and used until the
+ * directories change.
+ */
+static void
+load_icon_index (GtkIconTheme *icon_theme)
+{
+  GtkIconThemePrivate *priv = icon_theme->priv;
+  GPtrArray *dirs, *paths;
+  GArray *mtimes;
+  GtkIconIndex *index;
+  IconThemeDir *dir;
+  IconIndexBuild *build;
+  gboolean up_to_date, written;
+  guint image_flags;
+  gchar *filename;
+  GList *t, *d;
+  guint i;
 
-      if (g_str_has_suffix (name, ".icon"))
+  dirs = g_ptr_array_new ();
+  paths = g_ptr_array_new ();
+  mtimes = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  for (t = priv->themes; t; t = t->next)
+    for (d = ((IconTheme *)t->data)->dirs; d; d = d->next)
+      {
+	dir = d->data;
+	if (dir->cache == NULL)
+	  {
+	    g_ptr_array_add (dirs, dir);
+	    g_ptr_array_add (paths, dir->dir);
+	    g_array_append_val (mtimes, dir->mtime);
+	  }
+      }
+
+  if (dirs->len == 0)
+    goto out;
+
+  /* Names with only an .icon file are left out of the index */
+  image_flags = ICON_SUFFIX_XPM | ICON_SUFFIX_SVG | ICON_SUFFIX_PNG;
+#ifdef MAEMO_CHANGES
+  image_flags |= ICON_SUFFIX_ANI;
+#endif
+
+  filename = _gtk_icon_index_get_filename ((const gchar * const *)paths->pdata,
+					   paths->len);
+  index = _gtk_icon_index_new_for_file (filename);
+
+  up_to_date = index != NULL && icon_index_is_up_to_date (index, dirs);
+
+  if (priv->unwritten_index)
+    {
+      if (!up_to_date &&
+	  strcmp (priv->unwritten_index_filename, filename) == 0 &&
+	  icon_index_is_up_to_date (priv->unwritten_index, dirs))
 	{
-	  if (dir->icon_data == NULL)
-	    dir->icon_data = g_hash_table_new_full (g_str_hash, g_str_equal,
-						    g_free, (GDestroyNotify)icon_data_free);
-	  
-	  path = g_build_filename (full_dir, name, NULL);
-	  if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
-	    load_icon_data (dir, path, name);
-	  
-	  g_free (path);
-	  
-	  continue;
+	  if (index)
+	    _gtk_icon_index_unref (index);
+
+	  index = _gtk_icon_index_ref (priv->unwritten_index);
+	  up_to_date = TRUE;
 	}
+      else
+	set_unwritten_index (icon_theme, NULL, NULL);
+    }
 
-      suffix = suffix_from_name (name);
-      if (suffix == ICON_SUFFIX_NONE)
-	continue;
+  if (!up_to_date && !g_thread_supported ())
+    {
+      if (index)
+	_gtk_icon_index_unref (index);
 
-      base_name = strip_suffix (name);
+      index = _gtk_icon_index_build ((const gchar * const *)paths->pdata,
+				     (const gint64 *)mtimes->data,
+				     paths->len,
+				     icon_index_flags_for_file,
+				     image_flags,
+				     filename,
+				     &written);
+      if (index && !written)
+	set_unwritten_index (icon_theme, index, filename);
+    }
+  else if (!up_to_date)
+    {
+      build = g_slice_new (IconIndexBuild);
+      build->icon_theme = g_object_ref (icon_theme);
+      build->serial = priv->index_serial;
+      build->filename = g_strdup (filename);
 
-      hash_suffix = GPOINTER_TO_INT (g_hash_table_lookup (dir->icons, base_name));
-      g_hash_table_replace (icon_theme->all_icons, base_name, NULL);
-      g_hash_table_replace (dir->icons, base_name, GUINT_TO_POINTER (hash_suffix| suffix));
+      _gtk_icon_index_build_async ((const gchar * const *)paths->pdata,
+				   (const gint64 *)mtimes->data,
+				   paths->len,
+				   icon_index_flags_for_file,
+				   image_flags,
+				   filename,
+				   icon_index_ready,
+				   build);
     }
-  
-  g_dir_close (gdir);
+
+  if (index)
+    {
+      for (i = 0; i < dirs->len; i++)
+	{
+	  dir = g_ptr_array_index (dirs, i);
+	  dir->index_dir = _gtk_icon_index_get_directory_index (index, dir->dir, NULL);
+	  if (dir->index_dir >= 0)
+	    dir->index = _gtk_icon_index_ref (index);
+	}
+
+      _gtk_icon_index_add_icons (index, -1, priv->all_icons);
+      _gtk_icon_index_unref (index);
+    }
+
+  g_free (filename);
+
+ out:
+  g_ptr_array_free (dirs, TRUE);
+  g_ptr_array_free (paths, TRUE);
+  g_array_free (mtimes, TRUE);
 }
 
 static void
@@ -2521,6 +2717,8 @@ theme_subdir_load (GtkIconTheme *icon_theme,
   char *full_dir;
   GError *error = NULL;
   IconThemeDirMtime *dir_mtime;
+  struct stat stat_buf;
+  gboolean is_dir;
 
   size = g_key_file_get_integer (theme_file, subdir, "Size", &error);
   if (error)
@@ -2588,9 +2786,10 @@ theme_subdir_load (GtkIconTheme *icon_theme,
 	continue; /* directory doesn't exist */
 
        full_dir = g_build_filename (dir_mtime->dir, subdir, NULL);
+       is_dir = g_stat (full_dir, &stat_buf) == 0 && S_ISDIR (stat_buf.st_mode);
 
       /* First, see if we have a cache for the directory */
-      if (dir_mtime->cache != NULL || g_file_test (full_dir, G_FILE_TEST_IS_DIR))
+      if (dir_mtime->cache != NULL || is_dir)
 	{
 	  if (dir_mtime->cache == NULL)
 	    {
@@ -2608,6 +2807,9 @@ theme_subdir_load (GtkIconTheme *icon_theme,
 	  dir->dir = full_dir;
 	  dir->icon_data = NULL;
 	  dir->subdir = g_strdup (subdir);
+	  dir->index = NULL;
+	  dir->index_dir = -1;
+	  dir->mtime = is_dir ? stat_buf.st_mtime : 0;
 	  if (dir_mtime->cache != NULL)
             {
 	      dir->cache = _gtk_icon_cache_ref (dir_mtime->cache);
@@ -2615,9 +2817,9 @@ theme_subdir_load (GtkIconTheme *icon_theme,
             }
 	  else
 	    {
+	      /* Looked up in the icon index, see load_icon_index() */
 	      dir->cache = NULL;
               dir->subdir_index = -1;
-	      scan_directory (icon_theme->priv, dir, full_dir);
 	    }
 
 	  theme->dirs = g_list_prepend (theme->dirs, dir);
@@ -2893,6 +3095,57 @@ apply_emblems (GtkIconInfo *info)
   info->emblems_applied = TRUE;
 }
 
+/* Returns the key for the icon in the shared raster cache, or %NULL
+ * if it should not be cached. The key covers everything the scale and
+ * the rendered pixels depend on.
+ */
+static gchar *
+icon_info_get_raster_key (GtkIconInfo *icon_info)
+{
+  struct stat stat_buf;
+
+  if (!icon_info->filename || icon_info->cache_pixbuf)
+    return NULL;
+
+  if (g_stat (icon_info->filename, &stat_buf) != 0)
+    return NULL;
+
+  return g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT
+			  "\n%d %d %d %d %d",
+			  icon_info->filename,
+			  (gint64) stat_buf.st_mtime,
+			  (gint64) stat_buf.st_size,
+			  icon_info->desired_size,
+			  icon_info->forced_size,
+			  icon_info->dir_type,
+			  icon_info->dir_size,
+			  icon_info->threshold);
+}
+
+/* Looks for the rendered icon in the cache shared with other
+ * processes. On a miss, returns the key to store the icon under
+ * in @raster_key, if it can be cached.
+ */
+static gboolean
+icon_info_load_from_raster_cache (GtkIconInfo  *icon_info,
+				  gchar       **raster_key)
+{
+  *raster_key = icon_info_get_raster_key (icon_info);
+  if (!*raster_key)
+    return FALSE;
+
+  icon_info->pixbuf = _gtk_icon_raster_cache_lookup (*raster_key,
+						     &icon_info->scale);
+  if (!icon_info->pixbuf)
+    return FALSE;
+
+  g_free (*raster_key);
+  *raster_key = NULL;
+  apply_emblems (icon_info);
+
+  return TRUE;
+}
+
 /* This function contains the complicated logic for deciding
  * on the size at which to load the icon and loading it at
  * that size.
@@ -2904,6 +3157,7 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
   int image_width, image_height;
   GdkPixbuf *source_pixbuf;
   gboolean is_svg;
+  gchar *raster_key = NULL;
 
   /* First check if we already succeeded have the necessary
    * information (or failed earlier)
@@ -2963,6 +3217,10 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
 
       if (scale_only)
 	return TRUE;
+
+      /* Rendering SVGs is expensive, see if another process did it */
+      if (icon_info_load_from_raster_cache (icon_info, &raster_key))
+	return TRUE;
       
       stream = g_loadable_icon_load (icon_info->loadable,
                                      icon_info->desired_size,
@@ -2980,7 +3238,15 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
         }
 
       if (!icon_info->pixbuf)
-        return FALSE;
+	{
+	  g_free (raster_key);
+	  return FALSE;
+	}
+
+      if (raster_key)
+	_gtk_icon_raster_cache_store (raster_key, icon_info->pixbuf,
+				      icon_info->scale);
+      g_free (raster_key);
 
       apply_emblems (icon_info);
         
@@ -3013,6 +3279,14 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
   if (icon_info->scale >= 0. && scale_only)
     return TRUE;
 
+  /* Unless it is known that the image is used as is, it will likely
+   * have to be scaled; see if another process did it. Unscaled images
+   * are cheap enough to decode again.
+   */
+  if (icon_info->scale != 1.0 &&
+      icon_info_load_from_raster_cache (icon_info, &raster_key))
+    return TRUE;
+
   /* At this point, we need to actually get the icon; either from the
    * builtin image or by loading the file
    */
@@ -3037,7 +3311,10 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
     }
 
   if (!source_pixbuf)
-    return FALSE;
+    {
+      g_free (raster_key);
+      return FALSE;
+    }
 
   /* Do scale calculations that depend on the image size
    */
@@ -3073,8 +3350,14 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
 						   0.5 + image_height * icon_info->scale,
 						   GDK_INTERP_BILINEAR);
       g_object_unref (source_pixbuf);
+
+      if (raster_key && icon_info->pixbuf)
+	_gtk_icon_raster_cache_store (raster_key, icon_info->pixbuf,
+				      icon_info->scale);
     }
 
+  g_free (raster_key);
+
   apply_emblems (icon_info);
 
   return TRUE;
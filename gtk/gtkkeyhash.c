@@ -26,7 +26,13 @@
 #include "gtkprivate.h"
 #include "gtkalias.h"
 
+/* Lookups are cached per key hash; the cache is dropped when it grows
+ * beyond this many different key events.
+ */
+#define MAX_CACHED_LOOKUPS 256
+
 typedef struct _GtkKeyHashEntry GtkKeyHashEntry;
+typedef struct _GtkKeyHashLookup GtkKeyHashLookup;
 
 struct _GtkKeyHashEntry
 {
@@ -40,15 +46,68 @@ struct _GtkKeyHashEntry
   gint n_keys;
 };
 
+/* The key event a cached lookup result belongs to
+ */
+struct _GtkKeyHashLookup
+{
+  guint16 hardware_keycode;
+  gint group;
+  GdkModifierType state;
+  GdkModifierType mask;
+};
+
 struct _GtkKeyHash
 {
   GdkKeymap *keymap;
   GHashTable *keycode_hash;
   GHashTable *reverse_hash;
+  GHashTable *lookup_cache;
   GList *entries_list;
   GDestroyNotify destroy_notify;
 };
 
+static guint
+key_hash_lookup_hash (gconstpointer key)
+{
+  const GtkKeyHashLookup *lookup = key;
+
+  return lookup->hardware_keycode ^ (lookup->state << 8) ^ (lookup->group << 28) ^ lookup->mask;
+}
+
+static gboolean
+key_hash_lookup_equal (gconstpointer a,
+		       gconstpointer b)
+{
+  const GtkKeyHashLookup *lookup_a = a;
+  const GtkKeyHashLookup *lookup_b = b;
+
+  return (lookup_a->hardware_keycode == lookup_b->hardware_keycode &&
+	  lookup_a->group == lookup_b->group &&
+	  lookup_a->state == lookup_b->state &&
+	  lookup_a->mask == lookup_b->mask);
+}
+
+static void
+key_hash_lookup_free (gpointer data)
+{
+  g_slice_free (GtkKeyHashLookup, data);
+}
+
+static void
+key_hash_lookup_results_free (gpointer data)
+{
+  g_slist_free (data);
+}
+
+/* Forget the cached lookups, after the entries or the keymap changed
+ */
+static void
+key_hash_clear_lookup_cache (GtkKeyHash *key_hash)
+{
+  if (g_hash_table_size (key_hash->lookup_cache) > 0)
+    g_hash_table_remove_all (key_hash->lookup_cache);
+}
+
 static void
 key_hash_clear_keycode (gpointer key,
 			gpointer value,
@@ -106,6 +165,8 @@ key_hash_keys_changed (GdkKeymap  *keymap,
 {
   /* The keymap changed, so we have to regenerate the keycode hash
    */
+  key_hash_clear_lookup_cache (key_hash);
+
   if (key_hash->keycode_hash)
     {
       g_hash_table_foreach (key_hash->keycode_hash, key_hash_clear_keycode, NULL);
@@ -137,6 +198,10 @@ _gtk_key_hash_new (GdkKeymap      *keymap,
   key_hash->entries_list = NULL;
   key_hash->keycode_hash = NULL;
   key_hash->reverse_hash = g_hash_table_new (g_direct_hash, NULL);
+  key_hash->lookup_cache = g_hash_table_new_full (key_hash_lookup_hash,
+						  key_hash_lookup_equal,
+						  key_hash_lookup_free,
+						  key_hash_lookup_results_free);
   key_hash->destroy_notify = item_destroy_notify;
 
   return key_hash;
@@ -183,6 +248,7 @@ _gtk_key_hash_free (GtkKeyHash *key_hash)
     }
   
   g_hash_table_destroy (key_hash->reverse_hash);
+  g_hash_table_destroy (key_hash->lookup_cache);
 
   g_list_foreach (key_hash->entries_list, key_hash_free_entry_foreach, key_hash);
   g_list_free (key_hash->entries_list);
@@ -212,6 +278,8 @@ _gtk_key_hash_add_entry (GtkKeyHash      *key_hash,
   entry->modifiers = modifiers;
   entry->keys = NULL;
 
+  key_hash_clear_lookup_cache (key_hash);
+
   key_hash->entries_list = g_list_prepend (key_hash->entries_list, entry);
   g_hash_table_insert (key_hash->reverse_hash, value, key_hash->entries_list);
 
@@ -237,6 +305,8 @@ _gtk_key_hash_remove_entry (GtkKeyHash *key_hash,
     {
       GtkKeyHashEntry *entry = entry_node->data;
 
+      key_hash_clear_lookup_cache (key_hash);
+
       if (key_hash->keycode_hash)
 	{
 	  gint i;
@@ -355,35 +425,12 @@ keyval_in_group (GdkKeymap  *keymap,
   return FALSE;
 }
 
-/**
- * _gtk_key_hash_lookup:
- * @key_hash: a #GtkKeyHash
- * @hardware_keycode: hardware keycode field from a #GdkEventKey
- * @state: state field from a #GdkEventKey
- * @mask: mask of modifiers to consider when matching against the
- *        modifiers in entries.
- * @group: group field from a #GdkEventKey
- * 
- * Looks up the best matching entry or entries in the hash table for
- * a given event. The results are sorted so that entries with less
- * modifiers come before entries with more modifiers.
- * 
- * The matches returned by this function can be exact (i.e. keycode, level
- * and group all match) or fuzzy (i.e. keycode and level match, but group
- * does not). As long there are any exact matches, only exact matches
- * are returned. If there are no exact matches, fuzzy matches will be
- * returned, as long as they are not shadowing a possible exact match.
- * This means that fuzzy matches won't be considered if their keyval is 
- * present in the current group.
- * 
- * Return value: A #GSList of matching entries.
- **/
-GSList *
-_gtk_key_hash_lookup (GtkKeyHash      *key_hash,
-		      guint16          hardware_keycode,
-		      GdkModifierType  state,
-		      GdkModifierType  mask,
-		      gint             group)
+static GSList *
+key_hash_lookup (GtkKeyHash      *key_hash,
+		 guint16          hardware_keycode,
+		 GdkModifierType  state,
+		 GdkModifierType  mask,
+		 gint             group)
 {
   GHashTable *keycode_hash = key_hash_get_keycode_hash (key_hash);
   GSList *keys = g_hash_table_lookup (keycode_hash, GUINT_TO_POINTER ((guint)hardware_keycode));
@@ -523,6 +570,92 @@ _gtk_key_hash_lookup (GtkKeyHash      *key_hash,
   return results;
 }
 
+/**
+ * _gtk_key_hash_lookup:
+ * @key_hash: a #GtkKeyHash
+ * @hardware_keycode: hardware keycode field from a #GdkEventKey
+ * @state: state field from a #GdkEventKey
+ * @mask: mask of modifiers to consider when matching against the
+ *        modifiers in entries.
+ * @group: group field from a #GdkEventKey
+ * 
+ * Looks up the best matching entry or entries in the hash table for
+ * a given event. The results are sorted so that entries with less
+ * modifiers come before entries with more modifiers.
+ * 
+ * The matches returned by this function can be exact (i.e. keycode, level
+ * and group all match) or fuzzy (i.e. keycode and level match, but group
+ * does not). As long there are any exact matches, only exact matches
+ * are returned. If there are no exact matches, fuzzy matches will be
+ * returned, as long as they are not shadowing a possible exact match.
+ * This means that fuzzy matches won't be considered if their keyval is 
+ * present in the current group.
+ * 
+ * Return value: A #GSList of matching entries, free it with
+ *   g_slist_free().
+ **/
+GSList *
+_gtk_key_hash_lookup (GtkKeyHash      *key_hash,
+		      guint16          hardware_keycode,
+		      GdkModifierType  state,
+		      GdkModifierType  mask,
+		      gint             group)
+{
+  return g_slist_copy (_gtk_key_hash_lookup_cached (key_hash, hardware_keycode,
+						    state, mask, group));
+}
+
+/**
+ * _gtk_key_hash_lookup_cached:
+ * @key_hash: a #GtkKeyHash
+ * @hardware_keycode: hardware keycode field from a #GdkEventKey
+ * @state: state field from a #GdkEventKey
+ * @mask: mask of modifiers to consider when matching against the
+ *        modifiers in entries.
+ * @group: group field from a #GdkEventKey
+ * 
+ * Like _gtk_key_hash_lookup(), but the result is remembered, so that
+ * repeating the lookup for the same key event costs a single hash
+ * table lookup and allocates nothing.
+ * 
+ * Return value: A #GSList of matching entries. The list is owned by
+ *   @key_hash and only valid until entries are added to or removed
+ *   from @key_hash, or the keymap changes.
+ **/
+GSList *
+_gtk_key_hash_lookup_cached (GtkKeyHash      *key_hash,
+			     guint16          hardware_keycode,
+			     GdkModifierType  state,
+			     GdkModifierType  mask,
+			     gint             group)
+{
+  GtkKeyHashLookup lookup;
+  GtkKeyHashLookup *new_lookup;
+  GSList *results;
+
+  /* We don't want Caps_Lock to affect keybinding lookups.
+   */
+  lookup.hardware_keycode = hardware_keycode;
+  lookup.group = group;
+  lookup.state = state & ~GDK_LOCK_MASK;
+  lookup.mask = mask;
+
+  if (g_hash_table_lookup_extended (key_hash->lookup_cache, &lookup,
+				    NULL, (gpointer *) &results))
+    return results;
+
+  results = key_hash_lookup (key_hash, hardware_keycode, lookup.state, mask, group);
+
+  if (g_hash_table_size (key_hash->lookup_cache) >= MAX_CACHED_LOOKUPS)
+    g_hash_table_remove_all (key_hash->lookup_cache);
+
+  new_lookup = g_slice_new (GtkKeyHashLookup);
+  *new_lookup = lookup;
+  g_hash_table_insert (key_hash->lookup_cache, new_lookup, results);
+
+  return results;
+}
+
 /**
  * _gtk_key_hash_lookup_keyval:
  * @key_hash: a #GtkKeyHash
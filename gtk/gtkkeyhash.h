@@ -41,6 +41,11 @@ GSList *    _gtk_key_hash_lookup        (GtkKeyHash      *key_hash,
 					 GdkModifierType  state,
 					 GdkModifierType  mask,
 					 gint             group);
+GSList *    _gtk_key_hash_lookup_cached (GtkKeyHash      *key_hash,
+					 guint16          hardware_keycode,
+					 GdkModifierType  state,
+					 GdkModifierType  mask,
+					 gint             group);
 GSList *    _gtk_key_hash_lookup_keyval (GtkKeyHash      *key_hash,
 					 guint            keyval,
 					 GdkModifierType  modifiers);
@@ -69,6 +69,10 @@
 
 #include "gdk/gdkprivate.h" /* for GDK_WINDOW_DESTROYED */
 
+#ifdef GDK_WINDOWING_X11
+#include "x11/gdkx.h"
+#endif
+
 #ifdef G_OS_WIN32
 
 static HMODULE gtk_dll;
@@ -236,7 +240,8 @@ static const GDebugKey gtk_debug_keys[] = {
   {"geometry", GTK_DEBUG_GEOMETRY},
   {"icontheme", GTK_DEBUG_ICONTHEME},
   {"printing", GTK_DEBUG_PRINTING},
-  {"builder", GTK_DEBUG_BUILDER}
+  {"builder", GTK_DEBUG_BUILDER},
+  {"signals", GTK_DEBUG_SIGNALS}
 };
 #endif /* G_ENABLE_DEBUG */
 
@@ -654,6 +659,30 @@ _gtk_module_has_mixed_deps (GModule *module_to_check)
   return result;
 }
 
+#ifdef GDK_WINDOWING_X11
+/* Atoms that GTK+ converts to X atoms early on, for selections,
+ * clipboard handling, XEMBED and settings changes. They are interned
+ * in one batch when the display is opened.
+ */
+static const gchar *const gtk_preload_atoms[] = {
+  "ATOM_PAIR",
+  "CLIPBOARD_MANAGER",
+  "COMPOUND_TEXT",
+  "DELETE",
+  "INCR",
+  "MULTIPLE",
+  "NULL",
+  "SAVE_TARGETS",
+  "TARGETS",
+  "TEXT",
+  "TIMESTAMP",
+  "_GTK_LOAD_ICONTHEMES",
+  "_GTK_READ_RCFILES",
+  "_XEMBED",
+  "_XEMBED_INFO"
+};
+#endif
+
 static void
 do_pre_parse_initialization (int    *argc,
 			     char ***argv)
@@ -677,6 +706,11 @@ do_pre_parse_initialization (int    *argc,
 
   gdk_pre_parse_libgtk_only ();
   gdk_event_handler_set ((GdkEventFunc)gtk_main_do_event, NULL, NULL);
+
+#ifdef GDK_WINDOWING_X11
+  gdk_x11_register_preload_atoms (gtk_preload_atoms,
+				  G_N_ELEMENTS (gtk_preload_atoms));
+#endif
   
 #ifdef G_ENABLE_DEBUG
   env_string = g_getenv ("GTK_DEBUG");
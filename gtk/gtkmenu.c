@@ -47,6 +47,7 @@
 #include "gtkwindow.h"
 #include "gtkhbox.h"
 #include "gtkvscrollbar.h"
+#include "gtkwidgetpool.h"
 #include "gtksettings.h"
 #include "gtkprivate.h"
 #include "gtkintl.h"
@@ -115,6 +116,7 @@ struct _GtkMenuPrivate
   guint have_position         : 1;
   guint ignore_button_release : 1;
   guint no_toggle_size        : 1;
+  guint recyclable            : 1;
 
 #ifdef MAEMO_CHANGES
   /* For context menu behavior */
@@ -1447,6 +1449,96 @@ gtk_menu_new (void)
   return g_object_new (GTK_TYPE_MENU, NULL);
 }
 
+static gboolean
+gtk_menu_reset (GtkWidget *widget)
+{
+  GtkMenu *menu = GTK_MENU (widget);
+  GtkMenuPrivate *priv = gtk_menu_get_private (menu);
+
+  if (!menu->toplevel || menu->tearoff_window)
+    return FALSE;
+
+  gtk_container_foreach (GTK_CONTAINER (menu), (GtkCallback) gtk_widget_destroy, NULL);
+  gtk_widget_unrealize (menu->toplevel);
+
+  gtk_menu_set_screen (menu, NULL);
+  gtk_menu_set_title (menu, NULL);
+  gtk_menu_set_accel_group (menu, NULL);
+  gtk_menu_set_accel_path (menu, NULL);
+  gtk_menu_set_reserve_toggle_size (menu, TRUE);
+
+  menu->position_func = NULL;
+  menu->position_func_data = NULL;
+  menu->scroll_offset = 0;
+  priv->monitor_num = -1;
+
+  return TRUE;
+}
+
+static GtkWidgetPool *
+gtk_menu_get_pool (void)
+{
+  static GtkWidgetPool *pool = NULL;
+
+  if (!pool)
+    pool = _gtk_widget_pool_new (GTK_TYPE_MENU, 2, gtk_menu_reset);
+
+  return pool;
+}
+
+/* Like gtk_menu_new(), but reuses a menu given to _gtk_menu_release()
+ * if there is one. For the context menus of widgets, which are built
+ * from scratch every time they pop up. If the menu is handed out to
+ * the application, e.g. through a ::populate-popup signal, pass
+ * %FALSE for @recycle to get a new menu that is never reused.
+ */
+GtkWidget*
+_gtk_menu_new_recycled (gboolean recycle)
+{
+  GtkWidget *menu;
+
+  if (!recycle)
+    return gtk_menu_new ();
+
+  menu = _gtk_widget_pool_take (gtk_menu_get_pool ());
+  if (!menu)
+    {
+      menu = gtk_menu_new ();
+      gtk_menu_get_private (GTK_MENU (menu))->recyclable = TRUE;
+    }
+
+  return menu;
+}
+
+/* Destroys @menu, which must be attached, or keeps it for
+ * _gtk_menu_new_recycled() if it was created for reuse and nothing
+ * else uses it.
+ */
+void
+_gtk_menu_release (GtkMenu *menu)
+{
+  g_return_if_fail (GTK_IS_MENU (menu));
+
+  if (!gtk_menu_get_private (menu)->recyclable)
+    {
+      gtk_widget_destroy (GTK_WIDGET (menu));
+      return;
+    }
+
+  if (GTK_MENU_SHELL (menu)->active)
+    gtk_menu_popdown (menu);
+
+  /* The attach widget owns the menu, keep it alive past the detach */
+  g_object_ref (menu);
+  gtk_menu_detach (menu);
+
+  if (!_gtk_widget_pool_recycle (gtk_menu_get_pool (), GTK_WIDGET (menu)))
+    {
+      gtk_widget_destroy (GTK_WIDGET (menu));
+      g_object_unref (menu);
+    }
+}
+
 static void
 gtk_menu_real_insert (GtkMenuShell *menu_shell,
 		      GtkWidget    *child,
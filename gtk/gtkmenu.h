@@ -208,6 +208,9 @@ void       _gtk_menu_push_context_menu_behavior (void);
 void       _gtk_menu_pop_context_menu_behavior  (void);
 #endif /* MAEMO_CHANGES */
 
+GtkWidget* _gtk_menu_new_recycled         (gboolean             recycle);
+void       _gtk_menu_release              (GtkMenu             *menu);
+
 #ifndef GTK_DISABLE_DEPRECATED
 #define gtk_menu_append(menu,child)	gtk_menu_shell_append  ((GtkMenuShell *)(menu),(child))
 #define gtk_menu_prepend(menu,child)    gtk_menu_shell_prepend ((GtkMenuShell *)(menu),(child))
@@ -1838,11 +1838,11 @@ gtk_menu_shell_activate_mnemonic (GtkMenuShell *menu_shell,
   if (!key_hash)
     return FALSE;
   
-  entries = _gtk_key_hash_lookup (key_hash,
-				  event->hardware_keycode,
-				  event->state,
-				  gtk_accelerator_get_default_mod_mask (),
-				  event->group);
+  entries = _gtk_key_hash_lookup_cached (key_hash,
+					 event->hardware_keycode,
+					 event->state,
+					 gtk_accelerator_get_default_mod_mask (),
+					 event->group);
 
   if (entries)
     result = _gtk_mnemonic_hash_activate (mnemonic_hash,
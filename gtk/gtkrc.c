@@ -47,12 +47,15 @@
 #include "gtkversion.h"
 #include "gtkrc.h"
 #include "gtkbindings.h"
+#include "gtkcontainer.h"
+#include "gtkdebug.h"
 #include "gtkthemes.h"
 #include "gtkintl.h"
 #include "gtkiconfactory.h"
 #include "gtkmain.h"
 #include "gtkmodules.h"
 #include "gtkprivate.h"
+#include "gtkrccache.h"
 #include "gtksettings.h"
 #include "gtkwindow.h"
 
@@ -128,7 +131,21 @@ struct _GtkRcContext
 
   GHashTable *color_hash;
 
+  /* Memoized results of matching the rc_sets; see gtk_rc_match_paths()
+   * and gtk_rc_match_type(). Cleared whenever the rc_sets change.
+   */
+  GHashTable *path_match_cache;
+  GHashTable *class_match_cache;
+
+  /* Widgets still to be restyled after a theme change; see
+   * gtk_rc_restyle_in_batches()
+   */
+  GQueue restyle_mapped;
+  GQueue restyle_unmapped;
+  guint restyle_idle_id;
+
   guint reloading : 1;
+  guint restyle_in_batches : 1;
 };
 
 #define GTK_RC_STYLE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GTK_TYPE_RC_STYLE, GtkRcStylePrivate))
@@ -155,10 +172,13 @@ static GSList *    gtk_rc_styles_match               (GSList          *rc_styles
                                                       guint            path_length,
                                                       gchar           *path,
                                                       gchar           *path_reversed);
+static void        gtk_rc_invalidate_match_cache     (GtkRcContext    *context);
+static void        gtk_rc_cancel_restyle             (GtkRcContext    *context);
 static GtkStyle *  gtk_rc_style_to_style             (GtkRcContext    *context,
 						      GtkRcStyle      *rc_style);
 static GtkStyle*   gtk_rc_init_style                 (GtkRcContext    *context,
 						      GSList          *rc_styles);
+static void        gtk_rc_print_style_stats          (void);
 static void        gtk_rc_parse_default_files        (GtkRcContext    *context);
 static void        gtk_rc_parse_named                (GtkRcContext    *context,
 						      const gchar     *name,
@@ -639,7 +659,12 @@ gtk_rc_settings_changed (GtkSettings  *settings,
       (new_key_theme_name != context->key_theme_name &&
        !(new_key_theme_name && context->key_theme_name && strcmp (new_key_theme_name, context->key_theme_name) == 0)))
     {
+      /* Restyling every widget at once can take seconds in large
+       * applications, so spread it out
+       */
+      context->restyle_in_batches = TRUE;
       gtk_rc_reparse_all_for_settings (settings, TRUE);
+      context->restyle_in_batches = FALSE;
     }
 
   g_free (new_theme_name);
@@ -669,7 +694,9 @@ gtk_rc_color_hash_changed (GtkSettings  *settings,
   if (old_hash)
     g_hash_table_unref (old_hash);
 
+  context->restyle_in_batches = TRUE;
   gtk_rc_reparse_all_for_settings (settings, TRUE);
+  context->restyle_in_batches = FALSE;
 }
 
 static GtkRcContext *
@@ -686,7 +713,13 @@ gtk_rc_context_get (GtkSettings *settings)
       context->rc_sets_class = NULL;
       context->rc_files = NULL;
       context->default_style = NULL;
+      context->path_match_cache = NULL;
+      context->class_match_cache = NULL;
+      g_queue_init (&context->restyle_mapped);
+      g_queue_init (&context->restyle_unmapped);
+      context->restyle_idle_id = 0;
       context->reloading = FALSE;
+      context->restyle_in_batches = FALSE;
 
       g_object_get (settings,
 		    "gtk-theme-name", &context->theme_name,
@@ -759,6 +792,7 @@ _gtk_rc_context_destroy (GtkSettings *settings)
   _gtk_settings_reset_rc_values (context->settings);
   gtk_rc_clear_styles (context);
   gtk_rc_clear_rc_files (context);
+  gtk_rc_cancel_restyle (context);
 
   if (context->default_style)
     g_object_unref (context->default_style);
@@ -1027,6 +1061,200 @@ gtk_rc_context_parse_one_file (GtkRcContext *context,
   context->default_priority = saved_priority;
 }
 
+#define GET_UINT16(cache, offset) (GUINT16_FROM_BE (*(guint16 *)((cache) + (offset))))
+#define GET_UINT32(cache, offset) (GUINT32_FROM_BE (*(guint32 *)((cache) + (offset))))
+
+/* Returns the nul-terminated string at @offset in the cache, or
+ * %NULL if @offset doesn't point to one.
+ */
+static const gchar *
+rc_cache_get_string (const gchar *cache,
+		     gsize        size,
+		     guint32      offset)
+{
+  if (offset >= size || memchr (cache + offset, '\0', size - offset) == NULL)
+    return NULL;
+
+  return cache + offset;
+}
+
+/* Parses @filename from the cache written for it by gtk-update-rc-cache,
+ * if there is one and all the files that went into it are unchanged.
+ * This has the same effect as gtk_rc_context_parse_one_file(), but
+ * avoids opening and reading the include files one by one; the text
+ * in the cache still goes through the scanner. Returns %FALSE if the
+ * cache could not be used, in which case nothing has been registered
+ * or parsed.
+ */
+static gboolean
+gtk_rc_context_parse_cache (GtkRcContext *context,
+			    const gchar  *filename,
+			    gint          priority,
+			    gboolean      reload,
+			    gboolean      use_locale_variants)
+{
+  GMappedFile *map;
+  const gchar *cache;
+  gchar *cache_name, *canonical_name;
+  GtkRcFile **rc_files = NULL;
+  GPtrArray *stack;
+  GSList *saved_stack;
+  struct stat statbuf;
+  gsize size;
+  guint32 files_offset, chunks_offset;
+  guint32 n_files, n_chunks, i, j;
+  gint saved_priority;
+  gboolean result = FALSE;
+
+  cache_name = g_strconcat (filename, GTK_RC_CACHE_SUFFIX, NULL);
+  map = g_mapped_file_new (cache_name, FALSE, NULL);
+  g_free (cache_name);
+
+  if (!map)
+    return FALSE;
+
+  cache = g_mapped_file_get_contents (map);
+  size = g_mapped_file_get_length (map);
+
+  if (g_path_is_absolute (filename))
+    canonical_name = g_strdup (filename);
+  else
+    {
+      gchar *cwd;
+
+      cwd = g_get_current_dir ();
+      canonical_name = g_build_filename (cwd, filename, NULL);
+      g_free (cwd);
+    }
+
+  /* Check the header and that all the tables fit */
+  if (size < GTK_RC_CACHE_HEADER_SIZE ||
+      GET_UINT16 (cache, 0) != GTK_RC_CACHE_MAJOR_VERSION)
+    goto out;
+
+  files_offset = GET_UINT32 (cache, 4);
+  chunks_offset = GET_UINT32 (cache, 8);
+  if (files_offset % 4 != 0 || chunks_offset % 4 != 0 ||
+      files_offset > size - 4 || chunks_offset > size - 4)
+    goto out;
+
+  n_files = GET_UINT32 (cache, files_offset);
+  n_chunks = GET_UINT32 (cache, chunks_offset);
+  if (n_files == 0 ||
+      n_files > (size - files_offset - 4) / GTK_RC_CACHE_FILE_SIZE ||
+      n_chunks > (size - chunks_offset - 4) / GTK_RC_CACHE_CHUNK_SIZE)
+    goto out;
+
+  /* Check that none of the files changed */
+  for (i = 0; i < n_files; i++)
+    {
+      guint32 offset = files_offset + 4 + i * GTK_RC_CACHE_FILE_SIZE;
+      const gchar *name;
+
+      name = rc_cache_get_string (cache, size, GET_UINT32 (cache, offset));
+      if (name == NULL || !g_path_is_absolute (name))
+	goto out;
+
+      if (i == 0 && strcmp (name, canonical_name) != 0)
+	goto out;
+
+      if (g_lstat (name, &statbuf) != 0 ||
+	  (guint32) statbuf.st_mtime != GET_UINT32 (cache, offset + 4) ||
+	  (guint32) statbuf.st_size != GET_UINT32 (cache, offset + 8))
+	goto out;
+
+      if (use_locale_variants &&
+	  (GET_UINT32 (cache, offset + 12) & GTK_RC_CACHE_FILE_HAS_LOCALE_VARIANTS))
+	goto out;
+    }
+
+  /* Check the chunks */
+  for (i = 0; i < n_chunks; i++)
+    {
+      guint32 offset = chunks_offset + 4 + i * GTK_RC_CACHE_CHUNK_SIZE;
+
+      if (GET_UINT32 (cache, offset) >= n_files ||
+	  GET_UINT32 (cache, offset + 4) > n_files ||
+	  rc_cache_get_string (cache, size, GET_UINT32 (cache, offset + 8)) == NULL)
+	goto out;
+    }
+
+  /* Let the regular parser deal with recursive includes */
+  for (i = 0; i < n_files; i++)
+    {
+      guint32 offset = files_offset + 4 + i * GTK_RC_CACHE_FILE_SIZE;
+      const gchar *name = (i == 0) ? filename : cache + GET_UINT32 (cache, offset);
+      GSList *tmp_list;
+
+      for (tmp_list = current_files_stack; tmp_list; tmp_list = tmp_list->next)
+	if (!strcmp (((GtkRcFile *) tmp_list->data)->name, name))
+	  goto out;
+    }
+
+  /* Register the files like parsing them would, so that
+   * gtk_rc_reparse_all() notices changes to them.
+   */
+  rc_files = g_new (GtkRcFile *, n_files);
+  for (i = 0; i < n_files; i++)
+    {
+      guint32 offset = files_offset + 4 + i * GTK_RC_CACHE_FILE_SIZE;
+      const gchar *name = cache + GET_UINT32 (cache, offset);
+
+      if (i == 0)
+	rc_files[i] = add_to_rc_file_list (&context->rc_files, filename, reload);
+      else
+	rc_files[i] = add_to_rc_file_list (&context->rc_files, name, FALSE);
+
+      if (!rc_files[i]->canonical_name)
+	{
+	  rc_files[i]->canonical_name = (i == 0) ? g_strdup (canonical_name) : rc_files[i]->name;
+	  rc_files[i]->directory = g_path_get_dirname (rc_files[i]->canonical_name);
+	}
+      rc_files[i]->mtime = GET_UINT32 (cache, offset + 4);
+    }
+
+  saved_priority = context->default_priority;
+  context->default_priority = priority;
+  saved_stack = current_files_stack;
+  stack = g_ptr_array_new ();
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      guint32 offset = chunks_offset + 4 + i * GTK_RC_CACHE_CHUNK_SIZE;
+      GtkRcFile *rc_file = rc_files[GET_UINT32 (cache, offset)];
+      guint32 depth = MIN (GET_UINT32 (cache, offset + 4), stack->len);
+
+      /* Make the stack of current files look as if the chunk's file
+       * had been included from its parents.
+       */
+      g_ptr_array_set_size (stack, depth);
+      g_ptr_array_add (stack, rc_file);
+
+      current_files_stack = saved_stack;
+      for (j = 0; j < stack->len; j++)
+	current_files_stack = g_slist_prepend (current_files_stack,
+					       g_ptr_array_index (stack, j));
+
+      gtk_rc_parse_any (context, rc_file->name, -1, cache + GET_UINT32 (cache, offset + 8));
+
+      while (current_files_stack != saved_stack)
+	current_files_stack = g_slist_delete_link (current_files_stack,
+						   current_files_stack);
+    }
+
+  g_ptr_array_free (stack, TRUE);
+  context->default_priority = saved_priority;
+
+  result = TRUE;
+
+ out:
+  g_free (rc_files);
+  g_free (canonical_name);
+  g_mapped_file_unref (map);
+
+  return result;
+}
+
 static gchar *
 strchr_len (const gchar *str, gint len, char c)
 {
@@ -1082,7 +1310,9 @@ gtk_rc_context_parse_file (GtkRcContext *context,
 
   g_free (locale);
   
-  gtk_rc_context_parse_one_file (context, filename, priority, reload);
+  if (!gtk_rc_context_parse_cache (context, filename, priority, reload,
+				   n_locale_suffixes > 0))
+    gtk_rc_context_parse_one_file (context, filename, priority, reload);
   for (j = 0; j < n_locale_suffixes; j++)
     {
       if (!found)
@@ -1606,17 +1836,154 @@ gtk_rc_clear_styles (GtkRcContext *context)
   gtk_rc_free_rc_sets (context->rc_sets_class);
   g_slist_free (context->rc_sets_class);
   context->rc_sets_class = NULL;
+
+  gtk_rc_invalidate_match_cache (context);
+}
+
+/* Upper bound on the time spent restyling widgets between two frames,
+ * in microseconds.
+ */
+#define RESTYLE_BATCH_TIME 8000
+
+/* A destroyed toplevel can't be told apart from a live one later, so
+ * toplevels take themselves out of the queues when they are destroyed.
+ * Other widgets lose their parent.
+ */
+static void
+gtk_rc_unqueue_restyle (GtkWidget    *widget,
+			GtkRcContext *context)
+{
+  GList *link;
+
+  g_signal_handlers_disconnect_by_func (widget, gtk_rc_unqueue_restyle, context);
+
+  if ((link = g_queue_find (&context->restyle_mapped, widget)))
+    g_queue_delete_link (&context->restyle_mapped, link);
+  else if ((link = g_queue_find (&context->restyle_unmapped, widget)))
+    g_queue_delete_link (&context->restyle_unmapped, link);
+  else
+    return;
+
+  g_object_unref (widget);
+}
+
+/* Returns the next widget to restyle, mapped ones first, or %NULL.
+ * The caller owns the reference.
+ */
+static GtkWidget *
+gtk_rc_pop_restyle (GtkRcContext *context)
+{
+  GtkWidget *widget;
+
+  widget = g_queue_pop_head (&context->restyle_mapped);
+  if (!widget)
+    widget = g_queue_pop_head (&context->restyle_unmapped);
+
+  if (widget && gtk_widget_is_toplevel (widget))
+    g_signal_handlers_disconnect_by_func (widget, gtk_rc_unqueue_restyle, context);
+
+  return widget;
+}
+
+static void
+gtk_rc_cancel_restyle (GtkRcContext *context)
+{
+  GtkWidget *widget;
+
+  if (context->restyle_idle_id)
+    {
+      g_source_remove (context->restyle_idle_id);
+      context->restyle_idle_id = 0;
+    }
+
+  while ((widget = gtk_rc_pop_restyle (context)))
+    g_object_unref (widget);
+}
+
+static void
+gtk_rc_queue_restyle (GtkWidget *widget,
+		      gpointer   data)
+{
+  GtkRcContext *context = data;
+
+  if (gtk_widget_get_mapped (widget))
+    g_queue_push_tail (&context->restyle_mapped, g_object_ref (widget));
+  else
+    g_queue_push_tail (&context->restyle_unmapped, g_object_ref (widget));
+
+  if (gtk_widget_is_toplevel (widget))
+    g_signal_connect (widget, "destroy",
+		      G_CALLBACK (gtk_rc_unqueue_restyle), context);
+}
+
+static gboolean
+gtk_rc_restyle_batch (gpointer data)
+{
+  GtkRcContext *context = data;
+  GtkWidget *widget;
+  gint64 start;
+  guint n_widgets = 0;
+
+  start = g_get_monotonic_time ();
+
+  /* Widgets on screen come first, so that what the user sees is
+   * consistent as soon as possible; hidden ones are restyled after.
+   * Children are queued when their parent is restyled, since they
+   * inherit from it.
+   */
+  while ((widget = gtk_rc_pop_restyle (context)))
+    {
+      /* Destroyed, or removed from the toplevel it was queued for;
+       * destroyed toplevels are no longer queued
+       */
+      if (gtk_widget_get_parent (widget) || gtk_widget_is_toplevel (widget))
+	{
+	  _gtk_widget_reset_rc_style (widget);
+
+	  if (GTK_IS_CONTAINER (widget))
+	    gtk_container_forall (GTK_CONTAINER (widget),
+				  gtk_rc_queue_restyle, context);
+	}
+
+      g_object_unref (widget);
+      n_widgets++;
+
+      if (g_get_monotonic_time () - start > RESTYLE_BATCH_TIME)
+	break;
+    }
+
+  GTK_NOTE (MISC,
+	    g_print ("restyled %u widgets in %" G_GINT64_FORMAT " us, %u pending\n",
+		     n_widgets, g_get_monotonic_time () - start,
+		     context->restyle_mapped.length + context->restyle_unmapped.length));
+
+  if (g_queue_is_empty (&context->restyle_mapped) &&
+      g_queue_is_empty (&context->restyle_unmapped))
+    {
+      context->restyle_idle_id = 0;
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 /* Reset all our widgets. Also, we have to invalidate cached icons in
  * icon sets so they get re-rendered.
+ *
+ * On theme changes coming from the settings, widgets are restyled
+ * from an idle in batches, so that each batch is followed by a
+ * relayout and redraw and the application stays responsive.
  */
 static void
 gtk_rc_reset_widgets (GtkSettings *settings)
 {
+  GtkRcContext *context = gtk_rc_context_get (settings);
   GList *list, *toplevels;
 
   _gtk_icon_set_invalidate_caches ();
+
+  /* Everything gets restyled again from the toplevels */
+  gtk_rc_cancel_restyle (context);
   
   toplevels = gtk_window_list_toplevels ();
   g_list_foreach (toplevels, (GFunc)g_object_ref, NULL);
@@ -1625,12 +1992,22 @@ gtk_rc_reset_widgets (GtkSettings *settings)
     {
       if (gtk_widget_get_screen (list->data) == settings->screen)
 	{
-	  gtk_widget_reset_rc_styles (list->data);
+	  if (context->restyle_in_batches)
+	    gtk_rc_queue_restyle (list->data, context);
+	  else
+	    gtk_widget_reset_rc_styles (list->data);
 	}
 
       g_object_unref (list->data);
     }
   g_list_free (toplevels);
+
+  if (context->restyle_in_batches &&
+      !(g_queue_is_empty (&context->restyle_mapped) &&
+	g_queue_is_empty (&context->restyle_unmapped)))
+    context->restyle_idle_id =
+      gdk_threads_add_idle_full (GDK_PRIORITY_REDRAW + 10,
+				 gtk_rc_restyle_batch, context, NULL);
 }
 
 static void
@@ -1690,6 +2067,8 @@ gtk_rc_reset_styles (GtkSettings *settings)
       reset = TRUE;
     }
   
+  GTK_NOTE (MISC, gtk_rc_print_style_stats ());
+
   /* Clear out styles that have been looked up already
    */
   if (realized_style_ht)
@@ -1874,6 +2253,10 @@ gtk_rc_reparse_all (void)
   return result;
 }
 
+/* Appends the sets in @sets that match @path to @rc_styles. Note
+ * that the list is built in reverse order; callers reverse it once
+ * they are done adding.
+ */
 static GSList *
 gtk_rc_styles_match (GSList       *rc_styles,
 		     GSList	  *sets,
@@ -1892,18 +2275,142 @@ gtk_rc_styles_match (GSList       *rc_styles,
       if (rc_set->type == GTK_PATH_WIDGET_CLASS)
         {
           if (_gtk_rc_match_widget_class (rc_set->path, path_length, path, path_reversed))
-	    rc_styles = g_slist_append (rc_styles, rc_set);
+	    rc_styles = g_slist_prepend (rc_styles, rc_set);
         }
       else
         {
           if (g_pattern_match (rc_set->pspec, path_length, path, path_reversed))
-	    rc_styles = g_slist_append (rc_styles, rc_set);
+	    rc_styles = g_slist_prepend (rc_styles, rc_set);
 	}
     }
 
   return rc_styles;
 }
 
+/* The number of (widget path, class path) pairs we remember matches
+ * for. When the cache fills up it is simply emptied; it refills with
+ * the paths that are actually in use.
+ */
+#define PATH_MATCH_CACHE_SIZE 2048
+
+static void
+gtk_rc_invalidate_match_cache (GtkRcContext *context)
+{
+  if (context->path_match_cache)
+    {
+      g_hash_table_destroy (context->path_match_cache);
+      context->path_match_cache = NULL;
+    }
+
+  if (context->class_match_cache)
+    {
+      g_hash_table_destroy (context->class_match_cache);
+      context->class_match_cache = NULL;
+    }
+}
+
+static GSList *
+gtk_rc_match_path (GSList      *rc_styles,
+		   GSList      *sets,
+		   const gchar *path)
+{
+  gchar *path_copy, *path_reversed;
+  guint path_length;
+
+  /* Matching widget class paths temporarily modifies the path */
+  path_length = strlen (path);
+  path_copy = g_strdup (path);
+  path_reversed = g_strdup (path);
+  g_strreverse (path_reversed);
+
+  rc_styles = gtk_rc_styles_match (rc_styles, sets, path_length, path_copy, path_reversed);
+
+  g_free (path_copy);
+  g_free (path_reversed);
+
+  return rc_styles;
+}
+
+/* Returns a new list of the widget and widget_class sets that match
+ * @widget_path and @class_path, in rc file order. Either path may be
+ * %NULL to skip matching it. Results are memoized per context, so
+ * every distinct pair of paths is only matched against all the sets
+ * once.
+ */
+static GSList *
+gtk_rc_match_paths (GtkRcContext *context,
+		    const gchar  *widget_path,
+		    const gchar  *class_path)
+{
+  GSList *rc_styles;
+  gchar *key;
+
+  if (!widget_path && !class_path)
+    return NULL;
+
+  key = g_strconcat (widget_path ? "+" : "-", widget_path ? widget_path : "", "\n",
+		     class_path ? "+" : "-", class_path ? class_path : "", NULL);
+
+  if (context->path_match_cache &&
+      g_hash_table_lookup_extended (context->path_match_cache, key,
+				    NULL, (gpointer *) &rc_styles))
+    {
+      g_free (key);
+      return g_slist_copy (rc_styles);
+    }
+
+  rc_styles = NULL;
+  if (widget_path)
+    rc_styles = gtk_rc_match_path (rc_styles, context->rc_sets_widget, widget_path);
+  if (class_path)
+    rc_styles = gtk_rc_match_path (rc_styles, context->rc_sets_widget_class, class_path);
+  rc_styles = g_slist_reverse (rc_styles);
+
+  if (!context->path_match_cache)
+    context->path_match_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) g_slist_free);
+  else if (g_hash_table_size (context->path_match_cache) >= PATH_MATCH_CACHE_SIZE)
+    g_hash_table_remove_all (context->path_match_cache);
+
+  g_hash_table_insert (context->path_match_cache, key, rc_styles);
+
+  return g_slist_copy (rc_styles);
+}
+
+/* Returns a new list of the class sets that match @type or one of its
+ * ancestors, most derived type first. The set of types in use is
+ * small and the type names never change, so the result is memoized
+ * for every type.
+ */
+static GSList *
+gtk_rc_match_type (GtkRcContext *context,
+		   GType         type)
+{
+  GSList *rc_styles;
+  GType parent;
+
+  if (!context->rc_sets_class || type == G_TYPE_NONE)
+    return NULL;
+
+  if (context->class_match_cache &&
+      g_hash_table_lookup_extended (context->class_match_cache, GSIZE_TO_POINTER (type),
+				    NULL, (gpointer *) &rc_styles))
+    return g_slist_copy (rc_styles);
+
+  rc_styles = NULL;
+  for (parent = type; parent; parent = g_type_parent (parent))
+    rc_styles = gtk_rc_match_path (rc_styles, context->rc_sets_class, g_type_name (parent));
+  rc_styles = g_slist_reverse (rc_styles);
+
+  if (!context->class_match_cache)
+    context->class_match_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							NULL, (GDestroyNotify) g_slist_free);
+
+  g_hash_table_insert (context->class_match_cache, GSIZE_TO_POINTER (type), rc_styles);
+
+  return g_slist_copy (rc_styles);
+}
+
 static gint
 rc_set_compare (gconstpointer a, gconstpointer b)
 {
@@ -1980,52 +2487,24 @@ gtk_rc_get_style (GtkWidget *widget)
   if (!rc_style_key_id)
     rc_style_key_id = g_quark_from_static_string ("gtk-rc-style");
 
-  if (context->rc_sets_widget)
+  if (context->rc_sets_widget || context->rc_sets_widget_class)
     {
-      gchar *path, *path_reversed;
-      guint path_length;
+      gchar *path = NULL;
+      gchar *class_path = NULL;
 
-      gtk_widget_path (widget, &path_length, &path, &path_reversed);
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-  
-  if (context->rc_sets_widget_class)
-    {
-      gchar *path, *path_reversed;
-      guint path_length;
+      if (context->rc_sets_widget)
+	gtk_widget_path (widget, NULL, &path, NULL);
+      if (context->rc_sets_widget_class)
+	gtk_widget_class_path (widget, NULL, &class_path, NULL);
 
-      gtk_widget_class_path (widget, &path_length, &path, &path_reversed);
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget_class, path_length, path, path_reversed);
+      rc_styles = gtk_rc_match_paths (context, path, class_path);
       g_free (path);
-      g_free (path_reversed);
+      g_free (class_path);
     }
 
-  if (context->rc_sets_class)
-    {
-      GType type;
+  rc_styles = g_slist_concat (rc_styles,
+			      gtk_rc_match_type (context, G_TYPE_FROM_INSTANCE (widget)));
 
-      type = G_TYPE_FROM_INSTANCE (widget);
-      while (type)
-	{
-	  gchar *path;
-          gchar *path_reversed;
-	  guint path_length;
-
-	  path = g_strdup (g_type_name (type));
-	  path_length = strlen (path);
-	  path_reversed = g_strdup (path);
-	  g_strreverse (path_reversed);
-	  
-	  rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_class, path_length, path, path_reversed);
-	  g_free (path);
-	  g_free (path_reversed);
-      
-	  type = g_type_parent (type);
-	}
-    }
-  
   rc_styles = sort_and_dereference_sets (rc_styles);
   
   widget_rc_style = g_object_get_qdata (G_OBJECT (widget), rc_style_key_id);
@@ -2084,10 +2563,6 @@ gtk_rc_get_style_by_paths (GtkSettings *settings,
 			   const char  *class_path,
 			   GType        type)
 {
-  /* We duplicate the code from above to avoid slowing down the above
-   * by generating paths when we don't need them. I don't know if
-   * this is really worth it.
-   */
   GSList *rc_styles = NULL;
   GtkRcContext *context;
 
@@ -2095,58 +2570,13 @@ gtk_rc_get_style_by_paths (GtkSettings *settings,
 
   context = gtk_rc_context_get (settings);
 
-  if (widget_path && context->rc_sets_widget)
-    {
-      gchar *path;
-      gchar *path_reversed;
-      guint path_length;
-
-      path_length = strlen (widget_path);
-      path = g_strdup (widget_path);
-      path_reversed = g_strdup (widget_path);
-      g_strreverse (path_reversed);
+  if (!context->rc_sets_widget)
+    widget_path = NULL;
+  if (!context->rc_sets_widget_class)
+    class_path = NULL;
 
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-  
-  if (class_path && context->rc_sets_widget_class)
-    {
-      gchar *path;
-      gchar *path_reversed;
-      guint path_length;
-
-      path = g_strdup (class_path);
-      path_length = strlen (class_path);
-      path_reversed = g_strdup (class_path);
-      g_strreverse (path_reversed);
-
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget_class, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-
-  if (type != G_TYPE_NONE && context->rc_sets_class)
-    {
-      while (type)
-	{
-	  gchar *path;
-          gchar *path_reversed;
-	  guint path_length;
-
-	  path = g_strdup (g_type_name (type));
-	  path_length = strlen (path);
-	  path_reversed = g_strdup (path);
-	  g_strreverse (path_reversed);
-	  
-	  rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_class, path_length, path, path_reversed);
-	  g_free (path);
-	  g_free (path_reversed);
-      
-	  type = g_type_parent (type);
-	}
-    }
+  rc_styles = gtk_rc_match_paths (context, widget_path, class_path);
+  rc_styles = g_slist_concat (rc_styles, gtk_rc_match_type (context, type));
  
   rc_styles = sort_and_dereference_sets (rc_styles);
   
@@ -2206,6 +2636,7 @@ gtk_rc_add_widget_name_style (GtkRcStyle  *rc_style,
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
   context->rc_sets_widget = gtk_rc_add_rc_sets (context->rc_sets_widget, rc_style, pattern, GTK_PATH_WIDGET);
+  gtk_rc_invalidate_match_cache (context);
 }
 
 void
@@ -2220,6 +2651,7 @@ gtk_rc_add_widget_class_style (GtkRcStyle  *rc_style,
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
   context->rc_sets_widget_class = gtk_rc_add_rc_sets (context->rc_sets_widget_class, rc_style, pattern, GTK_PATH_WIDGET_CLASS);
+  gtk_rc_invalidate_match_cache (context);
 }
 
 void
@@ -2234,6 +2666,7 @@ gtk_rc_add_class_style (GtkRcStyle  *rc_style,
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
   context->rc_sets_class = gtk_rc_add_rc_sets (context->rc_sets_class, rc_style, pattern, GTK_PATH_CLASS);
+  gtk_rc_invalidate_match_cache (context);
 }
 
 GScanner*
@@ -2412,6 +2845,184 @@ gtk_rc_style_to_style (GtkRcContext *context,
   return style;
 }
 
+/* Styles created from rc styles with the same content are shared, even
+ * when the rc style lists differ: different widget paths often end up
+ * with identical merged styles, and every screen has its own
+ * GtkRcContext with its own copies of the same rc styles. This only
+ * applies to styles without a theme engine, since the data engines
+ * keep in their rc styles can't be compared.
+ */
+static GHashTable *shared_style_ht = NULL;
+static guint n_styles_created = 0;
+static guint n_styles_shared = 0;
+
+static gint
+compare_color_names (gconstpointer a,
+		     gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static void
+append_color_hash (GString    *key,
+		   GHashTable *hash)
+{
+  GHashTableIter iter;
+  GPtrArray *names;
+  gpointer name;
+  guint i;
+
+  names = g_ptr_array_new ();
+
+  g_hash_table_iter_init (&iter, hash);
+  while (g_hash_table_iter_next (&iter, &name, NULL))
+    g_ptr_array_add (names, name);
+
+  g_ptr_array_sort (names, compare_color_names);
+
+  for (i = 0; i < names->len; i++)
+    {
+      GdkColor *color = g_hash_table_lookup (hash, names->pdata[i]);
+
+      g_string_append_printf (key, "%s=%04x%04x%04x;", (gchar *) names->pdata[i],
+			      color->red, color->green, color->blue);
+    }
+
+  g_string_append_c (key, '\n');
+
+  g_ptr_array_free (names, TRUE);
+}
+
+/* Returns a string describing everything that goes into the style
+ * created from rc_style in context, or %NULL if the style can't be
+ * shared.
+ */
+static gchar *
+gtk_rc_style_get_content_key (GtkRcContext *context,
+			      GtkRcStyle   *rc_style)
+{
+  GtkRcStylePrivate *priv = GTK_RC_STYLE_GET_PRIVATE (rc_style);
+  GString *key;
+  GSList *tmp_list;
+  gchar *str;
+  guint i;
+
+  if (G_OBJECT_TYPE (rc_style) != GTK_TYPE_RC_STYLE)
+    return NULL;
+
+  key = g_string_new (_gtk_rc_context_get_default_font_name (context->settings));
+  g_string_append_c (key, '\n');
+
+  if (rc_style->font_desc)
+    {
+      str = pango_font_description_to_string (rc_style->font_desc);
+      g_string_append (key, str);
+      g_free (str);
+    }
+  g_string_append_c (key, '\n');
+
+  for (i = 0; i < 5; i++)
+    g_string_append_printf (key, "%d %04x%04x%04x %04x%04x%04x %04x%04x%04x %04x%04x%04x %s\n",
+			    rc_style->color_flags[i],
+			    rc_style->fg[i].red, rc_style->fg[i].green, rc_style->fg[i].blue,
+			    rc_style->bg[i].red, rc_style->bg[i].green, rc_style->bg[i].blue,
+			    rc_style->text[i].red, rc_style->text[i].green, rc_style->text[i].blue,
+			    rc_style->base[i].red, rc_style->base[i].green, rc_style->base[i].blue,
+			    rc_style->bg_pixmap_name[i] ? rc_style->bg_pixmap_name[i] : "");
+
+  g_string_append_printf (key, "%d %d %d\n",
+			  rc_style->xthickness, rc_style->ythickness,
+			  rc_style->engine_specified);
+
+  /* Values that print as pointers, such as unparsed GStrings, only
+   * match themselves; they stay alive as long as the style does.
+   */
+  if (rc_style->rc_properties)
+    for (i = 0; i < rc_style->rc_properties->len; i++)
+      {
+	GtkRcProperty *node = &g_array_index (rc_style->rc_properties, GtkRcProperty, i);
+
+	str = g_strdup_value_contents (&node->value);
+	g_string_append_printf (key, "%s::%s=%s\n",
+				g_quark_to_string (node->type_name),
+				g_quark_to_string (node->property_name),
+				str);
+	g_free (str);
+      }
+
+  /* Icon factories are compared by identity, not by their icons.
+   * Every parse of an rc file creates its own factories, so styles
+   * with icons are only shared within one GtkRcContext, never
+   * between the contexts of different screens.
+   */
+  for (tmp_list = rc_style->icon_factories; tmp_list; tmp_list = tmp_list->next)
+    g_string_append_printf (key, "%p ", tmp_list->data);
+  g_string_append_c (key, '\n');
+
+  for (tmp_list = priv->color_hashes; tmp_list; tmp_list = tmp_list->next)
+    append_color_hash (key, tmp_list->data);
+
+  return g_string_free (key, FALSE);
+}
+
+static void
+shared_style_finalized (gpointer  data,
+			GObject  *where_the_object_was)
+{
+  g_hash_table_remove (shared_style_ht, data);
+}
+
+static GtkStyle *
+gtk_rc_style_to_shared_style (GtkRcContext *context,
+			      GtkRcStyle   *rc_style)
+{
+  GtkStyle *style = NULL;
+  gchar *key;
+
+  key = gtk_rc_style_get_content_key (context, rc_style);
+
+  if (key && shared_style_ht)
+    style = g_hash_table_lookup (shared_style_ht, key);
+
+  if (style)
+    {
+      n_styles_shared++;
+      g_free (key);
+
+      return g_object_ref (style);
+    }
+
+  style = gtk_rc_style_to_style (context, rc_style);
+  n_styles_created++;
+
+  if (key)
+    {
+      if (!shared_style_ht)
+	shared_style_ht = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, NULL);
+
+      /* The table holds no reference, the entry goes with the style */
+      g_hash_table_insert (shared_style_ht, key, style);
+      g_object_weak_ref (G_OBJECT (style), shared_style_finalized, key);
+    }
+
+  return style;
+}
+
+static void
+gtk_rc_print_style_stats (void)
+{
+  GTypeQuery query;
+
+  g_type_query (GTK_TYPE_STYLE, &query);
+
+  g_print ("rc styles: %u created, %u shared, %u sharable alive, "
+	   "at least %" G_GSIZE_FORMAT " bytes saved\n",
+	   n_styles_created, n_styles_shared,
+	   shared_style_ht ? g_hash_table_size (shared_style_ht) : 0,
+	   (gsize) n_styles_shared * query.instance_size);
+}
+
 /* Reuses or frees rc_styles */
 static GtkStyle *
 gtk_rc_init_style (GtkRcContext *context,
@@ -2485,7 +3096,7 @@ gtk_rc_init_style (GtkRcContext *context,
 	    proto_style->bg_pixmap_name[i] = NULL;
 	  }
 
-      style = gtk_rc_style_to_style (context, proto_style);
+      style = gtk_rc_style_to_shared_style (context, proto_style);
       g_object_unref (proto_style);
 
       g_hash_table_insert (realized_style_ht, rc_styles, style);
@@ -4308,6 +4919,8 @@ gtk_rc_parse_path_pattern (GtkRcContext *context,
 	context->rc_sets_widget_class = g_slist_prepend (context->rc_sets_widget_class, rc_set);
       else
 	context->rc_sets_class = g_slist_prepend (context->rc_sets_class, rc_set);
+
+      gtk_rc_invalidate_match_cache (context);
     }
 
   g_free (pattern);
@@ -0,0 +1,79 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_RC_CACHE_H__
+#define __GTK_RC_CACHE_H__
+
+/* Layout of the gtkrc cache files written by gtk-update-rc-cache and
+ * read by gtk_rc_context_parse_file().
+ *
+ * The cache for an rc file FILE is stored next to it as FILE.cache.
+ * It holds the contents of FILE and of every file it includes, with
+ * the includes expanded in place, split into chunks at the include
+ * statements. Comments and whitespace are dropped, except for newlines,
+ * so that line numbers in warnings stay correct. The chunks are still
+ * text and go through the regular scanner when they are parsed. The
+ * cache also lists all files that went into it with their modification
+ * time and size; if any of them changed, the cache is ignored.
+ *
+ * All numbers are stored big-endian, all offsets are from the start
+ * of the file and all strings are nul-terminated.
+ *
+ * Header:
+ * 2			CARD16		MAJOR_VERSION	1
+ * 2			CARD16		MINOR_VERSION	0
+ * 4			CARD32		FILE_LIST_OFFSET
+ * 4			CARD32		CHUNK_LIST_OFFSET
+ *
+ * FileList:
+ * 4			CARD32		N_FILES
+ * 16 * N_FILES		File		FILES
+ *
+ * File:
+ * 4			CARD32		NAME_OFFSET	absolute path
+ * 4			CARD32		MTIME		lower 32 bits
+ * 4			CARD32		SIZE
+ * 4			CARD32		FLAGS
+ *
+ * ChunkList:
+ * 4			CARD32		N_CHUNKS
+ * 12 * N_CHUNKS	Chunk		CHUNKS
+ *
+ * Chunk:
+ * 4			CARD32		FILE_INDEX
+ * 4			CARD32		DEPTH		include depth, 0 for FILE
+ * 4			CARD32		TEXT_OFFSET
+ *
+ * The first file is FILE itself.
+ */
+
+#define GTK_RC_CACHE_SUFFIX        ".cache"
+#define GTK_RC_CACHE_MAJOR_VERSION 1
+#define GTK_RC_CACHE_MINOR_VERSION 0
+
+#define GTK_RC_CACHE_HEADER_SIZE   12
+#define GTK_RC_CACHE_FILE_SIZE     16
+#define GTK_RC_CACHE_CHUNK_SIZE    12
+
+/* The directory of the file has locale specific variants of it,
+ * like gtkrc.ja; see gtk_rc_context_parse_file().
+ */
+#define GTK_RC_CACHE_FILE_HAS_LOCALE_VARIANTS (1 << 0)
+
+#endif /* __GTK_RC_CACHE_H__ */
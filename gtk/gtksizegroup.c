@@ -154,127 +154,161 @@ real_queue_resize (GtkWidget *widget)
 {
   GTK_PRIVATE_SET_FLAG (widget, GTK_ALLOC_NEEDED);
   GTK_PRIVATE_SET_FLAG (widget, GTK_REQUEST_NEEDED);
-  
+  GTK_PRIVATE_UNSET_FLAG (widget, GTK_DESCENDANT_RESIZE);
+
   if (widget->parent)
     _gtk_container_queue_resize (GTK_CONTAINER (widget->parent));
   else if (gtk_widget_is_toplevel (widget) && GTK_IS_CONTAINER (widget))
     _gtk_container_queue_resize (GTK_CONTAINER (widget));
 }
 
+static gboolean
+group_has_mode (GtkSizeGroup     *size_group,
+		GtkSizeGroupMode  mode)
+{
+  return size_group->mode == GTK_SIZE_GROUP_BOTH || size_group->mode == mode;
+}
+
+/* The cached size of a group is shared by all groups that are
+ * connected by widgets in more than one of them, so invalidating
+ * one of them invalidates all. Since the groups of such a closure
+ * are either all valid or all invalid, we can stop at the first
+ * group that already is. The groups that were valid are added to
+ * @invalidated.
+ */
 static void
-reset_group_sizes (GSList *groups)
+invalidate_group (GtkSizeGroup      *size_group,
+		  GtkSizeGroupMode   mode,
+		  GSList           **invalidated)
 {
-  GSList *tmp_list = groups;
-  while (tmp_list)
+  GSList *tmp_widgets;
+
+  if (mode == GTK_SIZE_GROUP_HORIZONTAL)
     {
-      GtkSizeGroup *tmp_group = tmp_list->data;
+      if (!size_group->have_width)
+	return;
+      size_group->have_width = FALSE;
+    }
+  else
+    {
+      if (!size_group->have_height)
+	return;
+      size_group->have_height = FALSE;
+    }
 
-      tmp_group->have_width = FALSE;
-      tmp_group->have_height = FALSE;
-      
-      tmp_list = tmp_list->next;
+  if (!g_slist_find (*invalidated, size_group))
+    *invalidated = g_slist_prepend (*invalidated, size_group);
+
+  for (tmp_widgets = size_group->widgets; tmp_widgets; tmp_widgets = tmp_widgets->next)
+    {
+      GSList *tmp_groups = get_size_groups (tmp_widgets->data);
+
+      if (tmp_groups->next)
+	for (; tmp_groups; tmp_groups = tmp_groups->next)
+	  if (group_has_mode (tmp_groups->data, mode))
+	    invalidate_group (tmp_groups->data, mode, invalidated);
     }
 }
 
 static void
-queue_resize_on_widget (GtkWidget *widget,
-			gboolean   check_siblings)
+invalidate_widget_groups (GtkWidget  *widget,
+			  GSList    **invalidated)
 {
-  GtkWidget *parent = widget;
-  GSList *tmp_list;
+  GSList *tmp_groups;
 
-  while (parent)
+  for (tmp_groups = get_size_groups (widget); tmp_groups; tmp_groups = tmp_groups->next)
     {
-      GSList *widget_groups;
-      GSList *groups;
-      GSList *widgets;
-      
-      if (widget == parent && !check_siblings)
-	{
-	  real_queue_resize (widget);
-	  parent = parent->parent;
-	  continue;
-	}
-      
-      widget_groups = get_size_groups (parent);
-      if (!widget_groups)
-	{
-	  if (widget == parent)
-	    real_queue_resize (widget);
+      GtkSizeGroup *tmp_group = tmp_groups->data;
 
-	  parent = parent->parent;
-	  continue;
-	}
+      if (group_has_mode (tmp_group, GTK_SIZE_GROUP_HORIZONTAL))
+	invalidate_group (tmp_group, GTK_SIZE_GROUP_HORIZONTAL, invalidated);
+      if (group_has_mode (tmp_group, GTK_SIZE_GROUP_VERTICAL))
+	invalidate_group (tmp_group, GTK_SIZE_GROUP_VERTICAL, invalidated);
+    }
+}
 
-      groups = NULL;
-      widgets = NULL;
-	  
-      add_widget_to_closure (parent, GTK_SIZE_GROUP_HORIZONTAL, &groups, &widgets);
-      g_slist_foreach (widgets, (GFunc)mark_unvisited, NULL);
-      g_slist_foreach (groups, (GFunc)mark_unvisited, NULL);
-
-      reset_group_sizes (groups);
-	      
-      tmp_list = widgets;
-      while (tmp_list)
-	{
-	  if (tmp_list->data == parent)
-	    {
-	      if (widget == parent)
-		real_queue_resize (parent);
-	    }
-	  else if (tmp_list->data == widget)
-            {
-              g_warning ("A container and its child are part of this SizeGroup");
-            }
-	  else
-	    queue_resize_on_widget (tmp_list->data, FALSE);
-
-	  tmp_list = tmp_list->next;
-	}
-      
-      g_slist_free (widgets);
-      g_slist_free (groups);
-	      
-      groups = NULL;
-      widgets = NULL;
-	      
-      add_widget_to_closure (parent, GTK_SIZE_GROUP_VERTICAL, &groups, &widgets);
-      g_slist_foreach (widgets, (GFunc)mark_unvisited, NULL);
-      g_slist_foreach (groups, (GFunc)mark_unvisited, NULL);
-
-      reset_group_sizes (groups);
-	      
-      tmp_list = widgets;
-      while (tmp_list)
+static void queue_resize_on_members (GtkSizeGroup *size_group,
+				     GtkWidget    *except);
+
+static void
+queue_resize_on_groups (GSList    *groups,
+			GtkWidget *except)
+{
+  GSList *tmp_groups;
+
+  for (tmp_groups = groups; tmp_groups; tmp_groups = tmp_groups->next)
+    queue_resize_on_members (tmp_groups->data, except);
+
+  g_slist_free (groups);
+}
+
+/* Queues a resize on @widget. The requisitions of its ancestors may
+ * change as a result, so the groups of all of them are invalidated,
+ * and the other members of the groups that were valid are queued to
+ * pick up the new size. A group that is invalid already had that
+ * done when it was invalidated, and is only computed again during
+ * the next size request, so this is the only place where the other
+ * members of a group get queued.
+ */
+static void
+queue_resize_on_widget (GtkWidget *widget)
+{
+  GtkWidget *parent;
+
+  real_queue_resize (widget);
+
+  for (parent = widget; parent; parent = parent->parent)
+    {
+      GSList *invalidated = NULL;
+
+      if (!get_size_groups (parent))
+	continue;
+
+      invalidate_widget_groups (parent, &invalidated);
+      queue_resize_on_groups (invalidated, parent);
+    }
+}
+
+/* Queues a resize on the parents of the members of @size_group, so
+ * that they pick up the new size of the group. The members themselves
+ * keep their requisitions.
+ */
+static void
+queue_resize_on_members (GtkSizeGroup *size_group,
+			 GtkWidget    *except)
+{
+  GSList *tmp_widgets;
+
+  for (tmp_widgets = size_group->widgets; tmp_widgets; tmp_widgets = tmp_widgets->next)
+    {
+      GtkWidget *tmp_widget = tmp_widgets->data;
+
+      if (tmp_widget == except)
+	continue;
+
+      if (tmp_widget->parent)
 	{
-	  if (tmp_list->data == parent)
-	    {
-	      if (widget == parent)
-		real_queue_resize (parent);
-	    }
-	  else if (tmp_list->data == widget)
-            {
-              g_warning ("A container and its child are part of this SizeGroup");
-            }
-	  else
-	    queue_resize_on_widget (tmp_list->data, FALSE);
-
-	  tmp_list = tmp_list->next;
+	  /* Whoever queued it took care of its groups already */
+	  if (!GTK_WIDGET_REQUEST_NEEDED (tmp_widget->parent))
+	    queue_resize_on_widget (tmp_widget->parent);
 	}
-      
-      g_slist_free (widgets);
-      g_slist_free (groups);
-      
-      parent = parent->parent;
+      else
+	real_queue_resize (tmp_widget);
     }
 }
 
+/* Invalidates the size of @size_group and queues its members */
 static void
 queue_resize_on_group (GtkSizeGroup *size_group)
 {
-  if (size_group->widgets)
-    queue_resize_on_widget (size_group->widgets->data, TRUE);
+  GSList *invalidated = NULL;
+
+  if (group_has_mode (size_group, GTK_SIZE_GROUP_HORIZONTAL))
+    invalidate_group (size_group, GTK_SIZE_GROUP_HORIZONTAL, &invalidated);
+  if (group_has_mode (size_group, GTK_SIZE_GROUP_VERTICAL))
+    invalidate_group (size_group, GTK_SIZE_GROUP_VERTICAL, &invalidated);
+
+  queue_resize_on_groups (invalidated, NULL);
 }
 
 static void
@@ -427,11 +461,22 @@ gtk_size_group_set_mode (GtkSizeGroup     *size_group,
 
   if (size_group->mode != mode)
     {
-      if (size_group->mode != GTK_SIZE_GROUP_NONE)
-	queue_resize_on_group (size_group);
+      GSList *tmp_widgets;
+      GSList *invalidated = NULL;
+
+      queue_resize_on_group (size_group);
       size_group->mode = mode;
-      if (size_group->mode != GTK_SIZE_GROUP_NONE)
-	queue_resize_on_group (size_group);
+
+      /* The group may now join the closures of other groups of its
+       * members, in which its old cached size means nothing.
+       */
+      size_group->have_width = FALSE;
+      size_group->have_height = FALSE;
+      for (tmp_widgets = size_group->widgets; tmp_widgets; tmp_widgets = tmp_widgets->next)
+	invalidate_widget_groups (tmp_widgets->data, &invalidated);
+
+      queue_resize_on_groups (invalidated, NULL);
+      queue_resize_on_members (size_group, NULL);
 
       g_object_notify (G_OBJECT (size_group), "mode");
     }
@@ -543,8 +588,9 @@ gtk_size_group_add_widget (GtkSizeGroup     *size_group,
 
       g_object_ref (size_group);
     }
-  
-  queue_resize_on_group (size_group);
+
+  /* The closures of the groups of @widget are merged now */
+  queue_resize_on_widget (widget);
 }
 
 /**
@@ -618,16 +664,51 @@ get_base_dimension (GtkWidget        *widget,
     }
 }
 
+static void
+request_descendant (GtkWidget *child,
+		    gpointer   data)
+{
+  gboolean *changed = data;
+  GtkRequisition old_requisition;
+
+  if (!GTK_WIDGET_REQUEST_NEEDED (child))
+    return;
+
+  old_requisition = child->requisition;
+  _gtk_size_group_compute_requisition (child, NULL);
+
+  if (child->requisition.width != old_requisition.width ||
+      child->requisition.height != old_requisition.height)
+    *changed = TRUE;
+}
+
 static void
 do_size_request (GtkWidget *widget)
 {
   if (GTK_WIDGET_REQUEST_NEEDED (widget))
     {
-      gtk_widget_ensure_style (widget);      
+      gtk_widget_ensure_style (widget);
       GTK_PRIVATE_UNSET_FLAG (widget, GTK_REQUEST_NEEDED);
-      g_signal_emit_by_name (widget,
-			     "size-request",
-			     &widget->requisition);
+
+      /* When the resize was queued further down, the requisition can
+       * only change if the requisition of one of the children did.
+       * Otherwise keep the old one, and leave GTK_DESCENDANT_RESIZE
+       * set so that gtk_widget_size_allocate() can skip the layout
+       * as well.
+       */
+      if (GTK_WIDGET_DESCENDANT_RESIZE (widget))
+	{
+	  gboolean changed = FALSE;
+
+	  gtk_container_forall (GTK_CONTAINER (widget),
+				request_descendant, &changed);
+	  if (!changed)
+	    return;
+
+	  GTK_PRIVATE_UNSET_FLAG (widget, GTK_DESCENDANT_RESIZE);
+	}
+
+      _gtk_widget_emit_size_request (widget, &widget->requisition);
     }
 }
 
@@ -640,71 +721,88 @@ compute_base_dimension (GtkWidget        *widget,
   return get_base_dimension (widget, mode);
 }
 
+static GtkSizeGroup *
+get_mode_group (GtkWidget        *widget,
+		GtkSizeGroupMode  mode)
+{
+  GSList *tmp_groups;
+
+  for (tmp_groups = get_size_groups (widget); tmp_groups; tmp_groups = tmp_groups->next)
+    if (group_has_mode (tmp_groups->data, mode))
+      return tmp_groups->data;
+
+  return NULL;
+}
+
+/* Computes the size of the closure of groups of @widget in the
+ * direction of @mode, and stores it in all of them. If @request is
+ * %TRUE, members that need a size request get one first; otherwise
+ * the size is only stored if none of them needs one, since it would
+ * be computed from old requisitions. Nothing gets queued here, that
+ * happened when the groups were invalidated.
+ */
 static gint
-compute_dimension (GtkWidget        *widget,
-		   GtkSizeGroupMode  mode)
+update_group_dimension (GtkWidget        *widget,
+			GtkSizeGroupMode  mode,
+			gboolean          request)
 {
   GSList *widgets = NULL;
   GSList *groups = NULL;
   GSList *tmp_list;
+  GtkSizeGroup *group;
+  gboolean complete = TRUE;
   gint result = 0;
 
   add_widget_to_closure (widget, mode, &groups, &widgets);
 
   g_slist_foreach (widgets, (GFunc)mark_unvisited, NULL);
   g_slist_foreach (groups, (GFunc)mark_unvisited, NULL);
-  
+
   g_slist_foreach (widgets, (GFunc)g_object_ref, NULL);
-  
-  if (!groups)
+
+  group = groups->data;
+
+  tmp_list = widgets;
+  while (tmp_list)
     {
-      result = compute_base_dimension (widget, mode);
+      GtkWidget *tmp_widget = tmp_list->data;
+      gint dimension;
+
+      if (request)
+	dimension = compute_base_dimension (tmp_widget, mode);
+      else
+	{
+	  if (GTK_WIDGET_REQUEST_NEEDED (tmp_widget))
+	    complete = FALSE;
+	  dimension = get_base_dimension (tmp_widget, mode);
+	}
+
+      if (gtk_widget_get_mapped (tmp_widget) || !group->ignore_hidden)
+	{
+	  if (dimension > result)
+	    result = dimension;
+	}
+
+      tmp_list = tmp_list->next;
     }
-  else
+
+  tmp_list = complete ? groups : NULL;
+  while (tmp_list)
     {
-      GtkSizeGroup *group = groups->data;
+      GtkSizeGroup *tmp_group = tmp_list->data;
 
-      if (mode == GTK_SIZE_GROUP_HORIZONTAL && group->have_width)
-	result = group->requisition.width;
-      else if (mode == GTK_SIZE_GROUP_VERTICAL && group->have_height)
-	result = group->requisition.height;
+      if (mode == GTK_SIZE_GROUP_HORIZONTAL)
+	{
+	  tmp_group->have_width = TRUE;
+	  tmp_group->requisition.width = result;
+	}
       else
 	{
-	  tmp_list = widgets;
-	  while (tmp_list)
-	    {
-	      GtkWidget *tmp_widget = tmp_list->data;
-
-	      gint dimension = compute_base_dimension (tmp_widget, mode);
-
-	      if (gtk_widget_get_mapped (tmp_widget) || !group->ignore_hidden)
-		{
-		  if (dimension > result)
-		    result = dimension;
-		}
-
-	      tmp_list = tmp_list->next;
-	    }
-
-	  tmp_list = groups;
-	  while (tmp_list)
-	    {
-	      GtkSizeGroup *tmp_group = tmp_list->data;
-
-	      if (mode == GTK_SIZE_GROUP_HORIZONTAL)
-		{
-		  tmp_group->have_width = TRUE;
-		  tmp_group->requisition.width = result;
-		}
-	      else
-		{
-		  tmp_group->have_height = TRUE;
-		  tmp_group->requisition.height = result;
-		}
-	      
-	      tmp_list = tmp_list->next;
-	    }
+	  tmp_group->have_height = TRUE;
+	  tmp_group->requisition.height = result;
 	}
+
+      tmp_list = tmp_list->next;
     }
 
   g_slist_foreach (widgets, (GFunc)g_object_unref, NULL);
@@ -716,36 +814,41 @@ compute_dimension (GtkWidget        *widget,
 }
 
 static gint
-get_dimension (GtkWidget        *widget,
-	       GtkSizeGroupMode  mode)
+compute_dimension (GtkWidget        *widget,
+		   GtkSizeGroupMode  mode)
 {
-  GSList *widgets = NULL;
-  GSList *groups = NULL;
-  gint result = 0;
+  GtkSizeGroup *group;
 
-  add_widget_to_closure (widget, mode, &groups, &widgets);
+  do_size_request (widget);
 
-  g_slist_foreach (widgets, (GFunc)mark_unvisited, NULL);
-  g_slist_foreach (groups, (GFunc)mark_unvisited, NULL);  
+  group = get_mode_group (widget, mode);
+  if (!group)
+    return get_base_dimension (widget, mode);
 
-  if (!groups)
-    {
-      result = get_base_dimension (widget, mode);
-    }
+  if (mode == GTK_SIZE_GROUP_HORIZONTAL && group->have_width)
+    return group->requisition.width;
+  else if (mode == GTK_SIZE_GROUP_VERTICAL && group->have_height)
+    return group->requisition.height;
   else
-    {
-      GtkSizeGroup *group = groups->data;
+    return update_group_dimension (widget, mode, TRUE);
+}
 
-      if (mode == GTK_SIZE_GROUP_HORIZONTAL && group->have_width)
-	result = group->requisition.width;
-      else if (mode == GTK_SIZE_GROUP_VERTICAL && group->have_height)
-	result = group->requisition.height;
-    }
+static gint
+get_dimension (GtkWidget        *widget,
+	       GtkSizeGroupMode  mode)
+{
+  GtkSizeGroup *group;
 
-  g_slist_free (widgets);
-  g_slist_free (groups);
+  group = get_mode_group (widget, mode);
+  if (!group)
+    return get_base_dimension (widget, mode);
 
-  return result;
+  if (mode == GTK_SIZE_GROUP_HORIZONTAL && group->have_width)
+    return group->requisition.width;
+  else if (mode == GTK_SIZE_GROUP_VERTICAL && group->have_height)
+    return group->requisition.height;
+  else
+    return update_group_dimension (widget, mode, FALSE);
 }
 
 static void
@@ -836,14 +939,15 @@ _gtk_size_group_compute_requisition (GtkWidget      *widget,
  * _gtk_size_group_queue_resize:
  * @widget: a #GtkWidget
  * 
- * Queue a resize on a widget, and on all other widgets grouped with this widget.
+ * Queue a resize on a widget. The other widgets grouped with this widget
+ * are only resized if the size of the group changes as a result.
  **/
 void
 _gtk_size_group_queue_resize (GtkWidget *widget)
 {
   initialize_size_group_quarks ();
 
-  queue_resize_on_widget (widget, TRUE);
+  queue_resize_on_widget (widget);
 }
 
 typedef struct {
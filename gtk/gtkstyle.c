@@ -1979,19 +1979,126 @@ _gtk_style_peek_property_value (GtkStyle           *style,
   return &pcache->value;
 }
 
+typedef struct
+{
+  GHashTable *pixmaps;
+  gchar *key;
+} SharedBgPixmap;
+
+static void
+shared_bg_pixmap_finalized (gpointer  data,
+			    GObject  *where_the_object_was)
+{
+  SharedBgPixmap *shared = data;
+
+  g_hash_table_remove (shared->pixmaps, shared->key);
+
+  g_free (shared->key);
+  g_slice_free (SharedBgPixmap, shared);
+}
+
+/* Background pixmaps are shared between all styles that use the same
+ * file with the same background color on a colormap, since themes
+ * tend to set the same pixmap for many styles. The pixmaps keep their
+ * colormap alive, so the table on the colormap outlives them.
+ */
 static GdkPixmap *
 load_bg_image (GdkColormap *colormap,
 	       GdkColor    *bg_color,
 	       const gchar *filename)
 {
+  static GQuark quark_bg_pixmaps = 0;
+  GHashTable *pixmaps;
+  GdkPixmap *pixmap;
+  SharedBgPixmap *shared;
+  gchar *key;
+
   if (strcmp (filename, "<parent>") == 0)
     return (GdkPixmap*) GDK_PARENT_RELATIVE;
-  else
+
+  if (G_UNLIKELY (!quark_bg_pixmaps))
+    quark_bg_pixmaps = g_quark_from_static_string ("gtk-style-bg-pixmaps");
+
+  pixmaps = g_object_get_qdata (G_OBJECT (colormap), quark_bg_pixmaps);
+  if (!pixmaps)
+    {
+      pixmaps = g_hash_table_new (g_str_hash, g_str_equal);
+      g_object_set_qdata_full (G_OBJECT (colormap), quark_bg_pixmaps,
+			       pixmaps, (GDestroyNotify) g_hash_table_destroy);
+    }
+
+  key = g_strdup_printf ("%04x%04x%04x %s",
+			 bg_color->red, bg_color->green, bg_color->blue,
+			 filename);
+
+  pixmap = g_hash_table_lookup (pixmaps, key);
+  if (pixmap)
+    {
+      g_free (key);
+      return g_object_ref (pixmap);
+    }
+
+  pixmap = gdk_pixmap_colormap_create_from_xpm (NULL, colormap, NULL,
+						bg_color,
+						filename);
+  if (!pixmap)
     {
-      return gdk_pixmap_colormap_create_from_xpm (NULL, colormap, NULL,
-						  bg_color,
-						  filename);
+      g_free (key);
+      return NULL;
     }
+
+  shared = g_slice_new (SharedBgPixmap);
+  shared->pixmaps = pixmaps;
+  shared->key = key;
+  g_hash_table_insert (pixmaps, key, pixmap);
+  g_object_weak_ref (G_OBJECT (pixmap), shared_bg_pixmap_finalized, shared);
+
+  return pixmap;
+}
+
+/* Allocates all colors of the style with one call, so that the
+ * colormap can batch the work instead of handling 42 separate
+ * requests.
+ */
+static void
+alloc_style_colors (GtkStyle *style)
+{
+  GdkColor *color_sets[] = {
+    style->fg, style->bg, style->light, style->dark,
+    style->mid, style->text, style->base, style->text_aa
+  };
+  GdkColor colors[G_N_ELEMENTS (color_sets) * 5 + 2];
+  gboolean success[G_N_ELEMENTS (colors)];
+  gint n_colors = G_N_ELEMENTS (colors);
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (color_sets); i++)
+    memcpy (colors + 5 * i, color_sets[i], 5 * sizeof (GdkColor));
+
+  style->black.red = 0x0000;
+  style->black.green = 0x0000;
+  style->black.blue = 0x0000;
+  colors[n_colors - 2] = style->black;
+
+  style->white.red = 0xffff;
+  style->white.green = 0xffff;
+  style->white.blue = 0xffff;
+  colors[n_colors - 1] = style->white;
+
+  if (gdk_colormap_alloc_colors (style->colormap, colors, n_colors,
+				 FALSE, TRUE, success) > 0)
+    {
+      for (i = 0; i < n_colors - 2; i++)
+	if (!success[i])
+	  g_warning ("unable to allocate color: ( %d %d %d )",
+		     colors[i].red, colors[i].green, colors[i].blue);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (color_sets); i++)
+    memcpy (color_sets[i], colors + 5 * i, 5 * sizeof (GdkColor));
+
+  style->black = colors[n_colors - 2];
+  style->white = colors[n_colors - 1];
 }
 
 static void
@@ -2016,16 +2123,19 @@ gtk_style_real_realize (GtkStyle *style)
       style->text_aa[i].blue = (style->text[i].blue + style->base[i].blue) / 2;
     }
 
-  style->black.red = 0x0000;
-  style->black.green = 0x0000;
-  style->black.blue = 0x0000;
-  gdk_colormap_alloc_color (style->colormap, &style->black, FALSE, TRUE);
+  for (i = 0; i < 5; i++)
+    {
+      if (style->rc_style && style->rc_style->bg_pixmap_name[i])
+	style->bg_pixmap[i] = load_bg_image (style->colormap,
+					     &style->bg[i],
+					     style->rc_style->bg_pixmap_name[i]);
+    }
 
-  style->white.red = 0xffff;
-  style->white.green = 0xffff;
-  style->white.blue = 0xffff;
-  gdk_colormap_alloc_color (style->colormap, &style->white, FALSE, TRUE);
+  alloc_style_colors (style);
 
+  /* gtk_gc_get() shares GCs with the same values on a colormap, so
+   * styles with identical colors also share their GCs
+   */
   gc_values_mask = GDK_GC_FOREGROUND | GDK_GC_BACKGROUND;
   
   gc_values.foreground = style->black;
@@ -2040,36 +2150,6 @@ gtk_style_real_realize (GtkStyle *style)
 
   for (i = 0; i < 5; i++)
     {
-      if (style->rc_style && style->rc_style->bg_pixmap_name[i])
-	style->bg_pixmap[i] = load_bg_image (style->colormap,
-					     &style->bg[i],
-					     style->rc_style->bg_pixmap_name[i]);
-      
-      if (!gdk_colormap_alloc_color (style->colormap, &style->fg[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->fg[i].red, style->fg[i].green, style->fg[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->bg[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->bg[i].red, style->bg[i].green, style->bg[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->light[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->light[i].red, style->light[i].green, style->light[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->dark[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->dark[i].red, style->dark[i].green, style->dark[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->mid[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->mid[i].red, style->mid[i].green, style->mid[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->text[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->text[i].red, style->text[i].green, style->text[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->base[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->base[i].red, style->base[i].green, style->base[i].blue);
-      if (!gdk_colormap_alloc_color (style->colormap, &style->text_aa[i], FALSE, TRUE))
-        g_warning ("unable to allocate color: ( %d %d %d )",
-                   style->text_aa[i].red, style->text_aa[i].green, style->text_aa[i].blue);
-      
       gc_values.foreground = style->fg[i];
       style->fg_gc[i] = gtk_gc_get (style->depth, style->colormap, &gc_values, gc_values_mask);
       
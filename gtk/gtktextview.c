@@ -4104,7 +4104,7 @@ gtk_text_view_unrealize (GtkWidget *widget)
 
   if (text_view->popup_menu)
     {
-      gtk_widget_destroy (text_view->popup_menu);
+      _gtk_menu_release (GTK_MENU (text_view->popup_menu));
       text_view->popup_menu = NULL;
     }
 
@@ -8278,9 +8278,13 @@ popup_targets_received (GtkClipboard     *clipboard,
       clipboard_contains_text = gtk_selection_data_targets_include_text (data);
 
       if (text_view->popup_menu)
-	gtk_widget_destroy (text_view->popup_menu);
+	_gtk_menu_release (GTK_MENU (text_view->popup_menu));
 
-      text_view->popup_menu = gtk_menu_new ();
+      /* Menus that ::populate-popup handlers saw are not reused */
+      text_view->popup_menu =
+	_gtk_menu_new_recycled (!g_signal_has_handler_pending (text_view,
+							       signals[POPULATE_POPUP],
+							       0, TRUE));
       
       gtk_menu_attach_to_widget (GTK_MENU (text_view->popup_menu),
 				 GTK_WIDGET (text_view),
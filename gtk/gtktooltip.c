@@ -32,6 +32,7 @@
 #include "gtkimage.h"
 #include "gtkhbox.h"
 #include "gtkalignment.h"
+#include "gtkwidgetpool.h"
 
 #include "gtkalias.h"
 
@@ -101,6 +102,52 @@ static void       gtk_tooltip_set_last_window      (GtkTooltip      *tooltip,
 
 G_DEFINE_TYPE (GtkTooltip, gtk_tooltip, G_TYPE_OBJECT);
 
+/* Tooltips are destroyed when browse mode ends, so their windows
+ * are kept for the next one
+ */
+static gboolean
+gtk_tooltip_window_reset (GtkWidget *window)
+{
+  GtkWidget *box;
+  GList *children, *l;
+  GdkScreen *screen;
+
+  screen = gdk_screen_get_default ();
+  if (!screen)
+    return FALSE;
+
+  gtk_window_set_screen (GTK_WINDOW (window), screen);
+
+  /* The pool reset the name along with the rest of the widget state */
+  gtk_widget_set_name (window, "gtk-tooltip");
+
+  box = gtk_bin_get_child (GTK_BIN (gtk_bin_get_child (GTK_BIN (window))));
+  children = gtk_container_get_children (GTK_CONTAINER (box));
+  for (l = children; l; l = l->next)
+    {
+      if (GTK_IS_IMAGE (l->data))
+	gtk_image_clear (GTK_IMAGE (l->data));
+      else
+	gtk_label_set_text (GTK_LABEL (l->data), "");
+
+      gtk_widget_hide (l->data);
+    }
+  g_list_free (children);
+
+  return TRUE;
+}
+
+static GtkWidgetPool *
+gtk_tooltip_get_window_pool (void)
+{
+  static GtkWidgetPool *pool = NULL;
+
+  if (!pool)
+    pool = _gtk_widget_pool_new (GTK_TYPE_WINDOW, 1, gtk_tooltip_window_reset);
+
+  return pool;
+}
+
 static void
 gtk_tooltip_class_init (GtkTooltipClass *klass)
 {
@@ -128,6 +175,35 @@ gtk_tooltip_init (GtkTooltip *tooltip)
 
   tooltip->last_window = NULL;
 
+  tooltip->custom_widget = NULL;
+
+  tooltip->window = _gtk_widget_pool_take (gtk_tooltip_get_window_pool ());
+  if (tooltip->window)
+    {
+      GList *children;
+
+      g_object_ref (tooltip->window);
+      tooltip->alignment = gtk_bin_get_child (GTK_BIN (tooltip->window));
+      tooltip->box = gtk_bin_get_child (GTK_BIN (tooltip->alignment));
+
+      children = gtk_container_get_children (GTK_CONTAINER (tooltip->box));
+      tooltip->image = children->data;
+      tooltip->label = children->next->data;
+      g_list_free (children);
+
+      g_signal_connect (tooltip->window, "hide",
+			G_CALLBACK (gtk_tooltip_window_hide), tooltip);
+      g_signal_connect_swapped (tooltip->window, "style-set",
+				G_CALLBACK (gtk_tooltip_window_style_set), tooltip);
+      g_signal_connect_swapped (tooltip->window, "expose-event",
+				G_CALLBACK (gtk_tooltip_paint_window), tooltip);
+
+      /* The style may have changed while the window was unused */
+      gtk_tooltip_window_style_set (tooltip);
+
+      return;
+    }
+
   tooltip->window = g_object_ref (gtk_window_new (GTK_WINDOW_POPUP));
   gtk_window_set_type_hint (GTK_WINDOW (tooltip->window),
 			    GDK_WINDOW_TYPE_HINT_TOOLTIP);
@@ -163,8 +239,6 @@ gtk_tooltip_init (GtkTooltip *tooltip)
   gtk_label_set_line_wrap (GTK_LABEL (tooltip->label), TRUE);
   gtk_box_pack_start (GTK_BOX (tooltip->box), tooltip->label,
 		      FALSE, FALSE, 0);
-
-  tooltip->custom_widget = NULL;
 }
 
 static void
@@ -195,7 +269,12 @@ gtk_tooltip_dispose (GObject *object)
       g_signal_handlers_disconnect_by_func (display,
 					    gtk_tooltip_display_closed,
 					    tooltip);
-      gtk_widget_destroy (tooltip->window);
+      g_signal_handlers_disconnect_matched (tooltip->window,
+					    G_SIGNAL_MATCH_DATA,
+					    0, 0, NULL, NULL, tooltip);
+      if (!_gtk_widget_pool_recycle (gtk_tooltip_get_window_pool (),
+				     tooltip->window))
+	gtk_widget_destroy (tooltip->window);
       tooltip->window = NULL;
     }
 
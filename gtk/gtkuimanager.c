@@ -82,6 +82,7 @@ struct _Node {
   GList *uifiles;
 
   guint dirty : 1;
+  guint children_dirty : 1; /* some descendant is dirty */
   guint expand : 1;  /* used for separators */
   guint popup_accels : 1;
   guint always_show_image_set : 1; /* used for menu items */
@@ -128,7 +129,9 @@ static GtkWidget * gtk_ui_manager_real_get_widget (GtkUIManager      *manager,
 static GtkAction * gtk_ui_manager_real_get_action (GtkUIManager      *manager,
                                                    const gchar       *path);
 static void        queue_update                   (GtkUIManager      *self);
-static void        dirty_all_nodes                (GtkUIManager      *self);
+static void        dirty_menu_nodes               (GtkUIManager      *self);
+static void        dirty_action_group_nodes       (GtkUIManager      *self,
+                                                   GtkActionGroup    *action_group);
 static void        mark_node_dirty                (GNode             *node);
 static GNode     * get_child_node                 (GtkUIManager      *self,
                                                    GNode             *parent,
@@ -645,7 +648,7 @@ gtk_ui_manager_set_add_tearoffs (GtkUIManager *self,
     {
       self->private_data->add_tearoffs = add_tearoffs;
       
-      dirty_all_nodes (self);
+      dirty_menu_nodes (self);
 
       g_object_notify (G_OBJECT (self), "add-tearoffs");
     }
@@ -738,8 +741,8 @@ gtk_ui_manager_insert_action_group (GtkUIManager   *self,
 		    "object-signal::post-activate", G_CALLBACK (cb_proxy_post_activate), self,
 		    NULL);
 
-  /* dirty all nodes, as action bindings may change */
-  dirty_all_nodes (self);
+  /* dirty the nodes whose action may now come from this group */
+  dirty_action_group_nodes (self, action_group);
 
   g_signal_emit (self, ui_manager_signals[ACTIONS_CHANGED], 0);
 }
@@ -772,10 +775,11 @@ gtk_ui_manager_remove_action_group (GtkUIManager   *self,
                        "any-signal::pre-activate", G_CALLBACK (cb_proxy_pre_activate), self,
                        "any-signal::post-activate", G_CALLBACK (cb_proxy_post_activate), self, 
                        NULL);
-  g_object_unref (action_group);
 
-  /* dirty all nodes, as action bindings may change */
-  dirty_all_nodes (self);
+  /* dirty the nodes whose action may have come from this group */
+  dirty_action_group_nodes (self, action_group);
+
+  g_object_unref (action_group);
 
   g_signal_emit (self, ui_manager_signals[ACTIONS_CHANGED], 0);
 }
@@ -1988,12 +1992,11 @@ find_menu_position (GNode      *node,
 	  menushell = NODE_INFO (parent)->proxy;
 	  if (GTK_IS_MENU_ITEM (menushell))
 	    menushell = gtk_menu_item_get_submenu (GTK_MENU_ITEM (menushell));
-	  siblings = gtk_container_get_children (GTK_CONTAINER (menushell));
+	  siblings = GTK_MENU_SHELL (menushell)->children;
 	  if (siblings != NULL && GTK_IS_TEAROFF_MENU_ITEM (siblings->data))
 	    pos = 1;
 	  else
 	    pos = 0;
-	  g_list_free (siblings);
 	  break;
 	case NODE_TYPE_MENU_PLACEHOLDER:
 	  menushell = gtk_widget_get_parent (NODE_INFO (parent)->proxy);
@@ -2252,7 +2255,11 @@ update_smart_separators (GtkWidget *proxy)
     }
 }
 
-static void
+/* Returns whether proxies were added to or removed from the menu
+ * shell or toolbar that contains the proxy of @node, so that the
+ * smart separators there need to be updated
+ */
+static gboolean
 update_node (GtkUIManager *self, 
 	     GNode        *node,
 	     gboolean      in_popup,
@@ -2263,18 +2270,25 @@ update_node (GtkUIManager *self,
   GtkAction *action;
   const gchar *action_name;
   NodeUIReference *ref;
+  gboolean changed = FALSE;
+  gboolean children_changed = FALSE;
   
 #ifdef DEBUG_UI_MANAGER
   GList *tmp;
 #endif
 
-  g_return_if_fail (node != NULL);
-  g_return_if_fail (NODE_INFO (node) != NULL);
+  g_return_val_if_fail (node != NULL, FALSE);
+  g_return_val_if_fail (NODE_INFO (node) != NULL, FALSE);
 
   info = NODE_INFO (node);
   
-  if (!info->dirty)
-    return;
+  if (!info->dirty && !info->children_dirty)
+    return FALSE;
+
+  /* Cleared first, so that nodes dirtied while updating are
+   * found again by the next update
+   */
+  info->children_dirty = FALSE;
 
   if (info->type == NODE_TYPE_POPUP)
     {
@@ -2295,6 +2309,10 @@ update_node (GtkUIManager *self,
   g_print (")\n");
 #endif
 
+  /* Only visited to get to dirty descendants */
+  if (!info->dirty)
+    goto recurse_children;
+
   if (info->uifiles == NULL) {
     /* We may need to remove this node.
      * This must be done in post order
@@ -2320,7 +2338,7 @@ update_node (GtkUIManager *self,
     {
       g_warning ("%s: missing action %s", info->name, action_name);
       
-      return;
+      return FALSE;
     }
   
   if (action)
@@ -2340,7 +2358,7 @@ update_node (GtkUIManager *self,
 	    menu = info->proxy;
 	  else
 	    menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (info->proxy));
-	  siblings = gtk_container_get_children (GTK_CONTAINER (menu));
+	  siblings = GTK_MENU_SHELL (menu)->children;
 	  if (siblings != NULL && GTK_IS_TEAROFF_MENU_ITEM (siblings->data))
 	    {
 	      if (self->private_data->add_tearoffs && !in_popup)
@@ -2348,11 +2366,13 @@ update_node (GtkUIManager *self,
 	      else
 		gtk_widget_hide (GTK_WIDGET (siblings->data));
 	    }
-	  g_list_free (siblings);
 	}
       
       goto recurse_children;
     }
+
+  /* The proxy is created, replaced or connected to another action */
+  changed = TRUE;
   
   switch (info->type)
     {
@@ -2473,7 +2493,7 @@ update_node (GtkUIManager *self,
 	else
 	  menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (info->proxy));
 
-	siblings = gtk_container_get_children (GTK_CONTAINER (menu));
+	siblings = GTK_MENU_SHELL (menu)->children;
 	if (siblings != NULL && GTK_IS_TEAROFF_MENU_ITEM (siblings->data))
 	  {
 	    if (self->private_data->add_tearoffs && !in_popup)
@@ -2481,7 +2501,6 @@ update_node (GtkUIManager *self,
 	    else
 	      gtk_widget_hide (GTK_WIDGET (siblings->data));
 	  }
-	g_list_free (siblings);
       }
       break;
     case NODE_TYPE_UNDECIDED:
@@ -2782,10 +2801,12 @@ update_node (GtkUIManager *self,
       
       current = child;
       child = current->next;
-      update_node (self, current, in_popup, popup_accels);
+      if (update_node (self, current, in_popup, popup_accels))
+	children_changed = TRUE;
     }
   
-  if (info->proxy) 
+  /* the separators only change if the items around them do */
+  if (info->proxy && (changed || children_changed))
     {
       if (info->type == NODE_TYPE_MENU && GTK_IS_MENU_ITEM (info->proxy)) 
 	update_smart_separators (gtk_menu_item_get_submenu (GTK_MENU_ITEM (info->proxy)));
@@ -2795,9 +2816,16 @@ update_node (GtkUIManager *self,
 	update_smart_separators (info->proxy);
     }
   
+  /* the children of placeholders are in the parent's container */
+  if (info->type == NODE_TYPE_MENU_PLACEHOLDER ||
+      info->type == NODE_TYPE_TOOLBAR_PLACEHOLDER)
+    changed = changed || children_changed;
+
   /* handle cleanup of dead nodes */
   if (node->children == NULL && info->uifiles == NULL)
     {
+      if (info->proxy || info->extra)
+	changed = TRUE;
       if (info->proxy)
 	gtk_widget_destroy (info->proxy);
       if (info->extra)
@@ -2807,6 +2835,8 @@ update_node (GtkUIManager *self,
       free_node (node);
       g_node_destroy (node);
     }
+
+  return changed;
 }
 
 static gboolean
@@ -2884,19 +2914,55 @@ gtk_ui_manager_ensure_update (GtkUIManager *self)
 }
 
 static gboolean
-dirty_traverse_func (GNode   *node,
-		     gpointer data)
+dirty_menu_func (GNode   *node,
+		 gpointer data)
 {
-  NODE_INFO (node)->dirty = TRUE;
+  if (NODE_INFO (node)->type == NODE_TYPE_MENU)
+    mark_node_dirty (node);
   return FALSE;
 }
 
 static void
-dirty_all_nodes (GtkUIManager *self)
+dirty_menu_nodes (GtkUIManager *self)
 {
-  g_node_traverse (self->private_data->root_node,
-		   G_PRE_ORDER, G_TRAVERSE_ALL, -1,
-		   dirty_traverse_func, NULL);
+  /* only the tearoff menu items depend on the menus themselves */
+  if (self->private_data->root_node)
+    g_node_traverse (self->private_data->root_node,
+		     G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+		     dirty_menu_func, NULL);
+  queue_update (self);
+}
+
+static gboolean
+dirty_action_group_func (GNode   *node,
+			 gpointer data)
+{
+  GtkActionGroup *action_group = data;
+  NodeUIReference *ref;
+
+  if (NODE_INFO (node)->uifiles == NULL)
+    return FALSE;
+
+  ref = NODE_INFO (node)->uifiles->data;
+  if (ref->action_quark != 0 &&
+      gtk_action_group_get_action (action_group,
+				   g_quark_to_string (ref->action_quark)))
+    mark_node_dirty (node);
+
+  return FALSE;
+}
+
+static void
+dirty_action_group_nodes (GtkUIManager   *self,
+			  GtkActionGroup *action_group)
+{
+  /* Only nodes with an action of the same name as one in the group
+   * can be bound to a different action now
+   */
+  if (self->private_data->root_node)
+    g_node_traverse (self->private_data->root_node,
+		     G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+		     dirty_action_group_func, action_group);
   queue_update (self);
 }
 
@@ -2905,9 +2971,13 @@ mark_node_dirty (GNode *node)
 {
   GNode *p;
 
-  /* FIXME could optimize this */
-  for (p = node; p; p = p->parent)
-    NODE_INFO (p)->dirty = TRUE;  
+  NODE_INFO (node)->dirty = TRUE;
+
+  /* The ancestors only need to be visited to get to the node. An
+   * ancestor that is marked already has all of its ancestors marked
+   */
+  for (p = node->parent; p && !NODE_INFO (p)->children_dirty; p = p->parent)
+    NODE_INFO (p)->children_dirty = TRUE;
 }
 
 static const gchar *
@@ -28,6 +28,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <locale.h>
+#include <stdlib.h>
 #include "gtkcontainer.h"
 #include "gtkaccelmap.h"
 #include "gtkclipboard.h"
@@ -372,8 +373,6 @@ static void             gtk_widget_queue_tooltip_query          (GtkWidget *widg
 static void gtk_widget_set_usize_internal (GtkWidget *widget,
 					   gint       width,
 					   gint       height);
-static void gtk_widget_get_draw_rectangle (GtkWidget    *widget,
-					   GdkRectangle *rect);
 
 #ifdef MAEMO_CHANGES
 typedef struct
@@ -3338,6 +3337,8 @@ gtk_widget_unparent (GtkWidget *widget)
    * in the next parent.
    */
   GTK_PRIVATE_SET_FLAG (widget, GTK_CHILD_VISIBLE);
+
+  _gtk_container_child_area_changed (widget);
     
   old_parent = widget->parent;
   widget->parent = NULL;
@@ -3633,6 +3634,8 @@ gtk_widget_map (GtkWidget *widget)
 
       if (!gtk_widget_get_has_window (widget))
 	gdk_window_invalidate_rect (widget->window, &widget->allocation, FALSE);
+
+      _gtk_container_child_area_changed (widget);
     }
 }
 
@@ -3654,6 +3657,8 @@ gtk_widget_unmap (GtkWidget *widget)
 	gdk_window_invalidate_rect (widget->window, &widget->allocation, FALSE);
       _gtk_tooltip_hide (widget);
       g_signal_emit (widget, widget_signals[UNMAP], 0);
+
+      _gtk_container_child_area_changed (widget);
     }
 }
 
@@ -3918,13 +3923,18 @@ widget_add_child_draw_rectangle (GtkWidget    *widget,
       widget->window != widget->parent->window)
     return;
 
-  gtk_widget_get_draw_rectangle (widget, &child_rect);
+  _gtk_widget_get_draw_rectangle (widget, &child_rect);
   gdk_rectangle_union (rect, &child_rect, rect);
 }
 
-static void
-gtk_widget_get_draw_rectangle (GtkWidget    *widget,
-			       GdkRectangle *rect)
+/* Computes the area @widget draws in, in the coordinates of
+ * widget->window. For %NO_WINDOW widgets this is the allocation,
+ * extended by the "draw-border" style property and by the areas of
+ * the mapped %NO_WINDOW children.
+ */
+void
+_gtk_widget_get_draw_rectangle (GtkWidget    *widget,
+				GdkRectangle *rect)
 {
   if (!gtk_widget_get_has_window (widget))
     {
@@ -3973,7 +3983,7 @@ gtk_widget_queue_draw (GtkWidget *widget)
   
   g_return_if_fail (GTK_IS_WIDGET (widget));
 
-  gtk_widget_get_draw_rectangle (widget, &rect);
+  _gtk_widget_get_draw_rectangle (widget, &rect);
 
   gtk_widget_queue_draw_area (widget,
 			      rect.x, rect.y,
@@ -4100,6 +4110,230 @@ gtk_widget_draw (GtkWidget          *widget,
     }
 }
 
+/* The signals below are emitted for every widget on every relayout,
+ * frame or pointer motion, and usually only run the class handler.
+ * When GTK_SIGNAL_FAST_PATH is set, the class handler is called
+ * directly in that case, which saves the marshalling of
+ * g_signal_emit(). This is not the default, because neither emission
+ * hooks, which accessibility modules rely on, nor class closures
+ * overridden with g_signal_override_class_closure() can be detected;
+ * they would be skipped for widgets without handlers.
+ *
+ * With GTK_DEBUG=signals, the number of direct calls and of full
+ * emissions of each signal and the time spent in them are printed at
+ * exit. The times include nested emissions, such as the size requests
+ * of the children of a container.
+ */
+typedef enum
+{
+  FAST_SIGNAL_SIZE_REQUEST,
+  FAST_SIGNAL_SIZE_ALLOCATE,
+  FAST_SIGNAL_EXPOSE_EVENT,
+  FAST_SIGNAL_MOTION_NOTIFY_EVENT,
+  N_FAST_SIGNALS
+} FastSignal;
+
+static gboolean
+signal_fast_path_enabled (void)
+{
+  static gint enabled = -1;
+
+  if (G_UNLIKELY (enabled < 0))
+    enabled = g_getenv ("GTK_SIGNAL_FAST_PATH") != NULL;
+
+  return enabled;
+}
+
+#ifdef G_ENABLE_DEBUG
+typedef struct
+{
+  const gchar *name;
+  guint64      n_direct;
+  guint64      n_emitted;
+  gint64       direct_time;
+  gint64       emitted_time;
+} SignalStats;
+
+static SignalStats signal_stats[N_FAST_SIGNALS] = {
+  { "size-request" },
+  { "size-allocate" },
+  { "expose-event" },
+  { "motion-notify-event" }
+};
+
+static void
+signal_stats_atexit (void)
+{
+  gint i;
+
+  g_printerr ("%-20s %12s %12s %12s %12s\n", "signal",
+	      "direct", "usec", "emitted", "usec");
+  for (i = 0; i < N_FAST_SIGNALS; i++)
+    g_printerr ("%-20s %12" G_GUINT64_FORMAT " %12" G_GINT64_FORMAT
+		" %12" G_GUINT64_FORMAT " %12" G_GINT64_FORMAT "\n",
+		signal_stats[i].name,
+		signal_stats[i].n_direct, signal_stats[i].direct_time,
+		signal_stats[i].n_emitted, signal_stats[i].emitted_time);
+}
+#endif /* G_ENABLE_DEBUG */
+
+static inline gint64
+signal_stats_start (void)
+{
+#ifdef G_ENABLE_DEBUG
+  if (gtk_debug_flags & GTK_DEBUG_SIGNALS)
+    return g_get_monotonic_time ();
+#endif
+
+  return 0;
+}
+
+static inline void
+signal_stats_stop (FastSignal fast,
+		   gboolean   direct,
+		   gint64     start)
+{
+#ifdef G_ENABLE_DEBUG
+  if (gtk_debug_flags & GTK_DEBUG_SIGNALS)
+    {
+      static gboolean atexit_added = FALSE;
+      SignalStats *stats = &signal_stats[fast];
+      gint64 elapsed;
+
+      /* The flag can be turned on after the emission started */
+      if (start == 0)
+	return;
+
+      if (!atexit_added)
+	{
+	  atexit (signal_stats_atexit);
+	  atexit_added = TRUE;
+	}
+
+      elapsed = g_get_monotonic_time () - start;
+      if (direct)
+	{
+	  stats->n_direct++;
+	  stats->direct_time += elapsed;
+	}
+      else
+	{
+	  stats->n_emitted++;
+	  stats->emitted_time += elapsed;
+	}
+    }
+#endif
+}
+
+/* Whether emitting @signal_id on @widget would only run the class
+ * handler. Blocked handlers count, so that blocking a handler does
+ * not change how the signal is emitted.
+ */
+static inline gboolean
+signal_is_class_only (GtkWidget *widget,
+		      guint      signal_id)
+{
+  return signal_fast_path_enabled () &&
+         !g_signal_has_handler_pending (widget, signal_id, 0, TRUE);
+}
+
+/**
+ * _gtk_widget_emit_size_request:
+ * @widget: a #GtkWidget
+ * @requisition: the requisition to fill in
+ *
+ * Emits #GtkWidget::size-request on @widget, calling the class
+ * handler directly if that is all the emission would do.
+ **/
+void
+_gtk_widget_emit_size_request (GtkWidget      *widget,
+			       GtkRequisition *requisition)
+{
+  gint64 start = signal_stats_start ();
+  gboolean direct;
+
+  direct = signal_is_class_only (widget, widget_signals[SIZE_REQUEST]);
+  if (direct)
+    {
+      GtkWidgetClass *klass = GTK_WIDGET_GET_CLASS (widget);
+
+      if (klass->size_request)
+	klass->size_request (widget, requisition);
+    }
+  else
+    g_signal_emit (widget, widget_signals[SIZE_REQUEST], 0, requisition);
+
+  signal_stats_stop (FAST_SIGNAL_SIZE_REQUEST, direct, start);
+}
+
+static void
+gtk_widget_emit_size_allocate (GtkWidget     *widget,
+			       GtkAllocation *allocation)
+{
+  gint64 start = signal_stats_start ();
+  gboolean direct;
+
+  direct = signal_is_class_only (widget, widget_signals[SIZE_ALLOCATE]);
+  if (direct)
+    {
+      GtkWidgetClass *klass = GTK_WIDGET_GET_CLASS (widget);
+
+      if (klass->size_allocate)
+	klass->size_allocate (widget, allocation);
+    }
+  else
+    g_signal_emit (widget, widget_signals[SIZE_ALLOCATE], 0, allocation);
+
+  signal_stats_stop (FAST_SIGNAL_SIZE_ALLOCATE, direct, start);
+}
+
+/* Emits one of the event signals of @widget for @event. Returns
+ * %FALSE for signals without a fast path, in which case nothing
+ * was emitted.
+ */
+static gboolean
+gtk_widget_emit_event_fast (GtkWidget *widget,
+			    gint       signal_num,
+			    GdkEvent  *event,
+			    gboolean  *return_val)
+{
+  GtkWidgetClass *klass = GTK_WIDGET_GET_CLASS (widget);
+  FastSignal fast;
+  gint64 start;
+  gboolean direct;
+
+  switch (signal_num)
+    {
+    case EXPOSE_EVENT:
+      fast = FAST_SIGNAL_EXPOSE_EVENT;
+      break;
+    case MOTION_NOTIFY_EVENT:
+      fast = FAST_SIGNAL_MOTION_NOTIFY_EVENT;
+      break;
+    default:
+      return FALSE;
+    }
+
+  start = signal_stats_start ();
+
+  direct = signal_is_class_only (widget, widget_signals[signal_num]);
+  if (direct)
+    {
+      if (fast == FAST_SIGNAL_EXPOSE_EVENT && klass->expose_event)
+	*return_val = klass->expose_event (widget, (GdkEventExpose *) event);
+      else if (fast == FAST_SIGNAL_MOTION_NOTIFY_EVENT && klass->motion_notify_event)
+	*return_val = klass->motion_notify_event (widget, (GdkEventMotion *) event);
+      else
+	*return_val = FALSE;
+    }
+  else
+    g_signal_emit (widget, widget_signals[signal_num], 0, event, return_val);
+
+  signal_stats_stop (fast, direct, start);
+
+  return TRUE;
+}
+
 /**
  * gtk_widget_size_request:
  * @widget: a #GtkWidget
@@ -4216,7 +4450,7 @@ gtk_widget_queue_shallow_draw (GtkWidget *widget)
   if (!gtk_widget_get_realized (widget))
     return;
 
-  gtk_widget_get_draw_rectangle (widget, &rect);
+  _gtk_widget_get_draw_rectangle (widget, &rect);
 
   /* get_draw_rectangle() gives us window coordinates, we
    * need to convert to the coordinates that widget->allocation
@@ -4237,6 +4471,16 @@ gtk_widget_queue_shallow_draw (GtkWidget *widget)
   gdk_region_destroy (region);
 }
 
+static void
+allocate_descendant (GtkWidget *child,
+		     gpointer   data)
+{
+  if (GTK_WIDGET_ALLOC_NEEDED (child) &&
+      gtk_widget_get_visible (child) &&
+      gtk_widget_get_child_visible (child))
+    gtk_widget_size_allocate (child, &child->allocation);
+}
+
 /**
  * gtk_widget_size_allocate:
  * @widget: a #GtkWidget
@@ -4313,8 +4557,31 @@ gtk_widget_size_allocate (GtkWidget	*widget,
 
   if (!alloc_needed && !size_changed && !position_changed)
     return;
-  
-  g_signal_emit (widget, widget_signals[SIZE_ALLOCATE], 0, &real_allocation);
+
+  /* If the size request found that none of the children changed their
+   * requisition, the children keep their allocations too; only pass
+   * the allocation on to the ones that queued a resize below.
+   */
+  if (GTK_WIDGET_DESCENDANT_RESIZE (widget))
+    {
+      GTK_PRIVATE_UNSET_FLAG (widget, GTK_DESCENDANT_RESIZE);
+
+      if (!size_changed && !position_changed &&
+	  !GTK_WIDGET_REQUEST_NEEDED (widget))
+	{
+	  gtk_container_forall (GTK_CONTAINER (widget),
+				allocate_descendant, NULL);
+#ifdef MAEMO_CHANGES
+	  if (gtk_widget_is_toplevel (widget))
+	    _gtk_container_post_size_allocate (GTK_CONTAINER (widget));
+#endif
+	  return;
+	}
+    }
+
+  gtk_widget_emit_size_allocate (widget, &real_allocation);
+
+  _gtk_container_child_area_changed (widget);
 
   if (gtk_widget_get_mapped (widget))
     {
@@ -5213,7 +5480,8 @@ gtk_widget_event_internal (GtkWidget *widget,
 	  signal_num = -1;
 	  break;
 	}
-      if (signal_num != -1)
+      if (signal_num != -1 &&
+	  !gtk_widget_emit_event_fast (widget, signal_num, event, &return_val))
 	g_signal_emit (widget, widget_signals[signal_num], 0, event, &return_val);
     }
   if (WIDGET_REALIZED_FOR_EVENT (widget, event))
@@ -5488,7 +5756,7 @@ gtk_widget_region_intersect (GtkWidget       *widget,
   g_return_val_if_fail (GTK_IS_WIDGET (widget), NULL);
   g_return_val_if_fail (region != NULL, NULL);
 
-  gtk_widget_get_draw_rectangle (widget, &rect);
+  _gtk_widget_get_draw_rectangle (widget, &rect);
   
   dest = gdk_region_rectangle (&rect);
  
@@ -6635,6 +6903,7 @@ gtk_widget_set_parent (GtkWidget *widget,
 
   g_object_ref_sink (widget);
   widget->parent = parent;
+  _gtk_container_child_area_changed (widget);
 
   if (gtk_widget_get_state (parent) != GTK_STATE_NORMAL)
     data.state = gtk_widget_get_state (parent);
@@ -7417,6 +7686,14 @@ reset_rc_styles_recurse (GtkWidget *widget, gpointer data)
 }
 
 
+/* Like gtk_widget_reset_rc_styles(), but not recursive */
+void
+_gtk_widget_reset_rc_style (GtkWidget *widget)
+{
+  if (gtk_widget_has_rc_style (widget))
+    gtk_widget_reset_rc_style (widget);
+}
+
 /**
  * gtk_widget_reset_rc_styles:
  * @widget: a #GtkWidget.
@@ -1342,6 +1342,11 @@ void              _gtk_widget_propagate_hierarchy_changed (GtkWidget    *widget,
 void              _gtk_widget_propagate_screen_changed    (GtkWidget    *widget,
 							   GdkScreen    *previous_screen);
 void		  _gtk_widget_propagate_composited_changed (GtkWidget    *widget);
+void              _gtk_widget_reset_rc_style              (GtkWidget    *widget);
+void              _gtk_widget_get_draw_rectangle          (GtkWidget    *widget,
+							   GdkRectangle *rect);
+void              _gtk_widget_emit_size_request           (GtkWidget      *widget,
+							   GtkRequisition *requisition);
 
 void	   _gtk_widget_set_pointer_window  (GtkWidget      *widget,
 					    GdkWindow      *pointer_window);
@@ -0,0 +1,230 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include "gtkwidgetpool.h"
+#include "gtkintl.h"
+#include "gtkwindow.h"
+#include "gtkalias.h"
+
+struct _GtkWidgetPool
+{
+  GType type;
+  guint max_size;
+  GtkWidgetPoolResetFunc reset_func;
+
+  GSList *widgets;
+  guint n_widgets;
+
+  /* The signals of the type, its ancestors and its interfaces,
+   * collected when the first widget is recycled, since the
+   * signals of a class only exist once the class is initialized
+   */
+  GArray *signal_ids;
+};
+
+GtkWidgetPool *
+_gtk_widget_pool_new (GType                  type,
+		      guint                  max_size,
+		      GtkWidgetPoolResetFunc reset_func)
+{
+  GtkWidgetPool *pool;
+
+  g_return_val_if_fail (g_type_is_a (type, GTK_TYPE_WIDGET), NULL);
+  g_return_val_if_fail (reset_func != NULL, NULL);
+
+  pool = g_new0 (GtkWidgetPool, 1);
+  pool->type = type;
+  pool->max_size = max_size;
+  pool->reset_func = reset_func;
+
+  return pool;
+}
+
+/* Returns a widget from @pool, or %NULL if it is empty. The widget
+ * has the same ownership as a new one: it is floating, or owned by
+ * GTK+ for toplevels.
+ */
+GtkWidget *
+_gtk_widget_pool_take (GtkWidgetPool *pool)
+{
+  GtkWidget *widget;
+
+  if (!pool->widgets)
+    return NULL;
+
+  widget = pool->widgets->data;
+  pool->widgets = g_slist_delete_link (pool->widgets, pool->widgets);
+  pool->n_widgets--;
+
+  if (GTK_IS_WINDOW (widget))
+    g_object_unref (widget);
+  else
+    g_object_force_floating (G_OBJECT (widget));
+
+  return widget;
+}
+
+static void
+add_signal_ids (GArray *signal_ids,
+		GType   type)
+{
+  guint *ids;
+  guint n_ids;
+
+  ids = g_signal_list_ids (type, &n_ids);
+  g_array_append_vals (signal_ids, ids, n_ids);
+  g_free (ids);
+}
+
+static gboolean
+has_signal_handlers (GtkWidgetPool *pool,
+		     GtkWidget     *widget)
+{
+  guint i;
+
+  if (!pool->signal_ids)
+    {
+      GType *interfaces;
+      guint n_interfaces;
+      GType type;
+
+      pool->signal_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+      interfaces = g_type_interfaces (pool->type, &n_interfaces);
+      for (i = 0; i < n_interfaces; i++)
+	add_signal_ids (pool->signal_ids, interfaces[i]);
+      g_free (interfaces);
+
+      for (type = pool->type; type; type = g_type_parent (type))
+	add_signal_ids (pool->signal_ids, type);
+    }
+
+  for (i = 0; i < pool->signal_ids->len; i++)
+    if (g_signal_has_handler_pending (widget,
+				      g_array_index (pool->signal_ids, guint, i),
+				      0, TRUE))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Undoes the changes to the state every widget has that its owner
+ * does not know about, in case somebody else got to see the widget
+ */
+static void
+reset_widget (GtkWidget *widget)
+{
+  gint width, height;
+
+  if (widget->name)
+    gtk_widget_set_name (widget, NULL);
+
+  /* Drops the modifications of gtk_widget_modify_style() and the
+   * gtk_widget_modify_*() functions, and styles set explicitly
+   */
+  if (g_object_get_data (G_OBJECT (widget), "gtk-rc-style"))
+    {
+      g_object_set_data (G_OBJECT (widget), I_("gtk-rc-style"), NULL);
+      _gtk_widget_reset_rc_style (widget);
+    }
+  gtk_widget_set_style (widget, NULL);
+
+  gtk_widget_get_size_request (widget, &width, &height);
+  if (width != -1 || height != -1)
+    gtk_widget_set_size_request (widget, -1, -1);
+
+  if (!gtk_widget_get_sensitive (widget))
+    gtk_widget_set_sensitive (widget, TRUE);
+
+  if (gtk_widget_get_has_tooltip (widget))
+    {
+      gtk_widget_set_tooltip_window (widget, NULL);
+      gtk_widget_set_tooltip_text (widget, NULL);
+      gtk_widget_set_has_tooltip (widget, FALSE);
+    }
+
+  gtk_widget_set_direction (widget, GTK_TEXT_DIR_NONE);
+  gtk_widget_set_no_show_all (widget, FALSE);
+}
+
+static void
+discard_widget (GtkWidget *widget)
+{
+  gtk_widget_destroy (widget);
+  g_object_unref (widget);
+}
+
+/* Hands @widget to @pool, which keeps it for _gtk_widget_pool_take()
+ * if it can be reused and destroys it otherwise. Either way the pool
+ * takes over the reference of the caller and returns TRUE.
+ *
+ * Returns FALSE, without touching @widget, if somebody else still
+ * holds a reference to it; the caller keeps its reference then.
+ */
+gboolean
+_gtk_widget_pool_recycle (GtkWidgetPool *pool,
+			  GtkWidget     *widget)
+{
+  guint n_refs;
+
+  g_return_val_if_fail (G_OBJECT_TYPE (widget) == pool->type, FALSE);
+
+  if (GTK_OBJECT_FLAGS (widget) & GTK_IN_DESTRUCTION)
+    return FALSE;
+
+  /* A toplevel holds a reference on itself until it is destroyed */
+  n_refs = 1;
+  if (GTK_IS_WINDOW (widget))
+    {
+      if (!GTK_WINDOW (widget)->has_user_ref_count)
+	return FALSE;
+      n_refs++;
+    }
+
+  if (G_OBJECT (widget)->ref_count != n_refs)
+    return FALSE;
+
+  if (pool->n_widgets >= pool->max_size)
+    {
+      discard_widget (widget);
+      return TRUE;
+    }
+
+  gtk_widget_hide (widget);
+  if (gtk_widget_get_realized (widget))
+    gtk_widget_unrealize (widget);
+
+  reset_widget (widget);
+
+  /* The reset function may drop handlers GTK+ connected itself,
+   * anything left was connected by somebody else
+   */
+  if (!pool->reset_func (widget) || has_signal_handlers (pool, widget))
+    {
+      discard_widget (widget);
+      return TRUE;
+    }
+
+  pool->widgets = g_slist_prepend (pool->widgets, widget);
+  pool->n_widgets++;
+
+  return TRUE;
+}
@@ -0,0 +1,66 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_WIDGET_POOL_H__
+#define __GTK_WIDGET_POOL_H__
+
+#include <gtk/gtkwidget.h>
+
+G_BEGIN_DECLS
+
+/* A pool of unused widgets of one type, for widgets that GTK+ creates
+ * and throws away often, like context menus and the entries of
+ * editable cells. Instead of destroying such a widget, its owner hands
+ * it to the pool, which unrealizes it and calls the reset function of
+ * the pool to bring it back to the state its owner created it in. The
+ * owner then gets it from _gtk_widget_pool_take() instead of creating
+ * a new one.
+ *
+ * Before the reset function runs, the pool resets the state all widgets
+ * have: the name, style modifications, size request, sensitivity,
+ * tooltip, text direction and no-show-all flag. The reset function
+ * must restore any of these its owner sets when creating the widget.
+ *
+ * A widget is only kept if nobody but its owner can still see it: the
+ * owner must hold the only reference to it, besides the one a toplevel
+ * holds on itself, and no signal handlers may be connected to it once
+ * the reset function ran. Object data, weak references and other state
+ * set through the widget's own API can't be checked for, so pools are
+ * only used for widgets that GTK+ did not hand out to code that could
+ * keep them or change them beyond the reset: not for menus passed to
+ * ::populate-popup handlers, and not for cell entries returned from
+ * gtk_cell_renderer_start_editing() to anything but a GtkTreeView with
+ * no ::editing-started handlers on the renderer.
+ */
+
+typedef struct _GtkWidgetPool GtkWidgetPool;
+
+/* Returns FALSE if the widget can't be reused after all */
+typedef gboolean (*GtkWidgetPoolResetFunc) (GtkWidget *widget);
+
+GtkWidgetPool *_gtk_widget_pool_new     (GType                   type,
+					 guint                   max_size,
+					 GtkWidgetPoolResetFunc  reset_func);
+GtkWidget *    _gtk_widget_pool_take    (GtkWidgetPool          *pool);
+gboolean       _gtk_widget_pool_recycle (GtkWidgetPool          *pool,
+					 GtkWidget              *widget);
+
+G_END_DECLS
+
+#endif /* __GTK_WIDGET_POOL_H__ */
@@ -8441,11 +8441,11 @@ gtk_window_activate_key (GtkWindow   *window,
   if (key_hash)
     {
       GSList *tmp_list;
-      GSList *entries = _gtk_key_hash_lookup (key_hash,
-					      event->hardware_keycode,
-					      event->state,
-					      gtk_accelerator_get_default_mod_mask (),
-					      event->group);
+      GSList *entries = _gtk_key_hash_lookup_cached (key_hash,
+						     event->hardware_keycode,
+						     event->state,
+						     gtk_accelerator_get_default_mod_mask (),
+						     event->group);
 
       g_object_get (gtk_widget_get_settings (GTK_WIDGET (window)),
                     "gtk-enable-mnemonics", &enable_mnemonics,
@@ -8471,8 +8471,6 @@ gtk_window_activate_key (GtkWindow   *window,
                 }
             }
 	}
-
-      g_slist_free (entries);
     }
 
   if (found_entry)
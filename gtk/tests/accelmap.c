@@ -0,0 +1,240 @@
+/* accelmap.c - test loading and saving of accelerator maps
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkkeysyms.h>
+#include <glib/gstdio.h>
+
+/* Writes @contents to a new temporary file and returns its name */
+static gchar *
+write_accel_file (const gchar *contents)
+{
+  gchar *file_name;
+  gint fd;
+
+  fd = g_file_open_tmp ("accelmap-XXXXXX", &file_name, NULL);
+  g_assert (fd >= 0);
+  close (fd);
+
+  g_assert (g_file_set_contents (file_name, contents, -1, NULL));
+
+  return file_name;
+}
+
+static void
+remove_accel_file (gchar *file_name)
+{
+  gchar *cache_name;
+
+  cache_name = g_strconcat (file_name, ".cache", NULL);
+  g_unlink (cache_name);
+  g_unlink (file_name);
+  g_free (cache_name);
+  g_free (file_name);
+}
+
+static void
+assert_accel (const gchar     *accel_path,
+	      guint            accel_key,
+	      GdkModifierType  accel_mods)
+{
+  GtkAccelKey key;
+
+  g_assert (gtk_accel_map_lookup_entry (accel_path, &key));
+  g_assert_cmpuint (key.accel_key, ==, accel_key);
+  g_assert_cmpuint (key.accel_mods, ==, accel_mods);
+}
+
+static void
+find_path (gpointer         data,
+	   const gchar     *accel_path,
+	   guint            accel_key,
+	   GdkModifierType  accel_mods,
+	   gboolean         changed)
+{
+  const gchar **path = data;
+
+  if (*path && g_str_equal (*path, accel_path))
+    *path = NULL;
+}
+
+static void
+test_load (void)
+{
+  const gchar *path;
+  gchar *file_name;
+
+  file_name = write_accel_file ("(gtk_accel_path \"<Test>/Load/Open\" \"<Control>o\")\n"
+				"; (gtk_accel_path \"<Test>/Load/Unchanged\" \"<Control>u\")\n"
+				"(gtk_accel_path \"<Test>/Load/Close\" \"<Control>w\")\n");
+  gtk_accel_map_load (file_name);
+  remove_accel_file (file_name);
+
+  assert_accel ("<Test>/Load/Open", GDK_o, GDK_CONTROL_MASK);
+  g_assert (!gtk_accel_map_lookup_entry ("<Test>/Load/Unchanged", NULL));
+
+  /* The loaded accelerator wins over the default one */
+  gtk_accel_map_add_entry ("<Test>/Load/Open", GDK_n, GDK_CONTROL_MASK);
+  assert_accel ("<Test>/Load/Open", GDK_o, GDK_CONTROL_MASK);
+
+  /* Paths that have not been looked up yet are still saved */
+  path = "<Test>/Load/Close";
+  gtk_accel_map_foreach (&path, find_path);
+  g_assert (path == NULL);
+}
+
+static void
+count_change (GtkAccelMap     *accel_map,
+	      const gchar     *accel_path,
+	      guint            accel_key,
+	      GdkModifierType  accel_mods,
+	      gint            *n_changes)
+{
+  (*n_changes)++;
+
+  /* Only the final accelerator is notified */
+  g_assert_cmpuint (accel_key, ==, GDK_F3);
+}
+
+static void
+test_notify (void)
+{
+  gchar *file_name;
+  gint n_changes = 0;
+
+  g_signal_connect (gtk_accel_map_get (), "changed::<Test>/Notify/Action",
+		    G_CALLBACK (count_change), &n_changes);
+
+  file_name = write_accel_file ("(gtk_accel_path \"<Test>/Notify/Action\" \"F2\")\n"
+				"(gtk_accel_path \"<Test>/Notify/Other\" \"F4\")\n"
+				"(gtk_accel_path \"<Test>/Notify/Action\" \"F3\")\n");
+  gtk_accel_map_load (file_name);
+  remove_accel_file (file_name);
+
+  g_assert_cmpint (n_changes, ==, 1);
+
+  g_signal_handlers_disconnect_by_func (gtk_accel_map_get (), count_change, &n_changes);
+}
+
+/* Saves @accel_path with @accel_key to @file_name in a child, which
+ * leaves the accel map of the test alone
+ */
+static void
+save_in_child (const gchar *file_name,
+	       const gchar *accel_path,
+	       guint        accel_key)
+{
+  if (g_test_trap_fork (0, 0))
+    {
+      gtk_accel_map_add_entry (accel_path, accel_key, 0);
+      gtk_accel_map_change_entry (accel_path, accel_key, GDK_SHIFT_MASK, FALSE);
+      gtk_accel_map_save (file_name);
+      exit (0);
+    }
+  g_test_trap_assert_passed ();
+}
+
+static void
+test_cache (void)
+{
+  gchar *file_name, *cache_name;
+
+  file_name = write_accel_file ("");
+  cache_name = g_strconcat (file_name, ".cache", NULL);
+
+  save_in_child (file_name, "<Test>/Cache/Action", GDK_F5);
+  g_assert (g_file_test (cache_name, G_FILE_TEST_IS_REGULAR));
+
+  gtk_accel_map_load (file_name);
+  assert_accel ("<Test>/Cache/Action", GDK_F5, GDK_SHIFT_MASK);
+
+  g_free (cache_name);
+  remove_accel_file (file_name);
+}
+
+static void
+test_stale_cache (void)
+{
+  gchar *file_name;
+
+  file_name = write_accel_file ("");
+  save_in_child (file_name, "<Test>/Stale/Action", GDK_F6);
+
+  /* A file edited after the cache was written is parsed */
+  g_assert (g_file_set_contents (file_name,
+				 "(gtk_accel_path \"<Test>/Stale/Action\" \"<Alt>F7\")\n",
+				 -1, NULL));
+
+  gtk_accel_map_load (file_name);
+  assert_accel ("<Test>/Stale/Action", GDK_F7, GDK_MOD1_MASK);
+
+  remove_accel_file (file_name);
+}
+
+static void
+test_same_size_edit (void)
+{
+  struct utimbuf times;
+  struct stat st;
+  gchar *file_name, *contents, *key;
+  gsize length;
+
+  file_name = write_accel_file ("");
+  save_in_child (file_name, "<Test>/SameSize/Action", GDK_F6);
+
+  /* An edit that keeps the size and the modification time, like two
+   * writes within the same second, is not missed either
+   */
+  g_assert (g_stat (file_name, &st) == 0);
+  g_assert (g_file_get_contents (file_name, &contents, &length, NULL));
+  key = strstr (contents, "F6");
+  g_assert (key != NULL);
+  key[1] = '8';
+  g_assert (g_file_set_contents (file_name, contents, length, NULL));
+  g_free (contents);
+
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime;
+  g_assert (g_utime (file_name, &times) == 0);
+
+  gtk_accel_map_load (file_name);
+  assert_accel ("<Test>/SameSize/Action", GDK_F8, GDK_SHIFT_MASK);
+
+  remove_accel_file (file_name);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/accel-map/load", test_load);
+  g_test_add_func ("/accel-map/notify", test_notify);
+  g_test_add_func ("/accel-map/cache", test_cache);
+  g_test_add_func ("/accel-map/stale-cache", test_stale_cache);
+  g_test_add_func ("/accel-map/same-size-edit", test_same_size_edit);
+
+  return g_test_run ();
+}
@@ -0,0 +1,228 @@
+/* bindings.c - test the dispatch of key events to binding sets
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+#include <gdk/gdkkeysyms.h>
+
+/* A label with an action signal to bind keys to */
+typedef GtkLabel      TestLabel;
+typedef GtkLabelClass TestLabelClass;
+
+static GType test_label_get_type (void);
+
+G_DEFINE_TYPE (TestLabel, test_label, GTK_TYPE_LABEL)
+
+static void
+test_label_class_init (TestLabelClass *class)
+{
+  g_signal_new ("test-activate",
+		G_TYPE_FROM_CLASS (class),
+		G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+		0, NULL, NULL,
+		g_cclosure_marshal_VOID__INT,
+		G_TYPE_NONE, 1, G_TYPE_INT);
+
+  gtk_binding_entry_add_signal (gtk_binding_set_by_class (class),
+				GDK_F5, 0, "test-activate", 1, G_TYPE_INT, 1);
+  gtk_binding_entry_add_signal (gtk_binding_set_by_class (class),
+				GDK_F6, 0, "test-activate", 1, G_TYPE_INT, 1);
+  gtk_binding_entry_add_signal (gtk_binding_set_by_class (class),
+				GDK_F7, 0, "test-activate", 1, G_TYPE_INT, 1);
+  gtk_binding_entry_add_signal (gtk_binding_set_by_class (class),
+				GDK_F10, 0, "test-activate", 1, G_TYPE_INT, 4);
+}
+
+static void
+test_label_init (TestLabel *label)
+{
+}
+
+static void
+record_activate (GtkWidget *widget,
+		 gint       value,
+		 gint      *last_value)
+{
+  *last_value = value;
+}
+
+static GtkWidget *
+create_label (gint *last_value)
+{
+  GtkWidget *label;
+
+  label = g_object_ref_sink (g_object_new (test_label_get_type (), NULL));
+  g_signal_connect (label, "test-activate", G_CALLBACK (record_activate), last_value);
+
+  return label;
+}
+
+/* Sends a press of @keyval through the binding sets of @widget and
+ * returns what the handler saw, or 0 if the key was not handled
+ */
+static gint
+send_key (GtkWidget *widget,
+	  guint      keyval,
+	  gint      *last_value)
+{
+  GdkEventKey event = { 0, };
+  GdkKeymapKey *keys;
+  gint n_keys;
+  gboolean handled;
+
+  if (!gdk_keymap_get_entries_for_keyval (gdk_keymap_get_default (), keyval, &keys, &n_keys))
+    g_assert_not_reached ();
+
+  event.type = GDK_KEY_PRESS;
+  event.keyval = keyval;
+  event.hardware_keycode = keys[0].keycode;
+  event.group = keys[0].group;
+  g_free (keys);
+
+  *last_value = 0;
+  handled = gtk_bindings_activate_event (GTK_OBJECT (widget), &event);
+  g_assert_cmpint (handled, ==, *last_value != 0);
+
+  return *last_value;
+}
+
+static void
+test_class (void)
+{
+  GtkWidget *label;
+  gint last_value;
+
+  label = create_label (&last_value);
+
+  g_assert_cmpint (send_key (label, GDK_F5, &last_value), ==, 1);
+
+  /* The second press is looked up in the caches */
+  g_assert_cmpint (send_key (label, GDK_F5, &last_value), ==, 1);
+
+  /* A key nothing is bound to */
+  g_assert_cmpint (send_key (label, GDK_F9, &last_value), ==, 0);
+
+  g_object_unref (label);
+}
+
+static void
+test_override (void)
+{
+  GtkBindingSet *binding_set;
+  GtkWidget *label;
+  gint last_value;
+
+  label = create_label (&last_value);
+
+  g_assert_cmpint (send_key (label, GDK_F6, &last_value), ==, 1);
+
+  /* A set added later with a higher priority takes over the class,
+   * both for keys it binds and for keys it skips.
+   */
+  binding_set = gtk_binding_set_new ("test-override");
+  gtk_binding_set_add_path (binding_set, GTK_PATH_CLASS, "TestLabel",
+			    GTK_PATH_PRIO_APPLICATION);
+  gtk_binding_entry_add_signal (binding_set, GDK_F6, 0,
+				"test-activate", 1, G_TYPE_INT, 2);
+  gtk_binding_entry_skip (binding_set, GDK_F7, 0);
+
+  g_assert_cmpint (send_key (label, GDK_F6, &last_value), ==, 2);
+  g_assert_cmpint (send_key (label, GDK_F7, &last_value), ==, 0);
+
+  /* Removing the override falls back to the class binding */
+  gtk_binding_entry_remove (binding_set, GDK_F6, 0);
+  g_assert_cmpint (send_key (label, GDK_F6, &last_value), ==, 1);
+
+  g_object_unref (label);
+}
+
+static void
+test_add_remove (void)
+{
+  GtkBindingSet *binding_set;
+  GtkWidget *label;
+  gint last_value;
+
+  label = create_label (&last_value);
+  binding_set = gtk_binding_set_by_class (GTK_LABEL_GET_CLASS (label));
+
+  g_assert_cmpint (send_key (label, GDK_F8, &last_value), ==, 0);
+
+  gtk_binding_entry_add_signal (binding_set, GDK_F8, 0,
+				"test-activate", 1, G_TYPE_INT, 3);
+  g_assert_cmpint (send_key (label, GDK_F8, &last_value), ==, 3);
+
+  gtk_binding_entry_remove (binding_set, GDK_F8, 0);
+  g_assert_cmpint (send_key (label, GDK_F8, &last_value), ==, 0);
+
+  g_object_unref (label);
+}
+
+static gboolean
+change_bindings (GtkWidget *widget,
+		 gpointer   data)
+{
+  GtkBindingSet *binding_set;
+
+  /* Drops the cached key lookups and class branch sets */
+  binding_set = gtk_binding_set_new ("test-changed");
+  gtk_binding_set_add_path (binding_set, GTK_PATH_CLASS, "GtkLabel",
+			    GTK_PATH_PRIO_LOWEST);
+  gtk_binding_entry_add_signal (binding_set, GDK_F11, 0,
+				"test-activate", 1, G_TYPE_INT, 5);
+
+  return FALSE;
+}
+
+static void
+test_change_while_activating (void)
+{
+  GtkBindingSet *binding_set;
+  GtkWidget *label;
+  gint last_value;
+
+  label = create_label (&last_value);
+  g_signal_connect (label, "popup-menu", G_CALLBACK (change_bindings), NULL);
+
+  /* The first binding changes the bindings and declines the key, so
+   * the class binding is tried next
+   */
+  binding_set = gtk_binding_set_new ("test-change");
+  gtk_binding_set_add_path (binding_set, GTK_PATH_CLASS, "TestLabel",
+			    GTK_PATH_PRIO_APPLICATION);
+  gtk_binding_entry_add_signal (binding_set, GDK_F10, 0, "popup-menu", 0);
+
+  g_assert_cmpint (send_key (label, GDK_F10, &last_value), ==, 4);
+  g_assert_cmpint (send_key (label, GDK_F11, &last_value), ==, 5);
+
+  g_object_unref (label);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/bindings/class", test_class);
+  g_test_add_func ("/bindings/override", test_override);
+  g_test_add_func ("/bindings/add-remove", test_add_remove);
+  g_test_add_func ("/bindings/change-while-activating", test_change_while_activating);
+
+  return g_test_run ();
+}
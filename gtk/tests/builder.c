@@ -2576,6 +2576,175 @@ test_message_area (void)
   g_object_unref (builder);
 }
 
+static gboolean
+has_object (GtkBuilder  *builder,
+            const gchar *name)
+{
+  GSList *objects, *l;
+  gboolean found = FALSE;
+
+  /* gtk_builder_get_object() would build lazy objects */
+  objects = gtk_builder_get_objects (builder);
+  for (l = objects; l; l = l->next)
+    if (strcmp (gtk_buildable_get_name (l->data), name) == 0)
+      found = TRUE;
+  g_slist_free (objects);
+
+  return found;
+}
+
+static void
+connect_signal_counted (GtkBuilder    *builder,
+                        GObject       *object,
+                        const gchar   *signal_name,
+                        const gchar   *handler_name,
+                        GObject       *connect_object,
+                        GConnectFlags  flags,
+                        gpointer       user_data)
+{
+  gint *n_connected = user_data;
+
+  (*n_connected)++;
+}
+
+static void
+test_lazy (void)
+{
+  GtkBuilder *builder;
+  GError *error = NULL;
+  GObject *window, *notebook, *page, *dialog, *button, *label, *entry;
+  gint n_connected = 0;
+  const gchar buffer[] =
+    "<interface>"
+    "  <object class=\"GtkWindow\" id=\"window\">"
+    "    <child>"
+    "      <object class=\"GtkNotebook\" id=\"notebook\">"
+    "        <property name=\"visible\">True</property>"
+    "        <child>"
+    "          <object class=\"GtkLabel\" id=\"page1\">"
+    "            <property name=\"visible\">True</property>"
+    "            <property name=\"label\">first</property>"
+    "          </object>"
+    "        </child>"
+    "        <child>"
+    "          <object class=\"GtkVBox\" id=\"page2\" lazy=\"True\">"
+    "            <property name=\"visible\">True</property>"
+    "            <child>"
+    "              <object class=\"GtkLabel\" id=\"page2-label\">"
+    "                <property name=\"visible\">True</property>"
+    "                <property name=\"label\">second</property>"
+    "              </object>"
+    "            </child>"
+    "          </object>"
+    "          <packing>"
+    "            <property name=\"tab-label\">Second</property>"
+    "          </packing>"
+    "        </child>"
+    "      </object>"
+    "    </child>"
+    "  </object>"
+    "  <object class=\"GtkDialog\" id=\"dialog\" lazy=\"True\">"
+    "    <child internal-child=\"vbox\">"
+    "      <object class=\"GtkVBox\" id=\"dialog-vbox\">"
+    "        <child>"
+    "          <object class=\"GtkButton\" id=\"dialog-button\">"
+    "            <signal name=\"clicked\" handler=\"gtk_main_quit\"/>"
+    "          </object>"
+    "        </child>"
+    "      </object>"
+    "    </child>"
+    "  </object>"
+    "</interface>";
+  const gchar buffer2[] =
+    "<interface>"
+    "  <object class=\"GtkDialog\" id=\"dialog\">"
+    "    <child internal-child=\"vbox\">"
+    "      <object class=\"GtkVBox\" id=\"dialog-vbox\" lazy=\"True\"/>"
+    "    </child>"
+    "  </object>"
+    "</interface>";
+  const gchar buffer3[] =
+    "<interface>"
+    "  <object class=\"GtkLabel\" id=\"label\">"
+    "    <property name=\"mnemonic-widget\">entry</property>"
+    "  </object>"
+    "  <object class=\"GtkWindow\" id=\"lazy-window\" lazy=\"True\">"
+    "    <child>"
+    "      <object class=\"GtkButton\" id=\"lazy-button\"/>"
+    "    </child>"
+    "  </object>"
+    "  <object class=\"GtkLabel\" id=\"button-label\">"
+    "    <property name=\"mnemonic-widget\">lazy-button</property>"
+    "  </object>"
+    "  <object class=\"GtkEntry\" id=\"entry\"/>"
+    "</interface>";
+
+  builder = builder_new_from_string (buffer, -1, NULL);
+  g_assert (has_object (builder, "window"));
+  g_assert (has_object (builder, "page1"));
+  g_assert (!has_object (builder, "page2"));
+  g_assert (!has_object (builder, "page2-label"));
+  g_assert (!has_object (builder, "dialog"));
+  g_assert (!has_object (builder, "dialog-button"));
+
+  gtk_builder_connect_signals_full (builder, connect_signal_counted, &n_connected);
+  g_assert_cmpint (n_connected, ==, 0);
+
+  /* The placeholder is built when it is mapped */
+  window = gtk_builder_get_object (builder, "window");
+  notebook = gtk_builder_get_object (builder, "notebook");
+  g_assert_cmpint (gtk_notebook_get_n_pages (GTK_NOTEBOOK (notebook)), ==, 2);
+  gtk_widget_show (GTK_WIDGET (window));
+  g_assert (!has_object (builder, "page2"));
+
+  gtk_notebook_set_current_page (GTK_NOTEBOOK (notebook), 1);
+  g_assert (has_object (builder, "page2"));
+  g_assert (has_object (builder, "page2-label"));
+  page = gtk_builder_get_object (builder, "page2");
+  g_assert (gtk_widget_get_parent (GTK_WIDGET (page)) ==
+            gtk_notebook_get_nth_page (GTK_NOTEBOOK (notebook), 1));
+  g_assert (gtk_widget_get_mapped (GTK_WIDGET (page)));
+  g_assert (!has_object (builder, "dialog"));
+
+  /* Looking up an object inside of a lazy object builds it, and its
+   * signals are connected like the others
+   */
+  button = gtk_builder_get_object (builder, "dialog-button");
+  g_assert (GTK_IS_BUTTON (button));
+  dialog = gtk_builder_get_object (builder, "dialog");
+  g_assert (GTK_IS_DIALOG (dialog));
+  g_assert (gtk_widget_get_toplevel (GTK_WIDGET (button)) == GTK_WIDGET (dialog));
+  g_assert_cmpint (n_connected, ==, 1);
+
+  gtk_widget_destroy (GTK_WIDGET (window));
+  gtk_widget_destroy (GTK_WIDGET (dialog));
+  g_object_unref (builder);
+
+  /* Internal children can not be lazy */
+  builder = gtk_builder_new ();
+  gtk_builder_add_from_string (builder, buffer2, -1, &error);
+  g_assert (g_error_matches (error,
+                             GTK_BUILDER_ERROR,
+                             GTK_BUILDER_ERROR_INVALID_ATTRIBUTE));
+  g_error_free (error);
+  g_object_unref (builder);
+
+  /* Referring to a lazy object in the middle of a document builds it
+   * right away, without applying the forward references seen so far
+   */
+  builder = builder_new_from_string (buffer3, -1, NULL);
+  g_assert (has_object (builder, "lazy-button"));
+  label = gtk_builder_get_object (builder, "label");
+  entry = gtk_builder_get_object (builder, "entry");
+  g_assert (gtk_label_get_mnemonic_widget (GTK_LABEL (label)) == GTK_WIDGET (entry));
+  label = gtk_builder_get_object (builder, "button-label");
+  button = gtk_builder_get_object (builder, "lazy-button");
+  g_assert (gtk_label_get_mnemonic_widget (GTK_LABEL (label)) == GTK_WIDGET (button));
+
+  gtk_widget_destroy (GTK_WIDGET (gtk_builder_get_object (builder, "lazy-window")));
+  g_object_unref (builder);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -2622,6 +2791,7 @@ main (int argc, char **argv)
   g_test_add_func ("/Builder/Menus", test_menus);
   g_test_add_func ("/Builder/MessageArea", test_message_area);
   g_test_add_func ("/Builder/MessageDialog", test_message_dialog);
+  g_test_add_func ("/Builder/Lazy", test_lazy);
 
   return g_test_run();
 }
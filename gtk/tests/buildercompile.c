@@ -0,0 +1,643 @@
+/* buildercompile.c - test compiled GtkBuilder UI definitions
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Builds each UI definition from XML and from its compiled form, and
+ * checks that the two object trees are the same.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+static const gchar *basic_ui =
+  "<interface>"
+  "  <requires lib=\"gtk+\" version=\"2.12\"/>"
+  "  <object class=\"GtkWindow\" id=\"window1\">"
+  "    <property name=\"title\" translatable=\"yes\" context=\"window\">Compiled</property>"
+  "    <property name=\"border_width\">6</property>"
+  "    <property name=\"window_position\">center</property>"
+  "    <property name=\"type_hint\">GDK_WINDOW_TYPE_HINT_DIALOG</property>"
+  "    <property name=\"opacity\">0.75</property>"
+  "    <property name=\"default_width\">300</property>"
+  "    <signal name=\"delete_event\" handler=\"on_delete\" after=\"yes\"/>"
+  "    <child>"
+  "      <object class=\"GtkTable\" id=\"table1\">"
+  "        <property name=\"n_rows\">2</property>"
+  "        <property name=\"n_columns\">2</property>"
+  "        <property name=\"homogeneous\">True</property>"
+  "        <child>"
+  "          <object class=\"GtkLabel\" id=\"label1\">"
+  "            <property name=\"label\">_Name &amp; &lt;value&gt;</property>"
+  "            <property name=\"use_underline\">yes</property>"
+  "            <property name=\"mnemonic_widget\">entry1</property>"
+  "            <property name=\"xalign\">0.25</property>"
+  "            <property name=\"justify\">GTK_JUSTIFY_RIGHT</property>"
+  "          </object>"
+  "          <packing>"
+  "            <property name=\"x_options\">GTK_FILL</property>"
+  "            <property name=\"y_options\">GTK_EXPAND | GTK_FILL</property>"
+  "          </packing>"
+  "        </child>"
+  "        <child>"
+  "          <object class=\"GtkEntry\" id=\"entry1\">"
+  "            <property name=\"max_length\">20</property>"
+  "            <property name=\"invisible_char\">*</property>"
+  "            <property name=\"text\" translatable=\"no\">text</property>"
+  "            <signal name=\"activate\" handler=\"on_activate\" object=\"window1\"/>"
+  "          </object>"
+  "          <packing>"
+  "            <property name=\"left_attach\">1</property>"
+  "            <property name=\"right_attach\">2</property>"
+  "          </packing>"
+  "        </child>"
+  "        <child>"
+  "          <placeholder/>"
+  "        </child>"
+  "        <child>"
+  "          <object class=\"GtkHScale\" id=\"scale1\">"
+  "            <property name=\"adjustment\">adjustment1</property>"
+  "            <property name=\"digits\">2</property>"
+  "            <property name=\"value_pos\">left</property>"
+  "          </object>"
+  "          <packing>"
+  "            <property name=\"top_attach\">1</property>"
+  "            <property name=\"bottom_attach\">2</property>"
+  "            <property name=\"right_attach\">2</property>"
+  "          </packing>"
+  "        </child>"
+  "      </object>"
+  "    </child>"
+  "  </object>"
+  "  <object class=\"GtkAdjustment\" id=\"adjustment1\">"
+  "    <property name=\"upper\">100</property>"
+  "    <property name=\"value\">42.5</property>"
+  "    <property name=\"step_increment\">0.5</property>"
+  "  </object>"
+  "</interface>";
+
+static const gchar *custom_ui =
+  "<interface>"
+  "  <object class=\"GtkListStore\" id=\"liststore1\">"
+  "    <columns>"
+  "      <column type=\"gchararray\"/>"
+  "      <column type=\"gint\"/>"
+  "      <column type=\"gboolean\"/>"
+  "    </columns>"
+  "    <data>"
+  "      <row>"
+  "        <col id=\"0\">\"Quoted\" &lt;text&gt; &amp; more</col>"
+  "        <col id=\"1\">7</col>"
+  "        <col id=\"2\">True</col>"
+  "      </row>"
+  "      <row>"
+  "        <col id=\"0\"><![CDATA[<cdata> & text]]></col>"
+  "        <col id=\"1\">-3</col>"
+  "        <col id=\"2\">False</col>"
+  "      </row>"
+  "    </data>"
+  "  </object>"
+  "  <object class=\"GtkWindow\" id=\"window2\">"
+  "    <child>"
+  "      <object class=\"GtkVBox\" id=\"vbox1\">"
+  "        <property name=\"spacing\">4</property>"
+  "        <child>"
+  "          <object class=\"GtkTreeView\" id=\"treeview1\">"
+  "            <property name=\"model\">liststore1</property>"
+  "            <property name=\"headers_visible\">False</property>"
+  "            <child>"
+  "              <object class=\"GtkTreeViewColumn\" id=\"column1\">"
+  "                <property name=\"title\">Text</property>"
+  "                <child>"
+  "                  <object class=\"GtkCellRendererText\" id=\"renderer1\"/>"
+  "                  <attributes>"
+  "                    <attribute name=\"text\">0</attribute>"
+  "                  </attributes>"
+  "                </child>"
+  "              </object>"
+  "            </child>"
+  "          </object>"
+  "          <packing>"
+  "            <property name=\"expand\">False</property>"
+  "            <property name=\"position\">0</property>"
+  "          </packing>"
+  "        </child>"
+  "        <child>"
+  "          <object class=\"GtkButton\" id=\"button1\">"
+  "            <property name=\"label\">gtk-ok</property>"
+  "            <property name=\"use_stock\">True</property>"
+  "            <property name=\"relief\">GTK_RELIEF_NONE</property>"
+  "            <signal name=\"clicked\" handler=\"on_clicked\" swapped=\"no\"/>"
+  "          </object>"
+  "        </child>"
+  "        <child>"
+  "          <object class=\"GtkButton\" id=\"button2\">"
+  "            <property name=\"label\" translatable=\"yes\">Cancel</property>"
+  "          </object>"
+  "        </child>"
+  "      </object>"
+  "    </child>"
+  "  </object>"
+  "  <object class=\"GtkSizeGroup\" id=\"sizegroup1\">"
+  "    <property name=\"mode\">GTK_SIZE_GROUP_HORIZONTAL</property>"
+  "    <widgets>"
+  "      <widget name=\"button1\"/>"
+  "      <widget name=\"button2\"/>"
+  "    </widgets>"
+  "  </object>"
+  "</interface>";
+
+static const gchar *dialog_ui =
+  "<interface>"
+  "  <object class=\"GtkDialog\" id=\"dialog1\">"
+  "    <property name=\"modal\">True</property>"
+  "    <child internal-child=\"vbox\">"
+  "      <object class=\"GtkVBox\" id=\"dialog-vbox1\">"
+  "        <child>"
+  "          <object class=\"GtkLabel\" id=\"dialog-label\">"
+  "            <property name=\"label\">Dialog\ttext</property>"
+  "          </object>"
+  "        </child>"
+  "        <child internal-child=\"action_area\">"
+  "          <object class=\"GtkHButtonBox\" id=\"dialog-action_area1\">"
+  "            <property name=\"layout_style\">end</property>"
+  "            <child>"
+  "              <object class=\"GtkButton\" id=\"ok_button\">"
+  "                <property name=\"label\">gtk-ok</property>"
+  "                <property name=\"use_stock\">True</property>"
+  "                <property name=\"can_default\">True</property>"
+  "              </object>"
+  "            </child>"
+  "          </object>"
+  "          <packing>"
+  "            <property name=\"pack_type\">end</property>"
+  "          </packing>"
+  "        </child>"
+  "      </object>"
+  "    </child>"
+  "    <action-widgets>"
+  "      <action-widget response=\"-5\">ok_button</action-widget>"
+  "    </action-widgets>"
+  "  </object>"
+  "</interface>";
+
+static gchar *tmp_dir;
+
+static gchar *
+compile_ui (const gchar  *ui,
+	    gchar       **xml_filename)
+{
+  static gint n_files = 0;
+  gchar *argv[5];
+  gchar *name, *filename;
+  gint status;
+  GError *error = NULL;
+
+  name = g_strdup_printf ("test%d.ui", n_files++);
+  *xml_filename = g_build_filename (tmp_dir, name, NULL);
+  filename = g_strconcat (*xml_filename, ".compiled", NULL);
+  g_free (name);
+
+  g_file_set_contents (*xml_filename, ui, -1, &error);
+  g_assert_no_error (error);
+
+  argv[0] = (gchar *)BUILDER_COMPILE;
+  argv[1] = "--quiet";
+  argv[2] = *xml_filename;
+  argv[3] = filename;
+  argv[4] = NULL;
+
+  g_spawn_sync (NULL, argv, NULL, 0, NULL, NULL, NULL, NULL, &status, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (status, ==, 0);
+
+  return filename;
+}
+
+static const gchar *
+object_name (GObject *object)
+{
+  if (object == NULL)
+    return NULL;
+
+  if (GTK_IS_BUILDABLE (object))
+    return gtk_buildable_get_name (GTK_BUILDABLE (object));
+
+  return g_object_get_data (object, "gtk-builder-name");
+}
+
+static gboolean
+is_comparable (GParamSpec *pspec)
+{
+  GType type = G_TYPE_FUNDAMENTAL (G_PARAM_SPEC_VALUE_TYPE (pspec));
+
+  /* Boxed values and pointers are compared by address */
+  return (pspec->flags & G_PARAM_READABLE) &&
+	 type != G_TYPE_BOXED && type != G_TYPE_POINTER && type != G_TYPE_PARAM;
+}
+
+static void
+compare_values (GObject     *object,
+		const gchar *property,
+		GParamSpec  *pspec,
+		GValue      *a,
+		GValue      *b)
+{
+  if (G_TYPE_FUNDAMENTAL (G_PARAM_SPEC_VALUE_TYPE (pspec)) == G_TYPE_OBJECT)
+    {
+      if (g_strcmp0 (object_name (g_value_get_object (a)),
+		     object_name (g_value_get_object (b))) != 0)
+	g_error ("%s.%s differs: %s, %s", object_name (object), property,
+		 object_name (g_value_get_object (a)),
+		 object_name (g_value_get_object (b)));
+    }
+  else if (g_param_values_cmp (pspec, a, b) != 0)
+    {
+      gchar *contents_a = g_strdup_value_contents (a);
+      gchar *contents_b = g_strdup_value_contents (b);
+
+      g_error ("%s.%s differs: %s, %s", object_name (object), property,
+	       contents_a, contents_b);
+    }
+}
+
+static void
+compare_properties (GObject *a,
+		    GObject *b)
+{
+  GParamSpec **pspecs;
+  guint i, n_pspecs;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (a), &n_pspecs);
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GValue value_a = { 0, };
+      GValue value_b = { 0, };
+
+      if (!is_comparable (pspecs[i]))
+	continue;
+
+      g_value_init (&value_a, G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+      g_value_init (&value_b, G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+      g_object_get_property (a, pspecs[i]->name, &value_a);
+      g_object_get_property (b, pspecs[i]->name, &value_b);
+
+      compare_values (a, pspecs[i]->name, pspecs[i], &value_a, &value_b);
+
+      g_value_unset (&value_a);
+      g_value_unset (&value_b);
+    }
+  g_free (pspecs);
+}
+
+static void
+compare_child_properties (GtkContainer *a,
+			  GtkWidget    *child_a,
+			  GtkContainer *b,
+			  GtkWidget    *child_b)
+{
+  GParamSpec **pspecs;
+  guint i, n_pspecs;
+
+  pspecs = gtk_container_class_list_child_properties (G_OBJECT_GET_CLASS (a), &n_pspecs);
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GValue value_a = { 0, };
+      GValue value_b = { 0, };
+
+      if (!is_comparable (pspecs[i]))
+	continue;
+
+      g_value_init (&value_a, G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+      g_value_init (&value_b, G_PARAM_SPEC_VALUE_TYPE (pspecs[i]));
+      gtk_container_child_get_property (a, child_a, pspecs[i]->name, &value_a);
+      gtk_container_child_get_property (b, child_b, pspecs[i]->name, &value_b);
+
+      compare_values (G_OBJECT (child_a), pspecs[i]->name, pspecs[i], &value_a, &value_b);
+
+      g_value_unset (&value_a);
+      g_value_unset (&value_b);
+    }
+  g_free (pspecs);
+}
+
+static void
+compare_children (GtkContainer *a,
+		  GtkContainer *b)
+{
+  GList *children_a, *children_b, *l, *m;
+
+  children_a = gtk_container_get_children (a);
+  children_b = gtk_container_get_children (b);
+  g_assert_cmpint (g_list_length (children_a), ==, g_list_length (children_b));
+
+  for (l = children_a, m = children_b; l; l = l->next, m = m->next)
+    {
+      g_assert_cmpstr (G_OBJECT_TYPE_NAME (l->data), ==, G_OBJECT_TYPE_NAME (m->data));
+      g_assert_cmpstr (object_name (l->data), ==, object_name (m->data));
+      compare_child_properties (a, l->data, b, m->data);
+    }
+
+  g_list_free (children_a);
+  g_list_free (children_b);
+}
+
+static void
+compare_models (GtkTreeModel *a,
+		GtkTreeModel *b)
+{
+  GtkTreeIter iter_a, iter_b;
+  gboolean valid_a, valid_b;
+  gint i, n_columns;
+
+  n_columns = gtk_tree_model_get_n_columns (a);
+  g_assert_cmpint (n_columns, ==, gtk_tree_model_get_n_columns (b));
+
+  valid_a = gtk_tree_model_get_iter_first (a, &iter_a);
+  valid_b = gtk_tree_model_get_iter_first (b, &iter_b);
+  while (valid_a && valid_b)
+    {
+      for (i = 0; i < n_columns; i++)
+	{
+	  GValue value_a = { 0, };
+	  GValue value_b = { 0, };
+	  gchar *contents_a, *contents_b;
+
+	  gtk_tree_model_get_value (a, &iter_a, i, &value_a);
+	  gtk_tree_model_get_value (b, &iter_b, i, &value_b);
+	  contents_a = g_strdup_value_contents (&value_a);
+	  contents_b = g_strdup_value_contents (&value_b);
+	  g_assert_cmpstr (contents_a, ==, contents_b);
+
+	  g_free (contents_a);
+	  g_free (contents_b);
+	  g_value_unset (&value_a);
+	  g_value_unset (&value_b);
+	}
+
+      valid_a = gtk_tree_model_iter_next (a, &iter_a);
+      valid_b = gtk_tree_model_iter_next (b, &iter_b);
+    }
+  g_assert (!valid_a && !valid_b);
+}
+
+static void
+compare_size_groups (GtkSizeGroup *a,
+		     GtkSizeGroup *b)
+{
+  GSList *l, *m;
+
+  l = gtk_size_group_get_widgets (a);
+  m = gtk_size_group_get_widgets (b);
+  for (; l && m; l = l->next, m = m->next)
+    g_assert_cmpstr (object_name (l->data), ==, object_name (m->data));
+  g_assert (l == NULL && m == NULL);
+}
+
+static void
+compare_objects (GObject *a,
+		 GObject *b)
+{
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (a), ==, G_OBJECT_TYPE_NAME (b));
+
+  compare_properties (a, b);
+
+  if (GTK_IS_CONTAINER (a))
+    compare_children (GTK_CONTAINER (a), GTK_CONTAINER (b));
+  if (GTK_IS_TREE_MODEL (a))
+    compare_models (GTK_TREE_MODEL (a), GTK_TREE_MODEL (b));
+  if (GTK_IS_SIZE_GROUP (a))
+    compare_size_groups (GTK_SIZE_GROUP (a), GTK_SIZE_GROUP (b));
+  if (GTK_IS_DIALOG (a))
+    {
+      GtkWidget *area_a = gtk_dialog_get_action_area (GTK_DIALOG (a));
+      GtkWidget *area_b = gtk_dialog_get_action_area (GTK_DIALOG (b));
+      GList *buttons_a = gtk_container_get_children (GTK_CONTAINER (area_a));
+      GList *buttons_b = gtk_container_get_children (GTK_CONTAINER (area_b));
+
+      g_assert_cmpint (gtk_dialog_get_response_for_widget (GTK_DIALOG (a), buttons_a->data), ==,
+		       gtk_dialog_get_response_for_widget (GTK_DIALOG (b), buttons_b->data));
+
+      g_list_free (buttons_a);
+      g_list_free (buttons_b);
+    }
+}
+
+static void
+collect_signal (GtkBuilder    *builder,
+		GObject       *object,
+		const gchar   *signal_name,
+		const gchar   *handler_name,
+		GObject       *connect_object,
+		GConnectFlags  flags,
+		gpointer       user_data)
+{
+  GString *signals = user_data;
+
+  g_string_append_printf (signals, "%s::%s %s %s %d\n",
+			  object_name (object), signal_name, handler_name,
+			  object_name (connect_object), flags);
+}
+
+static void
+compare_builders (GtkBuilder *a,
+		  GtkBuilder *b)
+{
+  GSList *objects_a, *objects_b, *l;
+  GString *signals_a, *signals_b;
+
+  objects_a = gtk_builder_get_objects (a);
+  objects_b = gtk_builder_get_objects (b);
+  g_assert_cmpint (g_slist_length (objects_a), ==, g_slist_length (objects_b));
+
+  for (l = objects_a; l; l = l->next)
+    {
+      GObject *object = gtk_builder_get_object (b, object_name (l->data));
+
+      g_assert (object != NULL);
+      compare_objects (l->data, object);
+    }
+
+  signals_a = g_string_new (NULL);
+  signals_b = g_string_new (NULL);
+  gtk_builder_connect_signals_full (a, collect_signal, signals_a);
+  gtk_builder_connect_signals_full (b, collect_signal, signals_b);
+  g_assert_cmpstr (signals_a->str, ==, signals_b->str);
+
+  g_string_free (signals_a, TRUE);
+  g_string_free (signals_b, TRUE);
+  g_slist_free (objects_a);
+  g_slist_free (objects_b);
+}
+
+static void
+destroy_builder (GtkBuilder *builder)
+{
+  GSList *objects, *l;
+
+  objects = gtk_builder_get_objects (builder);
+  for (l = objects; l; l = l->next)
+    {
+      if (GTK_IS_WINDOW (l->data))
+	gtk_widget_destroy (l->data);
+    }
+  g_slist_free (objects);
+
+  g_object_unref (builder);
+}
+
+static void
+test_ui (const gchar *ui)
+{
+  GtkBuilder *xml_builder, *compiled_builder;
+  gchar *xml_filename, *filename;
+  GError *error = NULL;
+
+  filename = compile_ui (ui, &xml_filename);
+
+  xml_builder = gtk_builder_new ();
+  gtk_builder_add_from_file (xml_builder, xml_filename, &error);
+  g_assert_no_error (error);
+
+  compiled_builder = gtk_builder_new ();
+  gtk_builder_add_from_file (compiled_builder, filename, &error);
+  g_assert_no_error (error);
+
+  compare_builders (xml_builder, compiled_builder);
+
+  destroy_builder (xml_builder);
+  destroy_builder (compiled_builder);
+
+  g_remove (xml_filename);
+  g_remove (filename);
+  g_free (xml_filename);
+  g_free (filename);
+}
+
+static void
+test_basic (void)
+{
+  test_ui (basic_ui);
+}
+
+static void
+test_custom (void)
+{
+  test_ui (custom_ui);
+}
+
+static void
+test_dialog (void)
+{
+  test_ui (dialog_ui);
+}
+
+static void
+test_requested_objects (void)
+{
+  GtkBuilder *xml_builder, *compiled_builder;
+  gchar *xml_filename, *filename;
+  gchar *object_ids[] = { "liststore1", "treeview1", NULL };
+  GError *error = NULL;
+
+  filename = compile_ui (custom_ui, &xml_filename);
+
+  xml_builder = gtk_builder_new ();
+  gtk_builder_add_objects_from_file (xml_builder, xml_filename, object_ids, &error);
+  g_assert_no_error (error);
+
+  compiled_builder = gtk_builder_new ();
+  gtk_builder_add_objects_from_file (compiled_builder, filename, object_ids, &error);
+  g_assert_no_error (error);
+
+  g_assert (gtk_builder_get_object (compiled_builder, "window2") == NULL);
+  g_assert (gtk_builder_get_object (compiled_builder, "renderer1") != NULL);
+  compare_builders (xml_builder, compiled_builder);
+
+  destroy_builder (xml_builder);
+  destroy_builder (compiled_builder);
+
+  g_remove (xml_filename);
+  g_remove (filename);
+  g_free (xml_filename);
+  g_free (filename);
+}
+
+static void
+test_invalid (void)
+{
+  GtkBuilder *builder;
+  gchar *xml_filename, *filename;
+  gchar *contents;
+  gsize length, i;
+  GError *error = NULL;
+
+  filename = compile_ui (dialog_ui, &xml_filename);
+  g_file_get_contents (filename, &contents, &length, &error);
+  g_assert_no_error (error);
+
+  /* Truncated files are rejected before anything is built */
+  for (i = 0; i < length; i += 7)
+    {
+      builder = gtk_builder_new ();
+      g_assert_cmpint (gtk_builder_add_from_string (builder, contents, i, &error), ==, 0);
+      g_assert (error != NULL);
+      g_clear_error (&error);
+      g_object_unref (builder);
+    }
+
+  /* An unknown record in place of the first one */
+  memset (contents + GUINT32_FROM_BE (*(guint32 *)(contents + 16)), 0xff, 4);
+  builder = gtk_builder_new ();
+  g_assert_cmpint (gtk_builder_add_from_string (builder, contents, length, &error), ==, 0);
+  g_assert_error (error, GTK_BUILDER_ERROR, GTK_BUILDER_ERROR_INVALID_VALUE);
+  g_clear_error (&error);
+  g_object_unref (builder);
+
+  g_free (contents);
+  g_remove (xml_filename);
+  g_remove (filename);
+  g_free (xml_filename);
+  g_free (filename);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  int result;
+
+  gtk_test_init (&argc, &argv);
+
+  tmp_dir = g_strdup_printf ("%s/buildercompile-%d", g_get_tmp_dir (), getpid ());
+  g_mkdir_with_parents (tmp_dir, 0755);
+
+  g_test_add_func ("/builder-compile/basic", test_basic);
+  g_test_add_func ("/builder-compile/custom", test_custom);
+  g_test_add_func ("/builder-compile/dialog", test_dialog);
+  g_test_add_func ("/builder-compile/requested-objects", test_requested_objects);
+  g_test_add_func ("/builder-compile/invalid", test_invalid);
+
+  result = g_test_run ();
+
+  g_rmdir (tmp_dir);
+  g_free (tmp_dir);
+
+  return result;
+}
@@ -0,0 +1,180 @@
+/* expose.c - test which children an expose of a container reaches
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+#define GRID_SIZE 10
+#define CELL_SIZE 40
+
+/* A fixed with GRID_SIZE x GRID_SIZE labels of CELL_SIZE pixels,
+ * enough for the fixed to keep an index of its children
+ */
+typedef struct
+{
+  GtkWidget *window;
+  GtkWidget *fixed;
+  GtkWidget *labels[GRID_SIZE][GRID_SIZE];
+  gint exposes[GRID_SIZE][GRID_SIZE];
+} Fixture;
+
+static gboolean
+count_expose (GtkWidget      *widget,
+	      GdkEventExpose *event,
+	      gint           *exposes)
+{
+  (*exposes)++;
+
+  return FALSE;
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+	       gconstpointer  data)
+{
+  gint i, j;
+
+  fixture->window = gtk_window_new (GTK_WINDOW_POPUP);
+  fixture->fixed = gtk_fixed_new ();
+  gtk_container_add (GTK_CONTAINER (fixture->window), fixture->fixed);
+
+  for (i = 0; i < GRID_SIZE; i++)
+    for (j = 0; j < GRID_SIZE; j++)
+      {
+	GtkWidget *label = gtk_label_new ("X");
+
+	gtk_widget_set_size_request (label, CELL_SIZE, CELL_SIZE);
+	gtk_fixed_put (GTK_FIXED (fixture->fixed), label, j * CELL_SIZE, i * CELL_SIZE);
+	g_signal_connect (label, "expose-event",
+			  G_CALLBACK (count_expose), &fixture->exposes[i][j]);
+	fixture->labels[i][j] = label;
+      }
+
+  gtk_widget_show_all (fixture->window);
+  flush_events ();
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+/* Exposes a rectangle of the fixed right away and returns the
+ * number of labels that got an expose
+ */
+static gint
+expose_rect (Fixture *fixture,
+	     gint     x,
+	     gint     y,
+	     gint     width,
+	     gint     height)
+{
+  GdkRectangle rect = { x, y, width, height };
+  gint i, j, n_exposed;
+
+  for (i = 0; i < GRID_SIZE; i++)
+    for (j = 0; j < GRID_SIZE; j++)
+      fixture->exposes[i][j] = 0;
+
+  gdk_window_invalidate_rect (fixture->fixed->window, &rect, FALSE);
+  gdk_window_process_updates (fixture->fixed->window, FALSE);
+
+  n_exposed = 0;
+  for (i = 0; i < GRID_SIZE; i++)
+    for (j = 0; j < GRID_SIZE; j++)
+      if (fixture->exposes[i][j])
+	n_exposed++;
+
+  return n_exposed;
+}
+
+static void
+test_culling (Fixture       *fixture,
+	      gconstpointer  data)
+{
+  /* Inside a single cell */
+  g_assert_cmpint (expose_rect (fixture, 45, 45, 10, 10), ==, 1);
+  g_assert_cmpint (fixture->exposes[1][1], ==, 1);
+
+  /* Across the corner of four cells */
+  g_assert_cmpint (expose_rect (fixture, 75, 75, 10, 10), ==, 4);
+  g_assert_cmpint (fixture->exposes[2][2], ==, 1);
+
+  /* The last row */
+  g_assert_cmpint (expose_rect (fixture, 0, (GRID_SIZE - 1) * CELL_SIZE,
+				GRID_SIZE * CELL_SIZE, CELL_SIZE), ==, GRID_SIZE);
+  g_assert_cmpint (fixture->exposes[GRID_SIZE - 1][0], ==, 1);
+
+  /* Everything */
+  g_assert_cmpint (expose_rect (fixture, 0, 0, GRID_SIZE * CELL_SIZE,
+				GRID_SIZE * CELL_SIZE), ==, GRID_SIZE * GRID_SIZE);
+}
+
+static void
+test_moved_child (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gtk_fixed_move (GTK_FIXED (fixture->fixed), fixture->labels[0][0], 45, 45);
+  flush_events ();
+
+  /* Both the moved label and the one below it are exposed */
+  g_assert_cmpint (expose_rect (fixture, 50, 50, 5, 5), ==, 2);
+  g_assert_cmpint (fixture->exposes[0][0], ==, 1);
+  g_assert_cmpint (fixture->exposes[1][1], ==, 1);
+
+  /* And nothing is left at the old place */
+  g_assert_cmpint (expose_rect (fixture, 5, 5, 5, 5), ==, 0);
+}
+
+static void
+test_hidden_child (Fixture       *fixture,
+		   gconstpointer  data)
+{
+  gtk_widget_hide (fixture->labels[1][1]);
+  flush_events ();
+  g_assert_cmpint (expose_rect (fixture, 45, 45, 10, 10), ==, 0);
+
+  gtk_widget_show (fixture->labels[1][1]);
+  flush_events ();
+  g_assert_cmpint (expose_rect (fixture, 45, 45, 10, 10), ==, 1);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/expose/culling", Fixture, NULL,
+	      fixture_setup, test_culling, fixture_teardown);
+  g_test_add ("/expose/moved-child", Fixture, NULL,
+	      fixture_setup, test_moved_child, fixture_teardown);
+  g_test_add ("/expose/hidden-child", Fixture, NULL,
+	      fixture_setup, test_hidden_child, fixture_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,413 @@
+/* iconcache.c - test gtk-update-icon-cache
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixdata.h>
+
+/* Like gtk-update-icon-cache, include the validator directly, it
+ * is not exported from the library
+ */
+#include "../gtk/gtkiconcachevalidator.c"
+
+#define GET_UINT16(cache, offset) (GUINT16_FROM_BE (*(guint16 *)((cache) + (offset))))
+#define GET_UINT32(cache, offset) (GUINT32_FROM_BE (*(guint32 *)((cache) + (offset))))
+
+#define HAS_SUFFIX_XPM (1 << 0)
+#define HAS_SUFFIX_SVG (1 << 1)
+#define HAS_SUFFIX_PNG (1 << 2)
+#define HAS_ICON_FILE  (1 << 3)
+
+static void
+write_png (const gchar *dir,
+	   const gchar *name,
+	   gint         size,
+	   guint32      color)
+{
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+  gchar *path;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  gdk_pixbuf_fill (pixbuf, color);
+
+  path = g_build_filename (dir, name, NULL);
+  gdk_pixbuf_save (pixbuf, path, "png", &error, NULL);
+  g_assert_no_error (error);
+
+  g_free (path);
+  g_object_unref (pixbuf);
+}
+
+static void
+write_file (const gchar *dir,
+	    const gchar *name,
+	    const gchar *contents)
+{
+  GError *error = NULL;
+  gchar *path;
+
+  path = g_build_filename (dir, name, NULL);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+  g_free (path);
+}
+
+/* Makes dir look like it has not changed since long before the
+ * cache was written
+ */
+static void
+age_directory (const gchar *dir)
+{
+  struct utimbuf times;
+
+  times.actime = times.modtime = time (NULL) - 3600;
+  g_assert_cmpint (g_utime (dir, &times), ==, 0);
+}
+
+static gchar *
+create_theme (void)
+{
+  gchar *theme, *apps, *actions;
+
+  theme = g_strdup_printf ("%s/iconcache-%d", g_get_tmp_dir (), getpid ());
+  apps = g_build_filename (theme, "16x16", "apps", NULL);
+  actions = g_build_filename (theme, "16x16", "actions", NULL);
+
+  g_mkdir_with_parents (apps, 0755);
+  g_mkdir_with_parents (actions, 0755);
+
+  write_file (theme, "index.theme",
+	      "[Icon Theme]\n"
+	      "Name=Test\n"
+	      "Directories=16x16/apps,16x16/actions\n"
+	      "\n"
+	      "[16x16/apps]\n"
+	      "Size=16\n"
+	      "\n"
+	      "[16x16/actions]\n"
+	      "Size=16\n");
+
+  write_png (apps, "app-one.png", 16, 0xff0000ff);
+  write_png (apps, "app-two.png", 16, 0x00ff00ff);
+  write_file (apps, "app-two.icon",
+	      "[Icon Data]\n"
+	      "EmbeddedTextRectangle=1,2,14,15\n"
+	      "DisplayName=App Two\n");
+  write_file (apps, "app-three.svg", "<svg/>\n");
+  write_png (actions, "go-next.png", 16, 0x0000ffff);
+
+  age_directory (apps);
+  age_directory (actions);
+
+  g_free (apps);
+  g_free (actions);
+
+  return theme;
+}
+
+static void
+remove_tree (const gchar *path)
+{
+  GDir *dir;
+  const gchar *name;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+	{
+	  gchar *child = g_build_filename (path, name, NULL);
+	  remove_tree (child);
+	  g_free (child);
+	}
+      g_dir_close (dir);
+    }
+
+  g_remove (path);
+}
+
+static void
+update_cache (const gchar *theme,
+	      const gchar *option1,
+	      const gchar *option2)
+{
+  gchar *argv[6];
+  gint i = 0;
+  gint status;
+  GError *error = NULL;
+
+  argv[i++] = (gchar *)UPDATE_ICON_CACHE;
+  argv[i++] = "--quiet";
+  if (option1)
+    argv[i++] = (gchar *)option1;
+  if (option2)
+    argv[i++] = (gchar *)option2;
+  argv[i++] = (gchar *)theme;
+  argv[i++] = NULL;
+
+  g_spawn_sync (NULL, argv, NULL, 0, NULL, NULL, NULL, NULL, &status, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (status, ==, 0);
+}
+
+static GMappedFile *
+load_cache (const gchar *theme)
+{
+  GMappedFile *map;
+  GError *error = NULL;
+  CacheInfo info;
+  gchar *path;
+
+  path = g_build_filename (theme, "icon-theme.cache", NULL);
+  map = g_mapped_file_new (path, FALSE, &error);
+  g_assert_no_error (error);
+  g_free (path);
+
+  info.cache = g_mapped_file_get_contents (map);
+  info.cache_size = g_mapped_file_get_length (map);
+  info.n_directories = 0;
+  info.flags = CHECK_OFFSETS|CHECK_STRINGS|CHECK_PIXBUFS;
+  g_assert (_gtk_icon_cache_validate (&info));
+
+  return map;
+}
+
+static guint
+icon_name_hash (const gchar *key)
+{
+  const signed char *p = (const signed char *)key;
+  guint32 h = *p;
+
+  if (h)
+    for (p += 1; *p != '\0'; p++)
+      h = (h << 5) - h + *p;
+
+  return h;
+}
+
+/* Returns the offset of the image entry for name in dir, or 0 */
+static guint32
+find_image (GMappedFile *map,
+	    const gchar *name,
+	    const gchar *dir)
+{
+  const gchar *cache = g_mapped_file_get_contents (map);
+  guint32 hash_offset, dir_list_offset;
+  guint32 n_dirs, n_buckets, n_images;
+  guint32 chain, image_list, i;
+  gint dir_index = -1;
+
+  hash_offset = GET_UINT32 (cache, 4);
+  dir_list_offset = GET_UINT32 (cache, 8);
+
+  n_dirs = GET_UINT32 (cache, dir_list_offset);
+  for (i = 0; i < n_dirs; i++)
+    if (strcmp (cache + GET_UINT32 (cache, dir_list_offset + 4 + 4 * i), dir) == 0)
+      dir_index = i;
+
+  if (dir_index < 0)
+    return 0;
+
+  n_buckets = GET_UINT32 (cache, hash_offset);
+  chain = GET_UINT32 (cache, hash_offset + 4 + 4 * (icon_name_hash (name) % n_buckets));
+
+  while (chain != 0xffffffff)
+    {
+      if (strcmp (cache + GET_UINT32 (cache, chain + 4), name) == 0)
+	{
+	  image_list = GET_UINT32 (cache, chain + 8);
+	  n_images = GET_UINT32 (cache, image_list);
+
+	  for (i = 0; i < n_images; i++)
+	    if (GET_UINT16 (cache, image_list + 4 + 8 * i) == dir_index)
+	      return image_list + 4 + 8 * i;
+	}
+
+      chain = GET_UINT32 (cache, chain);
+    }
+
+  return 0;
+}
+
+static guint16
+image_flags (GMappedFile *map,
+	     guint32      image)
+{
+  return GET_UINT16 (g_mapped_file_get_contents (map), image + 2);
+}
+
+/* Returns the width of the image data of image, or 0 */
+static gint
+image_width (GMappedFile *map,
+	     guint32      image)
+{
+  const gchar *cache = g_mapped_file_get_contents (map);
+  guint32 image_data, pixel_data;
+  GdkPixdata pixdata;
+
+  image_data = GET_UINT32 (cache, image + 4);
+  if (image_data == 0)
+    return 0;
+
+  pixel_data = GET_UINT32 (cache, image_data);
+  if (pixel_data == 0)
+    return 0;
+
+  if (!gdk_pixdata_deserialize (&pixdata, GET_UINT32 (cache, pixel_data + 4),
+				(const guint8 *)cache + pixel_data + 8, NULL))
+    g_assert_not_reached ();
+
+  return pixdata.width;
+}
+
+static gboolean
+image_has_meta_data (GMappedFile *map,
+		     guint32      image)
+{
+  const gchar *cache = g_mapped_file_get_contents (map);
+  guint32 image_data;
+
+  image_data = GET_UINT32 (cache, image + 4);
+
+  return image_data != 0 && GET_UINT32 (cache, image_data + 4) != 0;
+}
+
+static void
+check_theme (GMappedFile *map)
+{
+  gchar *apps, *actions;
+  guint32 image;
+
+  apps = g_build_filename ("16x16", "apps", NULL);
+  actions = g_build_filename ("16x16", "actions", NULL);
+
+  image = find_image (map, "app-one", apps);
+  g_assert (image != 0);
+  g_assert_cmpint (image_flags (map, image), ==, HAS_SUFFIX_PNG);
+  g_assert_cmpint (image_width (map, image), ==, 16);
+
+  image = find_image (map, "app-two", apps);
+  g_assert (image != 0);
+  g_assert_cmpint (image_flags (map, image), ==, HAS_SUFFIX_PNG | HAS_ICON_FILE);
+  g_assert (image_has_meta_data (map, image));
+
+  image = find_image (map, "app-three", apps);
+  g_assert (image != 0);
+  g_assert_cmpint (image_flags (map, image), ==, HAS_SUFFIX_SVG);
+
+  image = find_image (map, "go-next", actions);
+  g_assert (image != 0);
+  g_assert_cmpint (image_flags (map, image), ==, HAS_SUFFIX_PNG);
+
+  g_assert (find_image (map, "go-next", apps) == 0);
+
+  g_free (apps);
+  g_free (actions);
+}
+
+static void
+test_full (void)
+{
+  GMappedFile *map;
+  gchar *theme;
+
+  theme = create_theme ();
+
+  update_cache (theme, "--force", NULL);
+  map = load_cache (theme);
+  check_theme (map);
+  g_mapped_file_unref (map);
+
+  update_cache (theme, "--force", "--threads=4");
+  map = load_cache (theme);
+  check_theme (map);
+  g_mapped_file_unref (map);
+
+  remove_tree (theme);
+  g_free (theme);
+}
+
+static void
+test_incremental (void)
+{
+  GMappedFile *map;
+  gchar *theme, *apps, *actions, *subdir;
+  guint32 image;
+
+  theme = create_theme ();
+  apps = g_build_filename (theme, "16x16", "apps", NULL);
+  actions = g_build_filename (theme, "16x16", "actions", NULL);
+
+  /* Without an existing cache, everything is scanned */
+  update_cache (theme, "--force", "--incremental");
+  map = load_cache (theme);
+  check_theme (map);
+  g_mapped_file_unref (map);
+
+  /* A new icon in one directory, and an icon rewritten in place in
+   * a directory that looks unchanged, so its old data is kept
+   */
+  write_png (apps, "app-four.png", 16, 0xffff00ff);
+  write_png (actions, "go-next.png", 24, 0x0000ffff);
+  age_directory (actions);
+
+  update_cache (theme, "--force", "--incremental");
+  map = load_cache (theme);
+  check_theme (map);
+
+  subdir = g_build_filename ("16x16", "apps", NULL);
+  image = find_image (map, "app-four", subdir);
+  g_assert (image != 0);
+  g_assert_cmpint (image_width (map, image), ==, 16);
+  g_free (subdir);
+
+  subdir = g_build_filename ("16x16", "actions", NULL);
+  image = find_image (map, "go-next", subdir);
+  g_assert_cmpint (image_width (map, image), ==, 16);
+  g_mapped_file_unref (map);
+
+  /* A full run picks the rewritten icon up */
+  update_cache (theme, "--force", NULL);
+  map = load_cache (theme);
+  image = find_image (map, "go-next", subdir);
+  g_assert_cmpint (image_width (map, image), ==, 24);
+  g_mapped_file_unref (map);
+  g_free (subdir);
+
+  remove_tree (theme);
+  g_free (theme);
+  g_free (apps);
+  g_free (actions);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/iconcache/full", test_full);
+  g_test_add_func ("/iconcache/incremental", test_incremental);
+
+  return g_test_run ();
+}
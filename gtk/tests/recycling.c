@@ -0,0 +1,185 @@
+/* recycling.c - test the reuse of the entries of editable cells
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+/* A tree view with two editable rows of text */
+typedef struct
+{
+  GtkWidget *window;
+  GtkWidget *tree_view;
+  GtkCellRenderer *renderer;
+  GtkTreeViewColumn *column;
+} Fixture;
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+	       gconstpointer  data)
+{
+  GtkListStore *store;
+
+  store = gtk_list_store_new (1, G_TYPE_STRING);
+  gtk_list_store_insert_with_values (store, NULL, 0, 0, "First", -1);
+  gtk_list_store_insert_with_values (store, NULL, 1, 0, "Second", -1);
+
+  fixture->window = gtk_window_new (GTK_WINDOW_POPUP);
+  fixture->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+  gtk_container_add (GTK_CONTAINER (fixture->window), fixture->tree_view);
+  g_object_unref (store);
+
+  fixture->renderer = gtk_cell_renderer_text_new ();
+  g_object_set (fixture->renderer, "editable", TRUE, NULL);
+  fixture->column = gtk_tree_view_column_new_with_attributes ("Text", fixture->renderer,
+							      "text", 0, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (fixture->tree_view), fixture->column);
+
+  gtk_widget_show_all (fixture->window);
+  flush_events ();
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+/* Starts editing @row and returns the entry */
+static GtkEntry *
+start_editing (Fixture *fixture,
+	       gint     row)
+{
+  GtkTreePath *path;
+  GtkWidget *entry;
+
+  path = gtk_tree_path_new_from_indices (row, -1);
+  gtk_tree_view_set_cursor (GTK_TREE_VIEW (fixture->tree_view), path,
+			    fixture->column, TRUE);
+  gtk_tree_path_free (path);
+
+  entry = gtk_window_get_focus (GTK_WINDOW (fixture->window));
+  g_assert (GTK_IS_ENTRY (entry));
+
+  return GTK_ENTRY (entry);
+}
+
+static void
+stop_editing (GtkEntry *entry)
+{
+  gtk_cell_editable_editing_done (GTK_CELL_EDITABLE (entry));
+  gtk_cell_editable_remove_widget (GTK_CELL_EDITABLE (entry));
+  flush_events ();
+}
+
+static void
+test_reused_entry (Fixture       *fixture,
+		   gconstpointer  data)
+{
+  GtkEntry *entry, *first;
+  gint width, height;
+
+  first = start_editing (fixture, 0);
+  g_object_add_weak_pointer (G_OBJECT (first), (gpointer *) &first);
+  gtk_entry_set_max_length (first, 3);
+  gtk_entry_set_visibility (first, FALSE);
+  gtk_widget_set_name (GTK_WIDGET (first), "changed");
+  gtk_widget_set_size_request (GTK_WIDGET (first), 10, 10);
+  gtk_widget_set_tooltip_text (GTK_WIDGET (first), "Changed");
+  stop_editing (first);
+
+  /* The entry outlives the editing and is used for the next cell,
+   * without the changes made to it
+   */
+  g_assert (first != NULL);
+
+  entry = start_editing (fixture, 1);
+  g_assert (entry == first);
+  g_assert_cmpstr (gtk_entry_get_text (entry), ==, "Second");
+  g_assert_cmpint (gtk_entry_get_max_length (entry), ==, 0);
+  g_assert (gtk_entry_get_visibility (entry));
+  g_assert (!gtk_entry_get_has_frame (entry));
+  g_assert_cmpstr (gtk_widget_get_name (GTK_WIDGET (entry)), ==, "GtkEntry");
+  gtk_widget_get_size_request (GTK_WIDGET (entry), &width, &height);
+  g_assert_cmpint (width, ==, -1);
+  g_assert_cmpint (height, ==, -1);
+  g_assert (gtk_widget_get_tooltip_text (GTK_WIDGET (entry)) == NULL);
+  stop_editing (entry);
+
+  g_object_remove_weak_pointer (G_OBJECT (first), (gpointer *) &first);
+}
+
+static void
+count_activate (GtkEntry *entry,
+		gint     *n_activates)
+{
+  (*n_activates)++;
+}
+
+static void
+connect_activate (GtkCellRenderer *renderer,
+		  GtkCellEditable *editable,
+		  const gchar     *path,
+		  gint            *n_activates)
+{
+  g_signal_connect (editable, "activate", G_CALLBACK (count_activate), n_activates);
+}
+
+static void
+test_shared_entry (Fixture       *fixture,
+		   gconstpointer  data)
+{
+  GtkEntry *entry;
+  gint n_activates = 0;
+
+  /* An entry handed out to editing-started handlers is not reused,
+   * they might still hold on to it in ways that can't be detected
+   */
+  g_signal_connect (fixture->renderer, "editing-started",
+		    G_CALLBACK (connect_activate), &n_activates);
+
+  entry = start_editing (fixture, 0);
+  g_object_add_weak_pointer (G_OBJECT (entry), (gpointer *) &entry);
+  stop_editing (entry);
+  g_assert (entry == NULL);
+
+  entry = start_editing (fixture, 1);
+  gtk_widget_activate (GTK_WIDGET (entry));
+  g_assert_cmpint (n_activates, ==, 1);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/recycling/reused-entry", Fixture, NULL,
+	      fixture_setup, test_reused_entry, fixture_teardown);
+  g_test_add ("/recycling/shared-entry", Fixture, NULL,
+	      fixture_setup, test_shared_entry, fixture_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,204 @@
+/* resize.c - test which widgets a queued resize revisits
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+typedef struct
+{
+  gint requests;
+  gint allocations;
+} Counter;
+
+/* window
+ *   outer (vbox)
+ *     row (hbox)
+ *       label
+ *       column (vbox)
+ *         leaf
+ *     sibling (hbox)
+ *       sibling label
+ */
+typedef struct
+{
+  GtkWidget *window;
+  GtkWidget *outer;
+  GtkWidget *row;
+  GtkWidget *label;
+  GtkWidget *column;
+  GtkWidget *leaf;
+  GtkWidget *sibling;
+
+  Counter outer_count;
+  Counter row_count;
+  Counter column_count;
+  Counter leaf_count;
+  Counter sibling_count;
+} Fixture;
+
+static void
+count_request (GtkWidget      *widget,
+	       GtkRequisition *requisition,
+	       Counter        *counter)
+{
+  counter->requests++;
+}
+
+static void
+count_allocation (GtkWidget     *widget,
+		  GtkAllocation *allocation,
+		  Counter       *counter)
+{
+  counter->allocations++;
+}
+
+static void
+watch (GtkWidget *widget,
+       Counter   *counter)
+{
+  g_signal_connect (widget, "size-request", G_CALLBACK (count_request), counter);
+  g_signal_connect (widget, "size-allocate", G_CALLBACK (count_allocation), counter);
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+	       gconstpointer  data)
+{
+  fixture->window = gtk_window_new (GTK_WINDOW_POPUP);
+  gtk_window_set_default_size (GTK_WINDOW (fixture->window), 400, 300);
+
+  fixture->outer = gtk_vbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (fixture->window), fixture->outer);
+
+  fixture->row = gtk_hbox_new (FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (fixture->outer), fixture->row, FALSE, FALSE, 0);
+  fixture->label = gtk_label_new ("Label");
+  gtk_box_pack_start (GTK_BOX (fixture->row), fixture->label, FALSE, FALSE, 0);
+  fixture->column = gtk_vbox_new (FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (fixture->row), fixture->column, FALSE, FALSE, 0);
+  fixture->leaf = gtk_label_new ("Leaf");
+  gtk_box_pack_start (GTK_BOX (fixture->column), fixture->leaf, FALSE, FALSE, 0);
+
+  fixture->sibling = gtk_hbox_new (FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (fixture->outer), fixture->sibling, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (fixture->sibling), gtk_label_new ("Sibling"),
+		      FALSE, FALSE, 0);
+
+  gtk_widget_show_all (fixture->window);
+  flush_events ();
+
+  watch (fixture->outer, &fixture->outer_count);
+  watch (fixture->row, &fixture->row_count);
+  watch (fixture->column, &fixture->column_count);
+  watch (fixture->leaf, &fixture->leaf_count);
+  watch (fixture->sibling, &fixture->sibling_count);
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+static void
+test_unchanged_requisition (Fixture       *fixture,
+			    gconstpointer  data)
+{
+  /* The leaf queues a resize without its size changing: only the leaf
+   * and its parent are requested and allocated again.
+   */
+  gtk_widget_queue_resize (fixture->leaf);
+  flush_events ();
+
+  g_assert_cmpint (fixture->leaf_count.requests, ==, 1);
+  g_assert_cmpint (fixture->leaf_count.allocations, ==, 1);
+  g_assert_cmpint (fixture->column_count.requests, ==, 1);
+  g_assert_cmpint (fixture->column_count.allocations, ==, 1);
+  g_assert_cmpint (fixture->row_count.requests, ==, 0);
+  g_assert_cmpint (fixture->row_count.allocations, ==, 0);
+  g_assert_cmpint (fixture->outer_count.requests, ==, 0);
+  g_assert_cmpint (fixture->outer_count.allocations, ==, 0);
+  g_assert_cmpint (fixture->sibling_count.requests, ==, 0);
+  g_assert_cmpint (fixture->sibling_count.allocations, ==, 0);
+}
+
+static void
+test_changed_requisition (Fixture       *fixture,
+			  gconstpointer  data)
+{
+  gint width;
+
+  width = fixture->leaf->allocation.width;
+
+  gtk_label_set_text (GTK_LABEL (fixture->leaf), "A much longer leaf");
+  flush_events ();
+
+  g_assert_cmpint (fixture->row_count.requests, ==, 1);
+  g_assert_cmpint (fixture->outer_count.requests, ==, 1);
+  g_assert_cmpint (fixture->row_count.allocations, >=, 1);
+  g_assert_cmpint (fixture->leaf->allocation.width, >, width);
+  g_assert_cmpint (fixture->column->allocation.width, ==,
+		   fixture->leaf->allocation.width);
+}
+
+static void
+test_packing (Fixture       *fixture,
+	      gconstpointer  data)
+{
+  gint x;
+
+  x = fixture->column->allocation.x;
+
+  /* The column keeps its requisition, but its place in the row changes */
+  gtk_box_set_child_packing (GTK_BOX (fixture->row), fixture->column,
+			     FALSE, FALSE, 20, GTK_PACK_START);
+  flush_events ();
+
+  g_assert_cmpint (fixture->column->allocation.x, ==, x + 20);
+  g_assert_cmpint (fixture->sibling_count.allocations, ==, 0);
+
+  x = fixture->column->allocation.x;
+  gtk_widget_hide (fixture->label);
+  flush_events ();
+
+  g_assert_cmpint (fixture->column->allocation.x, <, x);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/resize/unchanged-requisition", Fixture, NULL,
+	      fixture_setup, test_unchanged_requisition, fixture_teardown);
+  g_test_add ("/resize/changed-requisition", Fixture, NULL,
+	      fixture_setup, test_changed_requisition, fixture_teardown);
+  g_test_add ("/resize/packing", Fixture, NULL,
+	      fixture_setup, test_packing, fixture_teardown);
+
+  return g_test_run ();
+}
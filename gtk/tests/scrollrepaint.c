@@ -0,0 +1,203 @@
+/* Scroll repaint tests
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Scrolling a viewport should copy the still visible part of its
+ * contents and only repaint the strip that is scrolled into view. These
+ * tests count the pixels the scrolled contents get expose events for
+ * at each scroll step, and after several steps that are queued before
+ * the updates are processed.
+ */
+
+#include <gtk/gtk.h>
+
+#define VIEW_WIDTH   200
+#define VIEW_HEIGHT  200
+#define CHILD_WIDTH  200
+#define CHILD_HEIGHT 4000
+#define N_STEPS      20
+
+static gint
+region_area (GdkRegion *region)
+{
+  GdkRectangle *rects;
+  gint n_rects, i;
+  gint area = 0;
+
+  gdk_region_get_rectangles (region, &rects, &n_rects);
+  for (i = 0; i < n_rects; i++)
+    area += rects[i].width * rects[i].height;
+  g_free (rects);
+
+  return area;
+}
+
+static gboolean
+count_exposed_pixels (GtkWidget      *widget,
+		      GdkEventExpose *event,
+		      gint           *repainted)
+{
+  *repainted += region_area (event->region);
+
+  return FALSE;
+}
+
+static void
+flush_updates (void)
+{
+  gdk_window_process_all_updates ();
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static GtkWidget *
+scrolled_viewport_new (GtkWidget *child)
+{
+  GtkWidget *scrolled;
+
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+				  GTK_POLICY_NEVER, GTK_POLICY_ALWAYS);
+  gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (scrolled), child);
+  gtk_viewport_set_shadow_type (GTK_VIEWPORT (GTK_BIN (scrolled)->child),
+				GTK_SHADOW_NONE);
+
+  return scrolled;
+}
+
+/* Scrolls @scrolled by @step pixels N_STEPS times and checks that the
+ * contents never repaint much more than the newly visible strips.
+ * Updates are only processed after every @n_queued steps, so that
+ * several window moves are queued at once; if @outer is not %NULL, it
+ * is scrolled back and forth by a pixel along with each step.
+ */
+static void
+check_scroll_steps (GtkWidget *scrolled,
+		    GtkWidget *outer,
+		    gint      *repainted,
+		    gint       step,
+		    gint       n_queued)
+{
+  GtkAdjustment *vadj, *outer_vadj = NULL;
+  gint strip, i, j;
+
+  vadj = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled));
+  if (outer)
+    outer_vadj = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (outer));
+
+  flush_updates ();
+
+  for (i = 0; i < N_STEPS; i += n_queued)
+    {
+      *repainted = 0;
+      strip = 0;
+
+      for (j = 0; j < n_queued; j++)
+	{
+	  gtk_adjustment_set_value (vadj, gtk_adjustment_get_value (vadj) + step);
+	  strip += ABS (step) * GTK_BIN (scrolled)->child->allocation.width;
+
+	  if (outer_vadj)
+	    {
+	      gtk_adjustment_set_value (outer_vadj,
+					gtk_adjustment_get_value (outer_vadj) + (j % 2 ? -1 : 1));
+	      strip += GTK_BIN (outer)->child->allocation.width;
+	    }
+	}
+
+      flush_updates ();
+
+      if (g_test_verbose ())
+	g_print ("steps %d-%d: repainted %d pixels, scrolled in %d\n",
+		 i, i + n_queued - 1, *repainted, strip);
+
+      /* Allow for rounding in the viewport's own invalidation */
+      g_assert_cmpint (*repainted, <=, 2 * strip);
+    }
+}
+
+static void
+test_scroll_viewport (void)
+{
+  GtkWidget *window, *scrolled, *area;
+  gint repainted = 0;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), VIEW_WIDTH, VIEW_HEIGHT);
+
+  area = gtk_drawing_area_new ();
+  gtk_widget_set_size_request (area, CHILD_WIDTH, CHILD_HEIGHT);
+  g_signal_connect (area, "expose-event",
+		    G_CALLBACK (count_exposed_pixels), &repainted);
+
+  scrolled = scrolled_viewport_new (area);
+  gtk_container_add (GTK_CONTAINER (window), scrolled);
+  gtk_widget_show_all (window);
+
+  check_scroll_steps (scrolled, NULL, &repainted, 7, 1);
+  check_scroll_steps (scrolled, NULL, &repainted, -5, 1);
+  check_scroll_steps (scrolled, NULL, &repainted, 7, 4);
+  check_scroll_steps (scrolled, NULL, &repainted, -5, 5);
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_scroll_nested_viewport (void)
+{
+  GtkWidget *window, *outer, *inner, *box, *area;
+  gint repainted = 0;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), VIEW_WIDTH, VIEW_HEIGHT);
+
+  area = gtk_drawing_area_new ();
+  gtk_widget_set_size_request (area, CHILD_WIDTH, CHILD_HEIGHT);
+  g_signal_connect (area, "expose-event",
+		    G_CALLBACK (count_exposed_pixels), &repainted);
+
+  inner = scrolled_viewport_new (area);
+  gtk_widget_set_size_request (inner, -1, VIEW_HEIGHT);
+
+  box = gtk_vbox_new (FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (box), inner, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (box), gtk_label_new ("below"), FALSE, FALSE, 0);
+
+  outer = scrolled_viewport_new (box);
+  gtk_container_add (GTK_CONTAINER (window), outer);
+  gtk_widget_show_all (window);
+
+  check_scroll_steps (inner, NULL, &repainted, 3, 1);
+  check_scroll_steps (inner, NULL, &repainted, -3, 1);
+  check_scroll_steps (inner, outer, &repainted, 3, 4);
+  check_scroll_steps (inner, outer, &repainted, -3, 4);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/scrolling/viewport", test_scroll_viewport);
+  g_test_add_func ("/scrolling/nested-viewport", test_scroll_nested_viewport);
+
+  return g_test_run ();
+}
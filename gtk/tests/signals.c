@@ -0,0 +1,186 @@
+/* signals.c - test the emission of the hot widget signals
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+/* A drawing area whose class handlers count their calls */
+typedef GtkDrawingArea      TestArea;
+typedef GtkDrawingAreaClass TestAreaClass;
+
+static GType test_area_get_type (void);
+
+G_DEFINE_TYPE (TestArea, test_area, GTK_TYPE_DRAWING_AREA)
+
+static gint n_class_requests;
+static gint n_class_exposes;
+
+static void
+test_area_size_request (GtkWidget      *widget,
+			GtkRequisition *requisition)
+{
+  n_class_requests++;
+  requisition->width = 17;
+  requisition->height = 23;
+}
+
+static gboolean
+test_area_expose_event (GtkWidget      *widget,
+			GdkEventExpose *event)
+{
+  n_class_exposes++;
+
+  return TRUE;
+}
+
+static void
+test_area_class_init (TestAreaClass *class)
+{
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (class);
+
+  widget_class->size_request = test_area_size_request;
+  widget_class->expose_event = test_area_expose_event;
+}
+
+static void
+test_area_init (TestArea *area)
+{
+}
+
+static void
+check_request (GtkWidget      *widget,
+	       GtkRequisition *requisition,
+	       gint           *n_requests)
+{
+  /* Run first: the class handler already filled in the requisition */
+  g_assert_cmpint (requisition->width, ==, 17);
+  (*n_requests)++;
+}
+
+static gboolean
+count_expose (GtkWidget      *widget,
+	      GdkEventExpose *event,
+	      gint           *n_exposes)
+{
+  (*n_exposes)++;
+
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (widget), "handled"));
+}
+
+static void
+request (GtkWidget *area)
+{
+  GtkRequisition requisition;
+
+  gtk_widget_queue_resize (area);
+  gtk_widget_size_request (area, &requisition);
+  g_assert_cmpint (requisition.width, ==, 17);
+  g_assert_cmpint (requisition.height, ==, 23);
+}
+
+static gboolean
+expose (GtkWidget *area)
+{
+  GdkEvent *event;
+  gboolean handled;
+
+  event = gdk_event_new (GDK_EXPOSE);
+  event->expose.window = g_object_ref (area->window);
+  event->expose.area = area->allocation;
+  event->expose.region = gdk_region_rectangle (&area->allocation);
+
+  handled = gtk_widget_send_expose (area, event);
+  gdk_event_free (event);
+
+  return handled;
+}
+
+static void
+test_size_request (void)
+{
+  GtkWidget *area;
+  gulong id;
+  gint n_requests = 0;
+
+  area = g_object_ref_sink (g_object_new (test_area_get_type (), NULL));
+  n_class_requests = 0;
+
+  request (area);
+  g_assert_cmpint (n_class_requests, ==, 1);
+
+  id = g_signal_connect (area, "size-request", G_CALLBACK (check_request), &n_requests);
+  request (area);
+  g_assert_cmpint (n_class_requests, ==, 2);
+  g_assert_cmpint (n_requests, ==, 1);
+
+  g_signal_handler_block (area, id);
+  request (area);
+  g_assert_cmpint (n_class_requests, ==, 3);
+  g_assert_cmpint (n_requests, ==, 1);
+
+  g_object_unref (area);
+}
+
+static void
+test_expose_event (void)
+{
+  GtkWidget *window, *area;
+  gint n_exposes = 0;
+
+  window = gtk_window_new (GTK_WINDOW_POPUP);
+  area = g_object_new (test_area_get_type (), NULL);
+  gtk_container_add (GTK_CONTAINER (window), area);
+  gtk_widget_show_all (window);
+  n_class_exposes = 0;
+
+  g_assert (expose (area));
+  g_assert_cmpint (n_class_exposes, ==, 1);
+
+  /* Run last: a handler that does not handle the expose is followed
+   * by the class handler, one that does stops the emission.
+   */
+  g_signal_connect (area, "expose-event", G_CALLBACK (count_expose), &n_exposes);
+  g_assert (expose (area));
+  g_assert_cmpint (n_exposes, ==, 1);
+  g_assert_cmpint (n_class_exposes, ==, 2);
+
+  g_object_set_data (G_OBJECT (area), "handled", GINT_TO_POINTER (TRUE));
+  g_assert (expose (area));
+  g_assert_cmpint (n_exposes, ==, 2);
+  g_assert_cmpint (n_class_exposes, ==, 2);
+
+  g_signal_handlers_disconnect_by_func (area, count_expose, &n_exposes);
+  g_assert (expose (area));
+  g_assert_cmpint (n_class_exposes, ==, 3);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  /* Handlers must behave the same with and without the fast path */
+  g_setenv ("GTK_SIGNAL_FAST_PATH", "1", TRUE);
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/signals/size-request", test_size_request);
+  g_test_add_func ("/signals/expose-event", test_expose_event);
+
+  return g_test_run ();
+}
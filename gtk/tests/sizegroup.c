@@ -0,0 +1,237 @@
+/* sizegroup.c - test the size negotiation of GtkSizeGroup
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+#define N_LABELS 3
+
+typedef struct
+{
+  GtkWidget *window;
+  GtkSizeGroup *group;
+  GtkWidget *labels[N_LABELS];
+  gint requests[N_LABELS];
+} Fixture;
+
+static void
+count_request (GtkWidget      *widget,
+	       GtkRequisition *requisition,
+	       gint           *requests)
+{
+  (*requests)++;
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+	       gconstpointer  data)
+{
+  static const gchar *texts[N_LABELS] = { "Short", "A much longer label", "Medium label" };
+  GtkWidget *vbox;
+  gint i;
+
+  fixture->window = gtk_window_new (GTK_WINDOW_POPUP);
+  vbox = gtk_vbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (fixture->window), vbox);
+
+  fixture->group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
+
+  for (i = 0; i < N_LABELS; i++)
+    {
+      GtkWidget *hbox = gtk_hbox_new (FALSE, 0);
+
+      fixture->labels[i] = gtk_label_new (texts[i]);
+      gtk_box_pack_start (GTK_BOX (hbox), fixture->labels[i], FALSE, FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (hbox), gtk_entry_new (), FALSE, FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 0);
+
+      gtk_size_group_add_widget (fixture->group, fixture->labels[i]);
+    }
+
+  gtk_widget_show_all (fixture->window);
+  flush_events ();
+
+  for (i = 0; i < N_LABELS; i++)
+    g_signal_connect (fixture->labels[i], "size-request",
+		      G_CALLBACK (count_request), &fixture->requests[i]);
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gtk_widget_destroy (fixture->window);
+  g_object_unref (fixture->group);
+}
+
+static void
+assert_same_width (Fixture *fixture,
+		   gint     width)
+{
+  gint i;
+
+  for (i = 0; i < N_LABELS; i++)
+    g_assert_cmpint (fixture->labels[i]->allocation.width, ==, width);
+}
+
+static void
+test_group_width (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gint width;
+
+  width = fixture->labels[1]->requisition.width;
+  assert_same_width (fixture, width);
+
+  /* The widest label shrinks */
+  gtk_label_set_text (GTK_LABEL (fixture->labels[1]), "Tiny");
+  flush_events ();
+  width = fixture->labels[2]->requisition.width;
+  assert_same_width (fixture, width);
+
+  /* Another one grows beyond the others */
+  gtk_label_set_text (GTK_LABEL (fixture->labels[0]), "Now this is the longest label");
+  flush_events ();
+  width = fixture->labels[0]->requisition.width;
+  g_assert_cmpint (width, >, fixture->labels[2]->requisition.width);
+  assert_same_width (fixture, width);
+}
+
+static void
+test_unchanged_group (Fixture       *fixture,
+		      gconstpointer  data)
+{
+  gint width;
+
+  width = fixture->labels[1]->allocation.width;
+
+  /* The size of the group stays the same, so the other members are
+   * not requested again
+   */
+  gtk_label_set_text (GTK_LABEL (fixture->labels[2]), "Medium");
+  flush_events ();
+
+  g_assert_cmpint (fixture->requests[2], ==, 1);
+  g_assert_cmpint (fixture->requests[0], ==, 0);
+  g_assert_cmpint (fixture->requests[1], ==, 0);
+  assert_same_width (fixture, width);
+}
+
+static void
+count_check_resize (GtkContainer *container,
+		    gint         *n_check_resizes)
+{
+  (*n_check_resizes)++;
+}
+
+static void
+test_single_pass (Fixture       *fixture,
+		  gconstpointer  data)
+{
+  gint n_check_resizes = 0;
+
+  /* Keep the size of the toplevel, so that it is not configured again */
+  gtk_widget_set_size_request (fixture->window, 1000, -1);
+  flush_events ();
+
+  g_signal_connect (fixture->window, "check-resize",
+		    G_CALLBACK (count_check_resize), &n_check_resizes);
+
+  /* The other members are queued along with the label whose size
+   * changed, so a single pass of the resize idle lays them all out
+   */
+  gtk_label_set_text (GTK_LABEL (fixture->labels[1]), "Tiny");
+  flush_events ();
+  g_assert_cmpint (n_check_resizes, ==, 1);
+  assert_same_width (fixture, fixture->labels[2]->requisition.width);
+
+  n_check_resizes = 0;
+  gtk_label_set_text (GTK_LABEL (fixture->labels[0]), "Now this is the longest label");
+  flush_events ();
+  g_assert_cmpint (n_check_resizes, ==, 1);
+  assert_same_width (fixture, fixture->labels[0]->requisition.width);
+}
+
+static void
+test_remove_widget (Fixture       *fixture,
+		    gconstpointer  data)
+{
+  gint width;
+
+  width = fixture->labels[1]->allocation.width;
+
+  gtk_size_group_remove_widget (fixture->group, fixture->labels[1]);
+  flush_events ();
+
+  g_assert_cmpint (fixture->labels[0]->allocation.width, <, width);
+  g_assert_cmpint (fixture->labels[0]->allocation.width, ==,
+		   fixture->labels[2]->requisition.width);
+  g_assert_cmpint (fixture->labels[1]->allocation.width, ==,
+		   fixture->labels[1]->requisition.width);
+
+  /* Adding it again restores the width of the group */
+  gtk_size_group_add_widget (fixture->group, fixture->labels[1]);
+  flush_events ();
+
+  assert_same_width (fixture, width);
+}
+
+static void
+test_set_mode (Fixture       *fixture,
+	       gconstpointer  data)
+{
+  gtk_size_group_set_mode (fixture->group, GTK_SIZE_GROUP_VERTICAL);
+  flush_events ();
+
+  g_assert_cmpint (fixture->labels[0]->allocation.width, ==,
+		   fixture->labels[0]->requisition.width);
+  g_assert_cmpint (fixture->labels[0]->allocation.width, <,
+		   fixture->labels[1]->allocation.width);
+
+  gtk_size_group_set_mode (fixture->group, GTK_SIZE_GROUP_BOTH);
+  flush_events ();
+
+  assert_same_width (fixture, fixture->labels[1]->requisition.width);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/sizegroup/group-width", Fixture, NULL,
+	      fixture_setup, test_group_width, fixture_teardown);
+  g_test_add ("/sizegroup/unchanged-group", Fixture, NULL,
+	      fixture_setup, test_unchanged_group, fixture_teardown);
+  g_test_add ("/sizegroup/single-pass", Fixture, NULL,
+	      fixture_setup, test_single_pass, fixture_teardown);
+  g_test_add ("/sizegroup/remove-widget", Fixture, NULL,
+	      fixture_setup, test_remove_widget, fixture_teardown);
+  g_test_add ("/sizegroup/set-mode", Fixture, NULL,
+	      fixture_setup, test_set_mode, fixture_teardown);
+
+  return g_test_run ();
+}
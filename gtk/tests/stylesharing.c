@@ -0,0 +1,232 @@
+/* stylesharing.c - test sharing of styles between widgets and screens
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* The multihead part only does something useful on a display with
+ * several screens, e.g. "Xvfb :1 -screen 0 640x480x24 -screen 1
+ * 640x480x24".
+ */
+
+#include <gtk/gtk.h>
+
+#define N_TOPLEVELS 25
+
+static const gchar rc_text[] =
+  "style \"first\" { bg[NORMAL] = \"#ff0000\" xthickness = 3 }\n"
+  "style \"second\" { bg[NORMAL] = \"#ff0000\" xthickness = 3 }\n"
+  "style \"third\" { bg[NORMAL] = \"#00ff00\" xthickness = 3 }\n"
+  "widget \"*.first\" style \"first\"\n"
+  "widget \"*.second\" style \"second\"\n"
+  "widget \"*.third\" style \"third\"\n"
+  "style \"restyled\" { fg[NORMAL] = @restyle_color }\n"
+  "widget \"*restyled\" style \"restyled\"\n";
+
+static GtkWidget *
+create_toplevel (GdkScreen  *screen,
+		 GtkWidget **children)
+{
+  static const gchar *names[] = { "first", "second", "third" };
+  GtkWidget *window, *box;
+  gint i;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_screen (GTK_WINDOW (window), screen);
+
+  box = gtk_vbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (window), box);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      children[i] = gtk_label_new (names[i]);
+      gtk_widget_set_name (children[i], names[i]);
+      gtk_box_pack_start (GTK_BOX (box), children[i], FALSE, FALSE, 0);
+    }
+
+  gtk_widget_realize (window);
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    gtk_widget_realize (children[i]);
+
+  return window;
+}
+
+static void
+test_identical_styles (void)
+{
+  GtkWidget *window, *children[3];
+
+  window = create_toplevel (gdk_screen_get_default (), children);
+
+  /* "first" and "second" have the same content */
+  g_assert (gtk_widget_get_style (children[0]) == gtk_widget_get_style (children[1]));
+  g_assert (gtk_widget_get_style (children[0]) != gtk_widget_get_style (children[2]));
+  g_assert_cmpint (gtk_widget_get_style (children[0])->xthickness, ==, 3);
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_multihead (void)
+{
+  GdkDisplay *display;
+  GHashTable *styles;
+  GSList *windows = NULL, *l;
+  gint n_screens, i, j;
+
+  display = gdk_display_get_default ();
+  n_screens = gdk_display_get_n_screens (display);
+  if (n_screens < 2)
+    g_test_message ("only one screen, multihead sharing is not tested");
+
+  styles = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < n_screens; i++)
+    {
+      GdkScreen *screen = gdk_display_get_screen (display, i);
+
+      for (j = 0; j < N_TOPLEVELS; j++)
+	{
+	  GtkWidget *children[3];
+
+	  windows = g_slist_prepend (windows, create_toplevel (screen, children));
+
+	  g_assert (gtk_widget_get_style (children[0]) == gtk_widget_get_style (children[1]));
+	  g_assert (gtk_widget_get_style (children[0])->colormap ==
+		    gdk_screen_get_default_colormap (screen));
+
+	  g_hash_table_insert (styles, gtk_widget_get_style (children[0]), NULL);
+	  g_hash_table_insert (styles, gtk_widget_get_style (children[2]), NULL);
+	}
+    }
+
+  /* The number of styles depends on the screens, not the toplevels */
+  g_assert_cmpint (g_hash_table_size (styles), ==, 2 * n_screens);
+
+  for (l = windows; l; l = l->next)
+    gtk_widget_destroy (l->data);
+  g_slist_free (windows);
+  g_hash_table_destroy (styles);
+}
+
+static void
+record_style_set (GtkWidget  *widget,
+		  GtkStyle   *previous_style,
+		  GSList    **restyled)
+{
+  *restyled = g_slist_append (*restyled, widget);
+}
+
+/* Creates a toplevel with a label, both matching the "restyled" style */
+static GtkWidget *
+create_restyled (GtkWidget **label,
+		 GSList    **restyled)
+{
+  GtkWidget *window;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_set_name (window, "restyled");
+
+  *label = gtk_label_new ("restyled");
+  gtk_widget_set_name (*label, "restyled");
+  gtk_container_add (GTK_CONTAINER (window), *label);
+
+  gtk_widget_realize (window);
+  gtk_widget_realize (*label);
+
+  g_signal_connect (window, "style-set", G_CALLBACK (record_style_set), restyled);
+  g_signal_connect (*label, "style-set", G_CALLBACK (record_style_set), restyled);
+
+  return window;
+}
+
+static gboolean
+has_color (GtkWidget   *widget,
+	   const gchar *spec)
+{
+  GdkColor color;
+
+  gdk_color_parse (spec, &color);
+
+  return gdk_color_equal (&gtk_widget_get_style (widget)->fg[GTK_STATE_NORMAL], &color);
+}
+
+static void
+test_restyle_batches (void)
+{
+  GtkSettings *settings;
+  GtkWidget *mapped, *unmapped, *destroyed;
+  GtkWidget *mapped_label, *unmapped_label, *destroyed_label;
+  GSList *restyled = NULL;
+
+  settings = gtk_settings_get_default ();
+
+  mapped = create_restyled (&mapped_label, &restyled);
+  unmapped = create_restyled (&unmapped_label, &restyled);
+  destroyed = g_object_ref (create_restyled (&destroyed_label, &restyled));
+  gtk_widget_show_all (mapped);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  g_assert (has_color (mapped_label, "#ff0000"));
+
+  /* A theme change from the settings restyles widgets from an idle */
+  g_object_set (settings, "gtk-color-scheme", "restyle_color:#00ff00", NULL);
+  g_assert (restyled == NULL);
+  g_assert (has_color (mapped_label, "#ff0000"));
+
+  /* Destroyed while queued, this must be skipped quietly */
+  gtk_widget_destroy (destroyed);
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  /* Mapped widgets come first, parents before their children */
+  g_assert_cmpint (g_slist_length (restyled), ==, 4);
+  g_assert (g_slist_nth_data (restyled, 0) == mapped);
+  g_assert (g_slist_nth_data (restyled, 1) == mapped_label);
+  g_assert (g_slist_nth_data (restyled, 2) == unmapped);
+  g_assert (g_slist_nth_data (restyled, 3) == unmapped_label);
+
+  g_assert (has_color (mapped, "#00ff00"));
+  g_assert (has_color (mapped_label, "#00ff00"));
+  g_assert (has_color (unmapped, "#00ff00"));
+  g_assert (has_color (unmapped_label, "#00ff00"));
+  g_assert (has_color (destroyed, "#ff0000"));
+
+  g_slist_free (restyled);
+  gtk_widget_destroy (mapped);
+  gtk_widget_destroy (unmapped);
+  g_object_unref (destroyed);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  /* The colors have to be known before the rc text is parsed */
+  g_object_set (gtk_settings_get_default (),
+		"gtk-color-scheme", "restyle_color:#ff0000", NULL);
+  gtk_rc_parse_string (rc_text);
+
+  g_test_add_func ("/style/identical-styles", test_identical_styles);
+  g_test_add_func ("/style/multihead", test_multihead);
+  g_test_add_func ("/style/restyle-batches", test_restyle_batches);
+
+  return g_test_run ();
+}
@@ -0,0 +1,166 @@
+/* uimanager.c - test the updates of GtkUIManager
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+static const gchar main_ui[] =
+  "<ui>"
+  "  <menubar name='menubar'>"
+  "    <menu action='Menu'>"
+  "      <menuitem action='first'/>"
+  "      <separator name='sep1'/>"
+  "      <placeholder name='plugins'/>"
+  "      <separator name='sep2'/>"
+  "      <menuitem action='second'/>"
+  "    </menu>"
+  "  </menubar>"
+  "</ui>";
+
+static const gchar plugin_ui[] =
+  "<ui>"
+  "  <menubar name='menubar'>"
+  "    <menu action='Menu'>"
+  "      <placeholder name='plugins'>"
+  "        <menuitem action='plugin'/>"
+  "      </placeholder>"
+  "    </menu>"
+  "  </menubar>"
+  "</ui>";
+
+static GtkActionGroup *
+create_action_group (const gchar  *name,
+                     const gchar **actions)
+{
+  GtkActionGroup *group;
+  gint i;
+
+  group = gtk_action_group_new (name);
+  for (i = 0; actions[i]; i++)
+    {
+      GtkAction *action = gtk_action_new (actions[i], actions[i], NULL, NULL);
+
+      gtk_action_group_add_action (group, action);
+      g_object_unref (action);
+    }
+
+  return group;
+}
+
+static GtkUIManager *
+create_manager (GtkActionGroup *group)
+{
+  GtkUIManager *manager;
+  GError *error = NULL;
+
+  manager = gtk_ui_manager_new ();
+  gtk_ui_manager_insert_action_group (manager, group, 0);
+  gtk_ui_manager_add_ui_from_string (manager, main_ui, -1, &error);
+  g_assert_no_error (error);
+  gtk_ui_manager_ensure_update (manager);
+
+  return manager;
+}
+
+static void
+test_action_groups (void)
+{
+  static const gchar *main_actions[] = { "Menu", "first", "second", "plugin", NULL };
+  static const gchar *extra_actions[] = { "second", "unused", NULL };
+  GtkActionGroup *group, *extra;
+  GtkUIManager *manager;
+  GtkWidget *first, *second;
+
+  group = create_action_group ("main", main_actions);
+  extra = create_action_group ("extra", extra_actions);
+  manager = create_manager (group);
+
+  first = gtk_ui_manager_get_widget (manager, "/menubar/Menu/first");
+  second = gtk_ui_manager_get_widget (manager, "/menubar/Menu/second");
+  g_assert (gtk_activatable_get_related_action (GTK_ACTIVATABLE (second)) ==
+            gtk_action_group_get_action (group, "second"));
+
+  /* Only the shadowed action is rebound */
+  gtk_ui_manager_insert_action_group (manager, extra, 0);
+  gtk_ui_manager_ensure_update (manager);
+  g_assert (gtk_ui_manager_get_widget (manager, "/menubar/Menu/first") == first);
+  g_assert (gtk_activatable_get_related_action (GTK_ACTIVATABLE (first)) ==
+            gtk_action_group_get_action (group, "first"));
+  g_assert (gtk_activatable_get_related_action (GTK_ACTIVATABLE (second)) ==
+            gtk_action_group_get_action (extra, "second"));
+
+  gtk_ui_manager_remove_action_group (manager, extra);
+  gtk_ui_manager_ensure_update (manager);
+  g_assert (gtk_activatable_get_related_action (GTK_ACTIVATABLE (second)) ==
+            gtk_action_group_get_action (group, "second"));
+
+  g_object_unref (manager);
+  g_object_unref (extra);
+  g_object_unref (group);
+}
+
+static void
+test_placeholder_separators (void)
+{
+  static const gchar *main_actions[] = { "Menu", "first", "second", "plugin", NULL };
+  GtkActionGroup *group;
+  GtkUIManager *manager;
+  GtkWidget *sep1, *sep2, *plugin;
+  GError *error = NULL;
+  guint merge_id;
+
+  group = create_action_group ("main", main_actions);
+  manager = create_manager (group);
+
+  sep1 = gtk_ui_manager_get_widget (manager, "/menubar/Menu/sep1");
+  sep2 = gtk_ui_manager_get_widget (manager, "/menubar/Menu/sep2");
+  g_assert (gtk_widget_get_visible (sep1));
+  g_assert (!gtk_widget_get_visible (sep2));
+
+  /* Items merged into the placeholder update the separators of the
+   * menu that contains it
+   */
+  merge_id = gtk_ui_manager_add_ui_from_string (manager, plugin_ui, -1, &error);
+  g_assert_no_error (error);
+  gtk_ui_manager_ensure_update (manager);
+  plugin = gtk_ui_manager_get_widget (manager, "/menubar/Menu/plugins/plugin");
+  g_assert (GTK_IS_MENU_ITEM (plugin));
+  g_assert (gtk_widget_get_visible (sep1));
+  g_assert (gtk_widget_get_visible (sep2));
+
+  gtk_ui_manager_remove_ui (manager, merge_id);
+  gtk_ui_manager_ensure_update (manager);
+  g_assert (gtk_ui_manager_get_widget (manager, "/menubar/Menu/plugins/plugin") == NULL);
+  g_assert (gtk_widget_get_visible (sep1));
+  g_assert (!gtk_widget_get_visible (sep2));
+
+  g_object_unref (manager);
+  g_object_unref (group);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/uimanager/action-groups", test_action_groups);
+  g_test_add_func ("/uimanager/placeholder-separators", test_placeholder_separators);
+
+  return g_test_run ();
+}
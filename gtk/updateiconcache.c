@@ -48,6 +48,8 @@ static gboolean ignore_theme_index = FALSE;
 static gboolean quiet = FALSE;
 static gboolean index_only = FALSE;
 static gboolean validate = FALSE;
+static gboolean incremental = FALSE;
+static gint n_threads = 1;
 static gchar *var_name = "-";
 
 /* Quite ugly - if we just add the c file to the
@@ -170,6 +172,7 @@ typedef struct
 {
   GdkPixdata pixdata;
   gboolean has_pixdata;
+  gboolean loading;
   guint32 offset;
   guint size;
 } ImageData;
@@ -469,6 +472,46 @@ follow_links (const gchar *path)
   return path2;
 }
 
+static void
+load_image_data (ImageData   *idata,
+		 const gchar *path)
+{
+  GdkPixbuf *pixbuf;
+
+  pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+
+  if (pixbuf)
+    {
+      gdk_pixdata_from_pixbuf (&idata->pixdata, pixbuf, FALSE);
+      idata->size = idata->pixdata.length + 8;
+      idata->has_pixdata = TRUE;
+    }
+}
+
+typedef struct
+{
+  ImageData *idata;
+  gchar *path;
+} ImageLoad;
+
+/* With --threads, decoding the images is farmed out to this pool
+ * while the directory walk continues; build_cache() waits for it
+ * before writing.
+ */
+static GThreadPool *load_pool = NULL;
+
+static void
+load_image_data_thread (gpointer data,
+			gpointer user_data)
+{
+  ImageLoad *load = data;
+
+  load_image_data (load->idata, load->path);
+
+  g_free (load->path);
+  g_free (load);
+}
+
 static void
 maybe_cache_image_data (Image       *image, 
 			const gchar *path)
@@ -476,7 +519,6 @@ maybe_cache_image_data (Image       *image,
   if (!index_only && !image->image_data && 
       (g_str_has_suffix (path, ".png") || g_str_has_suffix (path, ".xpm")))
     {
-      GdkPixbuf *pixbuf;
       ImageData *idata;
       gchar *path2;
 
@@ -513,17 +555,26 @@ maybe_cache_image_data (Image       *image,
 	    g_hash_table_insert (image_data_hash, g_strdup (path2), idata);  
 	}
 
-      if (!idata->has_pixdata)
+      if (load_pool)
 	{
-	  pixbuf = gdk_pixbuf_new_from_file (path, NULL);
-	  
-	  if (pixbuf) 
+	  /* has_pixdata may be written by a loader thread once the
+	   * data is queued, so only look at it when it isn't; data
+	   * reused from the old cache has it set already
+	   */
+	  if (!idata->loading && !idata->has_pixdata)
 	    {
-	      gdk_pixdata_from_pixbuf (&idata->pixdata, pixbuf, FALSE);
-	      idata->size = idata->pixdata.length + 8;
-	      idata->has_pixdata = TRUE;
+	      ImageLoad *load;
+
+	      idata->loading = TRUE;
+
+	      load = g_new (ImageLoad, 1);
+	      load->idata = idata;
+	      load->path = g_strdup (path);
+	      g_thread_pool_push (load_pool, load, NULL);
 	    }
 	}
+      else if (!idata->has_pixdata)
+	load_image_data (idata, path);
 
       image->image_data = idata;
 
@@ -579,6 +630,334 @@ maybe_cache_icon_data (Image       *image,
     }
 }
 
+/* With --incremental, the icons of directories that have not changed
+ * since the existing cache was written are taken from that cache
+ * instead of being scanned and decoded again. A directory counts as
+ * unchanged if its mtime is older than the cache, which is the case
+ * as long as files are only added, removed or renamed in it (as
+ * package managers do). Files rewritten in place, or trees unpacked
+ * with their old mtimes, need a full run.
+ */
+typedef struct
+{
+  const gchar *name;
+  int flags;
+  ImageData *image_data;
+  IconData *icon_data;
+} CachedImage;
+
+static GMappedFile *old_cache_map = NULL;
+static time_t old_cache_mtime;
+/* Maps directory names to lists of CachedImages */
+static GHashTable *old_cache_dirs = NULL;
+
+static guint16
+read_card16 (const gchar *cache, guint32 offset)
+{
+  return GUINT16_FROM_BE (*(guint16 *)(cache + offset));
+}
+
+static guint32
+read_card32 (const gchar *cache, guint32 offset)
+{
+  return GUINT32_FROM_BE (*(guint32 *)(cache + offset));
+}
+
+static ImageData *
+read_cached_image_data (const gchar *cache,
+			guint32      offset)
+{
+  ImageData *idata;
+  guint32 length;
+
+  length = read_card32 (cache, offset + 4);
+
+  idata = g_new0 (ImageData, 1);
+
+  /* The pixel data keeps pointing into the old cache, which stays
+   * mapped until the new one has been written
+   */
+  if (!gdk_pixdata_deserialize (&idata->pixdata, length,
+				(const guint8 *)cache + offset + 8, NULL))
+    {
+      g_free (idata);
+      return NULL;
+    }
+
+  idata->size = idata->pixdata.length + 8;
+  idata->has_pixdata = TRUE;
+
+  return idata;
+}
+
+static IconData *
+read_cached_icon_data (const gchar *cache,
+		       guint32      offset)
+{
+  IconData *data;
+  guint32 ofs;
+  int i;
+
+  data = g_new0 (IconData, 1);
+
+  ofs = read_card32 (cache, offset);
+  if (ofs)
+    {
+      data->has_embedded_rect = TRUE;
+      data->x0 = read_card16 (cache, ofs);
+      data->y0 = read_card16 (cache, ofs + 2);
+      data->x1 = read_card16 (cache, ofs + 4);
+      data->y1 = read_card16 (cache, ofs + 6);
+    }
+
+  ofs = read_card32 (cache, offset + 4);
+  if (ofs)
+    {
+      data->n_attach_points = read_card32 (cache, ofs);
+      data->attach_points = g_new (int, 2 * data->n_attach_points);
+      for (i = 0; i < 2 * data->n_attach_points; i++)
+	data->attach_points[i] = read_card16 (cache, ofs + 4 + 2 * i);
+    }
+
+  ofs = read_card32 (cache, offset + 8);
+  if (ofs)
+    data->n_display_names = read_card32 (cache, ofs);
+
+  data->display_names = g_new0 (gchar *, 2 * data->n_display_names + 1);
+  for (i = 0; i < 2 * data->n_display_names; i++)
+    data->display_names[i] = g_strdup (cache + read_card32 (cache, ofs + 4 + 4 * i));
+
+  data->size = -1;
+
+  return data;
+}
+
+static void
+free_cached_images (gpointer data)
+{
+  GList *list = data;
+
+  g_list_foreach (list, (GFunc)g_free, NULL);
+  g_list_free (list);
+}
+
+static void
+load_old_cache (const gchar *path)
+{
+  GMappedFile *map;
+  const gchar *cache;
+  gchar *cache_path;
+  struct stat cache_stat;
+  CacheInfo info;
+  GHashTable *image_datas, *icon_datas;
+  guint32 hash_offset, dir_list_offset;
+  guint32 n_buckets, n_images;
+  guint32 chain, image_list, image_data, ofs;
+  guint32 i, j;
+
+  cache_path = g_build_filename (path, CACHE_NAME, NULL);
+
+  if (g_stat (cache_path, &cache_stat) < 0)
+    {
+      g_free (cache_path);
+      return;
+    }
+
+  map = g_mapped_file_new (cache_path, FALSE, NULL);
+  if (!map)
+    {
+      g_free (cache_path);
+      return;
+    }
+
+  info.cache = g_mapped_file_get_contents (map);
+  info.cache_size = g_mapped_file_get_length (map);
+  info.n_directories = 0;
+  info.flags = CHECK_OFFSETS|CHECK_STRINGS|CHECK_PIXBUFS;
+
+  if (!_gtk_icon_cache_validate (&info))
+    {
+      if (!quiet)
+	g_printerr (_("Not a valid icon cache: %s\n"), cache_path);
+      g_mapped_file_unref (map);
+      g_free (cache_path);
+      return;
+    }
+
+  g_free (cache_path);
+
+  old_cache_map = map;
+  old_cache_mtime = cache_stat.st_mtime;
+  old_cache_dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+					  NULL, free_cached_images);
+
+  cache = info.cache;
+  hash_offset = read_card32 (cache, 4);
+  dir_list_offset = read_card32 (cache, 8);
+
+  /* Image and icon data shared between several images, e.g. through
+   * symlinks, stay shared
+   */
+  image_datas = g_hash_table_new (NULL, NULL);
+  icon_datas = g_hash_table_new (NULL, NULL);
+
+  n_buckets = read_card32 (cache, hash_offset);
+  for (i = 0; i < n_buckets; i++)
+    {
+      for (chain = read_card32 (cache, hash_offset + 4 + 4 * i);
+	   chain != 0xffffffff;
+	   chain = read_card32 (cache, chain))
+	{
+	  image_list = read_card32 (cache, chain + 8);
+	  n_images = read_card32 (cache, image_list);
+
+	  for (j = 0; j < n_images; j++)
+	    {
+	      CachedImage *cimage;
+	      const gchar *dir;
+	      GList *list;
+	      guint16 dir_index;
+
+	      dir_index = read_card16 (cache, image_list + 4 + 8 * j);
+	      image_data = read_card32 (cache, image_list + 4 + 8 * j + 4);
+
+	      dir = cache + read_card32 (cache, dir_list_offset + 4 + 4 * dir_index);
+
+	      cimage = g_new0 (CachedImage, 1);
+	      cimage->name = cache + read_card32 (cache, chain + 4);
+	      cimage->flags = read_card16 (cache, image_list + 4 + 8 * j + 2);
+
+	      ofs = image_data ? read_card32 (cache, image_data) : 0;
+	      if (ofs && !index_only)
+		{
+		  cimage->image_data = g_hash_table_lookup (image_datas, GUINT_TO_POINTER (ofs));
+		  if (!cimage->image_data)
+		    {
+		      cimage->image_data = read_cached_image_data (cache, ofs);
+		      g_hash_table_insert (image_datas, GUINT_TO_POINTER (ofs), cimage->image_data);
+		    }
+		}
+
+	      ofs = image_data ? read_card32 (cache, image_data + 4) : 0;
+	      if (ofs)
+		{
+		  cimage->icon_data = g_hash_table_lookup (icon_datas, GUINT_TO_POINTER (ofs));
+		  if (!cimage->icon_data)
+		    {
+		      cimage->icon_data = read_cached_icon_data (cache, ofs);
+		      g_hash_table_insert (icon_datas, GUINT_TO_POINTER (ofs), cimage->icon_data);
+		    }
+		}
+
+	      list = g_hash_table_lookup (old_cache_dirs, dir);
+	      g_hash_table_steal (old_cache_dirs, dir);
+	      g_hash_table_insert (old_cache_dirs, (gpointer) dir,
+				   g_list_prepend (list, cimage));
+	    }
+	}
+    }
+
+  g_hash_table_destroy (image_datas);
+  g_hash_table_destroy (icon_datas);
+}
+
+static void
+free_old_cache (void)
+{
+  if (old_cache_dirs)
+    {
+      g_hash_table_destroy (old_cache_dirs);
+      old_cache_dirs = NULL;
+    }
+
+  if (old_cache_map)
+    {
+      g_mapped_file_unref (old_cache_map);
+      old_cache_map = NULL;
+    }
+}
+
+/* Returns the icons the old cache has for subdir, if they can be
+ * reused, or %NULL.
+ */
+static GList *
+get_cached_images (const gchar *dir_path,
+		   const gchar *subdir)
+{
+  GList *cached, *list;
+  struct stat dir_stat;
+
+  if (!old_cache_dirs || !subdir)
+    return NULL;
+
+  cached = g_hash_table_lookup (old_cache_dirs, subdir);
+  if (!cached)
+    return NULL;
+
+  /* Changes within the second the cache was written are not
+   * visible in the mtime, so only older directories are trusted
+   */
+  if (g_stat (dir_path, &dir_stat) < 0 ||
+      dir_stat.st_mtime >= old_cache_mtime)
+    return NULL;
+
+  /* If the old cache was written with --index-only, or an image
+   * could not be loaded, the image data has to be loaded now
+   */
+  if (!index_only)
+    for (list = cached; list; list = list->next)
+      {
+	CachedImage *cimage = list->data;
+
+	if ((cimage->flags & (HAS_SUFFIX_PNG | HAS_SUFFIX_XPM)) &&
+	    !cimage->image_data)
+	  return NULL;
+      }
+
+  return cached;
+}
+
+static gboolean
+has_icon_suffix (const gchar *name)
+{
+  return (g_str_has_suffix (name, ".png") ||
+	  g_str_has_suffix (name, ".svg") ||
+	  g_str_has_suffix (name, ".xpm") ||
+#ifdef MAEMO_CHANGES
+	  g_str_has_suffix (name, ".ani") ||
+#endif /* MAEMO_CHANGES */
+	  g_str_has_suffix (name, ".icon"));
+}
+
+/* Registers the files that reused data came from, so that symlinks
+ * to them from rescanned directories share it.
+ */
+static void
+register_cached_image (CachedImage *cimage,
+		       const gchar *dir_path)
+{
+  gchar *path;
+
+  if (cimage->image_data)
+    {
+      path = g_strconcat (dir_path, G_DIR_SEPARATOR_S, cimage->name,
+			  (cimage->flags & HAS_SUFFIX_PNG) ? ".png" : ".xpm", NULL);
+      if (!g_hash_table_lookup (image_data_hash, path))
+	g_hash_table_insert (image_data_hash, path, cimage->image_data);
+      else
+	g_free (path);
+    }
+
+  if (cimage->icon_data)
+    {
+      path = g_strconcat (dir_path, G_DIR_SEPARATOR_S, cimage->name, ".icon", NULL);
+      if (!g_hash_table_lookup (icon_data_hash, path))
+	g_hash_table_insert (icon_data_hash, path, cimage->icon_data);
+      else
+	g_free (path);
+    }
+}
+
 static GList *
 scan_directory (const gchar *base_path, 
 		const gchar *subdir, 
@@ -592,6 +971,7 @@ scan_directory (const gchar *base_path,
   gchar *dir_path;
   gboolean dir_added = FALSE;
   guint dir_index = 0xffff;
+  GList *cached, *list;
   
   dir_path = g_build_filename (base_path, subdir, NULL);
 
@@ -603,6 +983,29 @@ scan_directory (const gchar *base_path,
   
   dir_hash = g_hash_table_new (g_str_hash, g_str_equal);
 
+  cached = get_cached_images (dir_path, subdir);
+  for (list = cached; list; list = list->next)
+    {
+      CachedImage *cimage = list->data;
+      Image *image;
+
+      if (!dir_added)
+	{
+	  dir_added = TRUE;
+	  dir_index = g_list_length (directories);
+	  directories = g_list_append (directories, g_strdup (subdir));
+	}
+
+      image = g_new0 (Image, 1);
+      image->dir_index = dir_index;
+      image->flags = cimage->flags;
+      image->image_data = cimage->image_data;
+      image->icon_data = cimage->icon_data;
+      g_hash_table_insert (dir_hash, g_strdup (cimage->name), image);
+
+      register_cached_image (cimage, dir_path);
+    }
+
   while ((name = g_dir_read_name (dir)))
     {
       gchar *path;
@@ -611,6 +1014,12 @@ scan_directory (const gchar *base_path,
       Image *image;
       gchar *basename, *dot;
 
+      /* Still look for new subdirectories, without touching the
+       * icons we already know about
+       */
+      if (cached && has_icon_suffix (name))
+	continue;
+
       path = g_build_filename (dir_path, name, NULL);
       retval = g_file_test (path, G_FILE_TEST_IS_DIR);
       if (retval)
@@ -1509,12 +1918,30 @@ opentmp:
   icon_data_hash = g_hash_table_new (g_str_hash, g_str_equal);
   string_pool = g_hash_table_new (g_str_hash, g_str_equal);
  
+  if (incremental)
+    load_old_cache (path);
+
+  if (n_threads > 1 && !index_only)
+    {
+      /* Load the loader modules before the threads need them */
+      g_slist_free (gdk_pixbuf_get_formats ());
+      load_pool = g_thread_pool_new (load_image_data_thread, NULL,
+				     n_threads, FALSE, NULL);
+    }
+
   directories = scan_directory (path, NULL, files, NULL, 0);
 
+  if (load_pool)
+    {
+      g_thread_pool_free (load_pool, FALSE, TRUE);
+      load_pool = NULL;
+    }
+
   if (g_hash_table_size (files) == 0)
     {
       /* Empty table, just close and remove the file */
 
+      free_old_cache ();
       fclose (cache);
       g_unlink (tmp_cache_path);
       g_unlink (cache_path);
@@ -1536,6 +1963,9 @@ opentmp:
     }
   cache = NULL;
 
+  /* The old cache must not be mapped anymore when it is replaced */
+  free_old_cache ();
+
   g_list_foreach (directories, (GFunc)g_free, NULL);
   g_list_free (directories);
   
@@ -1651,6 +2081,8 @@ static GOptionEntry args[] = {
   { "source", 'c', 0, G_OPTION_ARG_STRING, &var_name, N_("Output a C header file"), "NAME" },
   { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, N_("Turn off verbose output"), NULL },
   { "validate", 'v', 0, G_OPTION_ARG_NONE, &validate, N_("Validate existing icon cache"), NULL },
+  { "incremental", 'u', 0, G_OPTION_ARG_NONE, &incremental, N_("Reuse the existing cache for unchanged directories"), NULL },
+  { "threads", 'j', 0, G_OPTION_ARG_INT, &n_threads, N_("Load images using N threads"), "N" },
   { NULL }
 };
 
@@ -1750,6 +2182,9 @@ main (int argc, char **argv)
   if (!force_update && is_cache_up_to_date (path))
     return 0;
 
+  if (n_threads > 1 && !g_thread_supported ())
+    g_thread_init (NULL);
+
   g_type_init ();
   build_cache (path);
 
@@ -0,0 +1,576 @@
+/* updaterccache.c
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "gtkrccache.h"
+
+static gboolean quiet = FALSE;
+
+static GOptionEntry args[] = {
+  { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, "Turn off verbose output", NULL },
+  { NULL }
+};
+
+typedef struct
+{
+  gchar   *name;
+  gchar   *directory;
+  guint32  mtime;
+  guint32  size;
+  guint32  flags;
+} RcFile;
+
+typedef struct
+{
+  guint    file_index;
+  guint    depth;
+  gint     line;    /* Line of the last token in text */
+  gboolean empty;
+  GString *text;
+} Chunk;
+
+typedef struct
+{
+  GPtrArray *files;
+  GPtrArray *chunks;
+  GSList    *stack;  /* RcFiles currently being compiled, innermost first */
+} Compiler;
+
+static gboolean compile_file (Compiler     *compiler,
+			      const gchar  *filename,
+			      guint         depth,
+			      GError      **error);
+
+static gboolean
+has_locale_variants (const gchar *filename)
+{
+  gchar *dirname, *basename, *prefix, *cache_prefix;
+  const gchar *name;
+  gboolean result = FALSE;
+  GDir *dir;
+
+  dirname = g_path_get_dirname (filename);
+  basename = g_path_get_basename (filename);
+  prefix = g_strconcat (basename, ".", NULL);
+  cache_prefix = g_strconcat (basename, GTK_RC_CACHE_SUFFIX, NULL);
+
+  dir = g_dir_open (dirname, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+	{
+	  /* Also skips temporary files of g_file_set_contents() */
+	  if (g_str_has_prefix (name, prefix) &&
+	      !g_str_has_prefix (name, cache_prefix))
+	    {
+	      result = TRUE;
+	      break;
+	    }
+	}
+      g_dir_close (dir);
+    }
+
+  g_free (dirname);
+  g_free (basename);
+  g_free (prefix);
+  g_free (cache_prefix);
+
+  return result;
+}
+
+static Chunk *
+chunk_new (Compiler *compiler,
+	   guint     file_index,
+	   guint     depth,
+	   gint      line)
+{
+  Chunk *chunk;
+  gint i;
+
+  chunk = g_new (Chunk, 1);
+  chunk->file_index = file_index;
+  chunk->depth = depth;
+  chunk->line = line;
+  chunk->empty = TRUE;
+  chunk->text = g_string_new (NULL);
+
+  /* Keep line numbers in warnings the same as in the file */
+  for (i = 1; i < line; i++)
+    g_string_append_c (chunk->text, '\n');
+
+  g_ptr_array_add (compiler->chunks, chunk);
+
+  return chunk;
+}
+
+/* Starts a new token in @chunk that is on @line of the file */
+static void
+chunk_start_token (Chunk *chunk,
+		   gint   line)
+{
+  if (line > chunk->line)
+    {
+      for (; chunk->line < line; chunk->line++)
+	g_string_append_c (chunk->text, '\n');
+    }
+  else if (!chunk->empty)
+    g_string_append_c (chunk->text, ' ');
+
+  chunk->empty = FALSE;
+}
+
+static void
+append_string (GString     *text,
+	       const gchar *string)
+{
+  const gchar *p;
+
+  g_string_append_c (text, '"');
+  for (p = string; *p; p++)
+    {
+      switch (*p)
+	{
+	case '"':
+	case '\\':
+	  g_string_append_c (text, '\\');
+	  g_string_append_c (text, *p);
+	  break;
+	case '\n':
+	  g_string_append (text, "\\n");
+	  break;
+	case '\t':
+	  g_string_append (text, "\\t");
+	  break;
+	default:
+	  if ((guchar) *p < 0x20)
+	    g_string_append_printf (text, "\\%03o", (guchar) *p);
+	  else
+	    g_string_append_c (text, *p);
+	}
+    }
+  g_string_append_c (text, '"');
+}
+
+/* Appends the current token of @scanner to @chunk, in a form that
+ * scans back to the same token.
+ */
+static gboolean
+append_token (Chunk     *chunk,
+	      GScanner  *scanner,
+	      GTokenType token)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  chunk_start_token (chunk, scanner->line);
+
+  switch ((gint) token)
+    {
+    case G_TOKEN_IDENTIFIER:
+      g_string_append (chunk->text, scanner->value.v_identifier);
+      break;
+    case G_TOKEN_STRING:
+      append_string (chunk->text, scanner->value.v_string);
+      break;
+    case G_TOKEN_INT:
+      g_string_append_printf (chunk->text, "%lu", scanner->value.v_int);
+      break;
+    case G_TOKEN_FLOAT:
+      g_ascii_dtostr (buf, sizeof (buf), scanner->value.v_float);
+      g_string_append (chunk->text, buf);
+      /* Don't let it scan back as an integer */
+      if (strpbrk (buf, ".eEn") == NULL)
+	g_string_append (chunk->text, ".0");
+      break;
+    default:
+      if (token > G_TOKEN_NONE)
+	return FALSE;
+      g_string_append_c (chunk->text, (gchar) token);
+      break;
+    }
+
+  return TRUE;
+}
+
+/* Resolves an include statement the way parse_include_file() in
+ * gtkrc.c does. Returns %NULL if the include should be left to GTK+
+ * at runtime.
+ */
+static gchar *
+resolve_include (Compiler    *compiler,
+		 const gchar *filename)
+{
+  GSList *l;
+
+  if (g_path_is_absolute (filename))
+    {
+      if (g_file_test (filename, G_FILE_TEST_EXISTS))
+	return g_strdup (filename);
+
+      return NULL;
+    }
+
+  for (l = compiler->stack; l; l = l->next)
+    {
+      RcFile *file = l->data;
+      gchar *name = g_build_filename (file->directory, filename, NULL);
+
+      if (g_file_test (name, G_FILE_TEST_EXISTS))
+	return name;
+
+      g_free (name);
+    }
+
+  return NULL;
+}
+
+static gboolean
+is_in_stack (Compiler    *compiler,
+	     const gchar *filename)
+{
+  GSList *l;
+
+  for (l = compiler->stack; l; l = l->next)
+    {
+      RcFile *file = l->data;
+
+      if (strcmp (file->name, filename) == 0)
+	return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+compile_tokens (Compiler     *compiler,
+		GScanner     *scanner,
+		guint         file_index,
+		guint         depth,
+		GError      **error)
+{
+  Chunk *chunk;
+  GTokenType token;
+  gint braces = 0;
+
+  chunk = chunk_new (compiler, file_index, depth, 1);
+
+  while ((token = g_scanner_get_next_token (scanner)) != G_TOKEN_EOF)
+    {
+      if (token == G_TOKEN_ERROR)
+	{
+	  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		       "%s:%d: syntax error", scanner->input_name, scanner->line);
+	  return FALSE;
+	}
+
+      if (token == G_TOKEN_LEFT_CURLY)
+	braces++;
+      else if (token == G_TOKEN_RIGHT_CURLY)
+	braces--;
+      else if (braces == 0 &&
+	       token == G_TOKEN_IDENTIFIER &&
+	       strcmp (scanner->value.v_identifier, "include") == 0 &&
+	       g_scanner_peek_next_token (scanner) == G_TOKEN_STRING)
+	{
+	  gchar *include;
+	  gint line = scanner->line;
+
+	  g_scanner_get_next_token (scanner);
+	  include = resolve_include (compiler, scanner->value.v_string);
+
+	  if (include == NULL)
+	    {
+	      /* Leave it to GTK+ to warn about it, or to pick up the
+	       * file once it exists.
+	       */
+	      chunk_start_token (chunk, line);
+	      g_string_append (chunk->text, "include ");
+	      append_string (chunk->text, scanner->value.v_string);
+	      continue;
+	    }
+
+	  /* GTK+ ignores recursive includes */
+	  if (!is_in_stack (compiler, include))
+	    {
+	      if (!compile_file (compiler, include, depth + 1, error))
+		{
+		  g_free (include);
+		  return FALSE;
+		}
+
+	      chunk = chunk_new (compiler, file_index, depth, scanner->line);
+	    }
+
+	  g_free (include);
+	  continue;
+	}
+
+      if (!append_token (chunk, scanner, token))
+	{
+	  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		       "%s:%d: unexpected token", scanner->input_name, scanner->line);
+	  return FALSE;
+	}
+    }
+
+  return TRUE;
+}
+
+static gboolean
+compile_file (Compiler     *compiler,
+	      const gchar  *filename,
+	      guint         depth,
+	      GError      **error)
+{
+  struct stat statbuf;
+  GScanner *scanner;
+  RcFile *file;
+  gchar *contents;
+  gsize length;
+  guint file_index;
+  gboolean result;
+
+  if (g_lstat (filename, &statbuf) != 0 ||
+      !g_file_get_contents (filename, &contents, &length, error))
+    {
+      if (error && *error == NULL)
+	g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+		     "Could not stat %s", filename);
+      return FALSE;
+    }
+
+  file = g_new (RcFile, 1);
+  file->name = g_strdup (filename);
+  file->directory = g_path_get_dirname (filename);
+  file->mtime = statbuf.st_mtime;
+  file->size = statbuf.st_size;
+  file->flags = has_locale_variants (filename) ? GTK_RC_CACHE_FILE_HAS_LOCALE_VARIANTS : 0;
+
+  file_index = compiler->files->len;
+  g_ptr_array_add (compiler->files, file);
+  compiler->stack = g_slist_prepend (compiler->stack, file);
+
+  scanner = gtk_rc_scanner_new ();
+  scanner->input_name = filename;
+  g_scanner_input_text (scanner, contents, length);
+
+  result = compile_tokens (compiler, scanner, file_index, depth, error);
+
+  g_scanner_destroy (scanner);
+  g_free (contents);
+
+  compiler->stack = g_slist_delete_link (compiler->stack, compiler->stack);
+
+  return result;
+}
+
+static void
+write_uint16 (GString *data,
+	      guint16  value)
+{
+  value = GUINT16_TO_BE (value);
+  g_string_append_len (data, (gchar *) &value, 2);
+}
+
+static void
+write_uint32 (GString *data,
+	      guint32  value)
+{
+  value = GUINT32_TO_BE (value);
+  g_string_append_len (data, (gchar *) &value, 4);
+}
+
+static GString *
+write_cache (Compiler *compiler)
+{
+  GString *data, *strings;
+  guint32 files_offset, chunks_offset, strings_offset;
+  guint i;
+
+  files_offset = GTK_RC_CACHE_HEADER_SIZE;
+  chunks_offset = files_offset + 4 + compiler->files->len * GTK_RC_CACHE_FILE_SIZE;
+  strings_offset = chunks_offset + 4 + compiler->chunks->len * GTK_RC_CACHE_CHUNK_SIZE;
+
+  data = g_string_new (NULL);
+  strings = g_string_new (NULL);
+
+  write_uint16 (data, GTK_RC_CACHE_MAJOR_VERSION);
+  write_uint16 (data, GTK_RC_CACHE_MINOR_VERSION);
+  write_uint32 (data, files_offset);
+  write_uint32 (data, chunks_offset);
+
+  write_uint32 (data, compiler->files->len);
+  for (i = 0; i < compiler->files->len; i++)
+    {
+      RcFile *file = g_ptr_array_index (compiler->files, i);
+
+      write_uint32 (data, strings_offset + strings->len);
+      g_string_append_len (strings, file->name, strlen (file->name) + 1);
+
+      write_uint32 (data, file->mtime);
+      write_uint32 (data, file->size);
+      write_uint32 (data, file->flags);
+    }
+
+  write_uint32 (data, compiler->chunks->len);
+  for (i = 0; i < compiler->chunks->len; i++)
+    {
+      Chunk *chunk = g_ptr_array_index (compiler->chunks, i);
+
+      write_uint32 (data, chunk->file_index);
+      write_uint32 (data, chunk->depth);
+      write_uint32 (data, strings_offset + strings->len);
+      g_string_append_len (strings, chunk->text->str, chunk->text->len + 1);
+    }
+
+  g_assert (data->len == strings_offset);
+  g_string_append_len (data, strings->str, strings->len);
+  g_string_free (strings, TRUE);
+
+  return data;
+}
+
+static void
+compiler_free (Compiler *compiler)
+{
+  guint i;
+
+  for (i = 0; i < compiler->files->len; i++)
+    {
+      RcFile *file = g_ptr_array_index (compiler->files, i);
+
+      g_free (file->name);
+      g_free (file->directory);
+      g_free (file);
+    }
+  g_ptr_array_free (compiler->files, TRUE);
+
+  for (i = 0; i < compiler->chunks->len; i++)
+    {
+      Chunk *chunk = g_ptr_array_index (compiler->chunks, i);
+
+      g_string_free (chunk->text, TRUE);
+      g_free (chunk);
+    }
+  g_ptr_array_free (compiler->chunks, TRUE);
+
+  g_slist_free (compiler->stack);
+}
+
+static gboolean
+update_cache (const gchar  *filename,
+	      GError      **error)
+{
+  Compiler compiler;
+  GString *data;
+  gchar *canonical_name, *cache_name;
+  gboolean result;
+
+  /* Use the same absolute path gtk_rc_context_parse_file() will */
+  if (g_path_is_absolute (filename))
+    canonical_name = g_strdup (filename);
+  else
+    {
+      gchar *cwd;
+
+      cwd = g_get_current_dir ();
+      canonical_name = g_build_filename (cwd, filename, NULL);
+      g_free (cwd);
+    }
+
+  compiler.files = g_ptr_array_new ();
+  compiler.chunks = g_ptr_array_new ();
+  compiler.stack = NULL;
+
+  result = compile_file (&compiler, canonical_name, 0, error);
+
+  if (result)
+    {
+      data = write_cache (&compiler);
+
+      /* g_file_set_contents() replaces the old cache atomically, so
+       * running applications never map a partially written one.
+       */
+      cache_name = g_strconcat (filename, GTK_RC_CACHE_SUFFIX, NULL);
+      result = g_file_set_contents (cache_name, data->str, data->len, error);
+
+      if (result && !quiet)
+	g_printerr ("Cache file created successfully: %s (%u files, %u bytes)\n",
+		    cache_name, compiler.files->len, (guint) data->len);
+
+      g_free (cache_name);
+      g_string_free (data, TRUE);
+    }
+
+  compiler_free (&compiler);
+  g_free (canonical_name);
+
+  return result;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  gint i, status = 0;
+
+  setlocale (LC_ALL, "");
+
+  context = g_option_context_new ("GTKRC-FILE...");
+  g_option_context_set_summary (context,
+				"Write precompiled caches for gtkrc files, "
+				"including the files they include.");
+  g_option_context_add_main_entries (context, args, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (argc < 2)
+    {
+      g_printerr ("No gtkrc file given\n");
+      return 1;
+    }
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!update_cache (argv[i], &error))
+	{
+	  g_printerr ("Failed to write cache for %s: %s\n", argv[i], error->message);
+	  g_clear_error (&error);
+	  status = 1;
+	}
+    }
+
+  return status;
+}
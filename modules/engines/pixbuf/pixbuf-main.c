@@ -35,6 +35,7 @@ theme_init (GTypeModule *module)
 G_MODULE_EXPORT void
 theme_exit (void)
 {
+  theme_pixbuf_flush_cache ();
 }
 
 G_MODULE_EXPORT GtkRcStyle *
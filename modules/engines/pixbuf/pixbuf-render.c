@@ -347,13 +347,15 @@ replicate_cols (GdkPixbuf    *src,
 
 /* Scale the rectangle (src_x, src_y, src_width, src_height)
  * onto the rectangle (dest_x, dest_y, dest_width, dest_height)
- * of the destination, clip by clip_rect and render
+ * of the destination, clip by clip_rect and render. If dest_pixbuf
+ * is given, the result is copied into it instead of being drawn.
  */
 static void
 pixbuf_render (GdkPixbuf    *src,
 	       guint         hints,
 	       GdkWindow    *window,
 	       GdkBitmap    *mask,
+	       GdkPixbuf    *dest_pixbuf,
 	       GdkRectangle *clip_rect,
 	       gint          src_x,
 	       gint          src_y,
@@ -475,7 +477,16 @@ pixbuf_render (GdkPixbuf    *src,
       y_offset = 0;
     }
 
-  if (tmp_pixbuf)
+  if (tmp_pixbuf && dest_pixbuf)
+    {
+      gdk_pixbuf_copy_area (tmp_pixbuf,
+			    x_offset, y_offset,
+			    rect.width, rect.height,
+			    dest_pixbuf,
+			    rect.x, rect.y);
+      g_object_unref (tmp_pixbuf);
+    }
+  else if (tmp_pixbuf)
     {
       cairo_t *cr;
       
@@ -745,98 +756,449 @@ theme_pixbuf_get_pixbuf (ThemePixbuf *theme_pb)
   return theme_pb->pixbuf;
 }
 
-void
-theme_pixbuf_render (ThemePixbuf  *theme_pb,
-		     GdkWindow    *window,
-		     GdkBitmap    *mask,
-		     GdkRectangle *clip_rect,
-		     guint         component_mask,
-		     gboolean      center,
-		     gint          x,
-		     gint          y,
-		     gint          width,
-		     gint          height)
+/* Renders the components in component_mask of a stretched image,
+ * either to window (and mask), or into dest_pixbuf when that is
+ * given.
+ */
+static void
+theme_pixbuf_render_slices (ThemePixbuf  *theme_pb,
+			    GdkPixbuf    *pixbuf,
+			    GdkWindow    *window,
+			    GdkBitmap    *mask,
+			    GdkPixbuf    *dest_pixbuf,
+			    GdkRectangle *clip_rect,
+			    guint         component_mask,
+			    gint          x,
+			    gint          y,
+			    gint          width,
+			    gint          height)
 {
-  GdkPixbuf *pixbuf = theme_pixbuf_get_pixbuf (theme_pb);
   gint src_x[4], src_y[4], dest_x[4], dest_y[4];
   gint pixbuf_width = gdk_pixbuf_get_width (pixbuf);
   gint pixbuf_height = gdk_pixbuf_get_height (pixbuf);
 
-  if (!pixbuf)
-    return;
+  src_x[0] = 0;
+  src_x[1] = theme_pb->border_left;
+  src_x[2] = pixbuf_width - theme_pb->border_right;
+  src_x[3] = pixbuf_width;
+  
+  src_y[0] = 0;
+  src_y[1] = theme_pb->border_top;
+  src_y[2] = pixbuf_height - theme_pb->border_bottom;
+  src_y[3] = pixbuf_height;
+  
+  dest_x[0] = x;
+  dest_x[1] = x + theme_pb->border_left;
+  dest_x[2] = x + width - theme_pb->border_right;
+  dest_x[3] = x + width;
 
-  if (theme_pb->stretch)
+  if (dest_x[1] > dest_x[2])
     {
-      if (component_mask & COMPONENT_ALL)
-	component_mask = (COMPONENT_ALL - 1) & ~component_mask;
-
-      src_x[0] = 0;
-      src_x[1] = theme_pb->border_left;
-      src_x[2] = pixbuf_width - theme_pb->border_right;
-      src_x[3] = pixbuf_width;
-      
-      src_y[0] = 0;
-      src_y[1] = theme_pb->border_top;
-      src_y[2] = pixbuf_height - theme_pb->border_bottom;
-      src_y[3] = pixbuf_height;
-      
-      dest_x[0] = x;
-      dest_x[1] = x + theme_pb->border_left;
-      dest_x[2] = x + width - theme_pb->border_right;
-      dest_x[3] = x + width;
-
-      if (dest_x[1] > dest_x[2])
-	{
-	  component_mask &= ~(COMPONENT_NORTH | COMPONENT_SOUTH | COMPONENT_CENTER);
-	  dest_x[1] = dest_x[2] = (dest_x[1] + dest_x[2]) / 2;
-	}
+      component_mask &= ~(COMPONENT_NORTH | COMPONENT_SOUTH | COMPONENT_CENTER);
+      dest_x[1] = dest_x[2] = (dest_x[1] + dest_x[2]) / 2;
+    }
 
-      dest_y[0] = y;
-      dest_y[1] = y + theme_pb->border_top;
-      dest_y[2] = y + height - theme_pb->border_bottom;
-      dest_y[3] = y + height;
+  dest_y[0] = y;
+  dest_y[1] = y + theme_pb->border_top;
+  dest_y[2] = y + height - theme_pb->border_bottom;
+  dest_y[3] = y + height;
 
-      if (dest_y[1] > dest_y[2])
-	{
-	  component_mask &= ~(COMPONENT_EAST | COMPONENT_WEST | COMPONENT_CENTER);
-	  dest_y[1] = dest_y[2] = (dest_y[1] + dest_y[2]) / 2;
-	}
+  if (dest_y[1] > dest_y[2])
+    {
+      component_mask &= ~(COMPONENT_EAST | COMPONENT_WEST | COMPONENT_CENTER);
+      dest_y[1] = dest_y[2] = (dest_y[1] + dest_y[2]) / 2;
+    }
 
 
 
 #define RENDER_COMPONENT(X1,X2,Y1,Y2)					         \
-        pixbuf_render (pixbuf, theme_pb->hints[Y1][X1], window, mask, clip_rect, \
+        pixbuf_render (pixbuf, theme_pb->hints[Y1][X1], window, mask,	         \
+		       dest_pixbuf, clip_rect,				         \
 	 	       src_x[X1], src_y[Y1],				         \
 		       src_x[X2] - src_x[X1], src_y[Y2] - src_y[Y1],	         \
 		       dest_x[X1], dest_y[Y1],				         \
 		       dest_x[X2] - dest_x[X1], dest_y[Y2] - dest_y[Y1]);
-      
-      if (component_mask & COMPONENT_NORTH_WEST)
-	RENDER_COMPONENT (0, 1, 0, 1);
+  
+  if (component_mask & COMPONENT_NORTH_WEST)
+    RENDER_COMPONENT (0, 1, 0, 1);
+
+  if (component_mask & COMPONENT_NORTH)
+    RENDER_COMPONENT (1, 2, 0, 1);
+
+  if (component_mask & COMPONENT_NORTH_EAST)
+    RENDER_COMPONENT (2, 3, 0, 1);
+
+  if (component_mask & COMPONENT_WEST)
+    RENDER_COMPONENT (0, 1, 1, 2);
+
+  if (component_mask & COMPONENT_CENTER)
+    RENDER_COMPONENT (1, 2, 1, 2);
+
+  if (component_mask & COMPONENT_EAST)
+    RENDER_COMPONENT (2, 3, 1, 2);
+
+  if (component_mask & COMPONENT_SOUTH_WEST)
+    RENDER_COMPONENT (0, 1, 2, 3);
+
+  if (component_mask & COMPONENT_SOUTH)
+    RENDER_COMPONENT (1, 2, 2, 3);
+
+  if (component_mask & COMPONENT_SOUTH_EAST)
+    RENDER_COMPONENT (2, 3, 2, 3);
+
+#undef RENDER_COMPONENT
+}
+
+/* Render cache
+ *
+ * Widgets are drawn with the same image at the same size over and
+ * over: every button of a toolbar, or every notebook tab on each step
+ * of a resize. Scaling the nine slices of a stretched image is most of
+ * the engine's drawing time, so fully rendered results are kept in a
+ * size bounded LRU cache. Entries are keyed on the source pixbuf and
+ * its borders rather than on the ThemePixbuf, so ThemePixbufs loading
+ * the same file share entries, and since pixbufs are never modified a
+ * cached result never has to be invalidated.
+ *
+ * On first use on a screen, an entry also uploads its result into a
+ * surface similar to the target (a server side pixmap on X11), so that
+ * later draws are a plain copy on the server. The pixbuf is kept for
+ * drawing the mask and for other screens.
+ *
+ * GTK_PIXBUF_CACHE_SIZE sets the budget in kilobytes, 0 disables the
+ * cache. GTK_PIXBUF_CACHE_PIXMAPS=0 keeps results client side only.
+ */
+
+#define DEFAULT_RENDER_CACHE_SIZE 4096 /* kilobytes */
+
+/* Results larger than this fraction of the budget are not cached */
+#define RENDER_CACHE_MAX_ENTRY_FRACTION 4
+
+typedef struct _RenderCacheEntry RenderCacheEntry;
+
+struct _RenderCacheEntry
+{
+  /* Key */
+  GdkPixbuf *source;
+  gint       border_left;
+  gint       border_right;
+  gint       border_top;
+  gint       border_bottom;
+  guint      component_mask;
+  gint       width;
+  gint       height;
+
+  GdkPixbuf       *rendered;
+  cairo_surface_t *surface;
+  GdkScreen       *screen;
+  gsize            size;
+
+  GList            link;	/* In render_cache_lru */
+};
+
+static GHashTable *render_cache = NULL;
+static GQueue render_cache_lru = G_QUEUE_INIT;
+static gsize render_cache_size = 0;
+static gsize render_cache_max_size = 0;
+static gboolean render_cache_use_pixmaps = TRUE;
+
+static guint
+render_cache_entry_hash (gconstpointer key)
+{
+  const RenderCacheEntry *entry = key;
+  guint h;
+
+  h = g_direct_hash (entry->source);
+  h = h * 31 + entry->border_left;
+  h = h * 31 + entry->border_right;
+  h = h * 31 + entry->border_top;
+  h = h * 31 + entry->border_bottom;
+  h = h * 31 + entry->component_mask;
+  h = h * 31 + entry->width;
+  h = h * 31 + entry->height;
+
+  return h;
+}
+
+static gboolean
+render_cache_entry_equal (gconstpointer a,
+			  gconstpointer b)
+{
+  const RenderCacheEntry *ea = a;
+  const RenderCacheEntry *eb = b;
+
+  return (ea->source == eb->source &&
+	  ea->border_left == eb->border_left &&
+	  ea->border_right == eb->border_right &&
+	  ea->border_top == eb->border_top &&
+	  ea->border_bottom == eb->border_bottom &&
+	  ea->component_mask == eb->component_mask &&
+	  ea->width == eb->width &&
+	  ea->height == eb->height);
+}
+
+static void
+render_cache_entry_free (RenderCacheEntry *entry)
+{
+  render_cache_size -= entry->size;
+
+  if (entry->surface)
+    cairo_surface_destroy (entry->surface);
+  g_object_unref (entry->rendered);
+  g_object_unref (entry->source);
+  g_slice_free (RenderCacheEntry, entry);
+}
+
+static gboolean
+render_cache_init (void)
+{
+  const gchar *env;
+
+  if (render_cache)
+    return render_cache_max_size > 0;
+
+  render_cache_max_size = DEFAULT_RENDER_CACHE_SIZE;
+  env = g_getenv ("GTK_PIXBUF_CACHE_SIZE");
+  if (env)
+    render_cache_max_size = g_ascii_strtoull (env, NULL, 10);
+  render_cache_max_size *= 1024;
+
+  env = g_getenv ("GTK_PIXBUF_CACHE_PIXMAPS");
+  if (env && strcmp (env, "0") == 0)
+    render_cache_use_pixmaps = FALSE;
+
+  render_cache = g_hash_table_new_full (render_cache_entry_hash,
+					render_cache_entry_equal,
+					NULL,
+					(GDestroyNotify)render_cache_entry_free);
+
+  return render_cache_max_size > 0;
+}
+
+/* Evicts least recently used entries until the cache fits its budget.
+ * The most recently used entry is always kept.
+ */
+static void
+render_cache_trim (void)
+{
+  while (render_cache_size > render_cache_max_size &&
+	 render_cache_lru.length > 1)
+    {
+      GList *link = g_queue_peek_tail_link (&render_cache_lru);
 
-      if (component_mask & COMPONENT_NORTH)
-	RENDER_COMPONENT (1, 2, 0, 1);
+      g_queue_unlink (&render_cache_lru, link);
+      g_hash_table_remove (render_cache, link->data);
+    }
+}
+
+static RenderCacheEntry *
+render_cache_lookup (ThemePixbuf *theme_pb,
+		     GdkPixbuf   *pixbuf,
+		     guint        component_mask,
+		     gint         width,
+		     gint         height)
+{
+  RenderCacheEntry key, *entry;
+  gsize size;
+
+  if (!render_cache_init ())
+    return NULL;
+
+  key.source = pixbuf;
+  key.border_left = theme_pb->border_left;
+  key.border_right = theme_pb->border_right;
+  key.border_top = theme_pb->border_top;
+  key.border_bottom = theme_pb->border_bottom;
+  key.component_mask = component_mask;
+  key.width = width;
+  key.height = height;
+
+  entry = g_hash_table_lookup (render_cache, &key);
+  if (entry)
+    {
+      g_queue_unlink (&render_cache_lru, &entry->link);
+      g_queue_push_head_link (&render_cache_lru, &entry->link);
+
+      return entry;
+    }
+
+  size = (gsize)width * height * 4;
+  if (size > render_cache_max_size / RENDER_CACHE_MAX_ENTRY_FRACTION)
+    return NULL;
+
+  entry = g_slice_new (RenderCacheEntry);
+  *entry = key;
+  g_object_ref (entry->source);
+
+  entry->rendered = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+				    width, height);
+  if (entry->rendered == NULL)
+    {
+      g_object_unref (entry->source);
+      g_slice_free (RenderCacheEntry, entry);
+      return NULL;
+    }
+
+  /* Components are copied rather than composited, so the parts not
+   * covered by component_mask must start out transparent.
+   */
+  gdk_pixbuf_fill (entry->rendered, 0);
+  theme_pixbuf_render_slices (theme_pb, pixbuf, NULL, NULL,
+			      entry->rendered, NULL, component_mask,
+			      0, 0, width, height);
+
+  entry->surface = NULL;
+  entry->screen = NULL;
+  entry->size = gdk_pixbuf_get_rowstride (entry->rendered) * height;
+  entry->link.data = entry;
+  entry->link.prev = entry->link.next = NULL;
+
+  g_hash_table_insert (render_cache, entry, entry);
+  g_queue_push_head_link (&render_cache_lru, &entry->link);
+  render_cache_size += entry->size;
+
+  render_cache_trim ();
+
+  return entry;
+}
+
+static cairo_surface_t *
+render_cache_entry_get_surface (RenderCacheEntry *entry,
+				GdkWindow        *window,
+				cairo_t          *cr)
+{
+  GdkScreen *screen = gdk_drawable_get_screen (window);
+  cairo_t *tmp_cr;
+
+  if (entry->surface)
+    return entry->screen == screen ? entry->surface : NULL;
+
+  if (!render_cache_use_pixmaps)
+    return NULL;
+
+  entry->surface = cairo_surface_create_similar (cairo_get_target (cr),
+						 CAIRO_CONTENT_COLOR_ALPHA,
+						 entry->width, entry->height);
+  if (cairo_surface_status (entry->surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy (entry->surface);
+      entry->surface = NULL;
+      return NULL;
+    }
+
+  entry->screen = screen;
+
+  tmp_cr = cairo_create (entry->surface);
+  gdk_cairo_set_source_pixbuf (tmp_cr, entry->rendered, 0, 0);
+  cairo_set_operator (tmp_cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint (tmp_cr);
+  cairo_destroy (tmp_cr);
+
+  /* Assume the server side copy uses 32 bits per pixel */
+  entry->size += (gsize)entry->width * entry->height * 4;
+  render_cache_size += (gsize)entry->width * entry->height * 4;
+  render_cache_trim ();
+
+  return entry->surface;
+}
+
+static void
+render_cache_entry_draw (RenderCacheEntry *entry,
+			 GdkWindow        *window,
+			 GdkBitmap        *mask,
+			 GdkRectangle     *clip_rect,
+			 gint              x,
+			 gint              y)
+{
+  cairo_surface_t *surface;
+  GdkRectangle rect;
+  cairo_t *cr;
+
+  rect.x = x;
+  rect.y = y;
+  rect.width = entry->width;
+  rect.height = entry->height;
+
+  /* As in pixbuf_render(), the mask is not clipped */
+  if (!mask && clip_rect)
+    {
+      if (!gdk_rectangle_intersect (clip_rect, &rect, &rect))
+	return;
+    }
 
-      if (component_mask & COMPONENT_NORTH_EAST)
-	RENDER_COMPONENT (2, 3, 0, 1);
+  if (mask)
+    {
+      cr = gdk_cairo_create (mask);
+      gdk_cairo_set_source_pixbuf (cr, entry->rendered, x, y);
+      gdk_cairo_rectangle (cr, &rect);
+      cairo_fill (cr);
+      cairo_destroy (cr);
+    }
 
-      if (component_mask & COMPONENT_WEST)
-	RENDER_COMPONENT (0, 1, 1, 2);
+  cr = gdk_cairo_create (window);
 
-      if (component_mask & COMPONENT_CENTER)
-	RENDER_COMPONENT (1, 2, 1, 2);
+  surface = render_cache_entry_get_surface (entry, window, cr);
+  if (surface)
+    cairo_set_source_surface (cr, surface, x, y);
+  else
+    gdk_cairo_set_source_pixbuf (cr, entry->rendered, x, y);
 
-      if (component_mask & COMPONENT_EAST)
-	RENDER_COMPONENT (2, 3, 1, 2);
+  gdk_cairo_rectangle (cr, &rect);
+  cairo_fill (cr);
+  cairo_destroy (cr);
+}
 
-      if (component_mask & COMPONENT_SOUTH_WEST)
-	RENDER_COMPONENT (0, 1, 2, 3);
+void
+theme_pixbuf_flush_cache (void)
+{
+  if (render_cache)
+    {
+      /* The links are embedded in the entries */
+      g_queue_init (&render_cache_lru);
+      g_hash_table_destroy (render_cache);
+      render_cache = NULL;
+    }
+}
 
-      if (component_mask & COMPONENT_SOUTH)
-	RENDER_COMPONENT (1, 2, 2, 3);
+void
+theme_pixbuf_render (ThemePixbuf  *theme_pb,
+		     GdkWindow    *window,
+		     GdkBitmap    *mask,
+		     GdkRectangle *clip_rect,
+		     guint         component_mask,
+		     gboolean      center,
+		     gint          x,
+		     gint          y,
+		     gint          width,
+		     gint          height)
+{
+  GdkPixbuf *pixbuf = theme_pixbuf_get_pixbuf (theme_pb);
+  gint pixbuf_width, pixbuf_height;
+
+  if (!pixbuf)
+    return;
 
-      if (component_mask & COMPONENT_SOUTH_EAST)
-	RENDER_COMPONENT (2, 3, 2, 3);
+  pixbuf_width = gdk_pixbuf_get_width (pixbuf);
+  pixbuf_height = gdk_pixbuf_get_height (pixbuf);
+
+  if (theme_pb->stretch)
+    {
+      RenderCacheEntry *entry;
+
+      if (component_mask & COMPONENT_ALL)
+	component_mask = (COMPONENT_ALL - 1) & ~component_mask;
+
+      if (width <= 0 || height <= 0)
+	return;
+
+      entry = render_cache_lookup (theme_pb, pixbuf, component_mask,
+				   width, height);
+      if (entry)
+	render_cache_entry_draw (entry, window, mask, clip_rect, x, y);
+      else
+	theme_pixbuf_render_slices (theme_pb, pixbuf, window, mask, NULL,
+				    clip_rect, component_mask,
+				    x, y, width, height);
     }
   else
     {
@@ -845,7 +1207,7 @@ theme_pixbuf_render (ThemePixbuf  *theme_pb,
 	  x += (width - pixbuf_width) / 2;
 	  y += (height - pixbuf_height) / 2;
 	  
-	  pixbuf_render (pixbuf, 0, window, NULL, clip_rect,
+	  pixbuf_render (pixbuf, 0, window, NULL, NULL, clip_rect,
 			 0, 0,
 			 pixbuf_width, pixbuf_height,
 			 x, y,
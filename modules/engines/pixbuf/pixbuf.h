@@ -210,6 +210,7 @@ G_GNUC_INTERNAL void         theme_pixbuf_render       (ThemePixbuf  *theme_pb,
 					gint          dest_y,
 					gint          dest_width,
 					gint          dest_height);
+G_GNUC_INTERNAL void         theme_pixbuf_flush_cache  (void);
 
 
 
@@ -0,0 +1,132 @@
+/* atomstartup - count the X round trips needed to intern atoms
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Initializes GTK+, shows a window, and then converts the atoms an
+ * application typically needs to X atoms. Every conversion that sends a
+ * request to the X server is a synchronous round trip, which is what
+ * gdk_x11_register_preload_atoms() is meant to avoid. Run with
+ * --no-preload to compare against interning the atoms on demand.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+
+/* What an application might register itself */
+static const gchar *const app_atoms[] = {
+  "_APP_DOCUMENT",
+  "_APP_SELECTION",
+  "_APP_COMMAND",
+  "_APP_STATE",
+  "text/uri-list",
+  "text/plain",
+  "text/plain;charset=utf-8",
+  "image/png",
+  "application/x-color",
+  "_NET_WM_WINDOW_OPACITY",
+  "_NET_WM_WINDOW_TYPE_DIALOG",
+  "_NET_WM_WINDOW_TYPE_UTILITY",
+  "_NET_WORKAREA"
+};
+
+/* Atoms GTK+ and GDK convert once widgets are used */
+static const gchar *const toolkit_atoms[] = {
+  "TARGETS",
+  "TIMESTAMP",
+  "MULTIPLE",
+  "SAVE_TARGETS",
+  "CLIPBOARD_MANAGER",
+  "UTF8_STRING",
+  "COMPOUND_TEXT",
+  "TEXT",
+  "_XEMBED",
+  "_XEMBED_INFO",
+  "_GTK_LOAD_ICONTHEMES",
+  "_GTK_READ_RCFILES",
+  "_NET_WM_NAME",
+  "_NET_WM_STATE",
+  "_NET_WM_USER_TIME"
+};
+
+static guint
+count_round_trips (GdkDisplay          *display,
+		   const gchar * const *names,
+		   guint                n_names)
+{
+  Display *xdisplay = GDK_DISPLAY_XDISPLAY (display);
+  gulong serial;
+  guint n_round_trips = 0;
+  guint i;
+
+  for (i = 0; i < n_names; i++)
+    {
+      serial = XNextRequest (xdisplay);
+      gdk_x11_get_xatom_by_name_for_display (display, names[i]);
+      if (XNextRequest (xdisplay) != serial)
+	n_round_trips++;
+    }
+
+  return n_round_trips;
+}
+
+int
+main (int argc, char **argv)
+{
+  GdkDisplay *display;
+  GtkWidget *window;
+  gboolean preload = TRUE;
+  gint64 start, init_time, lookup_time;
+  guint n_app, n_toolkit;
+  gint i;
+
+  for (i = 1; i < argc; i++)
+    if (strcmp (argv[i], "--no-preload") == 0)
+      preload = FALSE;
+
+  if (preload)
+    gdk_x11_register_preload_atoms (app_atoms, G_N_ELEMENTS (app_atoms));
+
+  start = g_get_monotonic_time ();
+  gtk_init (&argc, &argv);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_show (window);
+  gdk_flush ();
+  init_time = g_get_monotonic_time () - start;
+
+  display = gtk_widget_get_display (window);
+
+  start = g_get_monotonic_time ();
+  n_toolkit = count_round_trips (display, toolkit_atoms, G_N_ELEMENTS (toolkit_atoms));
+  n_app = count_round_trips (display, app_atoms, G_N_ELEMENTS (app_atoms));
+  lookup_time = g_get_monotonic_time () - start;
+
+  fprintf (stdout, "preload: %s\n", preload ? "yes" : "no");
+  fprintf (stdout, "startup: %g sec\n", init_time / (gdouble) G_USEC_PER_SEC);
+  fprintf (stdout, "toolkit atoms: %u of %u needed a round trip\n",
+	   n_toolkit, (guint) G_N_ELEMENTS (toolkit_atoms));
+  fprintf (stdout, "application atoms: %u of %u needed a round trip\n",
+	   n_app, (guint) G_N_ELEMENTS (app_atoms));
+  fprintf (stdout, "atom lookups: %g sec\n", lookup_time / (gdouble) G_USEC_PER_SEC);
+
+  gtk_widget_destroy (window);
+
+  return 0;
+}
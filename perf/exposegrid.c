@@ -0,0 +1,122 @@
+/* exposegrid - time exposes of containers with many children
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: exposegrid [SIZE]
+ *
+ * Fills a table with SIZE x SIZE labels (60 by default) and times the
+ * expose of a small area, of one row of labels and of the whole
+ * table. Also reports how many labels each expose reaches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#define N_EXPOSES 200
+
+static guint n_label_exposes;
+
+static gboolean
+count_expose (GtkWidget      *widget,
+	      GdkEventExpose *event,
+	      gpointer        data)
+{
+  n_label_exposes++;
+
+  return FALSE;
+}
+
+static void
+time_exposes (GtkWidget   *widget,
+	      const gchar *name,
+	      gint         x,
+	      gint         y,
+	      gint         width,
+	      gint         height)
+{
+  GdkRectangle rect = { x, y, width, height };
+  GTimer *timer;
+  gdouble elapsed;
+  gint i;
+
+  timer = g_timer_new ();
+  elapsed = 0;
+
+  for (i = 0; i < N_EXPOSES; i++)
+    {
+      n_label_exposes = 0;
+
+      gdk_window_invalidate_rect (widget->window, &rect, TRUE);
+      g_timer_start (timer);
+      gdk_window_process_updates (widget->window, TRUE);
+      g_timer_stop (timer);
+      elapsed += g_timer_elapsed (timer, NULL);
+    }
+
+  fprintf (stdout, "%s: %g msec per expose, %u labels exposed\n",
+	   name, elapsed * 1000 / N_EXPOSES, n_label_exposes);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *table;
+  gint size, i, j;
+
+  gtk_init (&argc, &argv);
+
+  size = argc > 1 ? atoi (argv[1]) : 60;
+  if (size <= 0)
+    {
+      g_printerr ("Usage: %s [SIZE]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  table = gtk_table_new (size, size, TRUE);
+  gtk_container_add (GTK_CONTAINER (window), table);
+
+  for (i = 0; i < size; i++)
+    for (j = 0; j < size; j++)
+      {
+	GtkWidget *label = gtk_label_new ("00");
+
+	g_signal_connect (label, "expose-event", G_CALLBACK (count_expose), NULL);
+	gtk_table_attach_defaults (GTK_TABLE (table), label, j, j + 1, i, i + 1);
+      }
+
+  gtk_widget_show_all (window);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  fprintf (stdout, "%d x %d labels\n", size, size);
+  time_exposes (window, "small area",
+		table->allocation.width / 2, table->allocation.height / 2, 8, 8);
+  time_exposes (window, "one row",
+		0, table->allocation.height / 2,
+		table->allocation.width, table->allocation.height / size);
+  time_exposes (window, "whole table",
+		0, 0, table->allocation.width, table->allocation.height);
+
+  gtk_widget_destroy (window);
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+/* keybindings - time the dispatch of key events to key bindings
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: keybindings [DEPTH]
+ *
+ * Puts an entry DEPTH containers deep (20 by default) into a window
+ * with a few accelerators, and times what the default key press
+ * handlers do for a key event: the key bindings of the entry and each
+ * of its ancestors are looked up until one handles the key, and the
+ * window looks for a mnemonic or an accelerator. This is done once
+ * for a key that nothing is bound to, and once for a key the entry
+ * binds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkkeysyms.h>
+
+#define N_KEYS 10000
+
+static void
+dispatch_key (GtkWidget   *widget,
+	      GdkEventKey *event)
+{
+  GtkWidget *toplevel = gtk_widget_get_toplevel (widget);
+
+  if (gtk_window_activate_key (GTK_WINDOW (toplevel), event))
+    return;
+
+  for (; widget; widget = widget->parent)
+    if (gtk_bindings_activate_event (GTK_OBJECT (widget), event))
+      return;
+}
+
+static void
+time_key (GtkWidget   *entry,
+	  const gchar *name,
+	  guint        keyval)
+{
+  GdkEventKey event = { 0, };
+  GdkKeymapKey *keys;
+  gint n_keys;
+  GTimer *timer;
+  gint i;
+
+  if (!gdk_keymap_get_entries_for_keyval (gdk_keymap_get_default (), keyval, &keys, &n_keys))
+    {
+      fprintf (stdout, "%s: key not in the keymap\n", name);
+      return;
+    }
+
+  event.type = GDK_KEY_PRESS;
+  event.window = entry->window;
+  event.keyval = keyval;
+  event.hardware_keycode = keys[0].keycode;
+  event.group = keys[0].group;
+  g_free (keys);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < N_KEYS; i++)
+    dispatch_key (entry, &event);
+
+  g_timer_stop (timer);
+
+  fprintf (stdout, "%s: %g usec per key\n",
+	   name, g_timer_elapsed (timer, NULL) * 1000000 / N_KEYS);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *parent, *entry;
+  GtkAccelGroup *accel_group;
+  gint depth, i;
+
+  gtk_init (&argc, &argv);
+
+  depth = argc > 1 ? atoi (argv[1]) : 20;
+  if (depth <= 0)
+    {
+      g_printerr ("Usage: %s [DEPTH]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  accel_group = gtk_accel_group_new ();
+  gtk_window_add_accel_group (GTK_WINDOW (window), accel_group);
+
+  parent = window;
+  for (i = 0; i < depth; i++)
+    {
+      GtkWidget *box = i % 2 ? gtk_hbox_new (FALSE, 0) : gtk_vbox_new (FALSE, 0);
+      GtkWidget *button;
+      gchar *text;
+
+      text = g_strdup_printf ("Button _%c", 'a' + i % 26);
+      button = gtk_button_new_with_mnemonic (text);
+      g_free (text);
+      gtk_widget_add_accelerator (button, "clicked", accel_group,
+				  GDK_F1 + i % 12, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+
+      gtk_box_pack_start (GTK_BOX (box), button, FALSE, FALSE, 0);
+      gtk_container_add (GTK_CONTAINER (parent), box);
+      parent = box;
+    }
+
+  entry = gtk_entry_new ();
+  gtk_entry_set_text (GTK_ENTRY (entry), "Some text");
+  gtk_container_add (GTK_CONTAINER (parent), entry);
+
+  gtk_widget_show_all (window);
+  gtk_widget_grab_focus (entry);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  fprintf (stdout, "depth %d\n", depth);
+  time_key (entry, "unbound key", GDK_F9);
+  time_key (entry, "entry binding", GDK_Home);
+
+  gtk_widget_destroy (window);
+  g_object_unref (accel_group);
+
+  return 0;
+}
@@ -0,0 +1,228 @@
+/* pixbufengine - time drawing a pixbuf engine themed window at many sizes
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: pixbufengine [--no-cache]
+ *
+ * Generates a theme for the pixbuf ("pixmap") engine with stretched,
+ * bordered images for buttons, notebook tabs and the window
+ * background, builds a window using it, and times redrawing the
+ * window repeatedly at one size and while stepping through many sizes
+ * as during an interactive resize. --no-cache disables the engine's
+ * render cache for comparison.
+ *
+ * The engine must be installed, or GTK_PATH must point at a directory
+ * with a <binary-version>/engines/ subdirectory containing it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#define IMAGE_SIZE     48
+#define IMAGE_BORDER   10
+#define N_BUTTONS      24
+#define N_TABS         8
+#define N_REDRAWS      50
+#define N_SIZES        100
+
+static gchar *
+write_image (guint32 color)
+{
+  GdkPixbuf *pixbuf, *border;
+  GError *error = NULL;
+  gchar *filename;
+  gint fd;
+
+  /* A bordered image, so that each slice scales differently */
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, IMAGE_SIZE, IMAGE_SIZE);
+  gdk_pixbuf_fill (pixbuf, 0x202020ff);
+  border = gdk_pixbuf_new_subpixbuf (pixbuf, 2, 2, IMAGE_SIZE - 4, IMAGE_SIZE - 4);
+  gdk_pixbuf_fill (border, color);
+  g_object_unref (border);
+  border = gdk_pixbuf_new_subpixbuf (pixbuf, IMAGE_BORDER, IMAGE_BORDER,
+				     IMAGE_SIZE - 2 * IMAGE_BORDER, 4);
+  gdk_pixbuf_fill (border, 0xffffffc0);
+  g_object_unref (border);
+
+  fd = g_file_open_tmp ("pixbufengine-XXXXXX.png", &filename, &error);
+  if (fd < 0)
+    g_error ("Could not create a temporary file: %s", error->message);
+  close (fd);
+
+  if (!gdk_pixbuf_save (pixbuf, filename, "png", &error, NULL))
+    g_error ("Could not write %s: %s", filename, error->message);
+  g_object_unref (pixbuf);
+
+  return filename;
+}
+
+static gchar *image_files[3];
+
+static void
+parse_generated_theme (void)
+{
+  gchar *button, *tab, *background;
+  gchar *theme;
+
+  button = image_files[0] = write_image (0x6080a0ff);
+  tab = image_files[1] = write_image (0xa08060ff);
+  background = image_files[2] = write_image (0xd0d0d0ff);
+
+  theme = g_strdup_printf ("style \"pixbuf-bench\"\n"
+			   "{\n"
+			   "  engine \"pixmap\"\n"
+			   "  {\n"
+			   "    image { function = BOX detail = \"button\" file = \"%s\" border = { %d, %d, %d, %d } stretch = TRUE }\n"
+			   "    image { function = EXTENSION file = \"%s\" border = { %d, %d, %d, %d } stretch = TRUE }\n"
+			   "    image { function = BOX file = \"%s\" border = { %d, %d, %d, %d } stretch = TRUE }\n"
+			   "    image { function = FLAT_BOX file = \"%s\" border = { %d, %d, %d, %d } stretch = TRUE }\n"
+			   "  }\n"
+			   "}\n"
+			   "class \"GtkWidget\" style \"pixbuf-bench\"\n",
+			   button, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER,
+			   tab, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER,
+			   background, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER,
+			   background, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER, IMAGE_BORDER);
+  gtk_rc_parse_string (theme);
+
+  g_free (theme);
+}
+
+static GtkWidget *
+create_window (void)
+{
+  GtkWidget *window, *notebook, *table;
+  gchar *text;
+  gint i;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  notebook = gtk_notebook_new ();
+  gtk_container_add (GTK_CONTAINER (window), notebook);
+
+  for (i = 0; i < N_TABS; i++)
+    {
+      text = g_strdup_printf ("Tab %d", i);
+      table = gtk_table_new (N_BUTTONS / 4, 4, TRUE);
+      gtk_notebook_append_page (GTK_NOTEBOOK (notebook), table,
+				gtk_label_new (text));
+      g_free (text);
+
+      if (i == 0)
+	{
+	  gint j;
+
+	  for (j = 0; j < N_BUTTONS; j++)
+	    {
+	      text = g_strdup_printf ("Button %d", j);
+	      gtk_table_attach_defaults (GTK_TABLE (table),
+					 gtk_button_new_with_label (text),
+					 j % 4, j % 4 + 1, j / 4, j / 4 + 1);
+	      g_free (text);
+	    }
+	}
+    }
+
+  return window;
+}
+
+static void
+flush_updates (GtkWidget *window)
+{
+  gdk_window_process_all_updates ();
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  gdk_display_sync (gtk_widget_get_display (window));
+}
+
+static gdouble
+time_redraws (GtkWidget *window)
+{
+  gint64 start;
+  gint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_REDRAWS; i++)
+    {
+      gtk_widget_queue_draw (window);
+      flush_updates (window);
+    }
+
+  return (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+}
+
+static gdouble
+time_resizes (GtkWidget *window)
+{
+  gint64 start;
+  gint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_SIZES; i++)
+    {
+      /* Grow, then shrink back through the same sizes */
+      gint step = i < N_SIZES / 2 ? i : N_SIZES - 1 - i;
+
+      gtk_window_resize (GTK_WINDOW (window), 400 + 4 * step, 300 + 3 * step);
+      flush_updates (window);
+    }
+
+  return (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window;
+  gboolean use_cache = TRUE;
+  gint i;
+
+  for (i = 1; i < argc; i++)
+    if (strcmp (argv[i], "--no-cache") == 0)
+      use_cache = FALSE;
+
+  if (!use_cache)
+    g_setenv ("GTK_PIXBUF_CACHE_SIZE", "0", TRUE);
+
+  gtk_init (&argc, &argv);
+
+  parse_generated_theme ();
+
+  window = create_window ();
+  gtk_window_set_default_size (GTK_WINDOW (window), 400, 300);
+  gtk_widget_show_all (window);
+  flush_updates (window);
+
+  fprintf (stdout, "render cache: %s\n", use_cache ? "yes" : "no");
+  fprintf (stdout, "%d redraws at one size: %g sec\n",
+	   N_REDRAWS, time_redraws (window));
+  fprintf (stdout, "%d resize steps: %g sec\n",
+	   N_SIZES, time_resizes (window));
+
+  gtk_widget_destroy (window);
+
+  for (i = 0; i < G_N_ELEMENTS (image_files); i++)
+    {
+      g_unlink (image_files[i]);
+      g_free (image_files[i]);
+    }
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* popups - time popping up and down short-lived widgets
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: popups [COUNT]
+ *
+ * Pops up the context menu of an entry and edits a cell of a tree
+ * view COUNT times each (100 by default), and reports how long the
+ * first time took and how long it took on average afterwards. GTK+
+ * reuses the menus and entries for these, so only the first time
+ * constructs them.
+ *
+ * The menu is popped up the way the menu key does it, so the window
+ * of the benchmark must be able to grab the pointer and keyboard.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+popup_entry_menu (GtkWidget *entry,
+		  gpointer   data)
+{
+  gboolean handled;
+  GList *menus;
+
+  g_signal_emit_by_name (entry, "popup-menu", &handled);
+
+  /* The entry asks for the clipboard targets before it pops up */
+  while (TRUE)
+    {
+      menus = gtk_menu_get_for_attach_widget (entry);
+      if (menus && gtk_widget_get_visible (menus->data))
+	break;
+
+      gtk_main_iteration ();
+    }
+
+  gtk_menu_shell_deactivate (GTK_MENU_SHELL (menus->data));
+  flush_events ();
+}
+
+static void
+edit_cell (GtkWidget *tree_view,
+	   gpointer   column)
+{
+  GtkTreePath *path;
+  GtkWidget *editable;
+
+  path = gtk_tree_path_new_first ();
+  gtk_tree_view_set_cursor (GTK_TREE_VIEW (tree_view), path, column, TRUE);
+  gtk_tree_path_free (path);
+
+  editable = gtk_window_get_focus (GTK_WINDOW (gtk_widget_get_toplevel (tree_view)));
+  g_assert (GTK_IS_ENTRY (editable));
+
+  gtk_cell_editable_editing_done (GTK_CELL_EDITABLE (editable));
+  gtk_cell_editable_remove_widget (GTK_CELL_EDITABLE (editable));
+  flush_events ();
+}
+
+typedef void (*PopupFunc) (GtkWidget *widget,
+			   gpointer   data);
+
+static void
+time_popups (const gchar *name,
+	     PopupFunc    func,
+	     GtkWidget   *widget,
+	     gpointer     data,
+	     gint         count)
+{
+  GTimer *timer;
+  gdouble first;
+  gint i;
+
+  timer = g_timer_new ();
+
+  func (widget, data);
+  first = g_timer_elapsed (timer, NULL);
+
+  g_timer_start (timer);
+  for (i = 1; i < count; i++)
+    func (widget, data);
+  g_timer_stop (timer);
+
+  fprintf (stdout, "%s: %g msec the first time, %g msec afterwards\n",
+	   name, first * 1000,
+	   count > 1 ? g_timer_elapsed (timer, NULL) * 1000 / (count - 1) : 0.0);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *vbox, *entry, *tree_view;
+  GtkListStore *store;
+  GtkCellRenderer *renderer;
+  GtkTreeViewColumn *column;
+  gint count;
+
+  gtk_init (&argc, &argv);
+
+  count = argc > 1 ? atoi (argv[1]) : 100;
+  if (count <= 0)
+    {
+      g_printerr ("Usage: %s [COUNT]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  vbox = gtk_vbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (window), vbox);
+
+  entry = gtk_entry_new ();
+  gtk_entry_set_text (GTK_ENTRY (entry), "Some text");
+  gtk_box_pack_start (GTK_BOX (vbox), entry, FALSE, FALSE, 0);
+
+  store = gtk_list_store_new (1, G_TYPE_STRING);
+  gtk_list_store_insert_with_values (store, NULL, 0, 0, "Some text", -1);
+  tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+  g_object_unref (store);
+
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (renderer, "editable", TRUE, NULL);
+  column = gtk_tree_view_column_new_with_attributes ("Text", renderer,
+						     "text", 0, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (tree_view), column);
+  gtk_box_pack_start (GTK_BOX (vbox), tree_view, TRUE, TRUE, 0);
+
+  gtk_widget_show_all (window);
+  flush_events ();
+
+  gtk_widget_grab_focus (entry);
+  time_popups ("entry context menu", popup_entry_menu, entry, NULL, count);
+  time_popups ("cell editing", edit_cell, tree_view, column, count);
+
+  gtk_widget_destroy (window);
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+/* rcstyles - time matching widgets against the styles of a gtkrc theme
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: rcstyles [GTKRC-FILE...]
+ *
+ * Parses the given theme files, or a generated theme with a few
+ * hundred widget, widget_class and class patterns if none are given,
+ * then builds a window with a couple of thousand widgets and times
+ * gtk_rc_get_style() for all of them. The first pass includes the
+ * cost of creating the styles, later passes only the matching.
+ */
+
+#include <stdio.h>
+#include <gtk/gtk.h>
+
+#define N_GENERATED_STYLES 300
+#define N_ROWS             200
+#define N_PASSES           10
+
+static void
+parse_generated_theme (void)
+{
+  static const gchar *types[] = {
+    "GtkButton", "GtkLabel", "GtkEntry", "GtkCheckButton", "GtkFrame",
+    "GtkHBox", "GtkVBox", "GtkScrolledWindow", "GtkToggleButton", "GtkWidget"
+  };
+  GString *theme;
+  gint i;
+
+  theme = g_string_new (NULL);
+  for (i = 0; i < N_GENERATED_STYLES; i++)
+    {
+      const gchar *type = types[i % G_N_ELEMENTS (types)];
+
+      g_string_append_printf (theme,
+			      "style \"style-%d\" { xthickness = %d }\n",
+			      i, i % 4);
+
+      switch (i % 3)
+	{
+	case 0:
+	  g_string_append_printf (theme, "widget \"*.row-%d.*\" style \"style-%d\"\n", i, i);
+	  break;
+	case 1:
+	  g_string_append_printf (theme, "widget_class \"*<GtkFrame>.*.%s\" style \"style-%d\"\n", type, i);
+	  break;
+	case 2:
+	  g_string_append_printf (theme, "class \"%s\" style \"style-%d\"\n", type, i);
+	  break;
+	}
+    }
+
+  gtk_rc_parse_string (theme->str);
+  g_string_free (theme, TRUE);
+}
+
+static void
+collect_widgets (GtkWidget *widget,
+		 gpointer   data)
+{
+  GPtrArray *widgets = data;
+
+  g_ptr_array_add (widgets, widget);
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), collect_widgets, widgets);
+}
+
+static GtkWidget *
+create_row (gint i)
+{
+  GtkWidget *frame, *box, *name;
+
+  frame = gtk_frame_new (NULL);
+  name = g_strdup_printf ("row-%d", i);
+  gtk_widget_set_name (frame, name);
+  g_free (name);
+
+  box = gtk_hbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (frame), box);
+  gtk_box_pack_start (GTK_BOX (box), gtk_label_new ("Label"), FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (box), gtk_entry_new (), TRUE, TRUE, 0);
+  gtk_box_pack_start (GTK_BOX (box), gtk_check_button_new_with_label ("Check"), FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (box), gtk_button_new_with_label ("Button"), FALSE, FALSE, 0);
+
+  return frame;
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *scrolled, *vbox;
+  GPtrArray *widgets;
+  GTimer *timer;
+  gint i, pass;
+
+  gtk_init (&argc, &argv);
+
+  if (argc > 1)
+    for (i = 1; i < argc; i++)
+      gtk_rc_parse (argv[i]);
+  else
+    parse_generated_theme ();
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), scrolled);
+  vbox = gtk_vbox_new (FALSE, 0);
+  gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (scrolled), vbox);
+
+  for (i = 0; i < N_ROWS; i++)
+    gtk_box_pack_start (GTK_BOX (vbox), create_row (i), FALSE, FALSE, 0);
+
+  widgets = g_ptr_array_new ();
+  collect_widgets (window, widgets);
+
+  timer = g_timer_new ();
+  for (pass = 0; pass < N_PASSES; pass++)
+    {
+      g_timer_start (timer);
+      for (i = 0; i < widgets->len; i++)
+	gtk_rc_get_style (g_ptr_array_index (widgets, i));
+      g_timer_stop (timer);
+
+      fprintf (stdout, "pass %d: %u widgets in %g sec\n",
+	       pass, widgets->len, g_timer_elapsed (timer, NULL));
+    }
+
+  g_timer_destroy (timer);
+  g_ptr_array_free (widgets, TRUE);
+  gtk_widget_destroy (window);
+
+  return 0;
+}
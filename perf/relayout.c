@@ -0,0 +1,193 @@
+/* relayout - time the resize of deep widget hierarchies when one leaf changes
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: relayout [DEPTH [FANOUT]]
+ *
+ * Builds a window with boxes nested DEPTH levels deep (20 by default),
+ * each level holding FANOUT labels (10 by default) next to the box of
+ * the next level, and times the resize that follows changing the
+ * deepest label: once setting the same text again, which keeps the
+ * requisition, and once alternating between a short and a long text.
+ * Also reports how many "size-request" and "size-allocate" emissions
+ * a single change costs; these are counted in one extra change after
+ * the timed ones, since connecting handlers to count them keeps the
+ * signals off the fast path of widgets without handlers, should
+ * GTK_SIGNAL_FAST_PATH be set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#define N_CHANGES 1000
+
+static guint n_requests;
+static guint n_allocations;
+
+static void
+count_request (GtkWidget      *widget,
+	       GtkRequisition *requisition,
+	       gpointer        data)
+{
+  n_requests++;
+}
+
+static void
+count_allocation (GtkWidget     *widget,
+		  GtkAllocation *allocation,
+		  gpointer       data)
+{
+  n_allocations++;
+}
+
+static void
+connect_counters (GtkWidget *widget,
+		  gpointer   data)
+{
+  if (GPOINTER_TO_INT (data))
+    {
+      g_signal_connect (widget, "size-request", G_CALLBACK (count_request), NULL);
+      g_signal_connect (widget, "size-allocate", G_CALLBACK (count_allocation), NULL);
+    }
+  else
+    {
+      g_signal_handlers_disconnect_by_func (widget, count_request, NULL);
+      g_signal_handlers_disconnect_by_func (widget, count_allocation, NULL);
+    }
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), connect_counters, data);
+}
+
+static GtkWidget *
+create_hierarchy (gint        depth,
+		  gint        fanout,
+		  GtkWidget **leaf)
+{
+  GtkWidget *box, *child;
+  gint i;
+
+  if (depth % 2)
+    box = gtk_hbox_new (FALSE, 2);
+  else
+    box = gtk_vbox_new (FALSE, 2);
+
+  for (i = 0; i < fanout; i++)
+    {
+      gchar *text = g_strdup_printf ("Label %d.%d", depth, i);
+
+      gtk_box_pack_start (GTK_BOX (box), gtk_label_new (text), FALSE, FALSE, 0);
+      g_free (text);
+    }
+
+  if (depth > 1)
+    child = create_hierarchy (depth - 1, fanout, leaf);
+  else
+    child = *leaf = gtk_label_new ("Leaf");
+
+  gtk_box_pack_start (GTK_BOX (box), child, TRUE, TRUE, 0);
+
+  return box;
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+time_changes (GtkWidget   *window,
+	      GtkWidget   *leaf,
+	      const gchar *name,
+	      const gchar *text1,
+	      const gchar *text2)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  gint i;
+
+  timer = g_timer_new ();
+  elapsed = 0;
+
+  for (i = 0; i < N_CHANGES; i++)
+    {
+      gtk_label_set_text (GTK_LABEL (leaf), i % 2 ? text2 : text1);
+
+      g_timer_start (timer);
+      gtk_container_check_resize (GTK_CONTAINER (window));
+      g_timer_stop (timer);
+      elapsed += g_timer_elapsed (timer, NULL);
+
+      flush_events ();
+    }
+
+  connect_counters (window, GINT_TO_POINTER (TRUE));
+  n_requests = 0;
+  n_allocations = 0;
+  gtk_label_set_text (GTK_LABEL (leaf), i % 2 ? text2 : text1);
+  gtk_container_check_resize (GTK_CONTAINER (window));
+  connect_counters (window, GINT_TO_POINTER (FALSE));
+  flush_events ();
+
+  fprintf (stdout, "%s: %g msec per change, %u size requests, %u size allocations\n",
+	   name, elapsed * 1000 / N_CHANGES, n_requests, n_allocations);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *leaf;
+  gint depth, fanout;
+
+  gtk_init (&argc, &argv);
+
+  depth = argc > 1 ? atoi (argv[1]) : 20;
+  fanout = argc > 2 ? atoi (argv[2]) : 10;
+  if (depth <= 0 || fanout < 0)
+    {
+      g_printerr ("Usage: %s [DEPTH [FANOUT]]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_container_add (GTK_CONTAINER (window),
+		     create_hierarchy (depth, fanout, &leaf));
+  gtk_widget_show_all (window);
+  flush_events ();
+
+  /* Keep the toplevel at its size, so that the allocation happens
+   * right away instead of after the window manager configured it.
+   */
+  gtk_window_resize (GTK_WINDOW (window),
+		     window->allocation.width + 200,
+		     window->allocation.height + 200);
+  flush_events ();
+
+  fprintf (stdout, "depth %d, %d labels per level\n", depth, fanout);
+  time_changes (window, leaf, "same text", "Leaf", "Leaf");
+  time_changes (window, leaf, "different size", "Leaf", "A much longer leaf");
+
+  gtk_widget_destroy (window);
+
+  return 0;
+}
@@ -0,0 +1,162 @@
+/* signals - time the emission of the hot widget signals in a frame
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: signals [SIZE]
+ *
+ * Fills a table with SIZE x SIZE labels (30 by default) and times
+ * frames in which every label gets a size request, a size allocation,
+ * an expose and a motion event. GTK_SIGNAL_FAST_PATH is set, and this
+ * is done once with no handlers connected, where GTK+ calls the class
+ * handlers directly, and once with a blocked handler connected to each
+ * of these signals of each label, which makes GTK+ emit the signals
+ * without running any other code. The difference is the cost of the
+ * signal emissions.
+ *
+ * Run with GTK_DEBUG=signals for the counts and times per signal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#define N_FRAMES 100
+
+static const gchar *hot_signals[] = {
+  "size-request",
+  "size-allocate",
+  "expose-event",
+  "motion-notify-event"
+};
+
+static void
+noop_handler (void)
+{
+}
+
+static void
+connect_blocked_handlers (GtkWidget *label,
+			  gpointer   data)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (hot_signals); i++)
+    {
+      gulong id = g_signal_connect (label, hot_signals[i],
+				    G_CALLBACK (noop_handler), NULL);
+      g_signal_handler_block (label, id);
+    }
+}
+
+static void
+disconnect_handlers (GtkWidget *label,
+		     gpointer   data)
+{
+  g_signal_handlers_disconnect_by_func (label, noop_handler, NULL);
+}
+
+static void
+queue_resize (GtkWidget *label,
+	      gpointer   data)
+{
+  gtk_widget_queue_resize_no_redraw (label);
+}
+
+static void
+send_motion (GtkWidget *label,
+	     gpointer   data)
+{
+  GdkEventMotion event = { 0, };
+
+  event.type = GDK_MOTION_NOTIFY;
+  event.window = label->window;
+  event.x = label->allocation.x + 1;
+  event.y = label->allocation.y + 1;
+
+  gtk_widget_event (label, (GdkEvent *) &event);
+}
+
+static void
+time_frames (GtkWidget   *window,
+	     GtkWidget   *table,
+	     const gchar *name)
+{
+  GTimer *timer;
+  gint i;
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < N_FRAMES; i++)
+    {
+      gtk_container_foreach (GTK_CONTAINER (table), queue_resize, NULL);
+      gtk_container_check_resize (GTK_CONTAINER (window));
+
+      gdk_window_invalidate_rect (window->window, NULL, TRUE);
+      gdk_window_process_updates (window->window, TRUE);
+
+      gtk_container_foreach (GTK_CONTAINER (table), send_motion, NULL);
+    }
+
+  g_timer_stop (timer);
+
+  fprintf (stdout, "%s: %g msec per frame\n",
+	   name, g_timer_elapsed (timer, NULL) * 1000 / N_FRAMES);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *table;
+  gint size, i, j;
+
+  g_setenv ("GTK_SIGNAL_FAST_PATH", "1", TRUE);
+  gtk_init (&argc, &argv);
+
+  size = argc > 1 ? atoi (argv[1]) : 30;
+  if (size <= 0)
+    {
+      g_printerr ("Usage: %s [SIZE]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  table = gtk_table_new (size, size, TRUE);
+  gtk_container_add (GTK_CONTAINER (window), table);
+
+  for (i = 0; i < size; i++)
+    for (j = 0; j < size; j++)
+      gtk_table_attach_defaults (GTK_TABLE (table), gtk_label_new ("00"),
+				 j, j + 1, i, i + 1);
+
+  gtk_widget_show_all (window);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  fprintf (stdout, "%d x %d labels\n", size, size);
+  time_frames (window, table, "class handlers only");
+
+  gtk_container_foreach (GTK_CONTAINER (table), connect_blocked_handlers, NULL);
+  time_frames (window, table, "full emissions");
+  gtk_container_foreach (GTK_CONTAINER (table), disconnect_handlers, NULL);
+
+  gtk_widget_destroy (window);
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+/* sizegroups - time the size negotiation of large forms using size groups
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: sizegroups [N_ROWS]
+ *
+ * Builds a form with N_ROWS rows (500 by default) of a label and an
+ * entry, with the labels in one size group and the entries in another,
+ * and times adding the widgets to the groups, showing the form, and
+ * the resize after changing the text of one label, once keeping the
+ * size of the group and once changing it. Also reports how many labels
+ * get a size request for a single change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#define N_CHANGES 200
+
+static guint n_label_requests;
+
+static void
+count_request (GtkWidget      *widget,
+	       GtkRequisition *requisition,
+	       gpointer        data)
+{
+  n_label_requests++;
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+time_changes (GtkWidget   *window,
+	      GtkWidget   *label,
+	      const gchar *name,
+	      const gchar *text1,
+	      const gchar *text2)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  gint i;
+
+  timer = g_timer_new ();
+  elapsed = 0;
+
+  for (i = 0; i < N_CHANGES; i++)
+    {
+      n_label_requests = 0;
+
+      g_timer_start (timer);
+      gtk_label_set_text (GTK_LABEL (label), i % 2 ? text2 : text1);
+      gtk_container_check_resize (GTK_CONTAINER (window));
+      g_timer_stop (timer);
+      elapsed += g_timer_elapsed (timer, NULL);
+
+      flush_events ();
+    }
+
+  fprintf (stdout, "%s: %g msec per change, %u labels requested\n",
+	   name, elapsed * 1000 / N_CHANGES, n_label_requests);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkWidget *window, *scrolled, *vbox;
+  GtkWidget **labels;
+  GtkSizeGroup *label_group, *entry_group;
+  GTimer *timer;
+  gdouble elapsed;
+  gint n_rows, i;
+
+  gtk_init (&argc, &argv);
+
+  n_rows = argc > 1 ? atoi (argv[1]) : 500;
+  if (n_rows < 2)
+    {
+      g_printerr ("Usage: %s [N_ROWS]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 600, 400);
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), scrolled);
+  vbox = gtk_vbox_new (FALSE, 0);
+  gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (scrolled), vbox);
+
+  label_group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
+  entry_group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
+  labels = g_new (GtkWidget *, n_rows);
+
+  timer = g_timer_new ();
+  elapsed = 0;
+
+  for (i = 0; i < n_rows; i++)
+    {
+      GtkWidget *hbox, *entry;
+      gchar *text;
+
+      hbox = gtk_hbox_new (FALSE, 6);
+      text = g_strdup_printf ("Field number %d:", i);
+      labels[i] = gtk_label_new (text);
+      g_free (text);
+      gtk_misc_set_alignment (GTK_MISC (labels[i]), 0.0, 0.5);
+      entry = gtk_entry_new ();
+      gtk_box_pack_start (GTK_BOX (hbox), labels[i], FALSE, FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (hbox), entry, FALSE, FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 0);
+
+      g_timer_start (timer);
+      gtk_size_group_add_widget (label_group, labels[i]);
+      gtk_size_group_add_widget (entry_group, entry);
+      g_timer_stop (timer);
+      elapsed += g_timer_elapsed (timer, NULL);
+    }
+  fprintf (stdout, "%d rows\n", n_rows);
+  fprintf (stdout, "adding to groups: %g msec\n", elapsed * 1000);
+
+  /* Showing the window does the first size negotiation */
+  g_timer_start (timer);
+  gtk_widget_show_all (window);
+  g_timer_stop (timer);
+  fprintf (stdout, "showing the form: %g msec\n", g_timer_elapsed (timer, NULL) * 1000);
+  flush_events ();
+
+  for (i = 0; i < n_rows; i++)
+    g_signal_connect (labels[i], "size-request",
+		      G_CALLBACK (count_request), NULL);
+
+  time_changes (window, labels[0], "same group size", "Field", "Field 0:");
+  time_changes (window, labels[0], "different group size",
+		"Field", "A field with a much longer label than the others:");
+
+  gtk_widget_destroy (window);
+  g_object_unref (label_group);
+  g_object_unref (entry_group);
+  g_free (labels);
+  g_timer_destroy (timer);
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+/* stresstest-uimanager.c
+ *
+ * Copyright (C) 2011 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Usage: stresstest-uimanager [N_ITEMS]
+ *
+ * Merges a menu with N_ITEMS items (2000 by default) and a toolbar
+ * into a GtkUIManager, then times the updates for what plugins
+ * typically do to such a UI: merging and removing a few items,
+ * inserting and removing an action group, and hiding actions.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#define N_ROUNDS        50
+#define N_PLUGIN_ITEMS  10
+#define N_TOOL_ITEMS    50
+
+static GtkActionGroup *
+create_action_group (const gchar *name,
+		     const gchar *prefix,
+		     gint         n_actions)
+{
+  GtkActionGroup *group;
+  gint i;
+
+  group = gtk_action_group_new (name);
+  for (i = 0; i < n_actions; i++)
+    {
+      gchar *action_name = g_strdup_printf ("%s%d", prefix, i);
+      GtkAction *action = gtk_action_new (action_name, action_name, NULL, NULL);
+
+      gtk_action_group_add_action (group, action);
+      g_object_unref (action);
+      g_free (action_name);
+    }
+
+  return group;
+}
+
+static gchar *
+create_main_ui (gint n_items)
+{
+  GString *ui;
+  gint i;
+
+  ui = g_string_new ("<ui><menubar name='menubar'><menu action='Menu'>");
+  for (i = 0; i < n_items; i++)
+    {
+      if (i > 0 && i % 20 == 0)
+	g_string_append (ui, "<separator/>");
+      if (i == n_items / 2)
+	g_string_append (ui, "<placeholder name='plugins'/>");
+      g_string_append_printf (ui, "<menuitem action='item%d'/>", i);
+    }
+  g_string_append (ui, "</menu></menubar><toolbar name='toolbar'>");
+  for (i = 0; i < MIN (n_items, N_TOOL_ITEMS); i++)
+    g_string_append_printf (ui, "<toolitem action='item%d'/>", i);
+  g_string_append (ui, "</toolbar></ui>");
+
+  return g_string_free (ui, FALSE);
+}
+
+static gchar *
+create_plugin_ui (void)
+{
+  GString *ui;
+  gint i;
+
+  ui = g_string_new ("<ui><menubar name='menubar'><menu action='Menu'>"
+		     "<placeholder name='plugins'>");
+  for (i = 0; i < N_PLUGIN_ITEMS; i++)
+    g_string_append_printf (ui, "<menuitem action='plugin%d'/>", i);
+  g_string_append (ui, "</placeholder></menu></menubar></ui>");
+
+  return g_string_free (ui, FALSE);
+}
+
+static void
+add_widget (GtkUIManager *manager,
+	    GtkWidget    *widget,
+	    GtkWidget    *box)
+{
+  gtk_box_pack_start (GTK_BOX (box), widget, FALSE, FALSE, 0);
+}
+
+static void
+report (const gchar *what,
+	GTimer      *timer,
+	gint         n_rounds)
+{
+  g_print ("%-40s %8.2f ms\n", what,
+	   g_timer_elapsed (timer, NULL) * 1000.0 / n_rounds);
+}
+
+int
+main (int argc, char **argv)
+{
+  GtkUIManager *manager;
+  GtkActionGroup *group, *plugin_group, *extra_group;
+  GtkAction *action;
+  GtkWidget *window, *box;
+  GError *error = NULL;
+  GTimer *timer;
+  gchar *ui, *plugin_ui;
+  guint merge_id;
+  gint n_items, i;
+
+  gtk_init (&argc, &argv);
+
+  n_items = argc > 1 ? atoi (argv[1]) : 2000;
+  if (n_items <= 0)
+    {
+      g_printerr ("Usage: %s [N_ITEMS]\n", argv[0]);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = gtk_vbox_new (FALSE, 0);
+  gtk_container_add (GTK_CONTAINER (window), box);
+
+  manager = gtk_ui_manager_new ();
+  g_signal_connect (manager, "add-widget", G_CALLBACK (add_widget), box);
+
+  group = create_action_group ("main", "item", n_items);
+  action = gtk_action_new ("Menu", "_Menu", NULL, NULL);
+  gtk_action_group_add_action (group, action);
+  g_object_unref (action);
+  gtk_ui_manager_insert_action_group (manager, group, 0);
+
+  plugin_group = create_action_group ("plugin", "plugin", N_PLUGIN_ITEMS);
+  gtk_ui_manager_insert_action_group (manager, plugin_group, -1);
+
+  /* Shadows a few of the actions in the main group */
+  extra_group = create_action_group ("extra", "item", 10);
+
+  timer = g_timer_new ();
+
+  ui = create_main_ui (n_items);
+  g_timer_start (timer);
+  if (!gtk_ui_manager_add_ui_from_string (manager, ui, -1, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  gtk_ui_manager_ensure_update (manager);
+  g_timer_stop (timer);
+  g_print ("%d menu items\n", n_items);
+  report ("initial merge", timer, 1);
+  g_free (ui);
+
+  plugin_ui = create_plugin_ui ();
+  g_timer_start (timer);
+  for (i = 0; i < N_ROUNDS; i++)
+    {
+      merge_id = gtk_ui_manager_add_ui_from_string (manager, plugin_ui, -1, NULL);
+      gtk_ui_manager_ensure_update (manager);
+      gtk_ui_manager_remove_ui (manager, merge_id);
+      gtk_ui_manager_ensure_update (manager);
+    }
+  g_timer_stop (timer);
+  report ("merge and remove plugin items", timer, N_ROUNDS);
+  g_free (plugin_ui);
+
+  g_timer_start (timer);
+  for (i = 0; i < N_ROUNDS; i++)
+    {
+      gtk_ui_manager_insert_action_group (manager, extra_group, 0);
+      gtk_ui_manager_ensure_update (manager);
+      gtk_ui_manager_remove_action_group (manager, extra_group);
+      gtk_ui_manager_ensure_update (manager);
+    }
+  g_timer_stop (timer);
+  report ("insert and remove action group", timer, N_ROUNDS);
+
+  g_timer_start (timer);
+  for (i = 0; i < N_ROUNDS; i++)
+    {
+      gchar *name = g_strdup_printf ("item%d", (i * 37) % n_items);
+
+      action = gtk_action_group_get_action (group, name);
+      gtk_action_set_visible (action, FALSE);
+      gtk_ui_manager_ensure_update (manager);
+      gtk_action_set_visible (action, TRUE);
+      gtk_ui_manager_ensure_update (manager);
+      g_free (name);
+    }
+  g_timer_stop (timer);
+  report ("hide and show action", timer, N_ROUNDS);
+
+  g_timer_destroy (timer);
+  gtk_widget_destroy (window);
+  g_object_unref (manager);
+  g_object_unref (extra_group);
+  g_object_unref (plugin_group);
+  g_object_unref (group);
+
+  return 0;
+}